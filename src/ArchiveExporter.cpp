@@ -0,0 +1,264 @@
+﻿#include "ArchiveExporter.h"
+#include "BlockFormatter.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// 每条备份输出长度的估计，用于预先分配分片缓冲区
+const size_t TEXT_BYTES_PER_BLOCK = 96;
+const size_t JSON_BYTES_PER_BLOCK = 36;
+const size_t RECORD_OVERHEAD = 256;
+
+const char* GeometryName(CardGeometry geometry) {
+    switch (geometry) {
+    case CardGeometry::Mini: return "Mini";
+    case CardGeometry::Classic1K: return "1K";
+    case CardGeometry::Classic2K: return "2K";
+    case CardGeometry::Classic4K: return "4K";
+    }
+    return "?";
+}
+
+void AppendHex(std::string& out, const unsigned char* data, size_t size) {
+    char buffer[CardImage::MAX_UID * 2 + BlockFormatter::COMPACT_HEX_LENGTH];
+    out.append(buffer, BlockFormatter::HexCompact(data, size, buffer));
+}
+
+}  // namespace
+
+void ArchiveExporter::AppendText(const CardImage& image, int64_t timestamp, std::string& out) {
+    // 与 ctime 相同的时间格式（ctime 使用共享缓冲区，不能在多个线程中调用）
+    std::time_t value = static_cast<std::time_t>(timestamp);
+    std::tm tm;
+    localtime_s(&tm, &value);
+    char line[BlockFormatter::MAX_LINE_LENGTH + 32];
+    size_t length = strftime(line, sizeof(line), "%a %b %d %H:%M:%S %Y", &tm);
+
+    out += "PN532 NFC卡片备份\n时间: ";
+    out.append(line, length);
+    out += "\nUID: ";
+    Span<const unsigned char> uid = image.UidView();
+    out.append(line, BlockFormatter::HexSpaced(uid.data(), uid.size(), line, true));
+    out += "\n\n";
+
+    BlockLineStyle style;
+    style.lowercase = true;
+    for (int sector = 0; sector < image.SectorCount(); sector++) {
+        int firstBlock = CardImage::FirstBlockOfSector(sector);
+        if (!image.IsKnown(firstBlock)) {
+            out += "扇区 " + std::to_string(sector) + " (认证失败)\n\n";
+            continue;
+        }
+
+        // 与 BackupCardData 一样只写从扇区开头连续读到的块
+        out += "扇区 " + std::to_string(sector) + " (认证成功)\n";
+        for (int block = 0; block < CardImage::BlocksInSector(sector) && image.IsKnown(firstBlock + block); block++) {
+            int blockNumber = firstBlock + block;
+            const unsigned char* data = image.Block(blockNumber).data();
+            length = snprintf(line, sizeof(line), "  块 %d (%d): ", block, blockNumber);
+            length += BlockFormatter::Line(data, CardImage::IsTrailer(blockNumber), line + length, style);
+            line[length++] = '\n';
+            out.append(line, length);
+        }
+        out += '\n';
+    }
+}
+
+void ArchiveExporter::AppendJson(const CardImage& image, int64_t timestamp, uint64_t offset, bool complete,
+    std::string& out) {
+    char number[64];
+    out += "{\"uid\":\"";
+    Span<const unsigned char> uid = image.UidView();
+    AppendHex(out, uid.data(), uid.size());
+    snprintf(number, sizeof(number), "\",\"time\":%lld,\"offset\":%llu,\"complete\":",
+        static_cast<long long>(timestamp), static_cast<unsigned long long>(offset));
+    out += number;
+    out += complete ? "true" : "false";
+    snprintf(number, sizeof(number), ",\"geometry\":\"%s\",\"atqa\":\"%04X\",\"sak\":\"%02X\",\"blocks\":[",
+        GeometryName(image.Geometry()), image.Atqa(), image.Sak());
+    out += number;
+
+    for (int block = 0; block < image.BlockCount(); block++) {
+        if (block > 0) {
+            out += ',';
+        }
+        if (!image.IsKnown(block)) {
+            out += "null";
+            continue;
+        }
+        out += '"';
+        AppendHex(out, image.Block(block).data(), 16);
+        out += '"';
+    }
+
+    out += "],\"keys\":[";
+    for (int sector = 0; sector < image.SectorCount(); sector++) {
+        if (sector > 0) {
+            out += ',';
+        }
+        const SectorKeyInfo& key = image.SectorKey(sector);
+        if (!key.known) {
+            out += "null";
+            continue;
+        }
+        out += key.keyType == 0x61 ? "{\"type\":\"B\",\"key\":\"" : "{\"type\":\"A\",\"key\":\"";
+        AppendHex(out, key.key.data(), key.key.size());
+        out += "\"}";
+    }
+    out += "]}\n";
+}
+
+bool ArchiveExporter::Export(const BackupArchive& archive, const ExportOptions& options, ExportStats* stats) {
+    auto start = std::chrono::steady_clock::now();
+    ExportStats result;
+    if (!archive.IsOpen() || options.output.empty()) {
+        return false;
+    }
+
+    std::vector<ArchiveEntry> entries;
+    archive.Entries([&entries](const ArchiveEntry& entry, const std::vector<unsigned char>&) {
+        entries.push_back(entry);
+        return true;
+    }, options.latestOnly);
+
+    const bool text = options.format == ExportFormat::Text;
+    std::ofstream stream;
+    if (text) {
+        std::error_code error;
+        std::filesystem::create_directories(options.output, error);
+        if (!std::filesystem::is_directory(options.output, error)) {
+            return false;
+        }
+    }
+    else {
+        stream.open(options.output, std::ios::binary | std::ios::trunc);
+        if (!stream.is_open()) {
+            return false;
+        }
+        result.files = 1;
+    }
+
+    const size_t shardRecords = std::max<size_t>(options.recordsPerShard, 1);
+    const size_t shardCount = (entries.size() + shardRecords - 1) / shardRecords;
+    unsigned threadCount = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threadCount = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threadCount, shardCount)));
+    result.threads = threadCount;
+
+    // 分片缓冲区：工作线程写入后标记完成，调用线程按顺序写出并释放
+    struct Shard {
+        std::string output;
+        uint64_t records = 0;
+        uint64_t failed = 0;
+        bool done = false;
+    };
+    std::vector<Shard> shards(shardCount);
+    const size_t maxAhead = static_cast<size_t>(threadCount) * 4;
+    std::mutex shardMutex;
+    std::condition_variable shardDone;
+    std::condition_variable shardWritten;
+    std::atomic<size_t> nextShard(0);
+    size_t written = 0;
+    bool cancelled = false;
+
+    auto worker = [&]() {
+        CardImage image;
+        for (;;) {
+            size_t index = nextShard.fetch_add(1);
+            if (index >= shardCount) {
+                return;
+            }
+            {
+                std::unique_lock<std::mutex> lock(shardMutex);
+                shardWritten.wait(lock, [&] { return cancelled || index < written + maxAhead; });
+                if (cancelled) {
+                    return;
+                }
+            }
+
+            Shard& shard = shards[index];
+            size_t first = index * shardRecords;
+            size_t last = std::min(first + shardRecords, entries.size());
+            shard.output.reserve((last - first) *
+                (RECORD_OVERHEAD + CardImage::MAX_BLOCKS / 4 * (text ? TEXT_BYTES_PER_BLOCK : JSON_BYTES_PER_BLOCK)));
+            for (size_t i = first; i < last; i++) {
+                int64_t timestamp = 0;
+                if (!archive.Load(entries[i].offset, image, &timestamp)) {
+                    shard.failed++;
+                    continue;
+                }
+                if (text) {
+                    AppendText(image, timestamp, shard.output);
+                }
+                else {
+                    AppendJson(image, timestamp, entries[i].offset, entries[i].complete, shard.output);
+                }
+                shard.records++;
+            }
+
+            std::lock_guard<std::mutex> lock(shardMutex);
+            shard.done = true;
+            shardDone.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threadCount; i++) {
+        workers.emplace_back(worker);
+    }
+
+    bool ok = true;
+    for (size_t index = 0; index < shardCount; index++) {
+        std::string output;
+        {
+            std::unique_lock<std::mutex> lock(shardMutex);
+            shardDone.wait(lock, [&] { return shards[index].done; });
+            output.swap(shards[index].output);
+        }
+
+        if (text) {
+            char name[32];
+            snprintf(name, sizeof(name), "export_%05zu.txt", index);
+            std::ofstream file(std::filesystem::path(options.output) / name, std::ios::binary | std::ios::trunc);
+            ok = file.is_open() && file.write(output.data(), output.size()).good();
+            result.files++;
+        }
+        else {
+            ok = stream.write(output.data(), output.size()).good();
+        }
+        result.records += shards[index].records;
+        result.failed += shards[index].failed;
+        result.bytes += output.size();
+
+        std::lock_guard<std::mutex> lock(shardMutex);
+        written = index + 1;
+        cancelled = !ok;
+        shardWritten.notify_all();
+        if (!ok) {
+            break;
+        }
+    }
+
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    if (!text) {
+        stream.close();
+        ok = ok && !stream.fail();
+    }
+
+    result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (stats) {
+        *stats = result;
+    }
+    return ok;
+}
@@ -0,0 +1,41 @@
+﻿#pragma once
+#include "BackupArchive.h"
+#include "CardImage.h"
+#include <cstdint>
+#include <string>
+
+// 导出格式
+enum class ExportFormat {
+    Text,       // 与 BackupCardData 相同的文本布局，按顺序分成多个文件
+    JsonLines,  // 每行一个 JSON 对象的单个文件
+};
+
+struct ExportOptions {
+    ExportFormat format = ExportFormat::JsonLines;
+    std::string output;           // Text：输出目录；JsonLines：输出文件
+    unsigned threads = 0;         // 0 = 按 CPU 核数
+    bool latestOnly = false;      // 只导出每张卡片的最新备份
+    size_t recordsPerShard = 256; // 每个分片（一个工作单元，Text 格式下一个文件）的备份数
+};
+
+struct ExportStats {
+    uint64_t records = 0;  // 已导出
+    uint64_t failed = 0;   // 读取失败而跳过
+    uint64_t bytes = 0;    // 写出的字节数
+    uint64_t files = 0;
+    unsigned threads = 0;
+    double elapsedMs = 0;
+};
+
+// 备份归档的并行导出
+// 按包文件顺序把备份分成分片，由线程池并行读取和格式化（每个分片写入预先分配的缓冲区），
+// 调用线程按分片顺序写出：JsonLines 追加到同一个文件，Text 每个分片一个文件（export_00000.txt、...）。
+// 输出内容与线程数无关；已完成但尚未轮到写出的分片数有上限，内存占用不随归档大小增长。
+class ArchiveExporter {
+public:
+    static bool Export(const BackupArchive& archive, const ExportOptions& options, ExportStats* stats = nullptr);
+
+    // 单个镜像的格式化，追加到 out
+    static void AppendText(const CardImage& image, int64_t timestamp, std::string& out);
+    static void AppendJson(const CardImage& image, int64_t timestamp, uint64_t offset, bool complete, std::string& out);
+};
@@ -0,0 +1,966 @@
+﻿#include "BackupArchive.h"
+#include "CardDumpFile.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// 包文件：16字节文件头（"PNPK"、u32 版本）+ 依次追加的记录
+const unsigned char PACK_MAGIC[4] = { 'P', 'N', 'P', 'K' };
+const uint32_t PACK_VERSION = 2;
+const uint64_t PACK_HEADER_SIZE = 16;
+
+// 记录头（48字节）：
+//   0 类型  4 u32 内容长度  8 u64 同一UID的上一条记录  16 i64 时间
+//   24 u8 UID长度  25 u8[10] UID  35 u8 标志（bit0 完整）  36 u32 内容CRC  40 保留  44 u32 记录头CRC
+// 类型 "PNRC"：内容为完整的 CardDumpFile 镜像（版本1写入的记录）
+// 类型 "PNRD"：去重镜像，内容为：
+//   0 u8 容量  1 u8 SAK  2 u16 ATQA  4 u16 数据分片数  6 u16 密钥分片数  8 u16 新分片数  10 保留
+//   12 已知块位图（(块数+7)/8 字节）  之后 u32 × (数据分片数 + 密钥分片数) 各分片位置 / 16
+//   最后是本记录新增的分片（每个64字节，在包文件中按16字节对齐，前面补0），其他记录可以引用
+const unsigned char RECORD_IMAGE[4] = { 'P', 'N', 'R', 'C' };
+const unsigned char RECORD_DEDUP[4] = { 'P', 'N', 'R', 'D' };
+const size_t RECORD_HEADER_SIZE = 48;
+const size_t DEDUP_HEADER_SIZE = 12;
+const size_t KEY_RECORD_SIZE = 8;
+const size_t REF_SIZE = 4;
+const int CHUNK_ALIGN_SHIFT = 4;                                     // 分片位置按16字节对齐
+const uint64_t MAX_CHUNK_OFFSET = 0xFFFFFFFFull << CHUNK_ALIGN_SHIFT;  // u32 引用可寻址 64GB
+
+// 卡片索引文件：64字节头 + 槽位数组（槽位数为2的幂）
+//   0 "PNIX"  4 u32 版本  8 u32 状态（1 = 正在更新）  16 u64 槽位数  24 u64 已用槽位
+//   32 u64 记录数  40 u64 已索引的包文件长度
+// 槽位（32字节）：0 u8 UID长度（0 = 空）  1 u8[10] UID  16 u64 最新记录  24 u64 记录数
+const unsigned char INDEX_MAGIC[4] = { 'P', 'N', 'I', 'X' };
+const uint32_t INDEX_VERSION = 1;
+const size_t INDEX_HEADER_SIZE = 64;
+const size_t SLOT_SIZE = 32;
+const uint64_t INITIAL_SLOTS = 1024;
+
+// 分片索引文件：64字节头（"PNPL"、u32 版本、16 u64 槽位数、24 u64 已用槽位）+ 槽位数组
+// 槽位（16字节）：0 u64 内容哈希  8 u64 分片位置（0 = 空）
+const unsigned char POOL_MAGIC[4] = { 'P', 'N', 'P', 'L' };
+const uint32_t POOL_VERSION = 1;
+const size_t POOL_SLOT_SIZE = 16;
+const uint64_t INITIAL_POOL_SLOTS = 4096;
+
+// Windows 平台均为小端序，直接按内存布局读写
+uint16_t Get16(const unsigned char* p) { uint16_t v; std::memcpy(&v, p, 2); return v; }
+uint32_t Get32(const unsigned char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+uint64_t Get64(const unsigned char* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+void Put16(unsigned char* p, uint16_t v) { std::memcpy(p, &v, 2); }
+void Put32(unsigned char* p, uint32_t v) { std::memcpy(p, &v, 4); }
+void Put64(unsigned char* p, uint64_t v) { std::memcpy(p, &v, 8); }
+
+uint64_t HashBytes(const unsigned char* data, size_t length) {
+    uint64_t hash = 14695981039346656037ull;  // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool SlotMatches(const unsigned char* slot, const std::vector<unsigned char>& uid) {
+    return slot[0] == uid.size() && std::memcmp(slot + 1, uid.data(), uid.size()) == 0;
+}
+
+bool ReadHandleAt(HANDLE handle, uint64_t offset, void* buffer, size_t size) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD transferred = 0;
+    return ReadFile(handle, buffer, static_cast<DWORD>(size), &transferred, &overlapped) && transferred == size;
+}
+
+bool GetHandleSize(HANDLE handle, uint64_t& size) {
+    LARGE_INTEGER value;
+    if (!GetFileSizeEx(handle, &value)) {
+        return false;
+    }
+    size = static_cast<uint64_t>(value.QuadPart);
+    return true;
+}
+
+bool SetHandleSize(HANDLE handle, uint64_t size) {
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<long long>(size);
+    return SetFilePointerEx(handle, position, NULL, FILE_BEGIN) && SetEndOfFile(handle);
+}
+
+// 检查已有索引文件的头部：魔数、版本、槽位数为2的幂且与文件长度一致
+bool CheckIndexHeader(HANDLE file, const unsigned char* magic, uint32_t version, size_t slotSize,
+    uint64_t minSlots, unsigned char* header) {
+    uint64_t size = 0;
+    if (!GetHandleSize(file, size) || size < INDEX_HEADER_SIZE || !ReadHandleAt(file, 0, header, INDEX_HEADER_SIZE) ||
+        std::memcmp(header, magic, 4) != 0 || Get32(header + 4) != version) {
+        return false;
+    }
+    uint64_t slotCount = Get64(header + 16);
+    return slotCount >= minSlots && (slotCount & (slotCount - 1)) == 0 && size == INDEX_HEADER_SIZE + slotCount * slotSize;
+}
+
+// 槽位数翻倍并重新插入，头部其他字段保持不变；slotHash 对空槽位返回 false
+template <typename Index, typename SlotHash>
+bool GrowTable(Index& index, size_t slotSize, SlotHash slotHash) {
+    uint64_t slotCount = Get64(index.view + 16);
+    std::vector<unsigned char> old(index.view, index.view + INDEX_HEADER_SIZE + slotCount * slotSize);
+    if (!index.Reset(INDEX_HEADER_SIZE + slotCount * 2 * slotSize)) {
+        return false;
+    }
+    std::memcpy(index.view, old.data(), INDEX_HEADER_SIZE);
+    Put64(index.view + 16, slotCount * 2);
+
+    uint64_t mask = slotCount * 2 - 1;
+    unsigned char* slots = index.view + INDEX_HEADER_SIZE;
+    std::vector<unsigned char> empty(slotSize, 0);
+    for (uint64_t i = 0; i < slotCount; i++) {
+        const unsigned char* slot = old.data() + INDEX_HEADER_SIZE + i * slotSize;
+        uint64_t hash = 0;
+        if (!slotHash(slot, hash)) {
+            continue;
+        }
+        uint64_t position = hash & mask;
+        while (std::memcmp(slots + position * slotSize, empty.data(), slotSize) != 0) {
+            position = (position + 1) & mask;
+        }
+        std::memcpy(slots + position * slotSize, slot, slotSize);
+    }
+    return true;
+}
+
+bool UidSlotHash(const unsigned char* slot, uint64_t& hash) {
+    hash = HashBytes(slot + 1, slot[0]);
+    return slot[0] != 0;
+}
+
+bool ChunkSlotHash(const unsigned char* slot, uint64_t& hash) {
+    hash = Get64(slot);
+    return Get64(slot + 8) != 0;
+}
+
+}  // namespace
+
+BackupArchive::BackupArchive()
+    : pack(INVALID_HANDLE_VALUE), readOnly(false), packSize(0) {
+}
+
+BackupArchive::~BackupArchive() {
+    Close();
+}
+
+// =================================================================
+// 索引文件映射
+// =================================================================
+
+// 写入方允许其他进程只读打开；只读打开时索引文件不存在也成功，之后按损坏处理（在内存中重建）
+bool BackupArchive::MappedIndex::Open(const std::string& path) {
+    if (readOnly) {
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, NULL);
+        return true;
+    }
+    file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    return file != INVALID_HANDLE_VALUE;
+}
+
+bool BackupArchive::MappedIndex::Map(uint64_t size) {
+    if (readOnly) {
+        copy.resize(static_cast<size_t>(size));
+        if (!ReadHandleAt(file, 0, copy.data(), copy.size())) {
+            copy.clear();
+            return false;
+        }
+        view = copy.data();
+        return true;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+        static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), NULL);
+    if (mapping == NULL) {
+        return false;
+    }
+    view = static_cast<unsigned char*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<size_t>(size)));
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        mapping = NULL;
+        return false;
+    }
+    return true;
+}
+
+void BackupArchive::MappedIndex::Unmap() {
+    if (readOnly) {
+        view = nullptr;
+        std::vector<unsigned char>().swap(copy);
+        return;
+    }
+    if (view) {
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+    if (mapping != NULL) {
+        CloseHandle(mapping);
+        mapping = NULL;
+    }
+}
+
+bool BackupArchive::MappedIndex::Reset(uint64_t size) {
+    Unmap();
+    if (readOnly) {
+        copy.assign(static_cast<size_t>(size), 0);
+        view = copy.data();
+        return true;
+    }
+    return SetHandleSize(file, 0) && Map(size);
+}
+
+void BackupArchive::MappedIndex::Flush() {
+    if (readOnly) {
+        return;
+    }
+    FlushViewOfFile(view, 0);
+    FlushFileBuffers(file);
+}
+
+void BackupArchive::MappedIndex::CloseFile() {
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+}
+
+void BackupArchive::MappedIndex::Close() {
+    Unmap();
+    CloseFile();
+}
+
+// =================================================================
+// 包文件
+// =================================================================
+
+bool BackupArchive::ReadAt(uint64_t offset, void* buffer, size_t size) const {
+    return ReadHandleAt(pack, offset, buffer, size);
+}
+
+bool BackupArchive::WriteAt(uint64_t offset, const void* buffer, size_t size) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD transferred = 0;
+    return WriteFile(pack, buffer, static_cast<DWORD>(size), &transferred, &overlapped) && transferred == size;
+}
+
+bool BackupArchive::ReadRecordHeader(uint64_t offset, RecordHeader& header) const {
+    unsigned char raw[RECORD_HEADER_SIZE];
+    if (offset < PACK_HEADER_SIZE || offset + RECORD_HEADER_SIZE > packSize || !ReadAt(offset, raw, sizeof(raw))) {
+        return false;
+    }
+    return ParseRecordHeader(raw, offset, header);
+}
+
+bool BackupArchive::ParseRecordHeader(const unsigned char* raw, uint64_t offset, RecordHeader& header) const {
+    if ((std::memcmp(raw, RECORD_IMAGE, 4) != 0 && std::memcmp(raw, RECORD_DEDUP, 4) != 0) ||
+        Get32(raw + 44) != CardDumpFile::Checksum(raw, 44) || raw[24] == 0 || raw[24] > CardImage::MAX_UID) {
+        return false;
+    }
+
+    header.type = Get32(raw);
+    header.payloadSize = Get32(raw + 4);
+    header.prevOffset = Get64(raw + 8);
+    header.timestamp = static_cast<int64_t>(Get64(raw + 16));
+    header.uid.assign(raw + 25, raw + 25 + raw[24]);
+    header.complete = (raw[35] & 0x01) != 0;
+    header.payloadCrc = Get32(raw + 36);
+    return offset + RECORD_HEADER_SIZE + header.payloadSize <= packSize;
+}
+
+bool BackupArchive::ReadPayload(uint64_t offset, const RecordHeader& header, std::vector<unsigned char>& payload) const {
+    payload.resize(header.payloadSize);
+    return ReadAt(offset + RECORD_HEADER_SIZE, payload.data(), payload.size()) &&
+        CardDumpFile::Checksum(payload.data(), payload.size()) == header.payloadCrc;
+}
+
+bool BackupArchive::ReadChunk(uint64_t offset, unsigned char* chunk) const {
+    return offset >= PACK_HEADER_SIZE + RECORD_HEADER_SIZE && offset + CHUNK_SIZE <= packSize &&
+        ReadAt(offset, chunk, CHUNK_SIZE);
+}
+
+// 还原一条记录的镜像（payloadOffset 为内容在包文件中的位置，本记录新增的分片直接从 payload 取）
+bool BackupArchive::DecodeImage(const RecordHeader& header, uint64_t payloadOffset,
+    const std::vector<unsigned char>& payload, CardImage& image) const {
+    if (header.type == Get32(RECORD_IMAGE)) {
+        return CardDumpFile::Deserialize(payload.data(), payload.size(), image);
+    }
+
+    if (payload.size() < DEDUP_HEADER_SIZE || payload[0] > static_cast<unsigned char>(CardGeometry::Classic4K)) {
+        return false;
+    }
+    CardGeometry geometry = static_cast<CardGeometry>(payload[0]);
+    int blockCount = CardImage::BlockCountOf(geometry);
+    int sectorCount = CardImage::SectorCountOf(geometry);
+    size_t dataChunks = Get16(payload.data() + 4);
+    size_t keyChunks = Get16(payload.data() + 6);
+    size_t bitmapSize = (blockCount + 7) / 8;
+    size_t refsStart = DEDUP_HEADER_SIZE + bitmapSize;
+    if (dataChunks * CHUNK_SIZE != static_cast<size_t>(blockCount) * 16 ||
+        keyChunks * CHUNK_SIZE < sectorCount * KEY_RECORD_SIZE ||
+        payload.size() < refsStart + (dataChunks + keyChunks) * REF_SIZE) {
+        return false;
+    }
+
+    // 分片依次拼接：先是全部块，再是密钥表
+    std::vector<unsigned char> content((dataChunks + keyChunks) * CHUNK_SIZE);
+    for (size_t i = 0; i < dataChunks + keyChunks; i++) {
+        uint64_t chunkOffset = static_cast<uint64_t>(Get32(payload.data() + refsStart + i * REF_SIZE)) << CHUNK_ALIGN_SHIFT;
+        unsigned char* target = content.data() + i * CHUNK_SIZE;
+        if (chunkOffset >= payloadOffset && chunkOffset + CHUNK_SIZE <= payloadOffset + payload.size()) {
+            std::memcpy(target, payload.data() + (chunkOffset - payloadOffset), CHUNK_SIZE);
+        }
+        else if (!ReadChunk(chunkOffset, target)) {
+            return false;
+        }
+    }
+
+    CardImage decoded(geometry);
+    decoded.SetUid(header.uid);
+    decoded.SetTargetInfo(Get16(payload.data() + 2), payload[1]);
+    for (int block = 0; block < blockCount; block++) {
+        if (payload[DEDUP_HEADER_SIZE + block / 8] & (1 << (block % 8))) {
+            decoded.StoreRead(block, content.data() + block * 16);
+        }
+    }
+    const unsigned char* keys = content.data() + dataChunks * CHUNK_SIZE;
+    for (int sector = 0; sector < sectorCount; sector++) {
+        const unsigned char* record = keys + sector * KEY_RECORD_SIZE;
+        if (record[0] & 0x01) {
+            decoded.SetSectorKey(sector, record[1], record + 2);
+        }
+    }
+    image = decoded;
+    return true;
+}
+
+// 检查一条记录的第 block 块（去重记录只取所在的分片，分片外的块按位置缓存结果）
+bool BackupArchive::RecordBlockMatches(const RecordHeader& header, uint64_t payloadOffset, const unsigned char* payload,
+    int block, const BlockPattern& pattern, std::unordered_map<uint64_t, bool>& chunkMatches) const {
+    if (header.type == Get32(RECORD_IMAGE)) {
+        CardImage image;
+        return CardDumpFile::Deserialize(payload, header.payloadSize, image) && block < image.BlockCount() &&
+            image.IsKnown(block) && pattern.Matches(image.Block(block));
+    }
+
+    if (header.payloadSize < DEDUP_HEADER_SIZE || payload[0] > static_cast<unsigned char>(CardGeometry::Classic4K)) {
+        return false;
+    }
+    int blockCount = CardImage::BlockCountOf(static_cast<CardGeometry>(payload[0]));
+    size_t refsStart = DEDUP_HEADER_SIZE + (blockCount + 7) / 8;
+    size_t refPosition = refsStart + (block * 16 / CHUNK_SIZE) * REF_SIZE;
+    if (block >= blockCount || refPosition + REF_SIZE > header.payloadSize ||
+        !(payload[DEDUP_HEADER_SIZE + block / 8] & (1 << (block % 8)))) {
+        return false;
+    }
+
+    uint64_t blockOffset = (static_cast<uint64_t>(Get32(payload + refPosition)) << CHUNK_ALIGN_SHIFT) + (block * 16) % CHUNK_SIZE;
+    if (blockOffset >= payloadOffset && blockOffset + 16 <= payloadOffset + header.payloadSize) {
+        return pattern.Matches(payload + (blockOffset - payloadOffset));
+    }
+
+    auto cached = chunkMatches.find(blockOffset);
+    if (cached != chunkMatches.end()) {
+        return cached->second;
+    }
+    unsigned char data[16];
+    bool matches = blockOffset + 16 <= packSize && ReadAt(blockOffset, data, sizeof(data)) && pattern.Matches(data);
+    chunkMatches.emplace(blockOffset, matches);
+    return matches;
+}
+
+bool BackupArchive::TruncatePack(uint64_t size) {
+    if (!SetHandleSize(pack, size)) {
+        return false;
+    }
+    packSize = size;
+    return true;
+}
+
+// =================================================================
+// 索引
+// =================================================================
+
+// 清空两个索引（填好之前卡片索引一直标记为正在更新）
+bool BackupArchive::CreateIndexes() {
+    if (!uidIndex.Reset(INDEX_HEADER_SIZE + INITIAL_SLOTS * SLOT_SIZE) ||
+        !chunkIndex.Reset(INDEX_HEADER_SIZE + INITIAL_POOL_SLOTS * POOL_SLOT_SIZE)) {
+        return false;
+    }
+    std::memcpy(uidIndex.view, INDEX_MAGIC, 4);
+    Put32(uidIndex.view + 4, INDEX_VERSION);
+    Put32(uidIndex.view + 8, 1);
+    Put64(uidIndex.view + 16, INITIAL_SLOTS);
+    Put64(uidIndex.view + 40, PACK_HEADER_SIZE);
+
+    std::memcpy(chunkIndex.view, POOL_MAGIC, 4);
+    Put32(chunkIndex.view + 4, POOL_VERSION);
+    Put64(chunkIndex.view + 16, INITIAL_POOL_SLOTS);
+    return true;
+}
+
+// 扩容时卡片索引已标记为正在更新，中途崩溃会在下次打开时重建
+bool BackupArchive::GrowUidIndex() {
+    return GrowTable(uidIndex, SLOT_SIZE, UidSlotHash);
+}
+
+bool BackupArchive::GrowChunkIndex() {
+    return GrowTable(chunkIndex, POOL_SLOT_SIZE, ChunkSlotHash);
+}
+
+unsigned char* BackupArchive::FindSlot(const std::vector<unsigned char>& uid, bool create) {
+    // 装载率超过 70% 时扩容，保证探测长度为常数
+    if (create && (Get64(uidIndex.view + 24) + 1) * 10 > Get64(uidIndex.view + 16) * 7 && !GrowUidIndex()) {
+        return nullptr;
+    }
+
+    uint64_t mask = Get64(uidIndex.view + 16) - 1;
+    uint64_t position = HashBytes(uid.data(), uid.size()) & mask;
+    while (true) {
+        unsigned char* slot = uidIndex.view + INDEX_HEADER_SIZE + position * SLOT_SIZE;
+        if (slot[0] == 0) {
+            if (!create) {
+                return nullptr;
+            }
+            slot[0] = static_cast<unsigned char>(uid.size());
+            std::memcpy(slot + 1, uid.data(), uid.size());
+            Put64(slot + 16, NO_RECORD);
+            Put64(uidIndex.view + 24, Get64(uidIndex.view + 24) + 1);
+            return slot;
+        }
+        if (SlotMatches(slot, uid)) {
+            return slot;
+        }
+        position = (position + 1) & mask;
+    }
+}
+
+const unsigned char* BackupArchive::FindSlot(const std::vector<unsigned char>& uid) const {
+    if (uid.empty() || uid.size() > CardImage::MAX_UID) {
+        return nullptr;
+    }
+    uint64_t mask = Get64(uidIndex.view + 16) - 1;
+    uint64_t position = HashBytes(uid.data(), uid.size()) & mask;
+    while (true) {
+        const unsigned char* slot = uidIndex.view + INDEX_HEADER_SIZE + position * SLOT_SIZE;
+        if (slot[0] == 0) {
+            return nullptr;
+        }
+        if (SlotMatches(slot, uid)) {
+            return slot;
+        }
+        position = (position + 1) & mask;
+    }
+}
+
+// 按内容查找已存的分片，哈希相同时读出比较，返回位置（没有时为0）
+uint64_t BackupArchive::FindChunk(const unsigned char* chunk, uint64_t hash) const {
+    uint64_t mask = Get64(chunkIndex.view + 16) - 1;
+    uint64_t position = hash & mask;
+    unsigned char stored[CHUNK_SIZE];
+    while (true) {
+        const unsigned char* slot = chunkIndex.view + INDEX_HEADER_SIZE + position * POOL_SLOT_SIZE;
+        uint64_t offset = Get64(slot + 8);
+        if (offset == 0) {
+            return 0;
+        }
+        if (Get64(slot) == hash && ReadChunk(offset, stored) && std::memcmp(stored, chunk, CHUNK_SIZE) == 0) {
+            return offset;
+        }
+        position = (position + 1) & mask;
+    }
+}
+
+bool BackupArchive::IndexRecord(uint64_t offset, const RecordHeader& header) {
+    unsigned char* slot = FindSlot(header.uid, true);
+    if (slot == nullptr) {
+        return false;
+    }
+    Put64(slot + 16, offset);
+    Put64(slot + 24, Get64(slot + 24) + 1);
+    Put64(uidIndex.view + 32, Get64(uidIndex.view + 32) + 1);
+    return true;
+}
+
+bool BackupArchive::IndexChunk(uint64_t offset, uint64_t hash) {
+    if ((Get64(chunkIndex.view + 24) + 1) * 10 > Get64(chunkIndex.view + 16) * 7 && !GrowChunkIndex()) {
+        return false;
+    }
+
+    uint64_t mask = Get64(chunkIndex.view + 16) - 1;
+    uint64_t position = hash & mask;
+    unsigned char* slot = chunkIndex.view + INDEX_HEADER_SIZE + position * POOL_SLOT_SIZE;
+    while (Get64(slot + 8) != 0) {
+        position = (position + 1) & mask;
+        slot = chunkIndex.view + INDEX_HEADER_SIZE + position * POOL_SLOT_SIZE;
+    }
+    Put64(slot, hash);
+    Put64(slot + 8, offset);
+    Put64(chunkIndex.view + 24, Get64(chunkIndex.view + 24) + 1);
+    return true;
+}
+
+void BackupArchive::SetIndexState(uint32_t state) {
+    Put32(uidIndex.view + 8, state);
+    if (!readOnly) {
+        FlushViewOfFile(uidIndex.view, INDEX_HEADER_SIZE);
+    }
+}
+
+void BackupArchive::FlushIndexes() {
+    chunkIndex.Flush();
+    uidIndex.Flush();
+}
+
+// =================================================================
+// 恢复
+// =================================================================
+
+// 从包文件重建索引
+bool BackupArchive::Rebuild() {
+    if (!CreateIndexes()) {
+        return false;
+    }
+    return Replay(PACK_HEADER_SIZE);
+}
+
+// 把 from 之后的完整记录（及其新增的分片）加入索引，截掉不完整或损坏的尾部
+// （只读时不截，只把可见的长度停在最后一条完整记录之后：尾部可能是写入方正在追加的记录）
+bool BackupArchive::Replay(uint64_t from) {
+    SetIndexState(1);
+
+    uint64_t offset = from;
+    RecordHeader header;
+    std::vector<unsigned char> payload;
+    while (ReadRecordHeader(offset, header) && ReadPayload(offset, header, payload)) {
+        if (header.type == Get32(RECORD_DEDUP)) {
+            if (payload.size() < DEDUP_HEADER_SIZE) {
+                break;
+            }
+            size_t newChunks = Get16(payload.data() + 8);
+            if (newChunks * CHUNK_SIZE > payload.size()) {
+                break;
+            }
+            size_t chunkStart = payload.size() - newChunks * CHUNK_SIZE;
+            for (size_t i = 0; i < newChunks; i++) {
+                const unsigned char* chunk = payload.data() + chunkStart + i * CHUNK_SIZE;
+                if (!IndexChunk(offset + RECORD_HEADER_SIZE + chunkStart + i * CHUNK_SIZE, HashBytes(chunk, CHUNK_SIZE))) {
+                    return false;
+                }
+            }
+        }
+        if (!IndexRecord(offset, header)) {
+            return false;
+        }
+        offset += RECORD_HEADER_SIZE + header.payloadSize;
+    }
+    if (readOnly) {
+        packSize = offset;
+    }
+    else if (offset < packSize && (!TruncatePack(offset) || !FlushFileBuffers(pack))) {
+        return false;
+    }
+
+    Put64(uidIndex.view + 40, offset);
+    FlushIndexes();
+    SetIndexState(0);
+    return true;
+}
+
+// =================================================================
+// 公开接口
+// =================================================================
+
+bool BackupArchive::Open(const std::string& packPath, bool readOnlyMode) {
+    std::lock_guard<std::shared_mutex> lock(archiveMutex);
+    CloseHandles();
+    readOnly = readOnlyMode;
+    uidIndex.readOnly = readOnly;
+    chunkIndex.readOnly = readOnly;
+
+    // 写入方独占写、允许他人读；只读方两者都允许，读卡程序先开后开都不冲突
+    pack = readOnly ?
+        CreateFileA(packPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL) :
+        CreateFileA(packPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (pack == INVALID_HANDLE_VALUE || !GetHandleSize(pack, packSize) || (readOnly && packSize == 0)) {
+        CloseHandles();
+        return false;
+    }
+
+    // 新建的包文件写入文件头；版本1的包文件升级版本号（旧程序不会把新记录当作损坏的尾部截掉）
+    unsigned char header[PACK_HEADER_SIZE] = {};
+    if (packSize > 0 && (packSize < PACK_HEADER_SIZE || !ReadAt(0, header, sizeof(header)) ||
+        std::memcmp(header, PACK_MAGIC, 4) != 0 || Get32(header + 4) > PACK_VERSION)) {
+        CloseHandles();
+        return false;
+    }
+    if (!readOnly && (packSize == 0 || Get32(header + 4) < PACK_VERSION)) {
+        std::memcpy(header, PACK_MAGIC, 4);
+        Put32(header + 4, PACK_VERSION);
+        if (!WriteAt(0, header, sizeof(header)) || !FlushFileBuffers(pack)) {
+            CloseHandles();
+            return false;
+        }
+        packSize = packSize > 0 ? packSize : PACK_HEADER_SIZE;
+    }
+
+    if (!uidIndex.Open(packPath + ".idx") || !chunkIndex.Open(packPath + ".pool")) {
+        CloseHandles();
+        return false;
+    }
+
+    // 两个索引都完好、上次正常结束更新且没有超出包文件时直接使用，否则重建
+    unsigned char uidHeader[INDEX_HEADER_SIZE];
+    unsigned char poolHeader[INDEX_HEADER_SIZE];
+    bool valid = CheckIndexHeader(uidIndex.file, INDEX_MAGIC, INDEX_VERSION, SLOT_SIZE, INITIAL_SLOTS, uidHeader) &&
+        CheckIndexHeader(chunkIndex.file, POOL_MAGIC, POOL_VERSION, POOL_SLOT_SIZE, INITIAL_POOL_SLOTS, poolHeader) &&
+        Get32(uidHeader + 8) == 0;
+    uint64_t committed = valid ? Get64(uidHeader + 40) : 0;
+    valid = valid && committed >= PACK_HEADER_SIZE && committed <= packSize;
+
+    bool mapped = valid &&
+        uidIndex.Map(INDEX_HEADER_SIZE + Get64(uidHeader + 16) * SLOT_SIZE) &&
+        chunkIndex.Map(INDEX_HEADER_SIZE + Get64(poolHeader + 16) * POOL_SLOT_SIZE);
+    if (readOnly && valid) {
+        // 复制期间写入方可能开始了一次追加：副本和文件的头部都没变才可用，否则从包文件重建
+        unsigned char current[INDEX_HEADER_SIZE];
+        valid = mapped &&
+            std::memcmp(uidIndex.view, uidHeader, INDEX_HEADER_SIZE) == 0 &&
+            std::memcmp(chunkIndex.view, poolHeader, INDEX_HEADER_SIZE) == 0 &&
+            ReadHandleAt(uidIndex.file, 0, current, sizeof(current)) && std::memcmp(current, uidHeader, sizeof(current)) == 0 &&
+            ReadHandleAt(chunkIndex.file, 0, current, sizeof(current)) && std::memcmp(current, poolHeader, sizeof(current)) == 0;
+        mapped = valid;
+    }
+
+    bool ready = valid ? mapped && (committed == packSize || Replay(committed)) : Rebuild();
+    if (!ready) {
+        CloseHandles();
+        return false;
+    }
+    if (readOnly) {
+        // 索引已在内存中，不再占用索引文件
+        uidIndex.CloseFile();
+        chunkIndex.CloseFile();
+    }
+    return true;
+}
+
+void BackupArchive::CloseHandles() {
+    uidIndex.Close();
+    chunkIndex.Close();
+    if (pack != INVALID_HANDLE_VALUE) {
+        CloseHandle(pack);
+        pack = INVALID_HANDLE_VALUE;
+    }
+    packSize = 0;
+}
+
+void BackupArchive::Close() {
+    std::lock_guard<std::shared_mutex> lock(archiveMutex);
+    CloseHandles();
+}
+
+bool BackupArchive::IsOpen() const {
+    std::shared_lock<std::shared_mutex> lock(archiveMutex);
+    return uidIndex.view != nullptr;
+}
+
+bool BackupArchive::Append(const CardImage& image, int64_t timestamp, uint64_t* offset) {
+    std::lock_guard<std::shared_mutex> lock(archiveMutex);
+    std::vector<unsigned char> uid = image.Uid();
+    if (readOnly || uidIndex.view == nullptr || uid.empty()) {
+        return false;
+    }
+
+    // 分片：全部块（未知的块为0），然后是扇区密钥表
+    int blockCount = image.BlockCount();
+    int sectorCount = image.SectorCount();
+    size_t dataChunks = blockCount * 16 / CHUNK_SIZE;
+    size_t keyChunks = (sectorCount * KEY_RECORD_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<unsigned char> content((dataChunks + keyChunks) * CHUNK_SIZE, 0);
+    size_t bitmapSize = (blockCount + 7) / 8;
+    std::vector<unsigned char> bitmap(bitmapSize, 0);
+    for (int block = 0; block < blockCount; block++) {
+        if (image.IsKnown(block)) {
+            bitmap[block / 8] |= static_cast<unsigned char>(1 << (block % 8));
+            std::memcpy(content.data() + block * 16, image.Block(block).data(), 16);
+        }
+    }
+    for (int sector = 0; sector < sectorCount; sector++) {
+        const SectorKeyInfo& key = image.SectorKey(sector);
+        unsigned char* record = content.data() + dataChunks * CHUNK_SIZE + sector * KEY_RECORD_SIZE;
+        if (key.known) {
+            record[0] = 0x01;
+            record[1] = key.keyType;
+            std::memcpy(record + 2, key.key.data(), 6);
+        }
+    }
+
+    // 已有的分片直接引用，其余随本记录写入（同一镜像内重复的分片也只写一次）
+    uint64_t recordOffset = packSize;
+    size_t totalChunks = dataChunks + keyChunks;
+    size_t refsStart = DEDUP_HEADER_SIZE + bitmapSize;
+    size_t chunkStart = refsStart + totalChunks * REF_SIZE;
+    chunkStart += (16 - (recordOffset + RECORD_HEADER_SIZE + chunkStart) % 16) % 16;
+    std::vector<unsigned char> refs(totalChunks * REF_SIZE);
+    std::vector<size_t> newChunks;
+    std::vector<uint64_t> newHashes;
+    for (size_t i = 0; i < totalChunks; i++) {
+        const unsigned char* chunk = content.data() + i * CHUNK_SIZE;
+        uint64_t hash = HashBytes(chunk, CHUNK_SIZE);
+        uint64_t chunkOffset = FindChunk(chunk, hash);
+        for (size_t n = 0; chunkOffset == 0 && n < newChunks.size(); n++) {
+            if (newHashes[n] == hash && std::memcmp(content.data() + newChunks[n] * CHUNK_SIZE, chunk, CHUNK_SIZE) == 0) {
+                chunkOffset = recordOffset + RECORD_HEADER_SIZE + chunkStart + n * CHUNK_SIZE;
+            }
+        }
+        if (chunkOffset == 0) {
+            chunkOffset = recordOffset + RECORD_HEADER_SIZE + chunkStart + newChunks.size() * CHUNK_SIZE;
+            newChunks.push_back(i);
+            newHashes.push_back(hash);
+        }
+        Put32(refs.data() + i * REF_SIZE, static_cast<uint32_t>(chunkOffset >> CHUNK_ALIGN_SHIFT));
+    }
+
+    std::vector<unsigned char> record(RECORD_HEADER_SIZE + chunkStart + newChunks.size() * CHUNK_SIZE, 0);
+    unsigned char* payload = record.data() + RECORD_HEADER_SIZE;
+    payload[0] = static_cast<unsigned char>(image.Geometry());
+    payload[1] = image.Sak();
+    Put16(payload + 2, image.Atqa());
+    Put16(payload + 4, static_cast<uint16_t>(dataChunks));
+    Put16(payload + 6, static_cast<uint16_t>(keyChunks));
+    Put16(payload + 8, static_cast<uint16_t>(newChunks.size()));
+    std::memcpy(payload + DEDUP_HEADER_SIZE, bitmap.data(), bitmapSize);
+    std::memcpy(payload + refsStart, refs.data(), refs.size());
+    for (size_t n = 0; n < newChunks.size(); n++) {
+        std::memcpy(payload + chunkStart + n * CHUNK_SIZE, content.data() + newChunks[n] * CHUNK_SIZE, CHUNK_SIZE);
+    }
+    size_t payloadSize = record.size() - RECORD_HEADER_SIZE;
+    if (recordOffset + record.size() > MAX_CHUNK_OFFSET) {
+        return false;  // 超出引用可寻址的范围
+    }
+
+    const unsigned char* slot = FindSlot(uid);
+    unsigned char* header = record.data();
+    std::memcpy(header, RECORD_DEDUP, 4);
+    Put32(header + 4, static_cast<uint32_t>(payloadSize));
+    Put64(header + 8, slot ? Get64(slot + 16) : NO_RECORD);
+    Put64(header + 16, static_cast<uint64_t>(timestamp));
+    header[24] = static_cast<unsigned char>(uid.size());
+    std::memcpy(header + 25, uid.data(), uid.size());
+    header[35] = image.Complete() ? 0x01 : 0x00;
+    Put32(header + 36, CardDumpFile::Checksum(payload, payloadSize));
+    Put32(header + 44, CardDumpFile::Checksum(header, 44));
+
+    // 先让记录落盘，再更新索引；写入失败时去掉写了一半的记录
+    if (!WriteAt(recordOffset, record.data(), record.size()) || !FlushFileBuffers(pack)) {
+        TruncatePack(recordOffset);
+        return false;
+    }
+    packSize += record.size();
+
+    // 索引扩容失败时关闭归档，下次打开时从包文件重建
+    RecordHeader indexed;
+    indexed.uid = uid;
+    SetIndexState(1);
+    bool indexOk = IndexRecord(recordOffset, indexed);
+    for (size_t n = 0; indexOk && n < newChunks.size(); n++) {
+        indexOk = IndexChunk(recordOffset + RECORD_HEADER_SIZE + chunkStart + n * CHUNK_SIZE, newHashes[n]);
+    }
+    if (!indexOk) {
+        CloseHandles();
+        return false;
+    }
+    Put64(uidIndex.view + 40, packSize);
+    FlushIndexes();
+    SetIndexState(0);
+
+    if (offset) {
+        *offset = recordOffset;
+    }
+    return true;
+}
+
+bool BackupArchive::Load(uint64_t offset, CardImage& image, int64_t* timestamp) const {
+    std::shared_lock<std::shared_mutex> lock(archiveMutex);
+    RecordHeader header;
+    std::vector<unsigned char> payload;
+    if (uidIndex.view == nullptr || !ReadRecordHeader(offset, header) || !ReadPayload(offset, header, payload)) {
+        return false;
+    }
+
+    if (!DecodeImage(header, offset + RECORD_HEADER_SIZE, payload, image)) {
+        return false;
+    }
+    if (timestamp) {
+        *timestamp = header.timestamp;
+    }
+    return true;
+}
+
+// 顺序扫描包文件（调用者持有锁）：按 1MB 窗口读入，记录跨窗口时从记录开头重新读
+void BackupArchive::ScanRecords(bool latestOnly, bool withPayload, const RecordVisitor& visit) const {
+    const size_t WINDOW_SIZE = 1 << 20;
+    std::vector<unsigned char> window;
+    uint64_t windowStart = 0;
+    auto view = [&](uint64_t offset, size_t size) -> const unsigned char* {
+        if (offset >= windowStart && offset + size <= windowStart + window.size()) {
+            return window.data() + (offset - windowStart);
+        }
+        size_t length = static_cast<size_t>(std::min<uint64_t>(std::max(WINDOW_SIZE, size), packSize - offset));
+        window.resize(length);
+        if (length < size || !ReadAt(offset, window.data(), length)) {
+            window.clear();
+            return nullptr;
+        }
+        windowStart = offset;
+        return window.data();
+    };
+
+    uint64_t offset = PACK_HEADER_SIZE;
+    RecordHeader header;
+    while (offset + RECORD_HEADER_SIZE <= packSize) {
+        const unsigned char* raw = view(offset, RECORD_HEADER_SIZE);
+        if (raw == nullptr || !ParseRecordHeader(raw, offset, header)) {
+            break;
+        }
+        uint64_t next = offset + RECORD_HEADER_SIZE + header.payloadSize;
+
+        const unsigned char* slot = latestOnly ? FindSlot(header.uid) : nullptr;
+        if (!latestOnly || (slot != nullptr && Get64(slot + 16) == offset)) {
+            const unsigned char* payload = nullptr;
+            if (withPayload) {
+                payload = view(offset + RECORD_HEADER_SIZE, header.payloadSize);
+                if (payload == nullptr) {
+                    break;
+                }
+            }
+            if (!visit(offset, header, payload)) {
+                break;
+            }
+        }
+        offset = next;
+    }
+}
+
+uint64_t BackupArchive::Entries(const EntryCallback& onEntry, bool latestOnly) const {
+    std::shared_lock<std::shared_mutex> lock(archiveMutex);
+    if (uidIndex.view == nullptr) {
+        return 0;
+    }
+
+    uint64_t listed = 0;
+    ScanRecords(latestOnly, false, [&](uint64_t offset, const RecordHeader& header, const unsigned char*) {
+        ArchiveEntry entry;
+        entry.offset = offset;
+        entry.timestamp = header.timestamp;
+        entry.complete = header.complete;
+        listed++;
+        return onEntry(entry, header.uid);
+    });
+    return listed;
+}
+
+uint64_t BackupArchive::FindBlockMatches(int block, const BlockPattern& pattern, const MatchCallback& onMatch,
+    bool latestOnly) const {
+    std::shared_lock<std::shared_mutex> lock(archiveMutex);
+    if (uidIndex.view == nullptr || block < 0 || block >= CardImage::MAX_BLOCKS) {
+        return 0;
+    }
+
+    std::unordered_map<uint64_t, bool> chunkMatches;
+    uint64_t examined = 0;
+    ScanRecords(latestOnly, true, [&](uint64_t offset, const RecordHeader& header, const unsigned char* payload) {
+        examined++;
+        if (!RecordBlockMatches(header, offset + RECORD_HEADER_SIZE, payload, block, pattern, chunkMatches)) {
+            return true;
+        }
+        ArchiveEntry entry;
+        entry.offset = offset;
+        entry.timestamp = header.timestamp;
+        entry.complete = header.complete;
+        return onMatch(entry, header.uid);
+    });
+    return examined;
+}
+
+bool BackupArchive::FindLatest(const std::vector<unsigned char>& uid, CardImage& image,
+    int64_t* timestamp, bool completeOnly) const {
+    uint64_t offset = NO_RECORD;
+    {
+        std::shared_lock<std::shared_mutex> lock(archiveMutex);
+        const unsigned char* slot = uidIndex.view ? FindSlot(uid) : nullptr;
+        if (slot == nullptr) {
+            return false;
+        }
+        offset = Get64(slot + 16);
+
+        // 沿链表找到第一条完整的备份（记录只会指向更早的位置）
+        RecordHeader header;
+        while (completeOnly && offset != NO_RECORD) {
+            if (!ReadRecordHeader(offset, header)) {
+                return false;
+            }
+            if (header.complete) {
+                break;
+            }
+            if (header.prevOffset != NO_RECORD && header.prevOffset >= offset) {
+                return false;
+            }
+            offset = header.prevOffset;
+        }
+    }
+    return offset != NO_RECORD && Load(offset, image, timestamp);
+}
+
+std::vector<ArchiveEntry> BackupArchive::History(const std::vector<unsigned char>& uid, size_t maxEntries) const {
+    std::shared_lock<std::shared_mutex> lock(archiveMutex);
+    std::vector<ArchiveEntry> entries;
+    const unsigned char* slot = uidIndex.view ? FindSlot(uid) : nullptr;
+    if (slot == nullptr) {
+        return entries;
+    }
+
+    uint64_t offset = Get64(slot + 16);
+    RecordHeader header;
+    while (offset != NO_RECORD && entries.size() < maxEntries && ReadRecordHeader(offset, header)) {
+        ArchiveEntry entry;
+        entry.offset = offset;
+        entry.timestamp = header.timestamp;
+        entry.complete = header.complete;
+        entries.push_back(entry);
+        if (header.prevOffset != NO_RECORD && header.prevOffset >= offset) {
+            break;
+        }
+        offset = header.prevOffset;
+    }
+    return entries;
+}
+
+uint64_t BackupArchive::RecordCount() const {
+    std::shared_lock<std::shared_mutex> lock(archiveMutex);
+    return uidIndex.view ? Get64(uidIndex.view + 32) : 0;
+}
+
+uint64_t BackupArchive::CardCount() const {
+    std::shared_lock<std::shared_mutex> lock(archiveMutex);
+    return uidIndex.view ? Get64(uidIndex.view + 24) : 0;
+}
+
+uint64_t BackupArchive::ChunkCount() const {
+    std::shared_lock<std::shared_mutex> lock(archiveMutex);
+    return chunkIndex.view ? Get64(chunkIndex.view + 24) : 0;
+}
+
+uint64_t BackupArchive::PackBytes() const {
+    std::shared_lock<std::shared_mutex> lock(archiveMutex);
+    return packSize;
+}
@@ -0,0 +1,152 @@
+﻿#pragma once
+#include "CardImage.h"
+#include "CardImageDiff.h"
+#include <windows.h>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 归档中的一条备份
+struct ArchiveEntry {
+    uint64_t offset = 0;    // 记录在包文件中的位置
+    int64_t timestamp = 0;  // 备份时间（Unix 秒）
+    bool complete = false;  // 备份时所有块都已读到
+};
+
+// 只追加的备份归档
+// 所有备份依次追加到一个包文件，每条记录指向同一 UID 的上一条记录；
+// 索引文件（包文件名 + ".idx"）是内存映射的开放寻址哈希表，按 UID 保存最新记录的位置和记录数。
+// 查找某张卡片的最新备份只需一次哈希探测，历史记录沿链表向前遍历。
+//
+// 块数据去重：镜像按64字节分片（1K卡的一个扇区、4K卡大扇区的四分之一），扇区密钥表也按64字节分片，
+// 每种分片内容只在包文件中存一次，由分片索引（包文件名 + ".pool"，按内容哈希）查找；
+// 备份记录只保存已知块位图和各分片的位置。全0扇区、出厂控制块、同一批发卡的相同布局都只存一份。
+//
+// 追加顺序：新分片和记录写入并刷盘 → 更新索引并刷盘。进程或系统在中途崩溃时，
+// 下次打开会补齐索引中缺少的记录、截掉不完整的尾部；索引损坏或缺失时从包文件重建。
+// 线程安全：读取（Load、FindLatest、Entries 等）可以在多个线程并发进行，Append 独占。
+// 只读打开用于查询、导出等工具：与正在追加的读卡程序共享文件，索引复制到内存（不映射，写入方照常扩容），
+// 从不修改包文件和索引；索引正在更新或已损坏时在内存中从包文件重建，尚未写完的尾部记录不可见。
+class BackupArchive {
+public:
+    static constexpr uint64_t NO_RECORD = std::numeric_limits<uint64_t>::max();
+    static constexpr size_t CHUNK_SIZE = 64;
+
+    // 记录回调：返回 false 时停止；在持有归档读锁时调用，不能调用 Append
+    using EntryCallback = std::function<bool(const ArchiveEntry& entry, const std::vector<unsigned char>& uid)>;
+    using MatchCallback = EntryCallback;
+
+private:
+    // 内存映射的索引文件（只读打开时为内存副本）
+    struct MappedIndex {
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = NULL;
+        unsigned char* view = nullptr;
+        bool readOnly = false;
+        std::vector<unsigned char> copy;
+
+        bool Open(const std::string& path);
+        bool Map(uint64_t size);
+        void Unmap();
+        bool Reset(uint64_t size);  // 清空后按新长度映射（内容为0）
+        void Flush();
+        void CloseFile();
+        void Close();
+    };
+
+    HANDLE pack;
+    bool readOnly;
+    MappedIndex uidIndex;
+    MappedIndex chunkIndex;
+    uint64_t packSize;
+    mutable std::shared_mutex archiveMutex;
+
+    struct RecordHeader {
+        uint32_t type = 0;
+        uint32_t payloadSize = 0;
+        uint64_t prevOffset = NO_RECORD;
+        int64_t timestamp = 0;
+        std::vector<unsigned char> uid;
+        bool complete = false;
+        uint32_t payloadCrc = 0;
+    };
+
+    // 顺序扫描的记录回调（payload 为 nullptr 表示没有读取内容），返回 false 时停止
+    using RecordVisitor = std::function<bool(uint64_t offset, const RecordHeader& header, const unsigned char* payload)>;
+
+    // 包文件读写（按偏移，不移动文件指针）
+    bool ReadAt(uint64_t offset, void* buffer, size_t size) const;
+    bool WriteAt(uint64_t offset, const void* buffer, size_t size);
+    bool ParseRecordHeader(const unsigned char* raw, uint64_t offset, RecordHeader& header) const;
+    bool ReadRecordHeader(uint64_t offset, RecordHeader& header) const;
+    bool ReadPayload(uint64_t offset, const RecordHeader& header, std::vector<unsigned char>& payload) const;
+    bool ReadChunk(uint64_t offset, unsigned char* chunk) const;
+    bool DecodeImage(const RecordHeader& header, uint64_t payloadOffset,
+        const std::vector<unsigned char>& payload, CardImage& image) const;
+    void ScanRecords(bool latestOnly, bool withPayload, const RecordVisitor& visit) const;
+    bool RecordBlockMatches(const RecordHeader& header, uint64_t payloadOffset, const unsigned char* payload,
+        int block, const BlockPattern& pattern, std::unordered_map<uint64_t, bool>& chunkMatches) const;
+
+    // 索引
+    bool CreateIndexes();
+    bool GrowUidIndex();
+    bool GrowChunkIndex();
+    unsigned char* FindSlot(const std::vector<unsigned char>& uid, bool create);
+    const unsigned char* FindSlot(const std::vector<unsigned char>& uid) const;
+    uint64_t FindChunk(const unsigned char* chunk, uint64_t hash) const;
+    bool IndexRecord(uint64_t offset, const RecordHeader& header);
+    bool IndexChunk(uint64_t offset, uint64_t hash);
+    void SetIndexState(uint32_t state);
+    void FlushIndexes();
+
+    // 打开时的恢复
+    bool Rebuild();
+    bool Replay(uint64_t from);
+    bool TruncatePack(uint64_t size);
+
+    void CloseHandles();
+
+public:
+    BackupArchive();
+    ~BackupArchive();
+
+    BackupArchive(const BackupArchive&) = delete;
+    BackupArchive& operator=(const BackupArchive&) = delete;
+
+    // 打开（不存在时创建）包文件和索引；readOnly 时包文件必须已存在，不能 Append
+    bool Open(const std::string& packPath, bool readOnly = false);
+    void Close();
+    bool IsOpen() const;
+
+    // 追加一份备份，offset 返回记录位置
+    bool Append(const CardImage& image, int64_t timestamp, uint64_t* offset = nullptr);
+
+    // 最新的备份；completeOnly 时跳过没有读完整卡的备份
+    bool FindLatest(const std::vector<unsigned char>& uid, CardImage& image,
+        int64_t* timestamp = nullptr, bool completeOnly = false) const;
+
+    // 某张卡片的备份记录（最新的在前），最多 maxEntries 条
+    std::vector<ArchiveEntry> History(const std::vector<unsigned char>& uid,
+        size_t maxEntries = std::numeric_limits<size_t>::max()) const;
+
+    // 读取一条记录
+    bool Load(uint64_t offset, CardImage& image, int64_t* timestamp = nullptr) const;
+
+    // 按包文件顺序列出所有备份；latestOnly 时只列每张卡片的最新备份。返回列出的备份数
+    uint64_t Entries(const EntryCallback& onEntry, bool latestOnly = false) const;
+
+    // 按顺序扫描整个归档，找出第 block 块已知且匹配 pattern 的备份；latestOnly 时只看每张卡片的最新备份。
+    // 去重后的相同分片只比较一次。返回检查过的备份数
+    uint64_t FindBlockMatches(int block, const BlockPattern& pattern, const MatchCallback& onMatch,
+        bool latestOnly = false) const;
+
+    uint64_t RecordCount() const;
+    uint64_t CardCount() const;
+    uint64_t ChunkCount() const;  // 不同分片数
+    uint64_t PackBytes() const;   // 包文件长度
+};
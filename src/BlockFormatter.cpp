@@ -0,0 +1,147 @@
+﻿#include "BlockFormatter.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_FORMATTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const char UPPER_DIGITS[] = "0123456789ABCDEF";
+const char LOWER_DIGITS[] = "0123456789abcdef";
+
+#ifdef BLOCK_FORMATTER_SSE2
+// 16个半字节（0-15）转为十六进制字符
+inline __m128i NibblesToHex(__m128i nibbles, bool lowercase) {
+    __m128i letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    __m128i letterOffset = _mm_and_si128(letters, _mm_set1_epi8(lowercase ? 'a' - '0' - 10 : 'A' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letterOffset);
+}
+
+// 16字节转为32个十六进制字符
+inline void Hex16(const unsigned char* data, char* out, bool lowercase) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+    __m128i low = _mm_and_si128(bytes, mask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), NibblesToHex(_mm_unpacklo_epi8(high, low), lowercase));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), NibblesToHex(_mm_unpackhi_epi8(high, low), lowercase));
+}
+#endif
+
+}  // namespace
+
+size_t BlockFormatter::HexCompact(const unsigned char* data, size_t length, char* out, bool lowercase) {
+    size_t i = 0;
+#ifdef BLOCK_FORMATTER_SSE2
+    for (; i + 16 <= length; i += 16) {
+        Hex16(data + i, out + i * 2, lowercase);
+    }
+#endif
+    const char* digits = lowercase ? LOWER_DIGITS : UPPER_DIGITS;
+    for (; i < length; i++) {
+        out[i * 2] = digits[data[i] >> 4];
+        out[i * 2 + 1] = digits[data[i] & 0x0F];
+    }
+    return length * 2;
+}
+
+size_t BlockFormatter::HexSpaced(const unsigned char* data, size_t length, char* out, bool lowercase) {
+    size_t i = 0;
+#ifdef BLOCK_FORMATTER_SSE2
+    char compact[32];
+    for (; i + 16 <= length; i += 16) {
+        Hex16(data + i, compact, lowercase);
+        char* cell = out + i * 3;
+        for (size_t b = 0; b < 16; b++) {
+            cell[b * 3] = compact[b * 2];
+            cell[b * 3 + 1] = compact[b * 2 + 1];
+            cell[b * 3 + 2] = ' ';
+        }
+    }
+#endif
+    const char* digits = lowercase ? LOWER_DIGITS : UPPER_DIGITS;
+    for (; i < length; i++) {
+        out[i * 3] = digits[data[i] >> 4];
+        out[i * 3 + 1] = digits[data[i] & 0x0F];
+        out[i * 3 + 2] = ' ';
+    }
+    return length * 3;
+}
+
+size_t BlockFormatter::Ascii(const unsigned char* data, size_t length, char* out) {
+    size_t i = 0;
+#ifdef BLOCK_FORMATTER_SSE2
+    // 有符号比较：0x80 以上为负数，自然落在可打印范围之外
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1F)),
+            _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7F)));
+        __m128i text = _mm_or_si128(_mm_and_si128(printable, bytes), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), text);
+    }
+#endif
+    for (; i < length; i++) {
+        out[i] = (data[i] >= 0x20 && data[i] <= 0x7E) ? static_cast<char>(data[i]) : '.';
+    }
+    return length;
+}
+
+bool BlockFormatter::HasPrintable(const unsigned char* data, size_t length) {
+    size_t i = 0;
+#ifdef BLOCK_FORMATTER_SSE2
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1F)),
+            _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7F)));
+        if (_mm_movemask_epi8(printable) != 0) {
+            return true;
+        }
+    }
+#endif
+    for (; i < length; i++) {
+        if (data[i] >= 0x20 && data[i] <= 0x7E) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t BlockFormatter::Trailer(const unsigned char* block, char* out, bool lowercase) {
+    static const char LAYOUT[] = "KeyA: .. .. .. .. .. ..  Access: .. .. ..  KeyB: .. .. .. .. .. ..";
+    static_assert(sizeof(LAYOUT) - 1 == TRAILER_LENGTH, "控制块布局长度不符");
+    // 各字段第一个字节在布局中的位置和字节范围
+    static const struct { size_t column; size_t first; size_t count; } FIELDS[] = {
+        { 6, 0, 6 }, { 33, 6, 3 }, { 49, 10, 6 },
+    };
+
+    char hex[COMPACT_HEX_LENGTH];
+    HexCompact(block, BLOCK_SIZE, hex, lowercase);
+    std::memcpy(out, LAYOUT, TRAILER_LENGTH);
+    for (const auto& field : FIELDS) {
+        for (size_t i = 0; i < field.count; i++) {
+            out[field.column + i * 3] = hex[(field.first + i) * 2];
+            out[field.column + i * 3 + 1] = hex[(field.first + i) * 2 + 1];
+        }
+    }
+    return TRAILER_LENGTH;
+}
+
+size_t BlockFormatter::Line(const unsigned char* block, bool trailer, char* out, const BlockLineStyle& style) {
+    size_t length = HexSpaced(block, BLOCK_SIZE, out, style.lowercase);
+    if (trailer) {
+        if (style.trailerFields) {
+            out[length++] = ' ';
+            length += Trailer(block, out + length, style.lowercase);
+        }
+        return length;
+    }
+
+    if (style.ascii == AsciiColumn::Always || (style.ascii == AsciiColumn::Printable && HasPrintable(block, BLOCK_SIZE))) {
+        std::memcpy(out + length, "  ASCII: ", 9);
+        length += 9;
+        length += Ascii(block, BLOCK_SIZE, out + length);
+    }
+    return length;
+}
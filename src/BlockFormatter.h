@@ -0,0 +1,48 @@
+﻿#pragma once
+#include <cstddef>
+
+// 数据块后面的 ASCII 列
+enum class AsciiColumn {
+    Never,
+    Printable,  // 块中有可打印字符时
+    Always,
+};
+
+// 一行块数据的样式
+struct BlockLineStyle {
+    bool lowercase = false;
+    AsciiColumn ascii = AsciiColumn::Printable;  // 数据块的 ASCII 列
+    bool trailerFields = false;                  // 控制块后面拆出 KeyA/Access/KeyB
+};
+
+// 16字节块的十六进制/ASCII 格式化，显示、日志、备份文件和导出共用
+// 直接写入调用者的缓冲区，不分配内存、不加结尾0，返回写入的字符数。
+// x86/x64 上用 SSE2 一次转换整块，其他平台查表。
+class BlockFormatter {
+public:
+    static constexpr size_t BLOCK_SIZE = 16;
+    static constexpr size_t COMPACT_HEX_LENGTH = 32;  // "00112233..."
+    static constexpr size_t SPACED_HEX_LENGTH = 48;   // "00 11 22 ... FF "（每字节后一个空格）
+    static constexpr size_t ASCII_LENGTH = 16;
+    static constexpr size_t TRAILER_LENGTH = 66;      // "KeyA: XX XX XX XX XX XX  Access: XX XX XX  KeyB: XX XX XX XX XX XX"
+    static constexpr size_t MAX_LINE_LENGTH = 128;    // Line 的最大长度
+
+    // 连续的十六进制，out 至少 length * 2 个字符
+    static size_t HexCompact(const unsigned char* data, size_t length, char* out, bool lowercase = false);
+
+    // 每字节后跟一个空格，out 至少 length * 3 个字符
+    static size_t HexSpaced(const unsigned char* data, size_t length, char* out, bool lowercase = false);
+
+    // 可打印字符（0x20-0x7E）原样输出，其他输出 '.'
+    static size_t Ascii(const unsigned char* data, size_t length, char* out);
+
+    // 是否含可打印字符
+    static bool HasPrintable(const unsigned char* data, size_t length);
+
+    // 控制块拆分为 KeyA（0-5）、访问位（6-8）、KeyB（10-15），out 至少 TRAILER_LENGTH 个字符
+    static size_t Trailer(const unsigned char* block, char* out, bool lowercase = false);
+
+    // 一整块："XX XX ... XX " 之后，数据块按样式加 "  ASCII: ..."，控制块按样式加 " KeyA: ..."；
+    // out 至少 MAX_LINE_LENGTH 个字符
+    static size_t Line(const unsigned char* block, bool trailer, char* out, const BlockLineStyle& style = BlockLineStyle());
+};
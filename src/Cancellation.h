@@ -0,0 +1,99 @@
+﻿#pragma once
+#include "PN532Status.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+// 取消令牌：由 CancellationSource 发出，可在任意线程查询
+// 默认构造的令牌永远不会被取消
+class CancellationToken {
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+
+    friend class CancellationSource;
+    explicit CancellationToken(std::shared_ptr<std::atomic<bool>> sharedFlag) : flag(std::move(sharedFlag)) {}
+
+public:
+    CancellationToken() = default;
+
+    bool IsCancelled() const {
+        return flag && flag->load(std::memory_order_acquire);
+    }
+};
+
+// 取消源：持有者调用 Cancel，所有由它发出的令牌随之生效
+class CancellationSource {
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+
+public:
+    CancellationSource() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void Cancel() { flag->store(true, std::memory_order_release); }
+    bool IsCancelled() const { return flag->load(std::memory_order_acquire); }
+    CancellationToken Token() const { return CancellationToken(flag); }
+};
+
+// 绝对截止时间（steady_clock），默认没有截止时间
+class Deadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    Clock::time_point at;
+    bool bounded;
+
+public:
+    Deadline() : at(Clock::time_point::max()), bounded(false) {}
+    explicit Deadline(Clock::time_point timePoint) : at(timePoint), bounded(true) {}
+
+    static Deadline Never() { return Deadline(); }
+
+    // 从现在起 ms 毫秒后到期，ms <= 0 表示没有截止时间
+    static Deadline After(int ms) {
+        if (ms <= 0) {
+            return Deadline();
+        }
+        return Deadline(Clock::now() + std::chrono::milliseconds(ms));
+    }
+
+    bool IsBounded() const { return bounded; }
+    bool Expired() const { return bounded && Clock::now() >= at; }
+
+    // 剩余毫秒数，不超过 cap；已到期返回 0
+    int RemainingMs(int cap) const {
+        if (!bounded) {
+            return cap;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(at - Clock::now()).count();
+        if (left <= 0) {
+            return 0;
+        }
+        return left < cap ? static_cast<int>(left) : cap;
+    }
+};
+
+// 一次长操作的约束：取消令牌 + 截止时间
+// PN532 在每条命令发出前检查，命令一旦发出就等到应答（或超时）为止，不会中途丢下一帧
+struct OperationContext {
+    CancellationToken token;
+    Deadline deadline;
+
+    OperationContext() = default;
+    OperationContext(const CancellationToken& cancelToken, const Deadline& until = Deadline())
+        : token(cancelToken), deadline(until) {}
+    explicit OperationContext(const Deadline& until) : deadline(until) {}
+
+    // 返回中止原因，None 表示可以继续
+    TransportError Check() const {
+        if (token.IsCancelled()) {
+            return TransportError::Cancelled;
+        }
+        if (deadline.Expired()) {
+            return TransportError::DeadlineExceeded;
+        }
+        return TransportError::None;
+    }
+
+    bool Stopped() const { return Check() != TransportError::None; }
+};
@@ -0,0 +1,448 @@
+﻿#include "CardDumpFile.h"
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+const unsigned char MAGIC[4] = { 'P', 'N', '5', 'D' };
+const size_t KEY_RECORD_SIZE = 8;
+
+std::array<uint32_t, 256> MakeCrcTable() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+
+void PutLE(unsigned char* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+uint64_t GetLE(const unsigned char* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+bool GeometryFromMfdSize(size_t size, CardGeometry& geometry) {
+    switch (size) {
+    case 320: geometry = CardGeometry::Mini; return true;
+    case 1024: geometry = CardGeometry::Classic1K; return true;
+    case 2048: geometry = CardGeometry::Classic2K; return true;
+    case 4096: geometry = CardGeometry::Classic4K; return true;
+    default: return false;
+    }
+}
+
+int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 解析以空格分隔的两位十六进制字节，遇到其他内容或达到 maxBytes 时停止
+size_t ParseHexBytes(const std::string& line, size_t pos, unsigned char* out, size_t maxBytes) {
+    size_t count = 0;
+    while (count < maxBytes) {
+        while (pos < line.size() && line[pos] == ' ') {
+            pos++;
+        }
+        if (pos + 2 > line.size()) {
+            break;
+        }
+        int high = HexValue(line[pos]);
+        int low = HexValue(line[pos + 1]);
+        if (high < 0 || low < 0 || (pos + 2 < line.size() && line[pos + 2] != ' ')) {
+            break;
+        }
+        out[count++] = static_cast<unsigned char>(high * 16 + low);
+        pos += 2;
+    }
+    return count;
+}
+
+// 扇区标题行："扇区 N (认证成功)"，N 可能是十进制或十六进制
+bool IsSectorHeader(const std::string& line) {
+    if (line.empty() || line[0] == ' ') {
+        return false;
+    }
+    size_t pos = line.find(' ');
+    if (pos == std::string::npos) {
+        return false;
+    }
+    size_t digits = pos + 1;
+    size_t end = digits;
+    while (end < line.size() && HexValue(line[end]) >= 0) {
+        end++;
+    }
+    return end > digits && line.compare(end, 2, " (") == 0;
+}
+
+// 块行 "  块 i (n): ..." 中扇区内的块号 i（dataStart 指向 "): "）
+// 旧文件写 UID 后流停在十六进制，i 按十六进制写出；新文件按十进制。
+// 扇区内最多16块，所以含 a-f 的按十六进制、只有数字的按十进制，两种写法都不会歧义
+bool ParseBlockIndex(const std::string& line, size_t dataStart, int& index) {
+    size_t open = line.rfind(" (", dataStart);
+    if (open == std::string::npos || open == 0) {
+        return false;
+    }
+    size_t end = open;
+    size_t begin = end;
+    while (begin > 0 && HexValue(line[begin - 1]) >= 0) {
+        begin--;
+    }
+    if (begin == end || (begin > 0 && line[begin - 1] != ' ')) {
+        return false;
+    }
+
+    bool hex = false;
+    for (size_t i = begin; i < end; i++) {
+        hex = hex || !std::isdigit(static_cast<unsigned char>(line[i]));
+    }
+    index = 0;
+    for (size_t i = begin; i < end; i++) {
+        index = index * (hex ? 16 : 10) + HexValue(line[i]);
+        if (index > 255) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ctime 格式的时间："Wed Jun 30 21:49:08 1993"
+bool ParseCtime(const std::string& text, int64_t& timestamp) {
+    std::tm tm = {};
+    std::istringstream input(text);
+    input >> std::get_time(&tm, "%a %b %d %H:%M:%S %Y");
+    if (input.fail()) {
+        return false;
+    }
+    tm.tm_isdst = -1;
+    std::time_t value = std::mktime(&tm);
+    if (value == static_cast<std::time_t>(-1)) {
+        return false;
+    }
+    timestamp = static_cast<int64_t>(value);
+    return true;
+}
+
+bool ReadWholeFile(const std::string& path, std::vector<unsigned char>& content) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::streamoff size = file.tellg();
+    if (size < 0) {
+        return false;
+    }
+    content.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    return size == 0 || file.read(reinterpret_cast<char*>(content.data()), size).good();
+}
+
+bool WriteWholeFile(const std::string& path, const std::vector<unsigned char>& content) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(content.data()), static_cast<std::streamsize>(content.size()));
+    return file.good();
+}
+
+}  // namespace
+
+uint32_t CardDumpFile::Checksum(const unsigned char* data, size_t size) {
+    static const std::array<uint32_t, 256> table = MakeCrcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+std::vector<unsigned char> CardDumpFile::Serialize(const CardImage& image, int64_t timestamp) {
+    int blockCount = image.BlockCount();
+    int sectorCount = image.SectorCount();
+    size_t total = HEADER_SIZE + blockCount * 16 + sectorCount * KEY_RECORD_SIZE + 4;
+
+    // 一次分配，直接按偏移写入
+    std::vector<unsigned char> out(total, 0);
+    unsigned char* header = out.data();
+    std::memcpy(header, MAGIC, 4);
+    PutLE(header + 4, VERSION, 2);
+    PutLE(header + 6, HEADER_SIZE, 2);
+    header[8] = static_cast<unsigned char>(image.Geometry());
+    Span<const unsigned char> uid = image.UidView();
+    header[9] = static_cast<unsigned char>(uid.size());
+    std::memcpy(header + 10, uid.data(), uid.size());
+    PutLE(header + 20, image.Atqa(), 2);
+    header[22] = image.Sak();
+    header[23] = static_cast<unsigned char>(sectorCount);
+    PutLE(header + 24, static_cast<uint64_t>(timestamp), 8);
+
+    unsigned char* blocks = out.data() + HEADER_SIZE;
+    for (int block = 0; block < blockCount; block++) {
+        if (image.IsKnown(block)) {
+            header[32 + block / 8] |= static_cast<unsigned char>(1 << (block % 8));
+            std::memcpy(blocks + block * 16, image.Block(block).data(), 16);
+        }
+    }
+
+    unsigned char* keys = blocks + blockCount * 16;
+    for (int sector = 0; sector < sectorCount; sector++) {
+        const SectorKeyInfo& key = image.SectorKey(sector);
+        unsigned char* record = keys + sector * KEY_RECORD_SIZE;
+        if (key.known) {
+            record[0] = 0x01;
+            record[1] = key.keyType;
+            std::memcpy(record + 2, key.key.data(), 6);
+        }
+    }
+
+    PutLE(out.data() + total - 4, Checksum(out.data(), total - 4), 4);
+    return out;
+}
+
+bool CardDumpFile::Deserialize(const unsigned char* data, size_t size, CardImage& image, int64_t* timestamp) {
+    if (size < HEADER_SIZE + 4 || std::memcmp(data, MAGIC, 4) != 0) {
+        return false;
+    }
+
+    uint16_t version = static_cast<uint16_t>(GetLE(data + 4, 2));
+    size_t headerSize = static_cast<size_t>(GetLE(data + 6, 2));
+    if (version == 0 || version > VERSION || headerSize < HEADER_SIZE || data[8] > static_cast<unsigned char>(CardGeometry::Classic4K)) {
+        return false;
+    }
+
+    CardGeometry geometry = static_cast<CardGeometry>(data[8]);
+    int blockCount = CardImage::BlockCountOf(geometry);
+    int sectorCount = CardImage::SectorCountOf(geometry);
+    size_t total = headerSize + blockCount * 16 + sectorCount * KEY_RECORD_SIZE + 4;
+    if (size < total || data[9] > CardImage::MAX_UID || data[23] != sectorCount) {
+        return false;
+    }
+    if (static_cast<uint32_t>(GetLE(data + total - 4, 4)) != Checksum(data, total - 4)) {
+        return false;
+    }
+
+    CardImage loaded(geometry);
+    loaded.SetUid(std::vector<unsigned char>(data + 10, data + 10 + data[9]));
+    loaded.SetTargetInfo(static_cast<uint16_t>(GetLE(data + 20, 2)), data[22]);
+
+    const unsigned char* blocks = data + headerSize;
+    for (int block = 0; block < blockCount; block++) {
+        if (data[32 + block / 8] & (1 << (block % 8))) {
+            loaded.StoreRead(block, blocks + block * 16);
+        }
+    }
+
+    const unsigned char* keys = blocks + blockCount * 16;
+    for (int sector = 0; sector < sectorCount; sector++) {
+        const unsigned char* record = keys + sector * KEY_RECORD_SIZE;
+        if (record[0] & 0x01) {
+            loaded.SetSectorKey(sector, record[1], record + 2);
+        }
+    }
+
+    image = loaded;
+    if (timestamp) {
+        *timestamp = static_cast<int64_t>(GetLE(data + 24, 8));
+    }
+    return true;
+}
+
+bool CardDumpFile::Save(const std::string& path, const CardImage& image, int64_t timestamp) {
+    return WriteWholeFile(path, Serialize(image, timestamp));
+}
+
+bool CardDumpFile::SaveMfd(const std::string& path, const CardImage& image) {
+    std::vector<unsigned char> out(image.BlockCount() * 16, 0);
+    for (int block = 0; block < image.BlockCount(); block++) {
+        if (image.IsKnown(block)) {
+            std::memcpy(out.data() + block * 16, image.Block(block).data(), 16);
+        }
+    }
+
+    // 卡片读出的 Key A 总是0，按惯例把认证成功的密钥填回控制块
+    for (int sector = 0; sector < image.SectorCount(); sector++) {
+        const SectorKeyInfo& key = image.SectorKey(sector);
+        if (key.known) {
+            int trailer = CardImage::FirstBlockOfSector(sector) + CardImage::BlocksInSector(sector) - 1;
+            size_t offset = trailer * 16 + (key.keyType == 0x61 ? 10 : 0);
+            std::memcpy(out.data() + offset, key.key.data(), 6);
+        }
+    }
+    return WriteWholeFile(path, out);
+}
+
+bool CardDumpFile::ParseMfd(const unsigned char* data, size_t size, CardImage& image) {
+    CardGeometry geometry;
+    if (!GeometryFromMfdSize(size, geometry)) {
+        return false;
+    }
+
+    CardImage loaded(geometry);
+    for (int block = 0; block < loaded.BlockCount(); block++) {
+        loaded.StoreRead(block, data + block * 16);
+    }
+
+    // 厂商块：4字节 UID 后跟 BCC，之后是 SAK 和 ATQA；否则按7字节 UID 处理
+    if ((data[0] ^ data[1] ^ data[2] ^ data[3]) == data[4]) {
+        loaded.SetUid(std::vector<unsigned char>(data, data + 4));
+        loaded.SetTargetInfo(static_cast<uint16_t>(data[6] | (data[7] << 8)), data[5]);
+    }
+    else {
+        loaded.SetUid(std::vector<unsigned char>(data, data + 7));
+    }
+
+    // 非0的 Key A 视为已知密钥（由其他工具导出的 .mfd 会填入密钥）
+    for (int sector = 0; sector < loaded.SectorCount(); sector++) {
+        int trailer = CardImage::FirstBlockOfSector(sector) + CardImage::BlocksInSector(sector) - 1;
+        const unsigned char* keyA = data + trailer * 16;
+        for (int i = 0; i < 6; i++) {
+            if (keyA[i] != 0) {
+                loaded.SetSectorKey(sector, 0x60, keyA);
+                break;
+            }
+        }
+    }
+
+    image = loaded;
+    return true;
+}
+
+bool CardDumpFile::ParseLegacyText(const std::string& text, CardImage& image, int64_t* timestamp) {
+    std::vector<unsigned char> uid;
+    std::vector<std::pair<int, CardBlock>> blocks;
+    int64_t savedAt = 0;
+    bool haveUid = false;
+    int sector = -1;
+
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos) {
+            lineEnd = text.size();
+        }
+        std::string line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (!haveUid) {
+            if (line.compare(0, 4, "UID:") == 0) {
+                unsigned char bytes[CardImage::MAX_UID];
+                size_t count = ParseHexBytes(line, 4, bytes, CardImage::MAX_UID);
+                uid.assign(bytes, bytes + count);
+                haveUid = count > 0;
+            }
+            else {
+                // "时间: " 行（ctime 格式，不依赖中文标签的编码）
+                size_t colon = line.find(": ");
+                if (colon != std::string::npos) {
+                    ParseCtime(line.substr(colon + 2), savedAt);
+                }
+            }
+            continue;
+        }
+
+        if (IsSectorHeader(line)) {
+            sector++;
+            if (sector >= CardImage::MAX_SECTORS) {
+                return false;
+            }
+            continue;
+        }
+
+        if (sector < 0 || line.compare(0, 2, "  ") != 0) {
+            continue;
+        }
+
+        // "  块 i (n): xx xx ... [ASCII: ...]"，块号取行中的 i：读取失败的块没有这一行，不能按出现顺序计数
+        size_t dataStart = line.find("): ");
+        int blockInSector = 0;
+        if (dataStart == std::string::npos || !ParseBlockIndex(line, dataStart, blockInSector) ||
+            blockInSector >= CardImage::BlocksInSector(sector)) {
+            continue;
+        }
+        CardBlock block;
+        if (ParseHexBytes(line, dataStart + 3, block.data(), 16) == 16) {
+            blocks.emplace_back(CardImage::FirstBlockOfSector(sector) + blockInSector, block);
+        }
+    }
+
+    if (!haveUid || sector < 0) {
+        return false;
+    }
+
+    int sectorCount = sector + 1;
+    CardImage loaded(sectorCount > 32 ? CardGeometry::Classic4K :
+        sectorCount > 16 ? CardGeometry::Classic2K : CardGeometry::Classic1K);
+    loaded.SetUid(uid);
+    for (const auto& entry : blocks) {
+        loaded.StoreRead(entry.first, entry.second.data());
+    }
+
+    image = loaded;
+    if (timestamp) {
+        *timestamp = savedAt;
+    }
+    return true;
+}
+
+bool CardDumpFile::Load(const std::string& path, CardImage& image, int64_t* timestamp, DumpFormat* format) {
+    if (format) {
+        *format = DumpFormat::Unknown;
+    }
+
+    std::vector<unsigned char> content;
+    if (!ReadWholeFile(path, content)) {
+        return false;
+    }
+
+    if (content.size() >= 4 && std::memcmp(content.data(), MAGIC, 4) == 0) {
+        if (!Deserialize(content.data(), content.size(), image, timestamp)) {
+            return false;
+        }
+        if (format) {
+            *format = DumpFormat::Native;
+        }
+        return true;
+    }
+
+    // 先按文本备份解析：长度恰好是 320/1024/2048/4096 字节的 backup_*.txt 不能当成 .mfd
+    if (ParseLegacyText(std::string(content.begin(), content.end()), image, timestamp)) {
+        if (format) {
+            *format = DumpFormat::LegacyText;
+        }
+        return true;
+    }
+
+    CardGeometry geometry;
+    if (!GeometryFromMfdSize(content.size(), geometry) || !ParseMfd(content.data(), content.size(), image)) {
+        return false;
+    }
+    if (timestamp) {
+        *timestamp = 0;
+    }
+    if (format) {
+        *format = DumpFormat::Mfd;
+    }
+    return true;
+}
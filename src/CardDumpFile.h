@@ -0,0 +1,57 @@
+﻿#pragma once
+#include "CardImage.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 卡片转储文件格式
+enum class DumpFormat {
+    Unknown,
+    Native,      // 本项目的二进制格式（.pn532）
+    Mfd,         // 标准 .mfd 原始块（320/1024/2048/4096 字节）
+    LegacyText,  // 旧版 BackupCardData 写出的 backup_*.txt
+};
+
+// 卡片镜像的保存与载入
+//
+// 二进制格式（小端序）：
+//   0   "PN5D"            魔数
+//   4   u16 版本          当前为 VERSION，读取时接受不高于它的版本
+//   6   u16 头长度        块数据从这里开始，新版本可以在头部追加字段
+//   8   u8  容量          CardGeometry
+//   9   u8  UID长度
+//   10  u8[10] UID
+//   20  u16 ATQA
+//   22  u8  SAK
+//   23  u8  扇区数
+//   24  i64 保存时间      Unix 秒
+//   32  u8[32] 块已知位图  第 n 块对应第 n/8 字节的第 n%8 位
+//   头部之后：块数 × 16 字节原始块，扇区数 × 8 字节密钥（标志、密钥类型、6字节密钥），
+//   最后是前面全部内容的 CRC32。
+// 不依赖串口，可单独编译（供 tools/import_backup.cpp 使用）。
+class CardDumpFile {
+public:
+    static constexpr uint16_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 64;
+
+    // 内存中的编码与解码
+    static std::vector<unsigned char> Serialize(const CardImage& image, int64_t timestamp);
+    static bool Deserialize(const unsigned char* data, size_t size, CardImage& image, int64_t* timestamp = nullptr);
+
+    // 本项目格式
+    static bool Save(const std::string& path, const CardImage& image, int64_t timestamp);
+
+    // 标准 .mfd 格式：未知的块写0，控制块中填入已知的扇区密钥
+    static bool SaveMfd(const std::string& path, const CardImage& image);
+    static bool ParseMfd(const unsigned char* data, size_t size, CardImage& image);
+
+    // 旧版文本备份：按出现顺序确定扇区和块（旧文件中扇区号、块号可能是十六进制）
+    static bool ParseLegacyText(const std::string& text, CardImage& image, int64_t* timestamp = nullptr);
+
+    // 判断格式并载入（按魔数、文本备份内容、.mfd 文件长度依次判断）
+    static bool Load(const std::string& path, CardImage& image, int64_t* timestamp = nullptr, DumpFormat* format = nullptr);
+
+    // 文件末尾使用的 CRC32（IEEE 802.3）
+    static uint32_t Checksum(const unsigned char* data, size_t size);
+};
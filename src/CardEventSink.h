@@ -0,0 +1,55 @@
+﻿#pragma once
+#include "PN532Status.h"
+#include "CardImage.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 事件级别（数值与 Logger 的日志级别一致）
+enum class EventLevel {
+    Info = 0,
+    Warning = 1,
+    Error = 2,
+    Debug = 3,
+};
+
+// 读卡器事件接口
+// PN532 协议层和读写流程只通过它报告进度和结果，不直接访问控制台
+// 所有方法默认为空实现，只需覆盖关心的事件
+class CardEventSink {
+public:
+    virtual ~CardEventSink() = default;
+
+    // 进度/状态文本
+    virtual void OnMessage(EventLevel /*level*/, const std::string& /*message*/) {}
+
+    // 读卡流程开始/结束
+    virtual void OnDumpStarted(const std::string& /*title*/, const std::vector<unsigned char>& /*uid*/) {}
+    virtual void OnDumpFinished(int /*successfulSectors*/, int /*totalSectors*/) {}
+
+    // 扇区认证结果
+    virtual void OnSectorAuthenticated(uint8_t /*sector*/, uint8_t /*keyType*/,
+        const std::vector<unsigned char>& /*key*/) {}
+    virtual void OnSectorAuthFailed(uint8_t /*sector*/, const PN532Result& /*result*/) {}
+
+    // 块/扇区数据（扇区数据通过 image.SectorBlocks(sector) 访问）
+    virtual void OnBlockRead(uint8_t /*block*/, const CardBlock& /*data*/) {}
+    virtual void OnSectorRead(uint8_t /*sector*/, const CardImage& /*image*/) {}
+    virtual void OnBlockWritten(uint8_t /*block*/, const CardBlock& /*data*/,
+        const PN532Result& /*result*/) {}
+
+    // 写入控制块前确认（默认拒绝，避免无人值守时锁死卡片）
+    virtual bool ConfirmControlBlockWrite(uint8_t /*block*/) { return false; }
+
+    // 检测到多个串口时选择其一，返回下标，-1 表示取消（默认选第一个）
+    virtual int ChoosePort(const std::vector<std::string>& /*ports*/) { return 0; }
+};
+
+// 不产生任何输出的事件接收器（无界面/后台服务使用）
+class NullCardEventSink : public CardEventSink {
+public:
+    static NullCardEventSink& Instance() {
+        static NullCardEventSink sink;
+        return sink;
+    }
+};
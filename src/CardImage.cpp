@@ -0,0 +1,123 @@
+﻿#include "CardImage.h"
+#include <algorithm>
+
+CardImage::CardImage(CardGeometry cardGeometry)
+    : blocks(), keys(), uid(), uidLength(0), atqa(0), sak(0), geometry(cardGeometry) {
+}
+
+int CardImage::SectorCountOf(CardGeometry cardGeometry) {
+    switch (cardGeometry) {
+    case CardGeometry::Mini: return 5;
+    case CardGeometry::Classic2K: return 32;
+    case CardGeometry::Classic4K: return 40;
+    default: return 16;
+    }
+}
+
+int CardImage::BlockCountOf(CardGeometry cardGeometry) {
+    switch (cardGeometry) {
+    case CardGeometry::Mini: return 20;
+    case CardGeometry::Classic2K: return 128;
+    case CardGeometry::Classic4K: return 256;
+    default: return 64;
+    }
+}
+
+// 4K卡前32个扇区每扇区4块，后8个扇区每扇区16块
+int CardImage::FirstBlockOfSector(int sector) {
+    return sector < 32 ? sector * 4 : 128 + (sector - 32) * 16;
+}
+
+int CardImage::BlocksInSector(int sector) {
+    return sector < 32 ? 4 : 16;
+}
+
+int CardImage::SectorOfBlock(int block) {
+    return block < 128 ? block / 4 : 32 + (block - 128) / 16;
+}
+
+bool CardImage::IsTrailer(int block) {
+    int sector = SectorOfBlock(block);
+    return block == FirstBlockOfSector(sector) + BlocksInSector(sector) - 1;
+}
+
+void CardImage::SetUid(const std::vector<unsigned char>& cardUid) {
+    uidLength = static_cast<uint8_t>(std::min<size_t>(cardUid.size(), MAX_UID));
+    std::copy(cardUid.begin(), cardUid.begin() + uidLength, uid.begin());
+}
+
+bool CardImage::SectorKnown(int sector) const {
+    int first = FirstBlockOfSector(sector);
+    for (int block = first; block < first + BlocksInSector(sector); block++) {
+        if (!known.test(block)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int CardImage::KnownSectorCount() const {
+    int count = 0;
+    for (int sector = 0; sector < SectorCount(); sector++) {
+        if (SectorKnown(sector)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int CardImage::KnownBlockCount() const {
+    return static_cast<int>(known.count());
+}
+
+void CardImage::StoreRead(int block, const unsigned char* data) {
+    if (block < 0 || block >= BlockCount()) {
+        return;
+    }
+    std::memcpy(blocks[block].bytes, data, 16);
+    known.set(block);
+    dirty.reset(block);
+}
+
+void CardImage::Edit(int block, const unsigned char* data) {
+    if (block < 0 || block >= BlockCount()) {
+        return;
+    }
+    std::memcpy(blocks[block].bytes, data, 16);
+    known.set(block);
+    dirty.set(block);
+}
+
+void CardImage::MarkWritten(int block) {
+    if (block >= 0 && block < MAX_BLOCKS) {
+        dirty.reset(block);
+    }
+}
+
+void CardImage::Forget(int block) {
+    if (block >= 0 && block < MAX_BLOCKS) {
+        known.reset(block);
+        dirty.reset(block);
+    }
+}
+
+void CardImage::Clear() {
+    known.reset();
+    dirty.reset();
+    keys.fill(SectorKeyInfo());
+}
+
+void CardImage::SetSectorKey(int sector, uint8_t keyType, const unsigned char* key) {
+    if (sector < 0 || sector >= MAX_SECTORS) {
+        return;
+    }
+    keys[sector].known = true;
+    keys[sector].keyType = keyType;
+    std::copy(key, key + 6, keys[sector].key.begin());
+}
+
+void CardImage::ForgetSectorKey(int sector) {
+    if (sector >= 0 && sector < MAX_SECTORS) {
+        keys[sector] = SectorKeyInfo();
+    }
+}
@@ -0,0 +1,149 @@
+﻿#pragma once
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// 16字节数据块（16字节对齐，可按数组方式访问）
+struct alignas(16) CardBlock {
+    unsigned char bytes[16];
+
+    unsigned char* data() { return bytes; }
+    const unsigned char* data() const { return bytes; }
+    static constexpr size_t size() { return 16; }
+
+    unsigned char* begin() { return bytes; }
+    unsigned char* end() { return bytes + 16; }
+    const unsigned char* begin() const { return bytes; }
+    const unsigned char* end() const { return bytes + 16; }
+
+    unsigned char& operator[](size_t i) { return bytes[i]; }
+    unsigned char operator[](size_t i) const { return bytes[i]; }
+
+    bool operator==(const CardBlock& other) const { return std::memcmp(bytes, other.bytes, 16) == 0; }
+    bool operator!=(const CardBlock& other) const { return !(*this == other); }
+
+    static CardBlock From(const unsigned char* source) {
+        CardBlock block;
+        std::memcpy(block.bytes, source, 16);
+        return block;
+    }
+    std::vector<unsigned char> ToVector() const { return std::vector<unsigned char>(bytes, bytes + 16); }
+};
+static_assert(sizeof(CardBlock) == 16, "CardBlock 必须正好16字节");
+
+// 连续元素的视图（项目按 C++17 编译，没有 std::span）
+template <typename T>
+class Span {
+private:
+    T* first;
+    size_t count;
+
+public:
+    Span() : first(nullptr), count(0) {}
+    Span(T* pointer, size_t length) : first(pointer), count(length) {}
+
+    T* data() const { return first; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* begin() const { return first; }
+    T* end() const { return first + count; }
+    T& operator[](size_t i) const { return first[i]; }
+};
+
+// MIFARE Classic 卡片容量
+enum class CardGeometry {
+    Mini,       // 5扇区 × 4块（320字节）
+    Classic1K,  // 16扇区 × 4块
+    Classic2K,  // 32扇区 × 4块
+    Classic4K,  // 32扇区 × 4块 + 8扇区 × 16块
+};
+
+// 扇区认证所用的密钥
+struct SectorKeyInfo {
+    bool known;
+    uint8_t keyType;                     // 0x60 = Key A, 0x61 = Key B
+    std::array<unsigned char, 6> key;
+
+    SectorKeyInfo() : known(false), keyType(0x60), key() {}
+};
+
+// 整卡镜像
+// 块数据按最大容量（4K，256块）连续存放，1K卡的每个扇区正好占一条64字节缓存行；
+// known 表示块内容已知（从卡片读到或已载入），dirty 表示本地修改过、尚未写回卡片。
+// 构造后不再分配内存，可以直接复制。
+class CardImage {
+public:
+    static constexpr int MAX_BLOCKS = 256;
+    static constexpr int MAX_SECTORS = 40;
+    static constexpr int MAX_SECTOR_BLOCKS = 16;
+    static constexpr int MAX_UID = 10;
+
+private:
+    alignas(64) std::array<CardBlock, MAX_BLOCKS> blocks;
+    std::bitset<MAX_BLOCKS> known;
+    std::bitset<MAX_BLOCKS> dirty;
+    std::array<SectorKeyInfo, MAX_SECTORS> keys;
+    std::array<unsigned char, MAX_UID> uid;
+    uint8_t uidLength;
+    uint16_t atqa;
+    uint8_t sak;
+    CardGeometry geometry;
+
+public:
+    CardImage() : CardImage(CardGeometry::Classic1K) {}
+    explicit CardImage(CardGeometry cardGeometry);
+
+    // 容量与布局
+    static int SectorCountOf(CardGeometry cardGeometry);
+    static int BlockCountOf(CardGeometry cardGeometry);
+    static int FirstBlockOfSector(int sector);
+    static int BlocksInSector(int sector);
+    static int SectorOfBlock(int block);
+    static bool IsTrailer(int block);
+
+    CardGeometry Geometry() const { return geometry; }
+    int SectorCount() const { return SectorCountOf(geometry); }
+    int BlockCount() const { return BlockCountOf(geometry); }
+
+    // UID
+    void SetUid(const std::vector<unsigned char>& cardUid);
+    std::vector<unsigned char> Uid() const { return std::vector<unsigned char>(uid.begin(), uid.begin() + uidLength); }
+    Span<const unsigned char> UidView() const { return Span<const unsigned char>(uid.data(), uidLength); }
+
+    // 选卡应答中的 ATQA（SENS_RES）和 SAK（SEL_RES），未知时为0
+    void SetTargetInfo(uint16_t cardAtqa, uint8_t cardSak) { atqa = cardAtqa; sak = cardSak; }
+    uint16_t Atqa() const { return atqa; }
+    uint8_t Sak() const { return sak; }
+
+    // 块访问（块号须小于 BlockCount）
+    const CardBlock& Block(int block) const { return blocks[block]; }
+    Span<const unsigned char> BlockBytes(int block) const { return Span<const unsigned char>(blocks[block].data(), 16); }
+    Span<const CardBlock> SectorBlocks(int sector) const {
+        return Span<const CardBlock>(&blocks[FirstBlockOfSector(sector)], BlocksInSector(sector));
+    }
+
+    bool IsKnown(int block) const { return known.test(block); }
+    bool IsDirty(int block) const { return dirty.test(block); }
+    bool SectorKnown(int sector) const;
+    int KnownSectorCount() const;
+    int KnownBlockCount() const;
+    bool Complete() const { return KnownBlockCount() == BlockCount(); }
+
+    // 从卡片读到的内容：标记已知并清除修改标记
+    void StoreRead(int block, const unsigned char* data);
+    // 本地修改：标记已知且待写回
+    void Edit(int block, const unsigned char* data);
+    // 已写回卡片
+    void MarkWritten(int block);
+    // 内容不再可信（例如卡片上的块被其他途径修改）
+    void Forget(int block);
+    void Clear();
+
+    // 扇区密钥
+    const SectorKeyInfo& SectorKey(int sector) const { return keys[sector]; }
+    void SetSectorKey(int sector, uint8_t keyType, const unsigned char* key);
+    void ForgetSectorKey(int sector);
+};
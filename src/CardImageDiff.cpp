@@ -0,0 +1,107 @@
+﻿#include "CardImageDiff.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CARD_IMAGE_DIFF_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+int NibbleValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+}  // namespace
+
+bool BlockPattern::Parse(const std::string& text, BlockPattern& pattern) {
+    BlockPattern parsed;
+    size_t nibble = 0;
+    for (char c : text) {
+        if (c == ' ') {
+            continue;
+        }
+        if (nibble >= 32) {
+            return false;
+        }
+        int value = NibbleValue(c);
+        if (value < 0 && c != '?') {
+            return false;
+        }
+        // 高半字节在前
+        int shift = (nibble % 2 == 0) ? 4 : 0;
+        if (value >= 0) {
+            parsed.value[nibble / 2] |= static_cast<unsigned char>(value << shift);
+            parsed.mask[nibble / 2] |= static_cast<unsigned char>(0x0F << shift);
+        }
+        nibble++;
+    }
+    if (nibble == 0 || nibble % 2 != 0) {
+        return false;
+    }
+    pattern = parsed;
+    return true;
+}
+
+bool BlockPattern::Matches(const CardBlock& block) const {
+    return Matches(block.data());
+}
+
+bool BlockPattern::Matches(const unsigned char* block) const {
+#ifdef CARD_IMAGE_DIFF_SSE2
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    __m128i wanted = _mm_load_si128(reinterpret_cast<const __m128i*>(value.data()));
+    __m128i bits = _mm_load_si128(reinterpret_cast<const __m128i*>(mask.data()));
+    __m128i equal = _mm_cmpeq_epi8(_mm_and_si128(data, bits), _mm_and_si128(wanted, bits));
+    return _mm_movemask_epi8(equal) == 0xFFFF;
+#else
+    for (size_t i = 0; i < 16; i++) {
+        if ((block[i] & mask[i]) != (value[i] & mask[i])) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+uint16_t CardImageDiff::CompareBlocks(const CardBlock& a, const CardBlock& b) {
+#ifdef CARD_IMAGE_DIFF_SSE2
+    __m128i left = _mm_load_si128(reinterpret_cast<const __m128i*>(a.data()));
+    __m128i right = _mm_load_si128(reinterpret_cast<const __m128i*>(b.data()));
+    return static_cast<uint16_t>(~_mm_movemask_epi8(_mm_cmpeq_epi8(left, right)) & 0xFFFF);
+#else
+    uint16_t changed = 0;
+    for (size_t i = 0; i < 16; i++) {
+        if (a[i] != b[i]) {
+            changed |= static_cast<uint16_t>(1 << i);
+        }
+    }
+    return changed;
+#endif
+}
+
+std::vector<BlockDiff> CardImageDiff::Diff(const CardImage& before, const CardImage& after) {
+    std::vector<BlockDiff> diffs;
+    int blockCount = std::max(before.BlockCount(), after.BlockCount());
+    for (int block = 0; block < blockCount; block++) {
+        bool knownBefore = block < before.BlockCount() && before.IsKnown(block);
+        bool knownAfter = block < after.BlockCount() && after.IsKnown(block);
+        if (!knownBefore && !knownAfter) {
+            continue;
+        }
+
+        uint16_t changed = (knownBefore && knownAfter) ? CompareBlocks(before.Block(block), after.Block(block)) : 0xFFFF;
+        if (changed != 0) {
+            BlockDiff diff;
+            diff.block = block;
+            diff.changedBytes = changed;
+            diff.knownBefore = knownBefore;
+            diff.knownAfter = knownAfter;
+            diffs.push_back(diff);
+        }
+    }
+    return diffs;
+}
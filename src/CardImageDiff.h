@@ -0,0 +1,35 @@
+﻿#pragma once
+#include "CardImage.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 两个镜像中不同的块
+struct BlockDiff {
+    int block = 0;
+    uint16_t changedBytes = 0;   // 第 i 位表示第 i 个字节不同（只有一边已知时为 0xFFFF）
+    bool knownBefore = false;
+    bool knownAfter = false;
+};
+
+// 块内容的匹配条件：(块 & mask) == (value & mask)
+struct BlockPattern {
+    CardBlock value = {};
+    CardBlock mask = {};
+
+    // 十六进制文本，可含空格，"?" 表示任意半字节；不足16字节时其余字节不限，如 "00 ?? 1f"、"de ad ?e ef"
+    static bool Parse(const std::string& text, BlockPattern& pattern);
+
+    bool Matches(const CardBlock& block) const;
+    bool Matches(const unsigned char* block) const;  // 任意对齐的16字节
+};
+
+// 镜像比较（x86/x64 上每块一次 SSE2 比较，其他平台逐字节）
+class CardImageDiff {
+public:
+    // 不同字节的位图，相同时为0
+    static uint16_t CompareBlocks(const CardBlock& a, const CardBlock& b);
+
+    // 按块比较两个镜像：两边都已知且内容不同、或只有一边已知的块
+    static std::vector<BlockDiff> Diff(const CardImage& before, const CardImage& after);
+};
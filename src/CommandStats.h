@@ -0,0 +1,315 @@
+﻿#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+// 对数-线性延迟直方图（单位：微秒）
+// 每个2的幂区间再均分为8个子桶，相对误差 < 12.5%，记录时不分配内存
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_EXPONENT = 27;  // 2^27 us ≈ 134 秒
+    static constexpr int BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    void Record(uint64_t us) {
+        buckets[BucketIndex(us)]++;
+        count++;
+        sum += us;
+        if (us > max) {
+            max = us;
+        }
+    }
+
+    uint64_t Count() const { return count; }
+    uint64_t Sum() const { return sum; }
+    uint64_t Max() const { return max; }
+    uint64_t BucketCount(int index) const { return buckets[index]; }
+
+    // 估算分位数（返回所在桶的上界，单位微秒）
+    uint64_t Percentile(double p) const {
+        if (count == 0) {
+            return 0;
+        }
+
+        uint64_t target = (uint64_t)(p * count);
+        if (target >= count) {
+            target = count - 1;
+        }
+
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            seen += buckets[i];
+            if (seen > target) {
+                uint64_t upper = BucketLowerBound(i + 1);
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+
+    static int BucketIndex(uint64_t us) {
+        if (us < SUB_BUCKETS) {
+            return (int)us;
+        }
+
+        int exponent = 63;
+        while (!(us & (1ULL << exponent))) {
+            exponent--;
+        }
+        if (exponent > MAX_EXPONENT) {
+            return BUCKET_COUNT - 1;
+        }
+
+        int sub = (int)((us >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+        return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    static uint64_t BucketLowerBound(int index) {
+        if (index < SUB_BUCKETS) {
+            return (uint64_t)index;
+        }
+        int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+        uint64_t sub = (uint64_t)(index % SUB_BUCKETS);
+        return (SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS);
+    }
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> buckets{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+};
+
+// 统计槽位：按命令码，InDataExchange 再按子命令细分
+enum class CommandSlot : int {
+    GetFirmwareVersion = 0,
+    SAMConfiguration,
+    InListPassiveTarget,
+    ExchangeAuthA,
+    ExchangeAuthB,
+    ExchangeRead,
+    ExchangeWrite,
+    ExchangeOther,
+    Other,
+    Count
+};
+
+inline const char* CommandSlotName(CommandSlot slot) {
+    switch (slot) {
+    case CommandSlot::GetFirmwareVersion: return "GetFirmwareVersion";
+    case CommandSlot::SAMConfiguration: return "SAMConfiguration";
+    case CommandSlot::InListPassiveTarget: return "InListPassiveTarget";
+    case CommandSlot::ExchangeAuthA: return "InDataExchange/AuthA";
+    case CommandSlot::ExchangeAuthB: return "InDataExchange/AuthB";
+    case CommandSlot::ExchangeRead: return "InDataExchange/Read";
+    case CommandSlot::ExchangeWrite: return "InDataExchange/Write";
+    case CommandSlot::ExchangeOther: return "InDataExchange/Other";
+    default: return "Other";
+    }
+}
+
+// 根据命令码和子命令确定统计槽位
+inline CommandSlot CommandSlotFor(uint8_t command, uint8_t subCommand) {
+    switch (command) {
+    case 0x02: return CommandSlot::GetFirmwareVersion;
+    case 0x14: return CommandSlot::SAMConfiguration;
+    case 0x4A: return CommandSlot::InListPassiveTarget;
+    case 0x40:
+        switch (subCommand) {
+        case 0x60: return CommandSlot::ExchangeAuthA;
+        case 0x61: return CommandSlot::ExchangeAuthB;
+        case 0x30: return CommandSlot::ExchangeRead;
+        case 0xA0: return CommandSlot::ExchangeWrite;
+        default: return CommandSlot::ExchangeOther;
+        }
+    default: return CommandSlot::Other;
+    }
+}
+
+// 单个命令的统计
+struct CommandStats {
+    LatencyHistogram roundTrip;      // 完整往返时间
+    uint64_t serialWriteUs = 0;      // 写串口耗时累计
+    uint64_t waitUs = 0;             // 程序内固定等待(sleep)耗时累计
+    uint64_t serialReadUs = 0;       // 读串口耗时累计（含等待模块应答）
+    uint64_t transportErrors = 0;    // 发送失败/无响应/帧错误
+    std::array<uint64_t, 256> statusCounts{};  // PN532 状态字节计数（0x00 为成功）
+
+    uint64_t ErrorCount() const {
+        uint64_t errors = transportErrors;
+        for (size_t i = 1; i < statusCounts.size(); i++) {
+            errors += statusCounts[i];
+        }
+        return errors;
+    }
+};
+
+// 单个读卡器的全部命令统计（快照可复制）
+struct PN532Stats {
+    std::string port;
+    std::array<CommandStats, (size_t)CommandSlot::Count> commands{};
+    LatencyHistogram timeToReady;    // 打开串口（或重连）到读卡器完成 SAM 配置
+    uint64_t readyFromCache = 0;     // 其中使用缓存的固件信息、跳过固件查询的次数
+    uint64_t readyFailures = 0;      // 截止时间内没有就绪的次数
+
+    const CommandStats& Get(CommandSlot slot) const {
+        return commands[(size_t)slot];
+    }
+
+    // 格式化为多行文本（用于日志）
+    std::string Format() const {
+        std::stringstream ss;
+        ss << "命令统计 - 串口: " << (port.empty() ? "未连接" : port);
+
+        auto ms = [](uint64_t us) {
+            std::stringstream v;
+            v << std::fixed << std::setprecision(1) << us / 1000.0;
+            return v.str();
+        };
+
+        if (timeToReady.Count() > 0 || readyFailures > 0) {
+            ss << "\n  就绪: 次数=" << timeToReady.Count()
+                << " 缓存=" << readyFromCache
+                << " 失败=" << readyFailures
+                << " p50=" << ms(timeToReady.Percentile(0.50)) << "ms"
+                << " max=" << ms(timeToReady.Max()) << "ms";
+        }
+
+        for (size_t i = 0; i < commands.size(); i++) {
+            const CommandStats& c = commands[i];
+            if (c.roundTrip.Count() == 0) {
+                continue;
+            }
+
+            ss << "\n  " << CommandSlotName((CommandSlot)i)
+                << ": 次数=" << c.roundTrip.Count()
+                << " 错误=" << c.ErrorCount()
+                << " p50=" << ms(c.roundTrip.Percentile(0.50)) << "ms"
+                << " p90=" << ms(c.roundTrip.Percentile(0.90)) << "ms"
+                << " p99=" << ms(c.roundTrip.Percentile(0.99)) << "ms"
+                << " max=" << ms(c.roundTrip.Max()) << "ms"
+                << " | 写串口=" << ms(c.serialWriteUs) << "ms"
+                << " 等待=" << ms(c.waitUs) << "ms"
+                << " 读串口=" << ms(c.serialReadUs) << "ms";
+
+            if (c.transportErrors > 0) {
+                ss << " 传输错误=" << c.transportErrors;
+            }
+            for (size_t code = 1; code < c.statusCounts.size(); code++) {
+                if (c.statusCounts[code] > 0) {
+                    ss << " 0x" << std::hex << std::setw(2) << std::setfill('0') << code
+                        << std::dec << "×" << c.statusCounts[code];
+                }
+            }
+        }
+        return ss.str();
+    }
+};
+
+// 线程安全的统计记录器
+class CommandStatsRecorder {
+private:
+    mutable std::mutex statsMutex;
+    PN532Stats stats;
+
+public:
+    void SetPort(const std::string& port) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.port = port;
+    }
+
+    void Record(CommandSlot slot, uint64_t totalUs, uint64_t writeUs, uint64_t waitUs,
+        uint64_t readUs, bool transportError, uint8_t status) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        CommandStats& c = stats.commands[(size_t)slot];
+        c.roundTrip.Record(totalUs);
+        c.serialWriteUs += writeUs;
+        c.waitUs += waitUs;
+        c.serialReadUs += readUs;
+        if (transportError) {
+            c.transportErrors++;
+        }
+        else {
+            c.statusCounts[status]++;
+        }
+    }
+
+    // 一次就绪过程：ready 为 false 表示截止时间内没有就绪
+    void RecordReady(uint64_t us, bool ready, bool fromCache) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (!ready) {
+            stats.readyFailures++;
+            return;
+        }
+        stats.timeToReady.Record(us);
+        if (fromCache) {
+            stats.readyFromCache++;
+        }
+    }
+
+    PN532Stats Snapshot() const {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        return stats;
+    }
+
+    void Reset() {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        std::string port = stats.port;
+        stats = PN532Stats();
+        stats.port = port;
+    }
+};
+
+// 命令计时器：构造时开始计时，析构时记录
+// 用 MarkWrite/MarkWait/MarkRead 划分串口写、固定等待、串口读三个阶段
+class CommandTimer {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    CommandStatsRecorder& recorder;
+    CommandSlot slot;
+    Clock::time_point start;
+    Clock::time_point lastMark;
+    uint64_t writeUs = 0;
+    uint64_t waitUs = 0;
+    uint64_t readUs = 0;
+    bool transportError = true;  // 未设置状态即视为传输失败
+    uint8_t status = 0;
+
+    uint64_t SinceLastMark() {
+        Clock::time_point now = Clock::now();
+        uint64_t us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - lastMark).count();
+        lastMark = now;
+        return us;
+    }
+
+public:
+    CommandTimer(CommandStatsRecorder& rec, uint8_t command, uint8_t subCommand = 0)
+        : recorder(rec), slot(CommandSlotFor(command, subCommand)),
+        start(Clock::now()), lastMark(start) {
+    }
+
+    ~CommandTimer() {
+        uint64_t totalUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - start).count();
+        recorder.Record(slot, totalUs, writeUs, waitUs, readUs, transportError, status);
+    }
+
+    CommandTimer(const CommandTimer&) = delete;
+    CommandTimer& operator=(const CommandTimer&) = delete;
+
+    void MarkWrite() { writeUs += SinceLastMark(); }
+    void MarkWait() { waitUs += SinceLastMark(); }
+    void MarkRead() { readUs += SinceLastMark(); }
+
+    // 收到有效应答，记录PN532状态字节（0x00为成功）
+    void SetStatus(uint8_t code) {
+        transportError = false;
+        status = code;
+    }
+};
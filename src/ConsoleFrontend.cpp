@@ -0,0 +1,933 @@
+﻿#include "ConsoleFrontend.h"
+#include "Trace.h"
+#include "BlockFormatter.h"
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <conio.h>
+#include <string>
+#include <algorithm>
+
+// 追加十六进制字节（"XX XX ..."）
+static void AppendHex(std::string& out, const unsigned char* data, size_t size) {
+    size_t start = out.size();
+    out.resize(start + size * 3);
+    BlockFormatter::HexSpaced(data, size, &out[start]);
+}
+
+static void AppendHex(std::string& out, const std::vector<unsigned char>& data) {
+    AppendHex(out, data.data(), data.size());
+}
+
+static void WriteConsole(const std::string& text) {
+    std::cout.write(text.data(), text.size());
+    std::cout.flush();
+}
+
+// =================================================================
+// 控制台事件接收器
+// =================================================================
+
+void ConsoleEventSink::OnMessage(EventLevel level, const std::string& message) {
+    // 调试信息只写入日志文件
+    if (level == EventLevel::Debug) {
+        return;
+    }
+    WriteConsole(message + "\n");
+}
+
+void ConsoleEventSink::OnDumpStarted(const std::string& title, const std::vector<unsigned char>& uid) {
+    std::string out = "\n=== " + title + " ===\n卡UID: ";
+    AppendHex(out, uid);
+    out += "\n";
+    WriteConsole(out);
+}
+
+void ConsoleEventSink::OnDumpFinished(int successfulSectors, int totalSectors) {
+    WriteConsole("\n读取完成! 成功读取 " + std::to_string(successfulSectors) + "/" +
+        std::to_string(totalSectors) + " 个扇区\n");
+}
+
+void ConsoleEventSink::OnSectorAuthenticated(uint8_t sector, uint8_t keyType,
+    const std::vector<unsigned char>& key) {
+    std::string out = "✅ 扇区 " + std::to_string(sector) + " 认证成功! 使用密钥: ";
+    out += (keyType == 0x60 ? "Key A " : "Key B ");
+    AppendHex(out, key);
+    out += "\n";
+    WriteConsole(out);
+}
+
+void ConsoleEventSink::OnSectorAuthFailed(uint8_t sector, const PN532Result& result) {
+    WriteConsole("❌ 扇区 " + std::to_string(sector) + " 认证失败: " + result.Describe() + "\n");
+}
+
+void ConsoleEventSink::OnBlockRead(uint8_t block, const CardBlock& data) {
+    std::string out = "块 " + std::to_string(block) + ": ";
+    AppendHex(out, data.data(), data.size());
+    out += "\n";
+    WriteConsole(out);
+}
+
+void ConsoleEventSink::OnSectorRead(uint8_t sector, const CardImage& image) {
+    PN532_TRACE_SPAN_ARG("显示扇区", "render", "sector", sector);
+
+    std::string out = "\n扇区 " + std::to_string(sector) + " 数据:\n";
+    out.reserve(out.size() + CardImage::BlocksInSector(sector) * BlockFormatter::MAX_LINE_LENGTH);
+    char line[BlockFormatter::MAX_LINE_LENGTH];
+    int firstBlock = CardImage::FirstBlockOfSector(sector);
+    Span<const CardBlock> blocks = image.SectorBlocks(sector);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        int blockNumber = firstBlock + static_cast<int>(i);
+        if (!image.IsKnown(blockNumber)) {
+            continue;
+        }
+
+        const unsigned char* block = blocks[i].data();
+        out += "  块 " + std::to_string(blockNumber) + ": ";
+
+        if (!CardImage::IsTrailer(blockNumber)) {  // 数据块，包含可打印字符时显示ASCII
+            out.append(line, BlockFormatter::Line(block, false, line));
+        }
+        else {  // 扇区最后一块是控制块，下一行拆出密钥和访问位
+            out += "[控制块] ";
+            out.append(line, BlockFormatter::HexSpaced(block, BlockFormatter::BLOCK_SIZE, line));
+            out += "\n        ";
+            out.append(line, BlockFormatter::Trailer(block, line));
+        }
+        out += "\n";
+    }
+    WriteConsole(out);
+}
+
+void ConsoleEventSink::OnBlockWritten(uint8_t block, const CardBlock& /*data*/,
+    const PN532Result& result) {
+    if (result.Ok()) {
+        WriteConsole("✅ 块 " + std::to_string(block) + " 写入成功!\n");
+    }
+    else {
+        WriteConsole("写入失败! " + result.Describe() + "\n");
+    }
+}
+
+bool ConsoleEventSink::ConfirmControlBlockWrite(uint8_t block) {
+    WriteConsole("警告: 尝试写入控制块 " + std::to_string(block) + "! 这可能会永久锁死卡片!\n"
+        "按 Y 确认写入控制块，其他键取消: ");
+    char ch = _getch();
+    WriteConsole("\n");
+    return ch == 'Y' || ch == 'y';
+}
+
+int ConsoleEventSink::ChoosePort(const std::vector<std::string>& ports) {
+    std::string out = "\n检测到多个串口，请选择:\n";
+    for (size_t i = 0; i < ports.size(); i++) {
+        out += "  [" + std::to_string(i + 1) + "] " + ports[i] + "\n";
+    }
+    out += "\n请选择串口号 (1-" + std::to_string(ports.size()) + "): ";
+    WriteConsole(out);
+
+    int choice;
+    std::cin >> choice;
+    std::cin.ignore();
+
+    if (choice < 1 || choice > static_cast<int>(ports.size())) {
+        return -1;
+    }
+    return choice - 1;
+}
+
+// =================================================================
+// 控制台交互前端
+// =================================================================
+
+ConsoleFrontend::ConsoleFrontend(PN532& reader) : nfc(reader) {
+}
+
+void ConsoleFrontend::SetupKeysFromUserInput() {
+    nfc.ClearAllKeys();
+
+    std::cout << "\n=== 密钥设置 ===" << std::endl;
+    nfc.LogToFile("开始密钥设置", 0);
+
+    std::cout << "请选择密钥模式:" << std::endl;
+    std::cout << "1. 仅使用默认密钥 (FFFFFFFFFFFF)" << std::endl;
+    std::cout << "2. 使用默认密钥 + 自定义密钥" << std::endl;
+    std::cout << "3. 仅使用自定义密钥" << std::endl;
+    std::cout << "请选择 (1-3): ";
+
+    int choice;
+    std::cin >> choice;
+    std::cin.ignore();  // 清除换行符
+
+    bool addDefaultKeys = (choice == 1 || choice == 2);
+    bool addCustomKeys = (choice == 2 || choice == 3);
+
+    // 记录用户选择
+    std::string modeStr;
+    switch (choice) {
+    case 1: modeStr = "仅默认密钥"; break;
+    case 2: modeStr = "默认+自定义密钥"; break;
+    case 3: modeStr = "仅自定义密钥"; break;
+    default: modeStr = "未知模式";
+    }
+    nfc.LogToFile("用户选择密钥模式: " + modeStr, 0);
+
+    if (addDefaultKeys) {
+        std::cout << "添加默认密钥到所有扇区..." << std::endl;
+        nfc.LogToFile("添加默认密钥到所有扇区", 0);
+
+        for (int sector = 0; sector < 16; sector++) {
+            nfc.AddDefaultKeyA(sector);
+            nfc.AddDefaultKeyB(sector);
+        }
+
+        nfc.LogToFile("已添加默认密钥FFFFFFFFFFFF到所有扇区", 0);
+    }
+
+    if (addCustomKeys) {
+        std::cout << "\n=== 添加自定义密钥 ===" << std::endl;
+        std::cout << "密钥格式: 12位十六进制数字 (例如: FFFFFFFFFFFF)" << std::endl;
+        std::cout << "输入 'q' 结束输入" << std::endl;
+
+        nfc.LogToFile("开始添加自定义密钥", 0);
+
+        while (true) {
+            std::cout << "\n输入密钥: ";
+            std::string input;
+            std::getline(std::cin, input);
+
+            if (input == "q" || input == "Q") {
+                std::cout << "结束密钥输入" << std::endl;
+                nfc.LogToFile("结束自定义密钥输入", 0);
+                break;
+            }
+
+            // 验证输入格式
+            if (input.length() != 12) {
+                std::cout << "错误: 密钥必须是12位十六进制数字!" << std::endl;
+                nfc.LogToFile("密钥输入错误: 长度必须是12位", 2);
+                continue;
+            }
+
+            bool valid = true;
+            for (char c : input) {
+                if (!((c >= '0' && c <= '9') ||
+                    (c >= 'A' && c <= 'F') ||
+                    (c >= 'a' && c <= 'f'))) {
+                    valid = false;
+                    break;
+                }
+            }
+
+            if (!valid) {
+                std::cout << "错误: 包含无效字符!" << std::endl;
+                nfc.LogToFile("密钥输入错误: 包含无效字符", 2);
+                continue;
+            }
+
+            // 转换为字节
+            std::vector<unsigned char> key;
+            for (int i = 0; i < 12; i += 2) {
+                std::string byteStr = input.substr(i, 2);
+                unsigned char byte = (unsigned char)std::strtoul(byteStr.c_str(), nullptr, 16);
+                key.push_back(byte);
+            }
+
+            // 记录密钥
+            std::stringstream keyMsg;
+            keyMsg << "自定义密钥: ";
+            for (auto k : key) {
+                keyMsg << std::hex << std::setw(2) << std::setfill('0') << (int)k << " ";
+            }
+            nfc.LogToFile(keyMsg.str(), 0);
+
+            // 选择密钥类型
+            std::cout << "密钥类型: 1. Key A  2. Key B (默认: 1): ";
+            std::string typeInput;
+            std::getline(std::cin, typeInput);
+
+            uint8_t keyType = 0x60;  // 默认Key A
+            if (typeInput == "2") {
+                keyType = 0x61;  // Key B
+            }
+
+            std::string typeStr = (keyType == 0x60) ? "Key A" : "Key B";
+            nfc.LogToFile("密钥类型: " + typeStr, 0);
+
+            // 选择扇区
+            std::cout << "应用于哪些扇区?" << std::endl;
+            std::cout << "1. 所有扇区 (0-15)" << std::endl;
+            std::cout << "2. 单个扇区" << std::endl;
+            std::cout << "3. 扇区范围" << std::endl;
+            std::cout << "请选择 (1-3): ";
+
+            std::string sectorChoice;
+            std::getline(std::cin, sectorChoice);
+
+            if (sectorChoice == "1") {
+                // 所有扇区
+                for (int sector = 0; sector < 16; sector++) {
+                    nfc.AddCustomKey(sector, key, keyType);
+                }
+                std::cout << "✅ 已为所有扇区添加密钥" << std::endl;
+                nfc.LogToFile("已将自定义密钥应用到所有扇区", 0);
+            }
+            else if (sectorChoice == "2") {
+                // 单个扇区
+                std::cout << "输入扇区号 (0-15): ";
+                int sector;
+                std::cin >> sector;
+                std::cin.ignore();
+
+                if (sector >= 0 && sector < 16) {
+                    nfc.AddCustomKey(sector, key, keyType);
+                    std::cout << "✅ 已为扇区 " << sector << " 添加密钥" << std::endl;
+                    nfc.LogToFile("已将自定义密钥应用到扇区 " + std::to_string(sector), 0);
+                }
+                else {
+                    std::cout << "❌ 无效的扇区号!" << std::endl;
+                    nfc.LogToFile("无效的扇区号: " + std::to_string(sector), 2);
+                }
+            }
+            else if (sectorChoice == "3") {
+                // 扇区范围
+                std::cout << "输入起始扇区 (0-15): ";
+                int startSector;
+                std::cin >> startSector;
+                std::cin.ignore();
+
+                std::cout << "输入结束扇区 (" << startSector << "-15): ";
+                int endSector;
+                std::cin >> endSector;
+                std::cin.ignore();
+
+                if (startSector >= 0 && startSector < 16 &&
+                    endSector >= startSector && endSector < 16) {
+                    for (int sector = startSector; sector <= endSector; sector++) {
+                        nfc.AddCustomKey(sector, key, keyType);
+                    }
+                    std::cout << "✅ 已为扇区 " << startSector << " 到 " << endSector << " 添加密钥" << std::endl;
+
+                    std::stringstream rangeMsg;
+                    rangeMsg << "已将自定义密钥应用到扇区 " << startSector << " 到 " << endSector;
+                    nfc.LogToFile(rangeMsg.str(), 0);
+                }
+                else {
+                    std::cout << "❌ 无效的扇区范围!" << std::endl;
+                    nfc.LogToFile("无效的扇区范围: " + std::to_string(startSector) + " 到 " + std::to_string(endSector), 2);
+                }
+            }
+            else {
+                std::cout << "❌ 无效的选择，返回主菜单" << std::endl;
+                nfc.LogToFile("无效的扇区选择选项", 2);
+            }
+        }
+    }
+
+    std::cout << "\n✅ 密钥设置完成!" << std::endl;
+    nfc.LogToFile("密钥设置完成", 0);
+}
+
+
+void ConsoleFrontend::ReadCardDataInteractive(const std::vector<unsigned char>& uid) {
+    std::cout << "\n=== 读取卡片数据 ===" << std::endl;
+    std::cout << "卡UID: ";
+    for (auto byte : uid) {
+        printf("%02X ", byte);
+    }
+    std::cout << std::endl;
+
+    // 记录开始交互式读取
+    std::stringstream startMsg;
+    startMsg << "开始交互式读取卡片 - UID: ";
+    for (auto b : uid) {
+        startMsg << std::hex << std::setw(2) << std::setfill('0') << (int)b << " ";
+    }
+    nfc.LogToFile(startMsg.str(), 0);
+
+    // 询问密钥选项
+    std::cout << "\n请选择密钥选项:" << std::endl;
+    std::cout << "1. 快速读取 (仅尝试默认密钥 FFFFFFFFFFFF)" << std::endl;
+    std::cout << "2. 高级读取 (可配置多个密钥)" << std::endl;
+    std::cout << "请选择 (1-2): ";
+
+    std::string choice;
+    std::getline(std::cin, choice);
+
+    if (choice == "1") {
+        // 快速读取：使用默认密钥
+        std::cout << "\n使用默认密钥进行快速读取..." << std::endl;
+        nfc.LogToFile("用户选择快速读取模式", 0);
+
+        nfc.ClearAllKeys();
+
+        // 添加默认密钥到所有扇区
+        for (int sector = 0; sector < 16; sector++) {
+            nfc.AddDefaultKeyA(sector);
+            nfc.AddDefaultKeyB(sector);
+        }
+
+        nfc.LogToFile("已为所有扇区设置默认密钥: FFFFFFFFFFFFF", 0);
+        nfc.ReadCardAllDataWithMultipleKeys(uid);
+    }
+    else if (choice == "2") {
+        // 高级读取：配置密钥
+        std::cout << "\n使用高级读取模式..." << std::endl;
+        nfc.LogToFile("用户选择高级读取模式", 0);
+
+        SetupKeysFromUserInput();
+        nfc.ReadCardAllDataWithMultipleKeys(uid);
+    }
+    else {
+        std::cout << "无效选择，使用快速读取模式" << std::endl;
+        nfc.LogToFile("用户输入无效，默认使用快速读取模式", 1);  // WARN级别
+
+        // 默认使用快速读取
+        nfc.ClearAllKeys();
+        for (int sector = 0; sector < 16; sector++) {
+            nfc.AddDefaultKeyA(sector);
+            nfc.AddDefaultKeyB(sector);
+        }
+
+        nfc.LogToFile("已为所有扇区设置默认密钥: FFFFFFFFFFFFF", 0);
+        nfc.ReadCardAllDataWithMultipleKeys(uid);
+    }
+}
+
+
+// 交互式写入卡片
+void ConsoleFrontend::WriteCardInteractive(const std::vector<unsigned char>& uid) {
+    PN532_TRACE_SPAN("WriteCardInteractive", "workflow");
+    std::cout << "\n=== 交互式卡片写入 ===" << std::endl;
+    std::cout << "卡UID: ";
+    for (auto byte : uid) {
+        printf("%02X ", byte);
+    }
+    std::cout << std::endl;
+
+    // 认证扇区
+    int sector;
+    std::cout << "\n输入要写入的扇区号 (0-15): ";
+    {
+        PN532_TRACE_SPAN("等待用户输入", "input");
+        std::cin >> sector;
+        std::cin.ignore();
+    }
+
+    if (sector < 0 || sector > 15) {
+        std::cout << "无效的扇区号!" << std::endl;
+        return;
+    }
+
+    uint8_t keyType;
+    std::vector<unsigned char> successfulKey;
+
+    if (!nfc.TryAuthenticateSector(uid, sector, keyType, successfulKey)) {
+        std::cout << "扇区认证失败，无法写入!" << std::endl;
+        return;
+    }
+
+    // 选择写入模式
+    std::cout << "\n选择写入模式:" << std::endl;
+    std::cout << "1. 写入文本数据" << std::endl;
+    std::cout << "2. 写入十六进制数据" << std::endl;
+    std::cout << "3. 修改密钥" << std::endl;
+    std::cout << "4. 清空扇区" << std::endl;
+    std::cout << "请选择 (1-4): ";
+
+    std::string choice;
+    {
+        PN532_TRACE_SPAN("等待用户输入", "input");
+        std::getline(std::cin, choice);
+    }
+
+    if (choice == "1") {
+        WriteTextToCard(uid);
+    }
+    else if (choice == "2") {
+        int blockInput;
+        uint8_t controlBlock = sector * 4 + 3;
+        std::cout << "输入块号 (" << (sector * 4) << "-" << (sector * 4 + 2)
+            << "，块" << (int)controlBlock << "为控制块): ";
+        std::cin >> blockInput;
+        std::cin.ignore();
+
+        // 验证输入是否在范围内
+        if (blockInput < static_cast<int>(sector * 4) ||
+            blockInput > static_cast<int>(sector * 4 + 2)) {
+            std::cout << "无效的块号!" << std::endl;
+            std::cout << "扇区 " << sector << " 的有效数据块是: "
+                << (sector * 4) << ", " << (sector * 4 + 1) << ", "
+                << (sector * 4 + 2) << std::endl;
+            return;
+        }
+
+        uint8_t block = static_cast<uint8_t>(blockInput);
+
+        // 输入十六进制数据
+        std::cout << "输入16字节十六进制数据 (空格分隔，例如: 01 02 03 ...): ";
+        std::string hexInput;
+        std::getline(std::cin, hexInput);
+
+        // 解析十六进制数据
+        std::vector<unsigned char> data;
+        std::stringstream ss(hexInput);
+        std::string byteStr;
+
+        while (ss >> byteStr) {
+            if (data.size() >= 16) break;
+            unsigned char byte = (unsigned char)std::strtoul(byteStr.c_str(), nullptr, 16);
+            data.push_back(byte);
+        }
+
+        // 填充到16字节
+        while (data.size() < 16) {
+            data.push_back(0x00);
+        }
+
+        // 写入数据
+        if (nfc.MifareWriteBlock(block, data)) {
+            std::cout << "✅ 数据写入成功!" << std::endl;
+
+            // 验证写入
+            std::vector<unsigned char> verifyData;
+            if (nfc.MifareReadBlock(block, verifyData)) {
+                std::cout << "验证读取: ";
+                for (auto b : verifyData) {
+                    printf("%02X ", b);
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+    else if (choice == "3") {
+        std::cout << "\n修改扇区 " << sector << " 密钥" << std::endl;
+
+        // 读取当前控制块
+        uint8_t controlBlock = sector * 4 + 3;
+        std::vector<unsigned char> currentData;
+        if (!nfc.MifareReadBlock(controlBlock, currentData)) {
+            std::cout << "无法读取当前控制块!" << std::endl;
+            return;
+        }
+
+        std::cout << "当前密钥A: ";
+        for (int i = 0; i < 6; i++) printf("%02X ", currentData[i]);
+        std::cout << std::endl;
+
+        std::cout << "当前访问位: ";
+        for (int i = 6; i < 9; i++) printf("%02X ", currentData[i]);
+        std::cout << std::endl;
+
+        std::cout << "当前密钥B: ";
+        for (int i = 10; i < 16; i++) printf("%02X ", currentData[i]);
+        std::cout << std::endl;
+
+        // 输入新密钥
+        std::cout << "\n输入新Key A (6字节十六进制，例如: FF FF FF FF FF FF): ";
+        std::string keyAStr;
+        std::getline(std::cin, keyAStr);
+
+        std::vector<unsigned char> keyA;
+        std::stringstream ssa(keyAStr);
+        std::string byteStr;
+
+        while (ssa >> byteStr && keyA.size() < 6) {
+            unsigned char byte = (unsigned char)std::strtoul(byteStr.c_str(), nullptr, 16);
+            keyA.push_back(byte);
+        }
+
+        if (keyA.size() != 6) {
+            std::cout << "Key A必须是6字节!" << std::endl;
+            return;
+        }
+
+        std::cout << "输入新Key B (6字节十六进制，或输入 'same' 使用Key A): ";
+        std::string keyBStr;
+        std::getline(std::cin, keyBStr);
+
+        std::vector<unsigned char> keyB;
+        if (keyBStr == "same" || keyBStr == "SAME") {
+            keyB = keyA;
+        }
+        else {
+            std::stringstream ssb(keyBStr);
+            while (ssb >> byteStr && keyB.size() < 6) {
+                unsigned char byte = (unsigned char)std::strtoul(byteStr.c_str(), nullptr, 16);
+                keyB.push_back(byte);
+            }
+
+            if (keyB.size() != 6) {
+                std::cout << "Key B必须是6字节!" << std::endl;
+                return;
+            }
+        }
+
+        // 保持原有访问控制位
+        std::vector<unsigned char> accessBits = { currentData[6], currentData[7], currentData[8], 0x00 };
+
+        if (nfc.ChangeSectorKeys(sector, keyA, keyB, accessBits)) {
+            std::cout << "✅ 密钥修改成功!" << std::endl;
+            std::cout << "新密钥已生效，请记住新密钥!" << std::endl;
+        }
+    }
+    else if (choice == "4") {
+        std::cout << "清空扇区 " << sector << " (写入全0)" << std::endl;
+        std::cout << "按 Y 确认，其他键取消: ";
+
+        char ch = _getch();
+        if (ch != 'Y' && ch != 'y') {
+            std::cout << "操作取消" << std::endl;
+            return;
+        }
+
+        uint8_t startBlock = sector * 4;
+        std::vector<unsigned char> zeroData(16, 0x00);
+
+        bool success = true;
+        for (int i = 0; i < 4; i++) {
+            uint8_t block = startBlock + i;
+
+            // 跳过厂商块和控制块
+            if (block == 0 || i == 3) {
+                continue;
+            }
+
+            if (!nfc.MifareWriteBlock(block, zeroData)) {
+                success = false;
+                break;
+            }
+        }
+
+        if (success) {
+            std::cout << "✅ 扇区清空成功!" << std::endl;
+        }
+        else {
+            std::cout << "❌ 扇区清空失败!" << std::endl;
+        }
+    }
+}
+
+// 写入文本到卡片
+void ConsoleFrontend::WriteTextToCard(const std::vector<unsigned char>& uid) {
+    std::cout << "\n=== 写入文本数据 ===" << std::endl;
+
+    int sector;
+    std::cout << "输入扇区号 (0-15): ";
+    std::cin >> sector;
+    std::cin.ignore();
+
+    if (sector < 0 || sector > 15) {
+        std::cout << "无效的扇区号!" << std::endl;
+        return;
+    }
+
+    int blockInput;
+    uint8_t controlBlock = sector * 4 + 3;  // 计算控制块号
+    std::cout << "输入块号 (" << (sector * 4) << "-" << (sector * 4 + 2)
+        << "，块" << (int)controlBlock << "为控制块): ";
+    std::cin >> blockInput;
+    std::cin.ignore();
+
+    if (blockInput < static_cast<int>(sector * 4) ||
+        blockInput > static_cast<int>(sector * 4 + 2)) {
+        std::cout << "无效的块号! 只能写入数据块(0-2)!" << std::endl;
+        std::cout << "扇区 " << sector << " 的有效数据块是: "
+            << (sector * 4) << ", " << (sector * 4 + 1) << ", "
+            << (sector * 4 + 2) << std::endl;
+        return;
+    }
+
+    uint8_t block = static_cast<uint8_t>(blockInput);
+
+    std::cout << "输入要写入的文本 (最多16个字符): ";
+    std::string text;
+    std::getline(std::cin, text);
+
+    // 将文本转换为16字节数据
+    std::vector<unsigned char> data(16, 0x00);
+    for (size_t i = 0; i < text.length() && i < 16; i++) {
+        data[i] = text[i];
+    }
+
+    // 添加结束符
+    if (text.length() < 16) {
+        data[text.length()] = 0x00;
+    }
+
+    std::cout << "准备写入的数据: ";
+    for (auto b : data) {
+        printf("%02X ", b);
+    }
+    std::cout << std::endl;
+
+    std::cout << "按 Y 确认写入，其他键取消: ";
+    char ch = _getch();
+    if (ch != 'Y' && ch != 'y') {
+        std::cout << "操作取消" << std::endl;
+        return;
+    }
+
+    if (nfc.MifareWriteBlock(block, data)) {
+        std::cout << "✅ 文本写入成功!" << std::endl;
+
+        // 验证写入
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::vector<unsigned char> verifyData;
+        if (nfc.MifareReadBlock(block, verifyData)) {
+            std::cout << "验证读取: ";
+            for (auto b : verifyData) {
+                if (b >= 32 && b <= 126) {
+                    std::cout << (char)b;
+                }
+                else if (b == 0) {
+                    std::cout << " ";
+                }
+                else {
+                    std::cout << ".";
+                }
+            }
+            std::cout << std::endl;
+        }
+    }
+}
+
+
+// 特殊写入模式
+void ConsoleFrontend::SpecialWriteMode() {
+    PN532_TRACE_SPAN("SpecialWriteMode", "workflow");
+    std::cout << "\n=== 特殊写入模式 ===" << std::endl;
+    std::cout << "此模式使用特殊密钥配置:" << std::endl;
+    std::cout << "  扇区1和2: Key A/B = 112233446655" << std::endl;
+    std::cout << "  其他扇区: 默认密钥 FFFFFFFFFFFFF" << std::endl;
+    std::cout << "将向扇区1的块5和块6写入特定格式的数据" << std::endl;
+    std::cout << "\n请输入一个0~50000之间的整数: ";
+
+    int number;
+    {
+        PN532_TRACE_SPAN("等待用户输入", "input");
+        std::cin >> number;
+        std::cin.ignore();
+    }
+
+    if (number < 0 || number > 50000) {
+        std::cout << "❌ 输入的数字必须在0~50000之间!" << std::endl;
+        return;
+    }
+
+    // 转换为8位十六进制字符串
+    std::stringstream ss;
+    ss << std::hex << std::setw(8) << std::setfill('0') << number;
+    std::string hexStr = ss.str();  // 8位十六进制字符串，例如：00000002
+
+    std::cout << "输入的整数: " << number << std::endl;
+    std::cout << "转换为8位十六进制: " << hexStr << std::endl;
+
+    // 分组：每2位一组，共4组
+    std::vector<std::string> groups;
+    for (int i = 0; i < 8; i += 2) {
+        groups.push_back(hexStr.substr(i, 2));
+    }
+
+    std::cout << "分组结果: ";
+    for (const auto& group : groups) {
+        std::cout << group << " ";
+    }
+    std::cout << std::endl;
+
+    // 倒序排列组，但组内顺序不变
+    std::reverse(groups.begin(), groups.end());
+
+    std::cout << "倒序后: ";
+    for (const auto& group : groups) {
+        std::cout << group << " ";
+    }
+    std::cout << std::endl;
+
+    // 计算校验码：原数组 + 校验码 = FF
+    std::vector<std::string> checksums;
+    for (const auto& group : groups) {
+        unsigned int value;
+        std::stringstream groupStream;
+        groupStream << std::hex << group;
+        groupStream >> value;
+
+        unsigned char checksum = 0xFF - static_cast<unsigned char>(value);
+        std::stringstream checksumStream;
+        checksumStream << std::hex << std::setw(2) << std::setfill('0')
+            << static_cast<int>(checksum);
+        checksums.push_back(checksumStream.str());
+    }
+
+    std::cout << "校验码: ";
+    for (const auto& checksum : checksums) {
+        std::cout << checksum << " ";
+    }
+    std::cout << std::endl;
+
+    // 按照原数据-校验码-原数据进行编组
+    std::vector<std::string> combined;
+
+    // 添加原数据（倒序后）
+    for (const auto& group : groups) {
+        combined.push_back(group);
+    }
+
+    // 添加校验码
+    for (const auto& checksum : checksums) {
+        combined.push_back(checksum);
+    }
+
+    // 再次添加原数据（倒序后）
+    for (const auto& group : groups) {
+        combined.push_back(group);
+    }
+
+    std::cout << "编组结果: ";
+    for (const auto& item : combined) {
+        std::cout << item << " ";
+    }
+    std::cout << std::endl;
+
+    // 转换为字节序列
+    std::vector<unsigned char> baseData;
+    for (const auto& item : combined) {
+        unsigned char byte = static_cast<unsigned char>(
+            std::strtoul(item.c_str(), nullptr, 16));
+        baseData.push_back(byte);
+    }
+
+    // 创建第一组数据：baseData + 01 FE 01 FE
+    std::vector<unsigned char> data1 = baseData;
+    data1.push_back(0x01);
+    data1.push_back(0xFE);
+    data1.push_back(0x01);
+    data1.push_back(0xFE);
+
+    // 创建第二组数据：baseData + 02 FD 02 FD
+    std::vector<unsigned char> data2 = baseData;
+    data2.push_back(0x02);
+    data2.push_back(0xFD);
+    data2.push_back(0x02);
+    data2.push_back(0xFD);
+
+    // 检测卡片：最多等待30秒，按 Esc 取消
+    std::cout << "\n请放置卡片... (按 Esc 取消)" << std::endl;
+
+    std::vector<unsigned char> uid;
+    {
+        PN532_TRACE_SPAN("等待卡片", "workflow");
+        Deadline waitDeadline = Deadline::After(30000);
+        while (!nfc.DetectNFC(uid)) {
+            if (_kbhit() && _getch() == 27) {
+                std::cout << "已取消写入" << std::endl;
+                return;
+            }
+            if (waitDeadline.Expired() || nfc.IsOperationAborted()) {
+                std::cout << "❌ 等待卡片超时，已取消写入" << std::endl;
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+    }
+
+    std::cout << "✅ 检测到卡片!" << std::endl;
+    std::cout << "卡UID: ";
+    for (auto b : uid) {
+        printf("%02X ", b);
+    }
+    std::cout << std::endl;
+
+    // 设置特殊密钥
+    nfc.SetupSpecialKeys();
+
+    // 认证扇区1
+    uint8_t keyType;
+    std::vector<unsigned char> successfulKey;
+
+    std::cout << "\n正在认证扇区1..." << std::endl;
+    PN532_TRACE_SPAN("认证扇区1并写入", "workflow");
+    if (!nfc.TryAuthenticateSector(uid, 1, keyType, successfulKey)) {
+        std::cout << "❌ 扇区1认证失败!" << std::endl;
+        return;
+    }
+
+    std::cout << "✅ 扇区1认证成功!" << std::endl;
+
+    // 写入块5
+    std::cout << "\n正在写入扇区1块5..." << std::endl;
+    std::cout << "数据: ";
+    for (auto b : data1) {
+        printf("%02X ", b);
+    }
+    std::cout << std::endl;
+
+    if (nfc.MifareWriteBlock(5, data1)) {
+        std::cout << "✅ 块5写入成功!" << std::endl;
+    }
+    else {
+        std::cout << "❌ 块5写入失败!" << std::endl;
+        return;
+    }
+
+    // 等待一下
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // 写入块6
+    std::cout << "\n正在写入扇区1块6..." << std::endl;
+    std::cout << "数据: ";
+    for (auto b : data2) {
+        printf("%02X ", b);
+    }
+    std::cout << std::endl;
+
+    if (nfc.MifareWriteBlock(6, data2)) {
+        std::cout << "✅ 块6写入成功!" << std::endl;
+    }
+    else {
+        std::cout << "❌ 块6写入失败!" << std::endl;
+        return;
+    }
+
+    std::cout << "\n🎉 特殊写入模式完成!" << std::endl;
+    std::cout << "按任意键继续..." << std::endl;
+}
+
+
+// 显示访问控制位
+void ConsoleFrontend::DisplayAccessBits(uint8_t sector) {
+    // 读取控制块
+    uint8_t blockNumber = sector * 4 + 3;
+    std::vector<unsigned char> controlBlock;
+
+    if (nfc.MifareReadBlock(blockNumber, controlBlock) && controlBlock.size() >= 16) {
+        std::cout << "扇区 " << sector << " 访问控制位: ";
+        for (int i = 6; i < 10; i++) {
+            printf("%02X ", controlBlock[i]);
+        }
+        std::cout << std::endl;
+
+        // 解析访问控制位
+        uint8_t accessBits[4];
+        for (int i = 0; i < 4; i++) {
+            accessBits[i] = controlBlock[6 + i];
+        }
+
+        // 简化解析（实际解析较复杂）
+        std::cout << "块权限:" << std::endl;
+        std::cout << "  块0-2: ";
+        switch (accessBits[0] & 0x0F) {
+        case 0x00: std::cout << "KeyA可读写，KeyB可读写"; break;
+        case 0x01: std::cout << "KeyA可读写，KeyB可读"; break;
+        case 0x02: std::cout << "KeyA可读写，KeyB可写"; break;
+        case 0x03: std::cout << "KeyA可读写，KeyB无访问"; break;
+        default: std::cout << "未知权限";
+        }
+        std::cout << std::endl;
+    }
+    else {
+        std::cout << "无法读取访问控制位" << std::endl;
+    }
+}
+
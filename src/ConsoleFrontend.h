@@ -0,0 +1,44 @@
+﻿#pragma once
+#include "PN532.h"
+#include "CardEventSink.h"
+#include <string>
+#include <vector>
+
+// 控制台事件接收器：把 PN532 的事件渲染到控制台
+// 每个事件先拼成完整字符串再一次性输出，避免逐字节 printf
+class ConsoleEventSink : public CardEventSink {
+public:
+    void OnMessage(EventLevel level, const std::string& message) override;
+    void OnDumpStarted(const std::string& title, const std::vector<unsigned char>& uid) override;
+    void OnDumpFinished(int successfulSectors, int totalSectors) override;
+    void OnSectorAuthenticated(uint8_t sector, uint8_t keyType,
+        const std::vector<unsigned char>& key) override;
+    void OnSectorAuthFailed(uint8_t sector, const PN532Result& result) override;
+    void OnBlockRead(uint8_t block, const CardBlock& data) override;
+    void OnSectorRead(uint8_t sector, const CardImage& image) override;
+    void OnBlockWritten(uint8_t block, const CardBlock& data,
+        const PN532Result& result) override;
+    bool ConfirmControlBlockWrite(uint8_t block) override;
+    int ChoosePort(const std::vector<std::string>& ports) override;
+};
+
+// 控制台交互前端：菜单中需要用户输入的流程
+class ConsoleFrontend {
+private:
+    PN532& nfc;
+
+public:
+    explicit ConsoleFrontend(PN532& reader);
+
+    // 读取
+    void ReadCardDataInteractive(const std::vector<unsigned char>& uid);
+    void DisplayAccessBits(uint8_t sector);
+
+    // 写入
+    void WriteCardInteractive(const std::vector<unsigned char>& uid);
+    void WriteTextToCard(const std::vector<unsigned char>& uid);
+    void SpecialWriteMode();
+
+    // 密钥配置
+    void SetupKeysFromUserInput();
+};
@@ -0,0 +1,76 @@
+﻿#include "ConsoleKeyReader.h"
+#include <conio.h>
+
+ConsoleKeyReader::ConsoleKeyReader(HANDLE wake)
+    : input(GetStdHandle(STD_INPUT_HANDLE)), wakeEvent(wake), running(false), armed(true) {
+}
+
+ConsoleKeyReader::~ConsoleKeyReader() {
+    Stop();
+}
+
+void ConsoleKeyReader::Start() {
+    if (running.exchange(true)) {
+        return;
+    }
+    worker = std::thread([this]() { Run(); });
+}
+
+void ConsoleKeyReader::Stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+    armCondition.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void ConsoleKeyReader::Resume() {
+    {
+        std::lock_guard<std::mutex> lock(armMutex);
+        armed = true;
+    }
+    armCondition.notify_all();
+}
+
+// 等待控制台输入，最多 100ms（以便及时响应 Stop）；
+// 鼠标、焦点、按键抬起等不产生字符的输入记录直接丢弃，否则句柄一直有信号
+bool ConsoleKeyReader::WaitForKey() {
+    if (WaitForSingleObject(input, 100) != WAIT_OBJECT_0) {
+        return false;
+    }
+
+    INPUT_RECORD record;
+    DWORD count = 0;
+    while (PeekConsoleInputA(input, &record, 1, &count) && count == 1) {
+        if (record.EventType == KEY_EVENT && record.Event.KeyEvent.bKeyDown && record.Event.KeyEvent.uChar.AsciiChar != 0) {
+            return _kbhit() != 0;
+        }
+        ReadConsoleInputA(input, &record, 1, &count);
+    }
+    return false;
+}
+
+void ConsoleKeyReader::Run() {
+    while (running) {
+        {
+            std::unique_lock<std::mutex> lock(armMutex);
+            armCondition.wait(lock, [this] { return armed || !running; });
+        }
+        if (!running) {
+            break;
+        }
+        if (!WaitForKey()) {
+            continue;
+        }
+
+        int key = _getch();
+        {
+            std::lock_guard<std::mutex> lock(armMutex);
+            armed = false;
+        }
+        keys.Push(key);
+        SetEvent(wakeEvent);
+    }
+}
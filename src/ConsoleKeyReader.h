@@ -0,0 +1,42 @@
+﻿#pragma once
+#include "SpscQueue.h"
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// 控制台按键线程
+// 在独立线程上等待按键，读到一个键后放入队列并触发 wakeEvent，然后暂停读取，
+// 直到界面线程处理完这个键（处理过程中可能有自己的 _getch/getline 提示）后调用 Resume，
+// 所以按键线程不会和菜单操作抢输入。
+class ConsoleKeyReader {
+private:
+    HANDLE input;
+    HANDLE wakeEvent;
+    std::thread worker;
+    std::atomic<bool> running;
+    SpscQueue<int, 16> keys;
+
+    std::mutex armMutex;
+    std::condition_variable armCondition;
+    bool armed;
+
+    void Run();
+    bool WaitForKey();
+
+public:
+    explicit ConsoleKeyReader(HANDLE wake);
+    ~ConsoleKeyReader();
+
+    ConsoleKeyReader(const ConsoleKeyReader&) = delete;
+    ConsoleKeyReader& operator=(const ConsoleKeyReader&) = delete;
+
+    void Start();
+    void Stop();
+
+    // 界面线程：取出读到的键
+    bool Next(int& key) { return keys.Pop(key); }
+    // 界面线程：这个键处理完了，继续读取
+    void Resume();
+};
@@ -0,0 +1,96 @@
+﻿#include "ConsoleScreen.h"
+#include <iostream>
+
+namespace {
+// 光标回到左上角，清除屏幕和回滚缓冲区
+const char CLEAR_SEQUENCE[] = "\x1b[H\x1b[2J\x1b[3J";
+}
+
+ConsoleScreen::ConsoleScreen() : output(GetStdHandle(STD_OUTPUT_HANDLE)), virtualTerminal(false), valid(false) {
+    DWORD mode = 0;
+    if (output != INVALID_HANDLE_VALUE && GetConsoleMode(output, &mode)) {
+        virtualTerminal = (mode & ENABLE_VIRTUAL_TERMINAL_PROCESSING) != 0 ||
+            SetConsoleMode(output, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+}
+
+void ConsoleScreen::Write(const std::string& text) {
+    std::cout.flush();
+    DWORD written = 0;
+    WriteFile(output, text.data(), static_cast<DWORD>(text.size()), &written, NULL);
+}
+
+void ConsoleScreen::ClearWithConsoleApi() {
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (!GetConsoleScreenBufferInfo(output, &info)) {
+        return;
+    }
+    DWORD cells = static_cast<DWORD>(info.dwSize.X) * info.dwSize.Y;
+    COORD home = { 0, 0 };
+    DWORD written = 0;
+    FillConsoleOutputCharacterA(output, ' ', cells, home, &written);
+    FillConsoleOutputAttribute(output, info.wAttributes, cells, home, &written);
+    SetConsoleCursorPosition(output, home);
+}
+
+void ConsoleScreen::Clear() {
+    std::cout.flush();
+    if (virtualTerminal) {
+        Write(CLEAR_SEQUENCE);
+    }
+    else {
+        ClearWithConsoleApi();
+    }
+    shown.clear();
+    valid = true;
+}
+
+void ConsoleScreen::Present(const std::vector<std::string>& lines) {
+    std::string frame;
+    if (!valid) {
+        // 清屏与整屏内容一起写出
+        if (virtualTerminal) {
+            frame = CLEAR_SEQUENCE;
+        }
+        else {
+            std::cout.flush();
+            ClearWithConsoleApi();
+        }
+        shown.clear();
+        valid = true;
+    }
+
+    if (!virtualTerminal) {
+        // 没有光标控制：整屏重画
+        if (!shown.empty()) {
+            ClearWithConsoleApi();
+        }
+        for (const auto& line : lines) {
+            frame += line;
+            frame += '\n';
+        }
+    }
+    else {
+        // 只重写变化的行：ESC[行;1H 定位，ESC[K 清除行尾旧内容，ESC[J 清除多出的旧行
+        for (size_t row = 0; row < lines.size(); row++) {
+            if (row < shown.size() && shown[row] == lines[row]) {
+                continue;
+            }
+            frame += "\x1b[" + std::to_string(row + 1) + ";1H";
+            frame += lines[row];
+            frame += "\x1b[K";
+        }
+        // 光标停在画面下方，之后的其他输出接在画面后面
+        if (!frame.empty() || lines.size() < shown.size()) {
+            frame += "\x1b[" + std::to_string(lines.size() + 1) + ";1H";
+        }
+        if (lines.size() < shown.size()) {
+            frame += "\x1b[J";
+        }
+    }
+
+    if (!frame.empty()) {
+        Write(frame);
+    }
+    shown = lines;
+}
@@ -0,0 +1,35 @@
+﻿#pragma once
+#include <windows.h>
+#include <string>
+#include <vector>
+
+// 控制台画面
+// 一屏内容按行组成后整体写出（一次 WriteFile），再次绘制时只重写变化的行（ANSI 光标定位），
+// 不再调用 system("cls") 和逐行 std::cout。
+// 控制台不支持虚拟终端序列（Windows 10 之前）时，每次都清屏后整屏写出。
+class ConsoleScreen {
+private:
+    HANDLE output;
+    bool virtualTerminal;
+    std::vector<std::string> shown;  // 屏幕上当前的各行
+    bool valid;                      // shown 与屏幕一致（之间没有其他输出）
+
+    void ClearWithConsoleApi();
+
+public:
+    ConsoleScreen();
+
+    bool VirtualTerminal() const { return virtualTerminal; }
+
+    // 清屏，下一次 Present 整屏绘制
+    void Clear();
+
+    // 画面上方有了其他输出（操作过程、输入提示），下一次 Present 清屏后整屏绘制
+    void Invalidate() { valid = false; }
+
+    // 显示一屏内容（从屏幕左上角开始，每个元素一行）
+    void Present(const std::vector<std::string>& lines);
+
+    // 一次写出（先刷新 std::cout，保证与之前的输出顺序一致）
+    void Write(const std::string& text);
+};
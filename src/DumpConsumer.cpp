@@ -0,0 +1,61 @@
+﻿#include "DumpConsumer.h"
+
+QueuedDumpConsumer::QueuedDumpConsumer(DumpConsumer& consumer)
+    : target(consumer), stopping(false) {
+    worker = std::thread([this]() { Run(); });
+}
+
+QueuedDumpConsumer::~QueuedDumpConsumer() {
+    Finish();
+}
+
+void QueuedDumpConsumer::Post(std::function<void()> delivery) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        pending.push_back(std::move(delivery));
+    }
+    queueCondition.notify_one();
+}
+
+void QueuedDumpConsumer::Run() {
+    while (true) {
+        std::function<void()> delivery;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]() { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;  // 已停止且全部交付
+            }
+            delivery = std::move(pending.front());
+            pending.pop_front();
+        }
+        delivery();
+    }
+}
+
+void QueuedDumpConsumer::OnDumpBegin(const std::vector<unsigned char>& uid) {
+    Post([this, uid]() { target.OnDumpBegin(uid); });
+}
+
+void QueuedDumpConsumer::OnBlock(const BlockResult& block) {
+    Post([this, block]() { target.OnBlock(block); });
+}
+
+void QueuedDumpConsumer::OnSector(const SectorResult& sector) {
+    Post([this, sector]() { target.OnSector(sector); });
+}
+
+void QueuedDumpConsumer::OnDumpEnd(const DumpSummary& summary) {
+    Post([this, summary]() { target.OnDumpEnd(summary); });
+}
+
+void QueuedDumpConsumer::Finish() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
@@ -0,0 +1,119 @@
+﻿#pragma once
+#include "PN532Status.h"
+#include "CardImage.h"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 单个块的读取结果（读到即发出）
+struct BlockResult {
+    uint8_t sector;
+    uint8_t block;                       // 绝对块号
+    CardBlock data;                      // 失败时内容无意义
+    uint8_t keyType;                     // 认证所用密钥类型（0x60/0x61）
+    std::array<unsigned char, 6> key;    // 认证所用密钥
+    PN532Result result;
+    int64_t readUs;                      // 本块读取耗时（微秒）
+    int64_t offsetMs;                    // 距离整卡读取开始的时间（毫秒）
+    bool fromCache;                      // 来自上次未读完的缓存，没有射频交换
+
+    BlockResult() : sector(0), block(0), data(), keyType(0), key(), readUs(0), offsetMs(0), fromCache(false) {}
+};
+
+// 单个扇区的结果（扇区结束时发出，包含已读到的块）
+struct SectorResult {
+    uint8_t sector;
+    bool authenticated;
+    uint8_t keyType;
+    std::array<unsigned char, 6> key;
+    std::array<CardBlock, CardImage::MAX_SECTOR_BLOCKS> blocks;  // 扇区内的块（4K卡大扇区为16块）
+    int blockCount;                      // 扇区的块数
+    int blocksRead;                      // 按顺序读到的块数，小于 blockCount 说明中途失败
+    PN532Result result;                  // 扇区最后一条命令的结果
+    int64_t authUs;                      // 密钥尝试耗时（微秒）
+    int64_t readUs;                      // 读块耗时（微秒）
+    bool fromCache;                      // 整个扇区来自缓存
+
+    SectorResult() : sector(0), authenticated(false), keyType(0), key(), blocks(), blockCount(4), blocksRead(0),
+        authUs(0), readUs(0), fromCache(false) {}
+
+    bool Complete() const { return authenticated && blocksRead == blockCount; }
+    int FirstBlock() const { return CardImage::FirstBlockOfSector(sector); }
+};
+
+// 整卡读取结束的汇总
+struct DumpSummary {
+    std::vector<unsigned char> uid;
+    CardImage image;                     // 读到的整卡镜像（未读到的块 known 为 false）
+    int completedSectors;
+    int totalSectors;
+    bool aborted;                        // 被取消或超时
+    int resumedSectors;                  // 从缓存补齐的扇区数
+    PN532Result lastResult;
+    int64_t elapsedMs;
+
+    DumpSummary() : completedSectors(0), totalSectors(16), aborted(false), resumedSectors(0), elapsedMs(0) {}
+};
+
+// 流式读卡结果的接收者
+// PN532::StreamCardData 在读卡线程上按顺序调用：OnDumpBegin → (OnBlock... OnSector)×N → OnDumpEnd，
+// 卡片中途离开时已读到的块和扇区都已交付
+class DumpConsumer {
+public:
+    virtual ~DumpConsumer() = default;
+
+    virtual void OnDumpBegin(const std::vector<unsigned char>& /*uid*/) {}
+    virtual void OnBlock(const BlockResult& /*block*/) {}
+    virtual void OnSector(const SectorResult& /*sector*/) {}
+    virtual void OnDumpEnd(const DumpSummary& /*summary*/) {}
+};
+
+// 用回调实现的接收者，未设置的回调忽略
+class CallbackDumpConsumer : public DumpConsumer {
+public:
+    std::function<void(const std::vector<unsigned char>&)> onBegin;
+    std::function<void(const BlockResult&)> onBlock;
+    std::function<void(const SectorResult&)> onSector;
+    std::function<void(const DumpSummary&)> onEnd;
+
+    void OnDumpBegin(const std::vector<unsigned char>& uid) override { if (onBegin) onBegin(uid); }
+    void OnBlock(const BlockResult& block) override { if (onBlock) onBlock(block); }
+    void OnSector(const SectorResult& sector) override { if (onSector) onSector(sector); }
+    void OnDumpEnd(const DumpSummary& summary) override { if (onEnd) onEnd(summary); }
+};
+
+// 把结果转交给后台线程处理的接收者
+// 读卡线程只做一次入队，写文件、界面刷新等耗时处理与后续射频交换并行进行。
+// Finish（或析构）等待所有结果交付完毕。
+class QueuedDumpConsumer : public DumpConsumer {
+private:
+    DumpConsumer& target;
+    std::thread worker;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<std::function<void()>> pending;
+    bool stopping;
+
+    void Post(std::function<void()> delivery);
+    void Run();
+
+public:
+    explicit QueuedDumpConsumer(DumpConsumer& consumer);
+    ~QueuedDumpConsumer();
+
+    QueuedDumpConsumer(const QueuedDumpConsumer&) = delete;
+    QueuedDumpConsumer& operator=(const QueuedDumpConsumer&) = delete;
+
+    void OnDumpBegin(const std::vector<unsigned char>& uid) override;
+    void OnBlock(const BlockResult& block) override;
+    void OnSector(const SectorResult& sector) override;
+    void OnDumpEnd(const DumpSummary& summary) override;
+
+    // 等待已入队的结果全部交付并结束后台线程
+    void Finish();
+};
@@ -0,0 +1,496 @@
+﻿#include "JobScheduler.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+
+JobScheduler::JobScheduler(ReaderPool& readerPool)
+    : pool(readerPool), nextJobId(1), nextReader(0), running(false) {
+}
+
+JobScheduler::~JobScheduler() {
+    Stop();
+}
+
+bool JobScheduler::Start() {
+    if (running || pool.ReaderCount() == 0) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(schedulerMutex);
+        states.assign(pool.ReaderCount(), ReaderState());
+        for (size_t i = 0; i < states.size(); i++) {
+            states[i].online = pool.IsOnline(static_cast<int>(i));
+        }
+    }
+
+    running = true;
+    dispatcher = std::thread([this]() { DispatchLoop(); });
+    return true;
+}
+
+void JobScheduler::Stop() {
+    if (!running) {
+        return;
+    }
+
+    // 先取消排队中的任务，调度线程等正在执行的任务结束后退出
+    std::vector<JobPtr> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(schedulerMutex);
+        running = false;
+        for (auto& state : states) {
+            cancelled.insert(cancelled.end(), state.queue.begin(), state.queue.end());
+            state.queue.clear();
+        }
+        cancelled.insert(cancelled.end(), waiting.begin(), waiting.end());
+        waiting.clear();
+        for (auto& state : states) {
+            if (state.running) {
+                state.running->cancel.Cancel();
+            }
+        }
+    }
+
+    for (auto& job : cancelled) {
+        job->result.cancelled = true;
+        job->result.message = "调度器已停止";
+        Finish(job);
+    }
+
+    if (dispatcher.joinable()) {
+        dispatcher.join();
+    }
+}
+
+CardJobHandle JobScheduler::Submit(const CardJob& job) {
+    auto record = std::make_shared<JobRecord>();
+    record->job = job;
+
+    CardJobHandle handle;
+    handle.result = record->promise.get_future().share();
+
+    std::lock_guard<std::mutex> lock(schedulerMutex);
+    record->id = nextJobId++;
+    record->result.jobId = record->id;
+    handle.id = record->id;
+
+    if (!running) {
+        record->result.cancelled = true;
+        record->result.message = "调度器未启动";
+        Finish(record);
+        return handle;
+    }
+
+    Enqueue(record);
+    return handle;
+}
+
+std::vector<CardJobHandle> JobScheduler::SubmitBatch(const std::vector<CardJob>& jobs) {
+    std::vector<CardJobHandle> handles;
+    handles.reserve(jobs.size());
+    for (const auto& job : jobs) {
+        handles.push_back(Submit(job));
+    }
+    return handles;
+}
+
+bool JobScheduler::Cancel(uint64_t jobId) {
+    JobPtr job;
+    {
+        std::lock_guard<std::mutex> lock(schedulerMutex);
+        auto removeFrom = [&](std::deque<JobPtr>& queue) {
+            auto it = std::find_if(queue.begin(), queue.end(),
+                [jobId](const JobPtr& j) { return j->id == jobId; });
+            if (it == queue.end()) {
+                return false;
+            }
+            job = *it;
+            queue.erase(it);
+            return true;
+        };
+
+        bool found = removeFrom(waiting);
+        for (size_t i = 0; !found && i < states.size(); i++) {
+            found = removeFrom(states[i].queue);
+        }
+        if (!found) {
+            // 正在执行的任务：通知读卡器线程中止，结果由 JobCompleted 事件带回
+            for (auto& state : states) {
+                if (state.running && state.running->id == jobId) {
+                    state.running->cancel.Cancel();
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    job->result.cancelled = true;
+    job->result.message = "任务已取消";
+    Finish(job);
+    return true;
+}
+
+size_t JobScheduler::PendingCount() {
+    std::lock_guard<std::mutex> lock(schedulerMutex);
+    size_t count = waiting.size();
+    for (const auto& state : states) {
+        count += state.queue.size();
+    }
+    return count;
+}
+
+void JobScheduler::SetEventCallback(std::function<void(const ReaderEvent&)> callback) {
+    eventCallback = std::move(callback);
+}
+
+void JobScheduler::DispatchLoop() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(schedulerMutex);
+            if (!running) {
+                bool busy = false;
+                for (const auto& state : states) {
+                    if (state.running) {
+                        busy = true;
+                        break;
+                    }
+                }
+                if (!busy) {
+                    return;
+                }
+            }
+        }
+
+        ReaderEvent event;
+        if (pool.WaitEvent(event, 100)) {
+            HandleEvent(event);
+            if (eventCallback) {
+                eventCallback(event);
+            }
+        }
+    }
+}
+
+void JobScheduler::HandleEvent(const ReaderEvent& event) {
+    JobPtr finished;
+    {
+        std::lock_guard<std::mutex> lock(schedulerMutex);
+        if (event.reader < 0) {
+            return;
+        }
+        if (event.reader >= static_cast<int>(states.size())) {
+            // 启动后加入的读卡器（热插拔），上线事件到来前按离线处理
+            states.resize(event.reader + 1);
+        }
+        ReaderState& state = states[event.reader];
+
+        switch (event.type) {
+        case ReaderEvent::Type::ReaderOnline:
+            state.online = true;
+            break;
+
+        case ReaderEvent::Type::ReaderOffline:
+        case ReaderEvent::Type::ReaderRemoved: {
+            // 离线或移除的读卡器的队列重新分配
+            state.online = false;
+            state.presentUid.clear();
+            std::deque<JobPtr> orphaned;
+            orphaned.swap(state.queue);
+            for (auto& job : orphaned) {
+                Enqueue(job);
+            }
+            break;
+        }
+
+        case ReaderEvent::Type::CardArrived:
+            state.presentUid = event.uid;
+            // 等待这张卡片的任务固定到该读卡器
+            for (auto it = waiting.begin(); it != waiting.end();) {
+                if ((*it)->job.targetUid == event.uid) {
+                    state.queue.push_back(*it);
+                    it = waiting.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            break;
+
+        case ReaderEvent::Type::CardRemoved:
+            state.presentUid.clear();
+            // 指定卡片的任务回到等待列表，任意卡片的任务留在队列中等待或被窃取
+            for (auto it = state.queue.begin(); it != state.queue.end();) {
+                if (!(*it)->job.targetUid.empty()) {
+                    waiting.push_back(*it);
+                    it = state.queue.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            break;
+
+        case ReaderEvent::Type::JobCompleted:
+            // 只认当前任务的完成事件，其他方式提交到读卡器池的任务不影响调度
+            if (state.running && event.jobId == state.poolJobId) {
+                finished = state.running;
+                state.running.reset();
+                state.poolJobId = 0;
+                finished->result.success = finished->result.success && event.success;
+                finished->result.result = event.result;
+                finished->result.reader = event.reader;
+                if (finished->result.message.empty()) {
+                    finished->result.message = event.message;
+                }
+            }
+            break;
+        }
+
+        Dispatch(event.reader);
+        // 新卡片或空闲读卡器可能让其他读卡器的积压任务被窃取
+        if (event.type == ReaderEvent::Type::ReaderOffline || event.type == ReaderEvent::Type::ReaderRemoved) {
+            for (size_t i = 0; i < states.size(); i++) {
+                Dispatch(static_cast<int>(i));
+            }
+        }
+    }
+
+    if (finished) {
+        Finish(finished);
+    }
+}
+
+// 加入队列（调用者持有 schedulerMutex）
+void JobScheduler::Enqueue(const JobPtr& job) {
+    if (states.empty()) {
+        waiting.push_back(job);
+        return;
+    }
+
+    if (!job->job.targetUid.empty()) {
+        // 指定卡片：放到卡片所在的读卡器，卡片不在任何读卡器上时等待
+        int target = -1;
+        for (size_t i = 0; i < states.size(); i++) {
+            if (states[i].online && states[i].presentUid == job->job.targetUid) {
+                target = static_cast<int>(i);
+                break;
+            }
+        }
+
+        if (target < 0) {
+            waiting.push_back(job);
+            return;
+        }
+        states[target].queue.push_back(job);
+        Dispatch(target);
+        return;
+    }
+
+    // 任意卡片：轮流放入在线读卡器的队列
+    size_t index = nextReader % states.size();
+    for (size_t i = 0; i < states.size(); i++) {
+        size_t candidate = (nextReader + i) % states.size();
+        if (states[candidate].online) {
+            index = candidate;
+            break;
+        }
+    }
+    nextReader = index + 1;
+
+    states[index].queue.push_back(job);
+    for (size_t i = 0; i < states.size(); i++) {
+        Dispatch(static_cast<int>((index + i) % states.size()));
+    }
+}
+
+// 取出该读卡器可执行的任务：先取自己队列头部，再从其他队列尾部窃取（调用者持有 schedulerMutex）
+JobScheduler::JobPtr JobScheduler::TakeJob(int reader) {
+    ReaderState& state = states[reader];
+    auto runnable = [&state](const JobPtr& job) {
+        return job->job.targetUid.empty() || job->job.targetUid == state.presentUid;
+    };
+
+    for (auto it = state.queue.begin(); it != state.queue.end(); ++it) {
+        if (runnable(*it)) {
+            JobPtr job = *it;
+            state.queue.erase(it);
+            return job;
+        }
+    }
+
+    for (size_t i = 1; i < states.size(); i++) {
+        ReaderState& victim = states[(reader + i) % states.size()];
+        for (auto it = victim.queue.rbegin(); it != victim.queue.rend(); ++it) {
+            if ((*it)->job.targetUid.empty()) {
+                JobPtr job = *it;
+                victim.queue.erase(std::next(it).base());
+                return job;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+// 空闲且有卡的读卡器开始执行下一个任务（调用者持有 schedulerMutex）
+void JobScheduler::Dispatch(int reader) {
+    if (!running) {
+        return;
+    }
+
+    ReaderState& state = states[reader];
+    if (!state.online || state.running || state.presentUid.empty()) {
+        return;
+    }
+
+    JobPtr job = TakeJob(reader);
+    if (!job) {
+        return;
+    }
+
+    job->result.success = true;
+    state.running = job;
+    state.poolJobId = pool.Submit(reader, [job](PN532& nfc, const std::vector<unsigned char>& uid) {
+        return RunJob(nfc, uid, *job);
+    });
+
+    if (state.poolJobId == 0) {
+        // 读卡器池不接受任务，放回队列头部
+        state.running.reset();
+        state.queue.push_front(job);
+    }
+}
+
+void JobScheduler::Finish(const JobPtr& job) {
+    job->promise.set_value(job->result);
+}
+
+// 在读卡器线程上执行任务
+bool JobScheduler::RunJob(PN532& nfc, const std::vector<unsigned char>& uid, JobRecord& record) {
+    PN532_TRACE_SPAN_ARG("批量任务", "scheduler", "job", record.id);
+    CardJobResult& result = record.result;
+    const CardJob& job = record.job;
+    result.uid = uid;
+
+    if (uid.empty() || (!job.targetUid.empty() && uid != job.targetUid)) {
+        result.success = false;
+        result.message = "目标卡片不在读卡器上";
+        return false;
+    }
+
+    // 取消令牌和时限作用于本任务的每条命令
+    ScopedOperationContext scope(nfc, OperationContext(record.cancel.Token(), Deadline::After(job.timeoutMs)));
+    auto finishAborted = [&]() {
+        result.success = false;
+        result.cancelled = true;
+        result.message = nfc.GetOperationContext().Check() == TransportError::DeadlineExceeded ? "任务超时" : "任务已取消";
+        return false;
+    };
+
+    if (job.type == CardJobType::Backup) {
+        DumpSummary summary;
+        bool saved = nfc.BackupCardData(uid, &summary);
+        result.completedSectors = summary.completedSectors;
+        result.result = summary.lastResult;
+        if (summary.aborted) {
+            return finishAborted();
+        }
+        if (!saved) {
+            result.success = false;
+            result.message = "备份未能写入";
+            return false;
+        }
+        if (summary.completedSectors < summary.totalSectors) {
+            result.success = false;
+            result.message = "部分扇区未能读取，已保存 " + std::to_string(summary.completedSectors) +
+                "/" + std::to_string(summary.totalSectors) + " 个扇区";
+            return false;
+        }
+        return true;
+    }
+
+    if (job.type == CardJobType::ReadImage) {
+        result.image = CardImage(job.image.Geometry());
+        result.image.SetUid(uid);
+    }
+
+    bool allOk = true;
+    for (int sector = 0; sector < job.image.SectorCount(); sector++) {
+        int firstBlock = CardImage::FirstBlockOfSector(sector);
+        int blockCount = CardImage::BlocksInSector(sector);
+
+        // 在扇区之间中止：已完成的扇区保留在结果中，写入中途的扇区只写了部分块
+        if (nfc.IsOperationAborted()) {
+            return finishAborted();
+        }
+
+        // 写入/校验只处理有数据的块，跳过厂商块（块0）和控制块
+        if (job.type != CardJobType::ReadImage) {
+            bool hasData = false;
+            for (int block = 0; block < blockCount - 1; block++) {
+                int blockNumber = firstBlock + block;
+                if (blockNumber != 0 && job.image.IsKnown(blockNumber)) {
+                    hasData = true;
+                }
+            }
+            if (!hasData) {
+                continue;
+            }
+        }
+
+        uint8_t keyType;
+        std::vector<unsigned char> key;
+        if (!nfc.TryAuthenticateSector(uid, sector, keyType, key)) {
+            allOk = false;
+            continue;
+        }
+
+        bool sectorOk = true;
+        for (int block = 0; block < blockCount && sectorOk; block++) {
+            uint8_t blockNumber = static_cast<uint8_t>(firstBlock + block);
+            bool dataBlock = !CardImage::IsTrailer(blockNumber) && blockNumber != 0;
+            std::vector<unsigned char> data;
+
+            switch (job.type) {
+            case CardJobType::ReadImage:
+                sectorOk = nfc.MifareReadBlock(blockNumber, result.image);
+                break;
+
+            case CardJobType::WriteImage:
+                if (dataBlock && job.image.IsKnown(blockNumber)) {
+                    sectorOk = nfc.MifareWriteBlock(blockNumber, job.image.Block(blockNumber));
+                }
+                break;
+
+            case CardJobType::Verify:
+                if (dataBlock && job.image.IsKnown(blockNumber)) {
+                    sectorOk = nfc.MifareReadBlock(blockNumber, data) && data.size() == 16 &&
+                        CardBlock::From(data.data()) == job.image.Block(blockNumber);
+                    if (!sectorOk && result.message.empty()) {
+                        result.message = "块 " + std::to_string(blockNumber) + " 校验不一致";
+                    }
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        if (sectorOk) {
+            result.completedSectors++;
+        }
+        else {
+            allOk = false;
+        }
+    }
+
+    if (!allOk && nfc.IsOperationAborted()) {
+        return finishAborted();
+    }
+
+    result.success = allOk;
+    return allOk;
+}
@@ -0,0 +1,124 @@
+﻿#pragma once
+#include "ReaderPool.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 批量卡片任务类型
+enum class CardJobType {
+    ReadImage,   // 读取整卡（16扇区 × 4块）
+    WriteImage,  // 写入整卡数据块（跳过厂商块和控制块）
+    Backup,      // 备份到文件（BackupCardData）
+    Verify,      // 读回数据块并与 image 比较
+};
+
+// 卡片任务
+struct CardJob {
+    CardJobType type;
+    std::vector<unsigned char> targetUid;            // 为空表示任意卡片
+    CardImage image;                                 // WriteImage/Verify 使用已知（known）的块；ReadImage 按其容量读取
+    int timeoutMs;                                   // 从开始执行算起的时限，0 表示不限
+
+    CardJob() : type(CardJobType::ReadImage), timeoutMs(0) {}
+    explicit CardJob(CardJobType jobType, const std::vector<unsigned char>& uid = {})
+        : type(jobType), targetUid(uid), timeoutMs(0) {}
+};
+
+// 任务结果
+struct CardJobResult {
+    uint64_t jobId;
+    bool success;
+    bool cancelled;                                  // 被取消或超时（completedSectors 为已完成的部分）
+    int reader;                                      // 执行任务的读卡器，-1 表示未执行
+    std::vector<unsigned char> uid;
+    PN532Result result;
+    CardImage image;                                 // ReadImage 读到的块（失败的块 known 为 false）
+    int completedSectors;
+    std::string message;
+
+    CardJobResult() : jobId(0), success(false), cancelled(false), reader(-1), completedSectors(0) {}
+};
+
+// 提交后返回的句柄
+struct CardJobHandle {
+    uint64_t id;
+    std::shared_future<CardJobResult> result;
+};
+
+// 工作窃取式任务调度器
+// 每个读卡器有自己的任务队列。指定 UID 的任务固定到该卡片所在的读卡器（卡片尚未出现时挂起等待），
+// 任意卡片的任务轮流分配到各读卡器队列；有卡且空闲的读卡器队列为空时，从其他读卡器队列尾部窃取。
+// 调度器接管 ReaderPool 的事件队列，其他事件可通过 SetEventCallback 转发。
+class JobScheduler {
+private:
+    struct JobRecord {
+        uint64_t id;
+        CardJob job;
+        std::promise<CardJobResult> promise;
+        CardJobResult result;
+        CancellationSource cancel;
+    };
+    using JobPtr = std::shared_ptr<JobRecord>;
+
+    struct ReaderState {
+        std::deque<JobPtr> queue;
+        std::vector<unsigned char> presentUid;
+        JobPtr running;
+        uint64_t poolJobId;        // running 在读卡器池中的任务ID，用来匹配 JobCompleted 事件
+        bool online;
+
+        ReaderState() : poolJobId(0), online(false) {}
+    };
+
+    ReaderPool& pool;
+    std::mutex schedulerMutex;
+    std::vector<ReaderState> states;
+    std::deque<JobPtr> waiting;    // 目标卡片尚未出现的任务
+    uint64_t nextJobId;
+    size_t nextReader;             // 任意卡片任务的轮转分配位置
+
+    std::thread dispatcher;
+    std::atomic<bool> running;
+    std::function<void(const ReaderEvent&)> eventCallback;
+
+    void DispatchLoop();
+    void HandleEvent(const ReaderEvent& event);
+    void Enqueue(const JobPtr& job);
+    void Dispatch(int reader);
+    JobPtr TakeJob(int reader);
+    void Finish(const JobPtr& job);
+
+    static bool RunJob(PN532& nfc, const std::vector<unsigned char>& uid, JobRecord& record);
+
+public:
+    explicit JobScheduler(ReaderPool& readerPool);
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    // 启动调度线程（ReaderPool 须已启动）
+    bool Start();
+    // 停止调度，未执行的任务以取消结束，正在执行的任务在下一条命令前中止
+    void Stop();
+
+    CardJobHandle Submit(const CardJob& job);
+    std::vector<CardJobHandle> SubmitBatch(const std::vector<CardJob>& jobs);
+
+    // 取消任务：排队中的任务直接结束；正在执行的任务在下一条命令前中止，
+    // 读卡器随即空闲，结果中保留已完成的扇区
+    bool Cancel(uint64_t jobId);
+
+    // 排队中（含等待卡片）的任务数
+    size_t PendingCount();
+
+    // 转发 ReaderPool 事件（在调度线程中调用，须在 Start 之前设置）
+    void SetEventCallback(std::function<void(const ReaderEvent&)> callback);
+};
@@ -0,0 +1,58 @@
+﻿#include "LinkWatchdog.h"
+#include <algorithm>
+
+LinkWatchdog::LinkWatchdog(PN532& reader, const WatchdogPolicy& watchdogPolicy)
+    : nfc(reader), policy(watchdogPolicy), online(true), transportFailures(0), backoffMs(0), attempts(0),
+    outages(0), lastOutageMs(0), retryNow(false) {
+}
+
+bool LinkWatchdog::AfterPoll() {
+    if (!online) {
+        return false;
+    }
+    if (!nfc.GetLastResult().IsTransportError()) {
+        transportFailures = 0;
+        return true;
+    }
+    if (++transportFailures < policy.suspectAfter) {
+        return true;
+    }
+
+    transportFailures = 0;
+    if (nfc.Ping()) {
+        return true;
+    }
+
+    online = false;
+    attempts = 0;
+    backoffMs = policy.initialBackoffMs;
+    lostAt = Clock::now();
+    nextAttempt = lostAt + std::chrono::milliseconds(backoffMs);
+    outages++;
+    nfc.LogToFile("读卡器链路断开 (" + nfc.GetLastResult().Describe() + ")，开始重连", 1);
+    return false;
+}
+
+bool LinkWatchdog::TryRecover() {
+    if (online) {
+        return true;
+    }
+    bool retry = retryNow.exchange(false);
+    if (!retry && Clock::now() < nextAttempt) {
+        return false;
+    }
+
+    attempts++;
+    if (!nfc.Reconnect(policy.searchOtherPorts)) {
+        backoffMs = std::min(backoffMs * 2, policy.maxBackoffMs);
+        nextAttempt = Clock::now() + std::chrono::milliseconds(backoffMs);
+        return false;
+    }
+
+    online = true;
+    transportFailures = 0;
+    lastOutageMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - lostAt).count();
+    nfc.LogToFile("读卡器已重新连接: " + nfc.GetPort() + "，断开 " + std::to_string(lastOutageMs) +
+        " ms，重连 " + std::to_string(attempts) + " 次", 0);
+    return true;
+}
@@ -0,0 +1,53 @@
+﻿#pragma once
+#include "PN532.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// 看门狗参数
+struct WatchdogPolicy {
+    int suspectAfter = 2;        // 连续几次传输层错误后检查链路
+    int initialBackoffMs = 250;  // 判定断开后第一次重连前的等待
+    int maxBackoffMs = 8000;     // 重连间隔上限（每次失败翻倍）
+    bool searchOtherPorts = true;  // 原串口打不开时在其他串口中找读卡器
+};
+
+// 读卡器链路看门狗
+// 在场检测失败分不清“场内没有卡”和“链路断了”：没有卡时 InListPassiveTarget 正常应答（目标数为0），
+// 只有传输层错误（写失败、无应答、坏帧）才可疑。连续 suspectAfter 次传输层错误后发一次 GetFirmwareVersion：
+// 有应答只是射频问题；没有应答即判定链路断开，之后按指数退避重新打开串口并重放 SAM 配置，直到恢复。
+// 除 RetryNow 外只在独占 PN532 的线程上调用。
+class LinkWatchdog {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    PN532& nfc;
+    WatchdogPolicy policy;
+    bool online;
+    int transportFailures;
+    int backoffMs;
+    int attempts;               // 本次断开后的重连次数
+    Clock::time_point lostAt;
+    Clock::time_point nextAttempt;
+    uint64_t outages;
+    int64_t lastOutageMs;
+    std::atomic<bool> retryNow;
+
+public:
+    explicit LinkWatchdog(PN532& reader, const WatchdogPolicy& watchdogPolicy = WatchdogPolicy());
+
+    // 每次在场检测之后调用；返回 false 表示链路已断开（本次检测结果不可信）
+    bool AfterPoll();
+
+    // 链路断开时代替在场检测调用：到了重连时间就尝试一次，恢复时返回 true
+    bool TryRecover();
+
+    // 有新串口插入时从任意线程调用：下一次 TryRecover 不等退避间隔，立即重连
+    void RetryNow() { retryNow = true; }
+
+    bool Online() const { return online; }
+    int Attempts() const { return attempts; }
+    uint64_t OutageCount() const { return outages; }
+    int64_t LastOutageMs() const { return lastOutageMs; }  // 最近一次断开到恢复的时长
+};
@@ -7,14 +7,46 @@
 #include <ctime>
 #include <mutex>
 #include <sstream>
+#include "Trace.h"
+#include "CardImage.h"
+#include "BlockFormatter.h"
 
 class Logger {
 private:
     std::ofstream logFile;
     std::string logFileName;
     bool enableLogging;
+    bool consoleEcho;
+    bool pendingOpen;  // 已确定文件名，第一次写入时再创建文件
     std::mutex logMutex;
 
+    // 创建（或追加打开）日志文件并写入日志头；调用者持有 logMutex
+    bool OpenFile() {
+        pendingOpen = false;
+        logFile.open(logFileName, std::ios::out | std::ios::app);
+        if (!logFile.is_open()) {
+            if (consoleEcho) {
+                std::cerr << "无法创建日志文件: " << logFileName << std::endl;
+            }
+            enableLogging = false;
+            return false;
+        }
+
+        logFile << "==========================================" << std::endl;
+        logFile << "NFC读写器日志 - 开始时间: " << GetCurrentTime() << std::endl;
+        logFile << "==========================================" << std::endl;
+        logFile.flush();
+        return true;
+    }
+
+    // 写文件前调用（持有 logMutex）：延迟创建的文件在这里打开
+    bool FileReady() {
+        if (pendingOpen) {
+            OpenFile();
+        }
+        return enableLogging && logFile.is_open();
+    }
+
     // 获取当前时间字符串
     std::string GetCurrentTime() {
         auto now = std::chrono::system_clock::now();
@@ -43,7 +75,7 @@ private:
     }
 
 public:
-    Logger() : enableLogging(false) {}
+    Logger() : enableLogging(false), consoleEcho(true), pendingOpen(false) {}
 
     ~Logger() {
         if (logFile.is_open()) {
@@ -51,8 +83,8 @@ public:
         }
     }
 
-    // 初始化日志系统
-    bool Initialize(const std::string& fileName = "", bool enable = true) {
+    // 初始化日志系统；deferOpen 时只确定文件名，第一次写入时才创建文件
+    bool Initialize(const std::string& fileName = "", bool enable = true, bool deferOpen = false) {
         enableLogging = enable;
 
         if (!enableLogging) {
@@ -74,21 +106,18 @@ public:
             logFileName = fileName;
         }
 
-        logFile.open(logFileName, std::ios::out | std::ios::app);
-        if (!logFile.is_open()) {
-            std::cerr << "无法创建日志文件: " << logFileName << std::endl;
-            enableLogging = false;
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (deferOpen) {
+            pendingOpen = true;
+            return true;
+        }
+        if (!OpenFile()) {
             return false;
         }
 
-        // 写入日志头
-        std::lock_guard<std::mutex> lock(logMutex);
-        logFile << "==========================================" << std::endl;
-        logFile << "NFC读写器日志 - 开始时间: " << GetCurrentTime() << std::endl;
-        logFile << "==========================================" << std::endl;
-        logFile.flush();
-
-        std::cout << "✅ 日志系统已启动，文件: " << logFileName << std::endl;
+        if (consoleEcho) {
+            std::cout << "✅ 日志系统已启动，文件: " << logFileName << std::endl;
+        }
         return true;
     }
 
@@ -97,18 +126,19 @@ public:
         if (!enableLogging && !toConsole) {
             return;
         }
+        PN532_TRACE_SPAN("写日志", "log");
 
         std::string formattedMessage = FormatLevel(level) + GetCurrentTime() + " - " + message;
 
         std::lock_guard<std::mutex> lock(logMutex);
 
         // 输出到控制台
-        if (toConsole) {
+        if (toConsole && consoleEcho) {
             std::cout << formattedMessage << std::endl;
         }
 
         // 输出到文件
-        if (enableLogging && logFile.is_open()) {
+        if (FileReady()) {
             logFile << formattedMessage << std::endl;
             logFile.flush();
         }
@@ -122,55 +152,58 @@ public:
     // 记录卡片信息
     void LogCardInfo(const std::vector<unsigned char>& uid, const std::string& operation) {
         if (!enableLogging) return;
+        PN532_TRACE_SPAN("写日志", "log");
 
-        std::stringstream ss;
-        ss << "卡片操作: " << operation << " - UID: ";
-        for (auto b : uid) {
-            ss << std::hex << std::setw(2) << std::setfill('0') << (int)b << " ";
-        }
+        std::string text = "卡片操作: " + operation + " - UID: ";
+        size_t uidStart = text.size();
+        text.resize(uidStart + uid.size() * 3);
+        BlockFormatter::HexSpaced(uid.data(), uid.size(), &text[uidStart], true);
 
         std::lock_guard<std::mutex> lock(logMutex);
-        logFile << GetCurrentTime() << " - " << ss.str() << std::endl;
+        if (!FileReady()) return;
+        logFile << GetCurrentTime() << " - " << text << std::endl;
         logFile.flush();
     }
 
     // 记录扇区数据
-    void LogSectorData(int sector, const std::vector<std::vector<unsigned char>>& blocks,
+    void LogSectorData(int sector, const CardImage& image,
         const std::string& keyType, const std::string& key) {
         if (!enableLogging) return;
-
-        std::lock_guard<std::mutex> lock(logMutex);
-
-        logFile << "扇区 " << sector << " 数据 (密钥: " << keyType << " " << key << ")" << std::endl;
-
+        PN532_TRACE_SPAN_ARG("写扇区日志", "log", "sector", sector);
+
+        // 在锁外格式化整个扇区（数据块总是附 ASCII）
+        BlockLineStyle style;
+        style.lowercase = true;
+        style.ascii = AsciiColumn::Always;
+        std::string text = "扇区 " + std::to_string(sector) + " 数据 (密钥: " + keyType + " " + key + ")\n";
+        char line[BlockFormatter::MAX_LINE_LENGTH];
+        int firstBlock = CardImage::FirstBlockOfSector(sector);
+        Span<const CardBlock> blocks = image.SectorBlocks(sector);
         for (size_t i = 0; i < blocks.size(); i++) {
-            logFile << "  块 " << i << ": ";
-            for (auto byte : blocks[i]) {
-                logFile << std::hex << std::setw(2) << std::setfill('0') << (int)byte << " ";
-            }
-
-            // 如果是数据块，添加ASCII表示
-            if (i < 3 && blocks[i].size() == 16) {
-                logFile << "  ASCII: ";
-                for (auto byte : blocks[i]) {
-                    if (byte >= 32 && byte <= 126) {
-                        logFile << (char)byte;
-                    }
-                    else {
-                        logFile << ".";
-                    }
-                }
+            int blockNumber = firstBlock + static_cast<int>(i);
+            if (!image.IsKnown(blockNumber)) {
+                continue;
             }
-
-            logFile << std::endl;
+            text += "  块 " + std::to_string(i) + ": ";
+            text.append(line, BlockFormatter::Line(blocks[i].data(), CardImage::IsTrailer(blockNumber), line, style));
+            text += '\n';
         }
+
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (!FileReady()) return;
+        logFile << text;
         logFile.flush();
     }
 
+    // 是否允许输出到控制台（库内部使用时关闭，由事件接收器负责显示）
+    void SetConsoleEcho(bool enable) {
+        consoleEcho = enable;
+    }
+
     // 设置日志状态
     void SetLogging(bool enable) {
         enableLogging = enable;
-        if (enable && !logFile.is_open()) {
+        if (enable && !logFile.is_open() && !pendingOpen) {
             Initialize("", true);
         }
     }
@@ -194,6 +227,7 @@ public:
             logFile << "==========================================" << std::endl;
             logFile.close();
         }
+        pendingOpen = false;
         enableLogging = false;
     }
 };
\ No newline at end of file
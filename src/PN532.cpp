@@ -1,45 +1,110 @@
 ﻿#include "PN532.h"
-#include <iostream>
+#include "PN532Frame.h"
+#include "CardDumpFile.h"
+#include "BlockFormatter.h"
+#include "Trace.h"
 #include <iomanip>
 #include <thread>
 #include <chrono>
 #include <sstream>
 #include <fstream>
-#include <conio.h>
 #include <string>
+#include <algorithm>
+
+// 字节序列转为 "XX XX ..." 形式
+static std::string HexString(const unsigned char* data, size_t size, bool lowercase = false) {
+    std::string text(size * 3, ' ');
+    BlockFormatter::HexSpaced(data, size, &text[0], lowercase);
+    return text;
+}
+
+static std::string HexString(const std::vector<unsigned char>& data, bool lowercase = false) {
+    return HexString(data.data(), data.size(), lowercase);
+}
+
+static std::string HexString(const CardBlock& data) {
+    return HexString(data.data(), data.size());
+}
 
 
-PN532::PN532() : baudRate(CBR_115200), useDefaultKeysOnly(true) {
-    // 默认启用日志
-    logger.Initialize("", true);
+PN532::PN532() : baudRate(CBR_115200), sink(&NullCardEventSink::Instance()), imageCache(nullptr), selectedAtqa(0), selectedSak(0), backupArchive(nullptr),
+    infoCache(nullptr), readerInfoKnown(false), statsDumpIntervalSec(300),
+    lastStatsDump(std::chrono::steady_clock::now()), useDefaultKeysOnly(true) {
+    // 默认启用日志（协议层不直接输出到控制台）；文件在第一次写入时才创建，不拖慢构造
+    logger.SetConsoleEcho(false);
+    logger.Initialize("", true, true);
 }
 
 PN532::~PN532() {
+    DumpStats();
     logger.Close();
 }
 
+// 事件接收器
+void PN532::SetEventSink(CardEventSink* eventSink) {
+    sink = eventSink ? eventSink : &NullCardEventSink::Instance();
+}
+
+CardEventSink& PN532::GetEventSink() const {
+    return *sink;
+}
+
+void PN532::SetImageCache(PartialImageCache* cache) {
+    imageCache = cache;
+}
+
+PartialImageCache* PN532::GetImageCache() const {
+    return imageCache;
+}
+
+void PN532::SetBackupArchive(BackupArchive* archive) {
+    backupArchive = archive;
+}
+
+BackupArchive* PN532::GetBackupArchive() const {
+    return backupArchive;
+}
+
+void PN532::SetReaderInfoCache(ReaderInfoCache* cache) {
+    infoCache = cache;
+}
+
+bool PN532::GetReaderInfo(ReaderInfo& info) const {
+    if (readerInfoKnown) {
+        info = readerInfo;
+    }
+    return readerInfoKnown;
+}
+
+void PN532::Notify(EventLevel level, const std::string& message) {
+    sink->OnMessage(level, message);
+}
+
+void PN532::Report(EventLevel level, const std::string& message) {
+    logger.LogToFile(message, static_cast<int>(level));
+    sink->OnMessage(level, message);
+}
+
 // 检测可用串口
 std::vector<std::string> PN532::DetectAvailablePorts() {
     std::vector<std::string> availablePorts;
 
-    std::cout << "扫描串口..." << std::endl;
+    Notify(EventLevel::Info, "扫描串口...");
 
     // 使用 SerialPort 类的静态方法获取可用串口
     availablePorts = SerialPort::GetAvailablePorts();
 
-    std::cout << "找到 " << availablePorts.size() << " 个可用串口" << std::endl;
+    Notify(EventLevel::Info, "找到 " + std::to_string(availablePorts.size()) + " 个可用串口");
 
     // 进一步测试哪些串口可能是PN532设备
     std::vector<std::string> pn532Ports;
 
     for (const auto& port : availablePorts) {
-        std::cout << "测试串口 " << port << "... ";
-
         SerialPort testPort;
         if (testPort.Open(port.c_str(), CBR_115200)) {
             // 尝试发送PN532命令来确认是否是PN532设备
             // 这里可以添加更复杂的设备识别逻辑
-            std::cout << "可用";
+            Notify(EventLevel::Info, "测试串口 " + port + "... 可用");
 
             // 可以添加测试命令，例如获取固件版本
             // 但为了简单起见，我们假设所有可用串口都是可能的PN532设备
@@ -48,9 +113,8 @@ std::vector<std::string> PN532::DetectAvailablePorts() {
             testPort.Close();
         }
         else {
-            std::cout << "不可用";
+            Notify(EventLevel::Info, "测试串口 " + port + "... 不可用");
         }
-        std::cout << std::endl;
     }
 
     return pn532Ports.empty() ? availablePorts : pn532Ports;
@@ -79,85 +143,57 @@ std::string PN532::GetLogFileName() const {
     return logger.GetLogFileName();
 }
 
-unsigned char PN532::CalculateChecksum(const std::vector<unsigned char>& data) {
-    unsigned char sum = 0;
-    for (auto byte : data) {
-        sum += byte;
-    }
-    return (0x100 - sum) & 0xFF;  // 低8位补数
+// 命令统计
+PN532Stats PN532::GetStats() const {
+    return stats.Snapshot();
 }
 
-std::vector<unsigned char> PN532::BuildFrame(const std::vector<unsigned char>& data) {
-    std::vector<unsigned char> frame;
+void PN532::ResetStats() {
+    stats.Reset();
+}
 
-    // 添加前导码和起始码
-    frame.push_back(PREAMBLE);
-    frame.push_back(STARTCODE1);
-    frame.push_back(STARTCODE2);
+void PN532::DumpStats() {
+    PN532Stats snapshot = stats.Snapshot();
+    bool hasData = false;
+    for (const auto& c : snapshot.commands) {
+        if (c.roundTrip.Count() > 0) {
+            hasData = true;
+            break;
+        }
+    }
 
-    // 数据长度和长度校验
-    unsigned char len = data.size();
-    unsigned char len_checksum = (0x100 - len) & 0xFF;
+    if (hasData) {
+        logger.LogToFile(snapshot.Format(), 0);
+    }
+    lastStatsDump = std::chrono::steady_clock::now();
+}
 
-    frame.push_back(len);
-    frame.push_back(len_checksum);
+void PN532::SetStatsDumpInterval(int seconds) {
+    statsDumpIntervalSec = seconds < 0 ? 0 : seconds;
+}
 
-    // 添加数据
-    for (auto byte : data) {
-        frame.push_back(byte);
+void PN532::MaybeDumpStats() {
+    if (statsDumpIntervalSec <= 0) {
+        return;
     }
 
-    // 计算数据校验和
-    unsigned char data_checksum = CalculateChecksum(data);
-    frame.push_back(data_checksum);
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastStatsDump >= std::chrono::seconds(statsDumpIntervalSec)) {
+        DumpStats();
+    }
+}
 
-    // 添加后导码
-    frame.push_back(POSTAMBLE);
+unsigned char PN532::CalculateChecksum(const std::vector<unsigned char>& data) {
+    return PN532Frame::CalculateChecksum(data);
+}
 
-    return frame;
+std::vector<unsigned char> PN532::BuildFrame(const std::vector<unsigned char>& data) {
+    return PN532Frame::BuildFrame(data);
 }
 
 bool PN532::ParseFrame(const std::vector<unsigned char>& response,
     std::vector<unsigned char>& data) {
-    data.clear();
-
-    // 去掉调试输出
-    // std::cout << "解析帧，数据长度: " << response.size() << std::endl;
-
-    // 寻找有效的PN532帧
-    for (int i = 0; i < (int)response.size() - 5; i++) {
-        if (response[i] == 0x00 && response[i + 1] == 0xFF &&
-            (response[i + 4] == 0xD4 || response[i + 4] == 0xD5)) {
-
-            unsigned char len = response[i + 2];
-            unsigned char lcs = response[i + 3];
-
-            // 检查长度校验
-            if (((len + lcs) & 0xFF) != 0) continue;
-
-            // 检查数据长度
-            if (i + 4 + len + 1 >= response.size()) continue;
-
-            // 提取数据
-            for (int j = 0; j < len; j++) {
-                data.push_back(response[i + 4 + j]);
-            }
-
-            // 验证校验和
-            unsigned char received_checksum = response[i + 4 + len];
-            unsigned char calculated_checksum = CalculateChecksum(data);
-
-            if (received_checksum == calculated_checksum) {
-                // 去掉成功解析的输出
-                // std::cout << "成功解析帧，位置: " << i << std::endl;
-                return true;
-            }
-
-            data.clear();
-        }
-    }
-
-    return false;
+    return PN532Frame::ParseFrame(response, data);
 }
 
 bool PN532::Initialize(const char* port, DWORD baud) {
@@ -166,148 +202,375 @@ bool PN532::Initialize(const char* port, DWORD baud) {
 
     // 如果未指定端口，尝试自动检测
     if (std::string(port).empty()) {
-        std::cout << "正在自动检测串口..." << std::endl;
+        Notify(EventLevel::Info, "正在自动检测串口...");
 
         std::vector<std::string> availablePorts = DetectAvailablePorts();
 
         if (availablePorts.empty()) {
-            logger.Log("未找到可用串口", 2);
-            std::cout << "❌ 未找到可用串口!" << std::endl;
+            Report(EventLevel::Error, "❌ 未找到可用串口!");
             return false;
         }
 
-        // 如果有多个串口，让用户选择
+        // 如果有多个串口，交给事件接收器选择
         if (availablePorts.size() > 1) {
-            std::cout << "\n检测到多个串口，请选择:" << std::endl;
-            for (size_t i = 0; i < availablePorts.size(); i++) {
-                std::cout << "  [" << i + 1 << "] " << availablePorts[i] << std::endl;
-            }
-
-            std::cout << "\n请选择串口号 (1-" << availablePorts.size() << "): ";
-            int choice;
-            std::cin >> choice;
-            std::cin.ignore();
+            int choice = sink->ChoosePort(availablePorts);
 
-            if (choice < 1 || choice > static_cast<int>(availablePorts.size())) {
-                std::cout << "❌ 无效的选择!" << std::endl;
+            if (choice < 0 || choice >= static_cast<int>(availablePorts.size())) {
+                Report(EventLevel::Error, "❌ 无效的选择!");
                 return false;
             }
 
-            comPort = availablePorts[choice - 1];
+            comPort = availablePorts[choice];
         }
         else {
             // 只有一个串口，自动选择
             comPort = availablePorts[0];
         }
 
-        std::cout << "选择串口: " << comPort << std::endl;
+        Notify(EventLevel::Info, "选择串口: " + comPort);
     }
     else {
         comPort = port;
     }
 
-    std::string msg = "尝试打开串口: " + comPort;
-    logger.Log(msg, 0);
+    Report(EventLevel::Info, "尝试打开串口: " + comPort);
 
     if (!serial.Open(comPort.c_str(), baud)) {
-        logger.Log("串口打开失败", 2);
+        Report(EventLevel::Error, "串口打开失败: " + serial.GetLastErrorMessage());
         return false;
     }
 
-    logger.Log("串口打开成功", 0);
-    logger.Log("等待模块初始化...", 0);
+    Report(EventLevel::Info, "串口打开成功");
+    Report(EventLevel::Info, "等待模块就绪...");
+    stats.SetPort(comPort);
+
+    if (!WaitReady(comPort, READY_TIMEOUT_MS)) {
+        Report(EventLevel::Error, "读卡器无应答: " + lastResult.Describe());
+        serial.Close();
+        return false;
+    }
+    return true;
+}
+
+// 每次尝试都带唤醒前导发 SAMConfiguration：模块还在上电或处于低功耗时这一帧被丢掉，下一次再试，
+// 一有应答就说明已经就绪，不再按最坏情况固定等待。缓存中有这个设备的固件信息时到此为止，
+// 否则再查询一次固件版本并写入缓存。就绪用时记入统计
+bool PN532::WaitReady(const std::string& port, int timeoutMs) {
+    PN532_TRACE_SPAN("等待就绪", "link");
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(timeoutMs);
+    auto expired = [&]() { return std::chrono::steady_clock::now() >= deadline || operation.Stopped(); };
+    serial.PurgeInput();
+
+    std::string deviceId = infoCache ? SerialPort::GetDeviceId(port) : "";
+    ReaderInfo info;
+    bool fromCache = !deviceId.empty() && infoCache->Find(deviceId, info);
+
+    std::vector<unsigned char> samCommand = {
+        HOSTTOPN532,
+        CMD_SAMCONFIGURATION,
+        0x01,  // 正常模式
+        0x14,  // 超时50ms * 20 = 1000ms
+        0x01   // 使用外部IRQ
+    };
+    std::vector<unsigned char> firmwareCommand = { HOSTTOPN532, CMD_GETFIRMWAREVERSION };
+    std::vector<unsigned char> data;
+
+    // 写串口失败、串口未打开时不再等
+    auto fatal = [](const PN532Result& result) {
+        return result.transport == TransportError::WriteFailed || result.transport == TransportError::NotConnected;
+    };
+
+    bool configured = false;
+    while (!configured && !expired()) {
+        PN532Result result = TransceivePolled(samCommand, data, READY_ATTEMPT_MS, true);
+        configured = result.Ok();
+        if (fatal(result)) {
+            break;
+        }
+    }
+
+    bool identified = configured && fromCache;
+    while (configured && !identified && !expired()) {
+        PN532Result result = TransceivePolled(firmwareCommand, data, READY_ATTEMPT_MS, false);
+        if (result.Ok() && data.size() >= 6) {
+            info.ic = data[2];
+            info.version = data[3];
+            info.revision = data[4];
+            info.support = data[5];
+            identified = true;
+            if (infoCache) {
+                infoCache->Store(deviceId, info);
+            }
+        }
+        else if (fatal(result)) {
+            break;
+        }
+    }
+
+    uint64_t elapsedUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    stats.RecordReady(elapsedUs, identified, fromCache);
+    if (!identified) {
+        if (lastResult.Ok()) {
+            lastResult = PN532Result::FromTransport(TransportError::NoResponse);
+        }
+        return false;
+    }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    readerInfo = info;
+    readerInfoKnown = true;
 
+    std::stringstream ss;
+    ss << "读卡器就绪: " << port << " 用时 " << std::fixed << std::setprecision(1) << elapsedUs / 1000.0 << " ms"
+        << "，固件 IC=" << std::hex << std::setw(2) << std::setfill('0') << (int)info.ic
+        << " 版本 " << std::dec << (int)info.version << "." << (int)info.revision
+        << (fromCache ? "（缓存）" : "");
+    Report(EventLevel::Info, ss.str());
     return true;
 }
 
-bool PN532::GetFirmwareVersion(std::vector<unsigned char>& version) {
-    logger.Log("获取PN532固件版本...", 0);
-    std::vector<unsigned char> command = { HOSTTOPN532, CMD_GETFIRMWAREVERSION };
+// 发送命令帧并读取应答
+// 成功时 data 为应答数据（D5 + 命令码+1 + 参数），InDataExchange 的状态字节会提取到结果中
+PN532Result PN532::Transceive(const std::vector<unsigned char>& command,
+    std::vector<unsigned char>& data, int waitMs) {
+    data.clear();
+
+    uint8_t commandCode = command.size() > 1 ? command[1] : 0;
+    uint8_t subCommand = (commandCode == CMD_INDATAEXCHANGE && command.size() > 3) ? command[3] : 0;
+
+    // 已取消或超时的操作不再发出新命令；已发出的命令总是等到应答，串口里不会留下半帧
+    TransportError aborted = operation.Check();
+    if (aborted != TransportError::None) {
+        lastResult = PN532Result::FromTransport(aborted);
+        return lastResult;
+    }
+
     std::vector<unsigned char> frame = BuildFrame(command);
+    CommandTimer timer(stats, commandCode, subCommand);
+
+    if (!serial.IsConnected()) {
+        lastResult = PN532Result::FromTransport(TransportError::NotConnected);
+        return lastResult;
+    }
 
     // 发送命令
-    std::cout << "发送固件版本请求..." << std::endl;
     if (!serial.WriteData((char*)frame.data(), frame.size())) {
-        std::cerr << "发送命令失败!" << std::endl;
-        return false;
+        lastResult = PN532Result::FromTransport(TransportError::WriteFailed);
+        return lastResult;
     }
+    timer.MarkWrite();
 
     // 等待响应
-    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+    timer.MarkWait();
 
     // 读取响应
     char buffer[256];
     int bytesRead = serial.ReadData(buffer, sizeof(buffer));
-
-    std::cout << "读取到 " << bytesRead << " 字节" << std::endl;
+    timer.MarkRead();
 
     if (bytesRead <= 0) {
-        std::cerr << "没有收到响应!" << std::endl;
-        return false;
+        lastResult = PN532Result::FromTransport(TransportError::NoResponse);
+        return lastResult;
     }
 
-    // 解析响应
     std::vector<unsigned char> response(buffer, buffer + bytesRead);
-    std::vector<unsigned char> data;
-
     if (!ParseFrame(response, data)) {
-        std::cerr << "解析响应失败!" << std::endl;
-        return false;
+        lastResult = PN532Result::FromTransport(TransportError::BadFrame);
+        return lastResult;
     }
 
-    // 检查响应数据
-    if (data.size() < 6) { // D5 + 命令响应 + 4字节固件信息
-        std::cerr << "响应数据太短: " << data.size() << " 字节" << std::endl;
+    lastResult = PN532Frame::CheckResponse(commandCode, data);
+    if (lastResult.IsTransportError()) {
+        return lastResult;
+    }
+
+    timer.SetStatus(lastResult.status);
+    return lastResult;
+}
+
+// 发送命令（wakeUp 时先发 HSU 唤醒前导），之后只读取接收缓冲区中已有的字节，直到收到完整应答或 timeoutMs 用完
+PN532Result PN532::TransceivePolled(const std::vector<unsigned char>& command,
+    std::vector<unsigned char>& data, int timeoutMs, bool wakeUp) {
+    data.clear();
+
+    uint8_t commandCode = command.size() > 1 ? command[1] : 0;
+    TransportError aborted = operation.Check();
+    if (aborted != TransportError::None) {
+        lastResult = PN532Result::FromTransport(aborted);
+        return lastResult;
+    }
+
+    std::vector<unsigned char> frame;
+    if (wakeUp) {
+        frame.assign(std::begin(HSU_WAKEUP), std::end(HSU_WAKEUP));
+    }
+    std::vector<unsigned char> body = BuildFrame(command);
+    frame.insert(frame.end(), body.begin(), body.end());
+    CommandTimer timer(stats, commandCode);
+
+    if (!serial.IsConnected()) {
+        lastResult = PN532Result::FromTransport(TransportError::NotConnected);
+        return lastResult;
+    }
+    if (!serial.WriteData((char*)frame.data(), frame.size())) {
+        lastResult = PN532Result::FromTransport(TransportError::WriteFailed);
+        return lastResult;
+    }
+    timer.MarkWrite();
+
+    // 只读缓冲区中已有的字节，ReadData 不会停在读取超时上；ACK 帧被 ParseFrame 跳过
+    // 每轮都检查截止时间，持续有数据（如串口上的噪声）也不会超出 timeoutMs
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    std::vector<unsigned char> response;
+    char buffer[PN532Frame::MAX_FRAME_LENGTH];
+    while (true) {
+        int available = serial.BytesAvailable();
+        bool failed = available < 0;
+        if (available > 0) {
+            int bytesRead = serial.ReadData(buffer, std::min<unsigned int>(available, sizeof(buffer)));
+            if (bytesRead > 0) {
+                response.insert(response.end(), buffer, buffer + bytesRead);
+                if (ParseFrame(response, data)) {
+                    break;
+                }
+            }
+            else {
+                failed = true;  // 有数据却读不出来：读串口出错，不再空转
+            }
+        }
+        if (failed || std::chrono::steady_clock::now() >= deadline) {
+            timer.MarkRead();
+            lastResult = PN532Result::FromTransport(response.empty() ? TransportError::NoResponse : TransportError::BadFrame);
+            return lastResult;
+        }
+        if (available <= 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    timer.MarkRead();
+
+    lastResult = PN532Frame::CheckResponse(commandCode, data);
+    if (!lastResult.IsTransportError()) {
+        timer.SetStatus(lastResult.status);
+    }
+    return lastResult;
+}
+
+// 按重试策略发送命令：只重试瞬时错误，每次重试增加等待时间
+PN532Result PN532::TransceiveWithRetry(const std::vector<unsigned char>& command,
+    std::vector<unsigned char>& data, int waitMs) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (int attempt = 0; ; attempt++) {
+        PN532Result result = Transceive(command, data, waitMs + attempt * retryPolicy.backoffMs);
+        if (!retryPolicy.ShouldRetry(result, attempt, start)) {
+            return result;
+        }
+    }
+}
+
+const PN532Result& PN532::GetLastResult() const {
+    return lastResult;
+}
+
+void PN532::SetRetryPolicy(const RetryPolicy& policy) {
+    retryPolicy = policy;
+    if (retryPolicy.maxAttempts < 1) {
+        retryPolicy.maxAttempts = 1;
+    }
+}
+
+void PN532::SetOperationContext(const OperationContext& context) {
+    operation = context;
+}
+
+void PN532::ClearOperationContext() {
+    operation = OperationContext();
+}
+
+const OperationContext& PN532::GetOperationContext() const {
+    return operation;
+}
+
+bool PN532::IsOperationAborted() const {
+    return operation.Stopped();
+}
+
+// 分段等待，操作中止时提前返回
+void PN532::Pause(int ms) {
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (!operation.Stopped()) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now()).count();
+        if (left <= 0) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(left < 20 ? left : 20));
+    }
+}
+
+bool PN532::CheckAborted(const char* what, int completedSectors, int totalSectors) {
+    TransportError aborted = operation.Check();
+    if (aborted == TransportError::None) {
         return false;
     }
 
-    // 检查TFI和命令响应
-    if (data[0] != PN532TOHOST) {
-        std::cerr << "错误的TFI: " << std::hex << (int)data[0] << std::dec << std::endl;
+    lastResult = PN532Result::FromTransport(aborted);
+    Report(EventLevel::Warning, std::string("⚠️ ") + what + "已中止 (" + TransportErrorName(aborted) +
+        ")，已完成 " + std::to_string(completedSectors) + "/" + std::to_string(totalSectors) + " 个扇区");
+    return true;
+}
+
+const RetryPolicy& PN532::GetRetryPolicy() const {
+    return retryPolicy;
+}
+
+bool PN532::GetFirmwareVersion(std::vector<unsigned char>& version) {
+    Report(EventLevel::Info, "获取PN532固件版本...");
+    std::vector<unsigned char> command = { HOSTTOPN532, CMD_GETFIRMWAREVERSION };
+    std::vector<unsigned char> data;
+
+    // 发送命令
+    Notify(EventLevel::Info, "发送固件版本请求...");
+    PN532Result result = TransceiveWithRetry(command, data, 200);
+    if (!result.Ok()) {
+        Report(EventLevel::Error, "获取固件版本失败: " + result.Describe());
         return false;
     }
 
-    if (data[1] != CMD_GETFIRMWAREVERSION + 1) {
-        std::cerr << "错误的命令响应: 期望 " << std::hex
-            << (int)(CMD_GETFIRMWAREVERSION + 1)
-            << ", 收到 " << (int)data[1] << std::dec << std::endl;
+    // 检查响应数据
+    if (data.size() < 6) { // D5 + 命令响应 + 4字节固件信息
+        Notify(EventLevel::Error, "响应数据太短: " + std::to_string(data.size()) + " 字节");
+        lastResult = PN532Result::FromTransport(TransportError::UnexpectedResponse);
         return false;
     }
 
     // 提取固件版本
     version.assign(data.begin() + 2, data.end());
 
-    std::cout << "固件版本: ";
-    for (auto byte : version) {
-        printf("%02X ", byte);
-    }
-    std::cout << std::endl;
+    Notify(EventLevel::Info, "固件版本: " + HexString(version));
 
     // 解释固件版本
     if (version.size() >= 4) {
-        std::cout << "IC版本: " << std::hex << (int)version[0] << std::dec << std::endl;
-        std::cout << "版本: " << (int)version[1] << "." << (int)version[2] << std::endl;
-        std::cout << "支持的功能: " << std::hex << (int)version[3] << std::dec << std::endl;
-    }
-    if (!ParseFrame(response, data)) {
-        logger.Log("解析固件版本响应失败", 2);
-        return false;
+        std::stringstream info;
+        info << "IC版本: " << std::hex << (int)version[0] << std::dec << "\n";
+        info << "版本: " << (int)version[1] << "." << (int)version[2] << "\n";
+        info << "支持的功能: " << std::hex << (int)version[3] << std::dec;
+        Notify(EventLevel::Info, info.str());
     }
 
     // 记录固件版本
-    if (data.size() >= 6) {
-        std::stringstream ss;
-        ss << "PN532固件版本: ";
-        for (size_t i = 2; i < data.size(); i++) {
-            ss << std::hex << std::setw(2) << std::setfill('0') << (int)data[i] << " ";
-        }
-        logger.Log(ss.str(), 0);
-
-        // 记录到文件
-        logger.LogToFile("设备固件: " + ss.str(), 0);
+    std::stringstream ss;
+    ss << "PN532固件版本: ";
+    for (auto byte : version) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << (int)byte << " ";
     }
+    Report(EventLevel::Debug, ss.str());
+
+    // 记录到文件
+    logger.LogToFile("设备固件: " + ss.str(), 0);
 
     return true;
 }
@@ -321,142 +584,131 @@ bool PN532::SAMConfiguration() {
         0x01   // 使用外部IRQ
     };
 
-    std::vector<unsigned char> frame = BuildFrame(command);
-
-    if (!serial.WriteData((char*)frame.data(), frame.size())) {
-        std::cerr << "发送SAM配置命令失败!" << std::endl;
+    std::vector<unsigned char> data;
+    PN532Result result = TransceiveWithRetry(command, data, 100);
+    if (!result.Ok()) {
+        Report(EventLevel::Error, "SAM配置失败: " + result.Describe());
         return false;
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    Notify(EventLevel::Info, "SAM配置成功!");
+    return true;
+}
 
-    char buffer[256];
-    int bytesRead = serial.ReadData(buffer, sizeof(buffer));
+bool PN532::Ping() {
+    std::vector<unsigned char> command = { HOSTTOPN532, CMD_GETFIRMWAREVERSION };
+    std::vector<unsigned char> data;
+    return TransceivePolled(command, data, 100, false).Ok() && data.size() >= 6;
+}
 
-    if (bytesRead <= 0) {
-        std::cerr << "读取SAM配置响应失败!" << std::endl;
+bool PN532::Reconnect(bool searchOtherPorts) {
+    serial.Close();
+    selectedUid.clear();
+
+    // 原来的串口还在：只试它（读卡器没有应答就等下一次，不去打扰其他串口设备）
+    if (!comPort.empty() && serial.Open(comPort.c_str(), baudRate)) {
+        if (WaitReady(comPort, READY_TIMEOUT_MS)) {
+            return true;
+        }
+        serial.Close();
         return false;
     }
-
-    std::vector<unsigned char> response(buffer, buffer + bytesRead);
-    std::vector<unsigned char> data;
-
-    if (!ParseFrame(response, data)) {
-        std::cerr << "解析SAM配置响应失败!" << std::endl;
+    if (!searchOtherPorts) {
         return false;
     }
 
-    if (data.size() < 2 || data[0] != PN532TOHOST || data[1] != CMD_SAMCONFIGURATION + 1) {
-        std::cerr << "SAM配置失败!" << std::endl;
-        return false;
+    // 原来的串口打不开（USB 重新枚举后换了编号）：在其他串口中找有 PN532 应答的
+    for (const auto& port : SerialPort::GetAvailablePorts()) {
+        if (port == comPort || !serial.Open(port.c_str(), baudRate)) {
+            continue;
+        }
+        if (WaitReady(port, READY_TIMEOUT_MS)) {
+            Report(EventLevel::Warning, "读卡器串口已从 " + comPort + " 变为 " + port);
+            comPort = port;
+            stats.SetPort(comPort);
+            return true;
+        }
+        serial.Close();
     }
+    return false;
+}
 
-    std::cout << "SAM配置成功!" << std::endl;
-    return true;
+const std::string& PN532::GetPort() const {
+    return comPort;
 }
 
 bool PN532::DetectNFC(std::vector<unsigned char>& uid) {
+    PN532_TRACE_SPAN("检测卡片", "rf");
+
     // 清空UID
     uid.clear();
 
-    // 尝试多次检测
-    const int MAX_RETRIES = 3;
-
-    for (int retry = 0; retry < MAX_RETRIES; retry++) {
-        // 发送检测命令
-        std::vector<unsigned char> command = {
-            HOSTTOPN532,
-            CMD_INLISTPASSIVETARGET,
-            0x01,  // 最大目标数
-            0x00   // 106kbps Type A
-        };
-
-        std::vector<unsigned char> frame = BuildFrame(command);
-
-        // 发送命令
-        if (!serial.WriteData((char*)frame.data(), frame.size())) {
-            if (retry == MAX_RETRIES - 1) {
-                logger.Log("发送检测命令失败", 2);
-            }
-            continue;
-        }
+    MaybeDumpStats();
 
-        // 根据重试次数调整等待时间
-        int waitTime = 100 + (retry * 50);  // 第一次100ms，第二次150ms，第三次200ms
-        std::this_thread::sleep_for(std::chrono::milliseconds(waitTime));
+    // 发送检测命令
+    std::vector<unsigned char> command = {
+        HOSTTOPN532,
+        CMD_INLISTPASSIVETARGET,
+        0x01,  // 最大目标数
+        0x00   // 106kbps Type A
+    };
 
-        // 读取响应
-        char buffer[256];
-        int bytesRead = serial.ReadData(buffer, sizeof(buffer));
+    auto start = std::chrono::steady_clock::now();
 
-        if (bytesRead <= 0) {
-            if (retry == MAX_RETRIES - 1) {
-                // 最后一次尝试也失败了
-                return false;
-            }
-            continue;  // 继续重试
-        }
+    for (int attempt = 0; ; attempt++) {
+        // 根据重试次数调整等待时间：第一次100ms，第二次150ms，第三次200ms
+        int waitTime = 100 + attempt * retryPolicy.backoffMs;
 
-        std::vector<unsigned char> response(buffer, buffer + bytesRead);
         std::vector<unsigned char> data;
+        PN532Result result = Transceive(command, data, waitTime);
 
-        if (!ParseFrame(response, data)) {
-            continue;
-        }
+        if (result.Ok()) {
+            // 检查目标数
+            if (data.size() >= 3 && data[2] == 0) {
+                return false;  // 没有检测到卡片
+            }
 
-        // 检查响应数据
-        if (data.size() < 12) {
-            continue;
-        }
+            // 应答: D5 4B 目标数 目标号 ATQA(2) SAK UID长度 UID...
+            unsigned char nfcidLength = data.size() >= 8 ? data[7] : 0;
 
-        // 检查是否是有效响应
-        if (data[0] != 0xD5 || data[1] != 0x4B) {
-            continue;
-        }
+            if (data.size() >= 12 && nfcidLength > 0 && data.size() >= 8u + nfcidLength) {
+                uid.assign(data.begin() + 8, data.begin() + 8 + nfcidLength);
 
-        // 检查目标数
-        unsigned char targetCount = data[2];
-        if (targetCount == 0) {
-            return false;  // 没有检测到卡片
-        }
-
-        // 获取NFCID长度
-        unsigned char nfcidLength = data[7];
+                // 验证UID有效性（确保不是全0或全F）
+                bool isValidUID = false;
+                for (auto byte : uid) {
+                    if (byte != 0x00 && byte != 0xFF) {
+                        isValidUID = true;
+                        break;
+                    }
+                }
 
-        if (nfcidLength > 0 && data.size() >= 8 + nfcidLength) {
-            for (int i = 0; i < nfcidLength; i++) {
-                uid.push_back(data[8 + i]);
-            }
+                if (isValidUID) {
+                    selectedUid = uid;
+                    selectedAtqa = static_cast<uint16_t>((data[4] << 8) | data[5]);
+                    selectedSak = data[6];
 
-            // 验证UID有效性（确保不是全0或全F）
-            bool isValidUID = false;
-            for (auto byte : uid) {
-                if (byte != 0x00 && byte != 0xFF) {
-                    isValidUID = true;
-                    break;
+                    // 记录检测成功
+                    if (attempt > 0) {
+                        Report(EventLevel::Debug, "卡片检测成功，重试次数: " + std::to_string(attempt + 1));
+                    }
+                    return true;
                 }
-            }
-
-            if (!isValidUID) {
                 uid.clear();
-                if (retry < MAX_RETRIES - 1) {
-                    continue;  // 继续重试
-                }
-                return false;
             }
 
-            // 记录检测成功
-            if (retry > 0) {
-                std::stringstream retryMsg;
-                retryMsg << "卡片检测成功，重试次数: " << retry + 1;
-                logger.Log(retryMsg.str(), 3);  // DEBUG级别
-            }
+            // 应答不完整或UID无效，按帧错误处理（可重试）
+            result = PN532Result::FromTransport(TransportError::BadFrame);
+            lastResult = result;
+        }
 
-            return true;
+        if (!retryPolicy.ShouldRetry(result, attempt, start)) {
+            if (result.transport == TransportError::WriteFailed) {
+                Report(EventLevel::Error, "发送检测命令失败");
+            }
+            return false;
         }
     }
-
-    return false;
 }
 
 bool PN532::MifareAuthenticate(const std::vector<unsigned char>& uid,
@@ -487,56 +739,19 @@ bool PN532::MifareAuthenticate(const std::vector<unsigned char>& uid,
         command.push_back(byte);
     }
 
-    std::vector<unsigned char> frame = BuildFrame(command);
-
-    // 发送认证命令
-    if (!serial.WriteData((char*)frame.data(), frame.size())) {
-        std::cerr << "发送认证命令失败!" << std::endl;
-        return false;
-    }
-
-    // 等待响应
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-    char buffer[256];
-    int bytesRead = serial.ReadData(buffer, sizeof(buffer));
-
-    if (bytesRead <= 0) {
-        std::cerr << "读取认证响应失败!" << std::endl;
-        return false;
-    }
-
-    std::vector<unsigned char> response(buffer, buffer + bytesRead);
     std::vector<unsigned char> data;
-
-    if (!ParseFrame(response, data)) {
-        std::cerr << "解析认证响应失败!" << std::endl;
-        return false;
-    }
-
-    // 检查响应
-    if (data.size() < 3) {
-        std::cerr << "认证响应数据太短!" << std::endl;
+    PN532Result result = TransceiveWithRetry(command, data, 100);
+    if (!result.Ok()) {
+        Notify(EventLevel::Warning, "认证失败! " + result.Describe());
         return false;
     }
 
-    // 检查是否是正确响应
-    if (data[0] != PN532TOHOST || data[1] != CMD_INDATAEXCHANGE + 1) {
-        std::cerr << "认证响应命令错误!" << std::endl;
-        return false;
-    }
-
-    // 检查状态（第三个字节应为0x00表示成功）
-    if (data[2] != 0x00) {
-        std::cerr << "认证失败! 错误代码: " << std::hex << (int)data[2] << std::dec << std::endl;
-        return false;
-    }
-
-    std::cout << "扇区 " << (blockNumber / 4) << " 认证成功!" << std::endl;
+    Notify(EventLevel::Info, "扇区 " + std::to_string(blockNumber / 4) + " 认证成功!");
     return true;
 }
 
 bool PN532::MifareReadBlock(uint8_t blockNumber, std::vector<unsigned char>& data) {
+    PN532_TRACE_SPAN_ARG("读取块", "rf", "block", blockNumber);
     data.clear();
 
     // 构建读取命令
@@ -548,96 +763,62 @@ bool PN532::MifareReadBlock(uint8_t blockNumber, std::vector<unsigned char>& dat
         blockNumber
     };
 
-    std::vector<unsigned char> frame = BuildFrame(command);
-
-    // 发送读取命令
-    if (!serial.WriteData((char*)frame.data(), frame.size())) {
-        std::cerr << "发送读取命令失败!" << std::endl;
-        return false;
-    }
-
-    // 等待响应
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-    char buffer[256];
-    int bytesRead = serial.ReadData(buffer, sizeof(buffer));
-
-    if (bytesRead <= 0) {
-        std::cerr << "读取响应失败!" << std::endl;
-        return false;
-    }
-
-    std::vector<unsigned char> response(buffer, buffer + bytesRead);
     std::vector<unsigned char> responseData;
-
-    if (!ParseFrame(response, responseData)) {
-        std::cerr << "解析读取响应失败!" << std::endl;
-        return false;
-    }
-
-    // 检查响应
-    if (responseData.size() < 3) {
-        std::cerr << "读取响应数据太短!" << std::endl;
-        return false;
-    }
-
-    // 检查是否是正确响应
-    if (responseData[0] != PN532TOHOST || responseData[1] != CMD_INDATAEXCHANGE + 1) {
-        std::cerr << "读取响应命令错误!" << std::endl;
-        return false;
-    }
-
-    // 检查状态（第三个字节应为0x00表示成功）
-    if (responseData[2] != 0x00) {
-        std::cerr << "读取失败! 错误代码: " << std::hex << (int)responseData[2] << std::dec << std::endl;
+    PN532Result result = TransceiveWithRetry(command, responseData, 100);
+    if (!result.Ok()) {
+        Notify(EventLevel::Error, "读取失败! " + result.Describe());
         return false;
     }
 
     // 提取数据（16字节）
     if (responseData.size() >= 19) {  // 3字节头 + 16字节数据
-        for (int i = 3; i < 19; i++) {
-            data.push_back(responseData[i]);
-        }
+        data.assign(responseData.begin() + 3, responseData.begin() + 19);
         return true;
     }
 
+    Notify(EventLevel::Error, "读取响应数据太短!");
+    lastResult = PN532Result::FromTransport(TransportError::UnexpectedResponse);
     return false;
 }
 
-bool PN532::MifareReadSector(uint8_t sector, std::vector<std::vector<unsigned char>>& blocks) {
-    blocks.clear();
+// 读取一个块并存入镜像
+bool PN532::MifareReadBlock(uint8_t blockNumber, CardImage& image) {
+    std::vector<unsigned char> data;
+    if (!MifareReadBlock(blockNumber, data)) {
+        return false;
+    }
+    image.StoreRead(blockNumber, data.data());
+    return true;
+}
 
-    // Mifare 1K有16个扇区，每个扇区4个块
-    if (sector >= 16) {
-        std::cerr << "无效的扇区号!" << std::endl;
+bool PN532::MifareReadSector(uint8_t sector, CardImage& image) {
+    // 扇区数由卡片容量决定（1K卡16个扇区，每个扇区4个块）
+    if (sector >= image.SectorCount()) {
+        Notify(EventLevel::Error, "无效的扇区号!");
         return false;
     }
 
     // 扇区的第一个块号
-    uint8_t startBlock = sector * 4;
+    int startBlock = CardImage::FirstBlockOfSector(sector);
+    int blockCount = CardImage::BlocksInSector(sector);
 
-    std::cout << "读取扇区 " << (int)sector << " (块 " << (int)startBlock << " 到 " << (int)(startBlock + 3) << ")" << std::endl;
+    Notify(EventLevel::Info, "读取扇区 " + std::to_string(sector) + " (块 " + std::to_string(startBlock) +
+        " 到 " + std::to_string(startBlock + blockCount - 1) + ")");
 
-    // 读取扇区的所有4个块
-    for (int i = 0; i < 4; i++) {
-        uint8_t blockNumber = startBlock + i;
-        std::vector<unsigned char> blockData;
+    // 读取扇区的所有块
+    for (int i = 0; i < blockCount; i++) {
+        uint8_t blockNumber = static_cast<uint8_t>(startBlock + i);
 
-        if (MifareReadBlock(blockNumber, blockData)) {
-            blocks.push_back(blockData);
-            std::cout << "块 " << (int)blockNumber << ": ";
-            for (auto byte : blockData) {
-                printf("%02X ", byte);
-            }
-            std::cout << std::endl;
+        if (MifareReadBlock(blockNumber, image)) {
+            sink->OnBlockRead(blockNumber, image.Block(blockNumber));
         }
         else {
-            std::cerr << "读取块 " << (int)blockNumber << " 失败!" << std::endl;
+            Notify(EventLevel::Error, "读取块 " + std::to_string(blockNumber) + " 失败!");
             return false;
         }
 
         // 块之间稍作延迟
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        Pause(50);
     }
 
     return true;
@@ -647,7 +828,7 @@ bool PN532::TryAuthenticateSector(const std::vector<unsigned char>& uid,
     uint8_t sector,
     uint8_t& successfulKeyType,
     std::vector<unsigned char>& successfulKey) {
-    uint8_t sectorFirstBlock = sector * 4;
+    uint8_t sectorFirstBlock = static_cast<uint8_t>(CardImage::FirstBlockOfSector(sector));
 
     // 如果没有为该扇区配置密钥，使用默认密钥
     if (sectorKeys.find(sector) == sectorKeys.end()) {
@@ -661,26 +842,30 @@ bool PN532::TryAuthenticateSector(const std::vector<unsigned char>& uid,
 
     // 检查是否有密钥配置
     if (keys.empty()) {
-        std::cout << "扇区 " << (int)sector << " 没有配置密钥" << std::endl;
+        Notify(EventLevel::Warning, "扇区 " + std::to_string(sector) + " 没有配置密钥");
         return false;
     }
 
     // 每个密钥条目7字节：类型(1) + 密钥(6)
     int keyCount = keys.size() / 7;
 
-    std::cout << "扇区 " << (int)sector << " 有 " << keyCount << " 个密钥待尝试" << std::endl;
+    Notify(EventLevel::Info, "扇区 " + std::to_string(sector) + " 有 " + std::to_string(keyCount) + " 个密钥待尝试");
 
     for (int keyIndex = 0; keyIndex < keyCount; keyIndex++) {
+        // 操作已中止：不是密钥的问题，不再尝试也不报告认证失败
+        if (IsOperationAborted()) {
+            lastResult = PN532Result::FromTransport(operation.Check());
+            return false;
+        }
+
         int baseIndex = keyIndex * 7;
         uint8_t keyType = keys[baseIndex];
         std::vector<unsigned char> key(keys.begin() + baseIndex + 1, keys.begin() + baseIndex + 7);
 
-        std::cout << "尝试密钥 " << (keyIndex + 1) << ": ";
-        std::cout << (keyType == 0x60 ? "Key A" : "Key B") << " ";
-        for (auto k : key) {
-            printf("%02X ", k);
-        }
-        std::cout << std::endl;
+        Notify(EventLevel::Info, "尝试密钥 " + std::to_string(keyIndex + 1) + ": " +
+            (keyType == 0x60 ? "Key A " : "Key B ") + HexString(key));
+
+        PN532_TRACE_SPAN_ARGS("认证密钥", "rf", "sector", sector, "key", keyIndex);
 
         // 构建认证命令
         std::vector<unsigned char> command = {
@@ -701,78 +886,41 @@ bool PN532::TryAuthenticateSector(const std::vector<unsigned char>& uid,
             command.push_back(byte);
         }
 
-        std::vector<unsigned char> frame = BuildFrame(command);
-
-        // 发送认证命令
-        if (!serial.WriteData((char*)frame.data(), frame.size())) {
-            std::cout << "发送认证命令失败" << std::endl;
-            continue;
-        }
-
-        // 等待响应
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::vector<unsigned char> data;
+        PN532Result result = TransceiveWithRetry(command, data, 100);
 
-        char buffer[256];
-        int bytesRead = serial.ReadData(buffer, sizeof(buffer));
+        if (result.Ok()) {
+            // 认证成功
+            successfulKeyType = keyType;
+            successfulKey = key;
 
-        if (bytesRead <= 0) {
-            std::cout << "没有响应" << std::endl;
-            continue;
-        }
+            sink->OnSectorAuthenticated(sector, keyType, key);
 
-        std::vector<unsigned char> response(buffer, buffer + bytesRead);
-        std::vector<unsigned char> data;
+            // 记录成功的认证到日志
+            std::stringstream authMsg;
+            authMsg << "扇区 " << (int)sector << " 认证成功 - 密钥: ";
+            authMsg << (keyType == 0x60 ? "Key A " : "Key B ");
+            for (auto k : key) {
+                authMsg << std::hex << std::setw(2) << std::setfill('0') << (int)k << " ";
+            }
+            logger.LogToFile(authMsg.str(), 0);
 
-        if (!ParseFrame(response, data)) {
-            std::cout << "解析响应失败" << std::endl;
-            continue;
+            return true;
         }
 
-        // 检查响应
-        if (data.size() >= 3 &&
-            data[0] == PN532TOHOST &&
-            data[1] == CMD_INDATAEXCHANGE + 1) {
-
-            // 检查认证结果
-            if (data[2] == 0x00) {  // 0x00表示认证成功
-                // 认证成功
-                successfulKeyType = keyType;
-                successfulKey = key;
-
-                std::cout << "✅ 扇区 " << (int)sector << " 认证成功! ";
-                std::cout << "使用密钥: " << (keyType == 0x60 ? "Key A" : "Key B") << " ";
-                for (auto k : key) {
-                    printf("%02X ", k);
-                }
-                std::cout << std::endl;
-
-                // 记录成功的认证到日志
-                std::stringstream authMsg;
-                authMsg << "扇区 " << (int)sector << " 认证成功 - 密钥: ";
-                authMsg << (keyType == 0x60 ? "Key A " : "Key B ");
-                for (auto k : key) {
-                    authMsg << std::hex << std::setw(2) << std::setfill('0') << (int)k << " ";
-                }
-                logger.Log(authMsg.str(), 0);
+        Report(EventLevel::Warning, "扇区 " + std::to_string(sector) + " 认证失败 - " + result.Describe());
 
-                return true;
-            }
-            else {
-                std::cout << "认证失败，错误码: " << std::hex << (int)data[2] << std::dec << std::endl;
-                // 记录认证失败到日志
-                std::stringstream failMsg;
-                failMsg << "扇区 " << (int)sector << " 认证失败 - 错误码: 0x" << std::hex << (int)data[2];
-                logger.Log(failMsg.str(), 2);
-            }
-        }
-        else {
-            std::cout << "无效的响应格式" << std::endl;
-            logger.Log("扇区 " + std::to_string(sector) + " 认证响应格式无效", 2);
+        // 密钥错误只说明当前密钥不对，继续尝试下一个；
+        // 其他永久错误（卡片离开、访问被拒、串口故障）换密钥也无济于事，立即放弃
+        if (result.Class() == ErrorClass::Permanent && result.status != 0x14) {
+            logger.LogToFile("扇区 " + std::to_string(sector) + " 认证中止", 2);
+            sink->OnSectorAuthFailed(sector, result);
+            return false;
         }
     }
 
-    std::cout << "❌ 扇区 " << (int)sector << " 所有密钥尝试失败" << std::endl;
-    logger.Log("扇区 " + std::to_string(sector) + " 所有密钥尝试失败", 2);
+    logger.LogToFile("扇区 " + std::to_string(sector) + " 所有密钥尝试失败", 2);
+    sink->OnSectorAuthFailed(sector, lastResult);
     return false;
 }
 
@@ -780,21 +928,24 @@ bool PN532::TryAuthenticateSector(const std::vector<unsigned char>& uid,
 bool PN532::MifareWriteBlock(uint8_t blockNumber, const std::vector<unsigned char>& data) {
     // 检查数据长度（必须是16字节）
     if (data.size() != 16) {
-        std::cout << "错误: 写入数据必须是16字节!" << std::endl;
+        Notify(EventLevel::Error, "错误: 写入数据必须是16字节!");
         return false;
     }
 
-    // 检查是否是控制块（每个扇区的第4个块）
-    if ((blockNumber + 1) % 4 == 0) {
-        std::cout << "警告: 尝试写入控制块! 这可能会永久锁死卡片!" << std::endl;
-        std::cout << "按 Y 确认写入控制块，其他键取消: ";
-        char ch = _getch();
-        if (ch != 'Y' && ch != 'y') {
-            std::cout << "操作取消" << std::endl;
+    return MifareWriteBlock(blockNumber, CardBlock::From(data.data()));
+}
+
+bool PN532::MifareWriteBlock(uint8_t blockNumber, const CardBlock& data) {
+    // 检查是否是控制块（每个扇区的最后一个块）
+    if (CardImage::IsTrailer(blockNumber)) {
+        if (!sink->ConfirmControlBlockWrite(blockNumber)) {
+            Report(EventLevel::Warning, "块 " + std::to_string(blockNumber) + " 是控制块，写入已取消");
             return false;
         }
     }
 
+    PN532_TRACE_SPAN_ARG("写入块", "rf", "block", blockNumber);
+
     // 构建写入命令
     std::vector<unsigned char> command = {
         HOSTTOPN532,
@@ -809,54 +960,22 @@ bool PN532::MifareWriteBlock(uint8_t blockNumber, const std::vector<unsigned cha
         command.push_back(byte);
     }
 
-    std::vector<unsigned char> frame = BuildFrame(command);
-
-    // 发送写入命令
-    if (!serial.WriteData((char*)frame.data(), frame.size())) {
-        std::cout << "发送写入命令失败!" << std::endl;
-        return false;
-    }
-
-    // 等待响应
-    std::this_thread::sleep_for(std::chrono::milliseconds(200));
-
-    char buffer[256];
-    int bytesRead = serial.ReadData(buffer, sizeof(buffer));
-
-    if (bytesRead <= 0) {
-        std::cout << "读取写入响应失败!" << std::endl;
-        return false;
-    }
-
-    std::vector<unsigned char> response(buffer, buffer + bytesRead);
+    // 写入不自动重试：失败后由调用者读回确认块内容
     std::vector<unsigned char> responseData;
-
-    if (!ParseFrame(response, responseData)) {
-        std::cout << "解析写入响应失败!" << std::endl;
+    PN532Result result = Transceive(command, responseData, 200);
+    sink->OnBlockWritten(blockNumber, data, result);
+    if (!result.Ok()) {
+        logger.LogToFile("块 " + std::to_string(blockNumber) + " 写入失败 - " + result.Describe(), 2);
         return false;
     }
 
-    // 检查响应
-    if (responseData.size() < 3) {
-        std::cout << "写入响应数据太短!" << std::endl;
-        return false;
-    }
+    logger.LogToFile("块 " + std::to_string(blockNumber) + " 写入成功", 0);
 
-    // 检查是否是正确响应
-    if (responseData[0] != PN532TOHOST || responseData[1] != CMD_INDATAEXCHANGE + 1) {
-        std::cout << "写入响应命令错误!" << std::endl;
-        return false;
+    // 缓存中的旧内容已失效
+    if (imageCache && !selectedUid.empty()) {
+        imageCache->InvalidateBlock(selectedUid, blockNumber);
     }
 
-    // 检查状态（第三个字节应为0x00表示成功）
-    if (responseData[2] != 0x00) {
-        std::cout << "写入失败! 错误代码: 0x" << std::hex << (int)responseData[2] << std::dec << std::endl;
-        return false;
-    }
-
-    std::cout << "✅ 块 " << (int)blockNumber << " 写入成功!" << std::endl;
-    logger.Log("块 " + std::to_string(blockNumber) + " 写入成功", 0);
-
     return true;
 }
 
@@ -894,45 +1013,44 @@ bool PN532::MifareWriteValueBlock(uint8_t blockNumber, int32_t value) {
 }
 
 // 写入整个扇区
-bool PN532::MifareWriteSector(uint8_t sector, const std::vector<std::vector<unsigned char>>& blocks) {
-    if (sector >= 16) {
-        std::cout << "无效的扇区号!" << std::endl;
+bool PN532::MifareWriteSector(uint8_t sector, CardImage& image) {
+    if (sector >= image.SectorCount()) {
+        Notify(EventLevel::Error, "无效的扇区号!");
         return false;
     }
 
-    if (blocks.size() != 4) {
-        std::cout << "必须提供4个块的数据!" << std::endl;
-        return false;
-    }
-
-    uint8_t startBlock = sector * 4;
+    int startBlock = CardImage::FirstBlockOfSector(sector);
+    int blockCount = CardImage::BlocksInSector(sector);
     bool success = true;
 
-    std::cout << "写入扇区 " << (int)sector << " (块 " << (int)startBlock << " 到 " << (int)(startBlock + 3) << ")" << std::endl;
+    Notify(EventLevel::Info, "写入扇区 " + std::to_string(sector) + " (块 " + std::to_string(startBlock) +
+        " 到 " + std::to_string(startBlock + blockCount - 1) + ")");
+
+    for (int i = 0; i < blockCount; i++) {
+        uint8_t blockNumber = static_cast<uint8_t>(startBlock + i);
 
-    for (int i = 0; i < 4; i++) {
-        uint8_t blockNumber = startBlock + i;
+        // 只写修改过的块
+        if (!image.IsDirty(blockNumber)) {
+            continue;
+        }
 
         // 跳过厂商块（扇区0块0）
         if (blockNumber == 0) {
-            std::cout << "跳过厂商块（只读）" << std::endl;
+            Notify(EventLevel::Info, "跳过厂商块（只读）");
             continue;
         }
 
-        std::cout << "写入块 " << (int)blockNumber << ": ";
-        for (auto b : blocks[i]) {
-            printf("%02X ", b);
-        }
-        std::cout << std::endl;
+        Notify(EventLevel::Info, "写入块 " + std::to_string(blockNumber) + ": " + HexString(image.Block(blockNumber)));
 
-        if (!MifareWriteBlock(blockNumber, blocks[i])) {
-            std::cout << "写入块 " << (int)blockNumber << " 失败!" << std::endl;
+        if (!MifareWriteBlock(blockNumber, image.Block(blockNumber))) {
+            Notify(EventLevel::Error, "写入块 " + std::to_string(blockNumber) + " 失败!");
             success = false;
             break;
         }
+        image.MarkWritten(blockNumber);
 
         // 块之间延迟
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        Pause(100);
     }
 
     return success;
@@ -945,26 +1063,19 @@ bool PN532::ChangeSectorKeys(uint8_t sector,
     const std::vector<unsigned char>& accessBits) {
     // 检查参数
     if (keyA.size() != 6 || keyB.size() != 6 || accessBits.size() != 4) {
-        std::cout << "密钥和访问位长度错误!" << std::endl;
+        Notify(EventLevel::Error, "密钥和访问位长度错误!");
         return false;
     }
 
     if (sector >= 16) {
-        std::cout << "无效的扇区号!" << std::endl;
+        Notify(EventLevel::Error, "无效的扇区号!");
         return false;
     }
 
     uint8_t blockNumber = sector * 4 + 3;  // 控制块
 
-    std::cout << "⚠️ 警告: 正在修改扇区 " << sector << " 的控制块!" << std::endl;
-    std::cout << "此操作可能永久锁死卡片!" << std::endl;
-    std::cout << "按 Y 确认，其他键取消: ";
-
-    char ch = _getch();
-    if (ch != 'Y' && ch != 'y') {
-        std::cout << "操作取消" << std::endl;
-        return false;
-    }
+    // 写入前的确认由 MifareWriteBlock 交给事件接收器
+    Notify(EventLevel::Warning, "⚠️ 警告: 正在修改扇区 " + std::to_string(sector) + " 的控制块!");
 
     // 构建控制块数据
     std::vector<unsigned char> controlBlock(16, 0x00);
@@ -985,11 +1096,7 @@ bool PN532::ChangeSectorKeys(uint8_t sector,
         controlBlock[10 + i] = keyB[i];
     }
 
-    std::cout << "新的控制块: ";
-    for (auto b : controlBlock) {
-        printf("%02X ", b);
-    }
-    std::cout << std::endl;
+    Notify(EventLevel::Info, "新的控制块: " + HexString(controlBlock));
 
     return MifareWriteBlock(blockNumber, controlBlock);
 }
@@ -1007,568 +1114,291 @@ std::vector<unsigned char> PN532::CalculateAccessBits(uint8_t b0, uint8_t b1, ui
     return accessBits;
 }
 
-// 显示访问控制位
-void PN532::DisplayAccessBits(uint8_t sector) {
-    // 读取控制块
-    uint8_t blockNumber = sector * 4 + 3;
-    std::vector<unsigned char> controlBlock;
-
-    if (MifareReadBlock(blockNumber, controlBlock) && controlBlock.size() >= 16) {
-        std::cout << "扇区 " << sector << " 访问控制位: ";
-        for (int i = 6; i < 10; i++) {
-            printf("%02X ", controlBlock[i]);
-        }
-        std::cout << std::endl;
-
-        // 解析访问控制位
-        uint8_t accessBits[4];
-        for (int i = 0; i < 4; i++) {
-            accessBits[i] = controlBlock[6 + i];
-        }
-
-        // 简化解析（实际解析较复杂）
-        std::cout << "块权限:" << std::endl;
-        std::cout << "  块0-2: ";
-        switch (accessBits[0] & 0x0F) {
-        case 0x00: std::cout << "KeyA可读写，KeyB可读写"; break;
-        case 0x01: std::cout << "KeyA可读写，KeyB可读"; break;
-        case 0x02: std::cout << "KeyA可读写，KeyB可写"; break;
-        case 0x03: std::cout << "KeyA可读写，KeyB无访问"; break;
-        default: std::cout << "未知权限";
-        }
-        std::cout << std::endl;
-    }
-    else {
-        std::cout << "无法读取访问控制位" << std::endl;
-    }
-}
-
 void PN532::ReadCardAllData(const std::vector<unsigned char>& uid) {
-    std::cout << "\n=== 读取CUID卡数据 ===" << std::endl;
-    std::cout << "卡UID: ";
-    for (auto byte : uid) {
-        printf("%02X ", byte);
-    }
-    std::cout << std::endl;
+    sink->OnDumpStarted("读取CUID卡数据", uid);
+
+    int successfulSectors = 0;
+    CardImage image;
+    image.SetUid(uid);
 
     // 尝试读取所有扇区（0-15）
     for (int sector = 0; sector < 16; sector++) {
+        if (CheckAborted("读取", successfulSectors, image.SectorCount())) {
+            break;
+        }
+
         // 每个扇区需要单独认证
         uint8_t sectorFirstBlock = sector * 4;
 
         // 尝试认证扇区（使用默认Key A）
         if (MifareAuthenticate(uid, sectorFirstBlock, 0x60, DEFAULT_KEY_A)) {
-            std::vector<std::vector<unsigned char>> blocks;
-
-            if (MifareReadSector(sector, blocks)) {
-                // 显示扇区数据
-                std::cout << "\n扇区 " << sector << " 数据:" << std::endl;
-                for (size_t i = 0; i < blocks.size(); i++) {
-                    std::cout << "  块 " << (sector * 4 + i) << ": ";
-
-                    // 如果是数据块，尝试解析为文本
-                    if (i < 3) {  // 前3个块是数据块
-                        // 检查是否有可打印文本
-                        bool hasPrintable = false;
-                        for (auto byte : blocks[i]) {
-                            if (byte >= 32 && byte <= 126) {
-                                hasPrintable = true;
-                                break;
-                            }
-                        }
-
-                        // 显示十六进制
-                        for (auto byte : blocks[i]) {
-                            printf("%02X ", byte);
-                        }
-
-                        // 如果包含可打印字符，显示ASCII
-                        if (hasPrintable) {
-                            std::cout << "  ASCII: ";
-                            for (auto byte : blocks[i]) {
-                                if (byte >= 32 && byte <= 126) {
-                                    std::cout << (char)byte;
-                                }
-                                else {
-                                    std::cout << ".";
-                                }
-                            }
-                        }
-                    }
-                    else {  // 第4个块是控制块
-                        std::cout << "[控制块] ";
-                        for (auto byte : blocks[i]) {
-                            printf("%02X ", byte);
-                        }
-
-                        // 解析控制块
-                        if (blocks[i].size() >= 16) {
-                            std::cout << "\n        Key A: ";
-                            for (int j = 0; j < 6; j++) printf("%02X ", blocks[i][j]);
-
-                            std::cout << "  Access Bits: ";
-                            for (int j = 6; j < 9; j++) printf("%02X ", blocks[i][j]);
-
-                            std::cout << "  Key B: ";
-                            for (int j = 10; j < 16; j++) printf("%02X ", blocks[i][j]);
-                        }
-                    }
-                    std::cout << std::endl;
-                }
+            image.SetSectorKey(sector, 0x60, DEFAULT_KEY_A);
+            if (MifareReadSector(sector, image)) {
+                successfulSectors++;
+                sink->OnSectorRead(sector, image);
             }
         }
-        else {
-            std::cout << "扇区 " << sector << " 认证失败（可能密钥不同）" << std::endl;
+        else if (!IsOperationAborted()) {
+            Notify(EventLevel::Warning, "扇区 " + std::to_string(sector) + " 认证失败（可能密钥不同）");
         }
 
         // 扇区间延迟
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        Pause(100);
     }
-}
-
-void PN532::SetupKeysFromUserInput() {
-    ClearAllKeys();
-
-    std::cout << "\n=== 密钥设置 ===" << std::endl;
-    logger.Log("开始密钥设置", 0);
-
-    std::cout << "请选择密钥模式:" << std::endl;
-    std::cout << "1. 仅使用默认密钥 (FFFFFFFFFFFF)" << std::endl;
-    std::cout << "2. 使用默认密钥 + 自定义密钥" << std::endl;
-    std::cout << "3. 仅使用自定义密钥" << std::endl;
-    std::cout << "请选择 (1-3): ";
 
-    int choice;
-    std::cin >> choice;
-    std::cin.ignore();  // 清除换行符
+    sink->OnDumpFinished(successfulSectors, 16);
+}
 
-    bool addDefaultKeys = (choice == 1 || choice == 2);
-    bool addCustomKeys = (choice == 2 || choice == 3);
+// 流式读取整卡
+// 每读到一个块立即发出 OnBlock，扇区结束（读完、认证失败或中途失败）时发出 OnSector，
+// 所以卡片中途离开或操作中止时，之前读到的内容都已交给 consumer
+int PN532::StreamCardData(const std::vector<unsigned char>& uid, CardImage& image, DumpConsumer& consumer) {
+    PN532_TRACE_SPAN("StreamCardData", "workflow");
+    using Clock = std::chrono::steady_clock;
+    auto elapsedUs = [](Clock::time_point from) {
+        return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - from).count());
+    };
 
-    // 记录用户选择
-    std::string modeStr;
-    switch (choice) {
-    case 1: modeStr = "仅默认密钥"; break;
-    case 2: modeStr = "默认+自定义密钥"; break;
-    case 3: modeStr = "仅自定义密钥"; break;
-    default: modeStr = "未知模式";
-    }
-    logger.Log("用户选择密钥模式: " + modeStr, 0);
+    auto dumpStart = Clock::now();
+    DumpSummary summary;
+    summary.uid = uid;
+    summary.totalSectors = image.SectorCount();
+
+    image.Clear();
+    image.SetUid(uid);
+
+    // 同一张卡片上次没有读完：已读到的块直接交付，只补读缺少的部分
+    CardImage cached(image.Geometry());
+    bool resuming = imageCache && imageCache->Find(uid, cached) && cached.Geometry() == image.Geometry();
+    if (resuming) {
+        image = cached;
+        Report(EventLevel::Info, "继续上次未完成的读取，已缓存 " + std::to_string(image.KnownSectorCount()) + "/" +
+            std::to_string(image.SectorCount()) + " 个扇区");
+    }
+    if (uid == selectedUid) {
+        image.SetTargetInfo(selectedAtqa, selectedSak);
+    }
+
+    // 交付一个镜像中已有的块
+    auto emitKnown = [&](SectorResult& sectorResult, int blockNumber) {
+        BlockResult blockResult;
+        blockResult.sector = sectorResult.sector;
+        blockResult.block = static_cast<uint8_t>(blockNumber);
+        blockResult.data = image.Block(blockNumber);
+        blockResult.keyType = sectorResult.keyType;
+        blockResult.key = sectorResult.key;
+        blockResult.offsetMs = elapsedUs(dumpStart) / 1000;
+        blockResult.fromCache = true;
+        consumer.OnBlock(blockResult);
+        sectorResult.blocks[sectorResult.blocksRead++] = blockResult.data;
+    };
 
-    if (addDefaultKeys) {
-        std::cout << "添加默认密钥到所有扇区..." << std::endl;
-        logger.Log("添加默认密钥到所有扇区", 0);
+    consumer.OnDumpBegin(uid);
 
-        for (int sector = 0; sector < 16; sector++) {
-            AddDefaultKeyA(sector);
-            AddDefaultKeyB(sector);
+    // 尝试读取所有扇区
+    for (int sector = 0; sector < image.SectorCount(); sector++) {
+        if (CheckAborted("读取", summary.completedSectors, image.SectorCount())) {
+            break;
         }
 
-        logger.LogToFile("已添加默认密钥FFFFFFFFFFFF到所有扇区", 0);
-    }
-
-    if (addCustomKeys) {
-        std::cout << "\n=== 添加自定义密钥 ===" << std::endl;
-        std::cout << "密钥格式: 12位十六进制数字 (例如: FFFFFFFFFFFF)" << std::endl;
-        std::cout << "输入 'q' 结束输入" << std::endl;
-
-        logger.Log("开始添加自定义密钥", 0);
-
-        while (true) {
-            std::cout << "\n输入密钥: ";
-            std::string input;
-            std::getline(std::cin, input);
-
-            if (input == "q" || input == "Q") {
-                std::cout << "结束密钥输入" << std::endl;
-                logger.Log("结束自定义密钥输入", 0);
-                break;
-            }
-
-            // 验证输入格式
-            if (input.length() != 12) {
-                std::cout << "错误: 密钥必须是12位十六进制数字!" << std::endl;
-                logger.Log("密钥输入错误: 长度必须是12位", 2);
-                continue;
-            }
-
-            bool valid = true;
-            for (char c : input) {
-                if (!((c >= '0' && c <= '9') ||
-                    (c >= 'A' && c <= 'F') ||
-                    (c >= 'a' && c <= 'f'))) {
-                    valid = false;
-                    break;
-                }
-            }
-
-            if (!valid) {
-                std::cout << "错误: 包含无效字符!" << std::endl;
-                logger.Log("密钥输入错误: 包含无效字符", 2);
-                continue;
+        Notify(EventLevel::Info, "\n尝试扇区 " + std::to_string(sector) + "...");
+        PN532_TRACE_SPAN_ARG("读取扇区", "workflow", "sector", sector);
+
+        int firstBlock = CardImage::FirstBlockOfSector(sector);
+        SectorResult sectorResult;
+        sectorResult.sector = static_cast<uint8_t>(sector);
+        sectorResult.blockCount = CardImage::BlocksInSector(sector);
+        const SectorKeyInfo& knownKey = image.SectorKey(sector);
+
+        if (resuming && image.SectorKnown(sector)) {
+            // 整个扇区已缓存，不需要射频交换
+            sectorResult.authenticated = true;
+            sectorResult.keyType = knownKey.keyType;
+            sectorResult.key = knownKey.key;
+            sectorResult.fromCache = true;
+            for (int block = 0; block < sectorResult.blockCount; block++) {
+                emitKnown(sectorResult, firstBlock + block);
             }
+            summary.completedSectors++;
+            summary.resumedSectors++;
+            consumer.OnSector(sectorResult);
+            continue;
+        }
 
-            // 转换为字节
+        auto authStart = Clock::now();
+        if (resuming && knownKey.known &&
+            MifareAuthenticate(uid, static_cast<uint8_t>(firstBlock), knownKey.keyType, knownKey.key.data())) {
+            // 上次成功的密钥，省去逐个尝试
+            sectorResult.authenticated = true;
+            sectorResult.keyType = knownKey.keyType;
+            sectorResult.key = knownKey.key;
+        }
+        else {
             std::vector<unsigned char> key;
-            for (int i = 0; i < 12; i += 2) {
-                std::string byteStr = input.substr(i, 2);
-                unsigned char byte = (unsigned char)std::strtoul(byteStr.c_str(), nullptr, 16);
-                key.push_back(byte);
-            }
-
-            // 记录密钥
-            std::stringstream keyMsg;
-            keyMsg << "自定义密钥: ";
-            for (auto k : key) {
-                keyMsg << std::hex << std::setw(2) << std::setfill('0') << (int)k << " ";
-            }
-            logger.Log(keyMsg.str(), 0);
-
-            // 选择密钥类型
-            std::cout << "密钥类型: 1. Key A  2. Key B (默认: 1): ";
-            std::string typeInput;
-            std::getline(std::cin, typeInput);
-
-            uint8_t keyType = 0x60;  // 默认Key A
-            if (typeInput == "2") {
-                keyType = 0x61;  // Key B
-            }
-
-            std::string typeStr = (keyType == 0x60) ? "Key A" : "Key B";
-            logger.Log("密钥类型: " + typeStr, 0);
-
-            // 选择扇区
-            std::cout << "应用于哪些扇区?" << std::endl;
-            std::cout << "1. 所有扇区 (0-15)" << std::endl;
-            std::cout << "2. 单个扇区" << std::endl;
-            std::cout << "3. 扇区范围" << std::endl;
-            std::cout << "请选择 (1-3): ";
-
-            std::string sectorChoice;
-            std::getline(std::cin, sectorChoice);
-
-            if (sectorChoice == "1") {
-                // 所有扇区
-                for (int sector = 0; sector < 16; sector++) {
-                    AddCustomKey(sector, key, keyType);
-                }
-                std::cout << "✅ 已为所有扇区添加密钥" << std::endl;
-                logger.Log("已将自定义密钥应用到所有扇区", 0);
-            }
-            else if (sectorChoice == "2") {
-                // 单个扇区
-                std::cout << "输入扇区号 (0-15): ";
-                int sector;
-                std::cin >> sector;
-                std::cin.ignore();
-
-                if (sector >= 0 && sector < 16) {
-                    AddCustomKey(sector, key, keyType);
-                    std::cout << "✅ 已为扇区 " << sector << " 添加密钥" << std::endl;
-                    logger.Log("已将自定义密钥应用到扇区 " + std::to_string(sector), 0);
-                }
-                else {
-                    std::cout << "❌ 无效的扇区号!" << std::endl;
-                    logger.Log("无效的扇区号: " + std::to_string(sector), 2);
-                }
-            }
-            else if (sectorChoice == "3") {
-                // 扇区范围
-                std::cout << "输入起始扇区 (0-15): ";
-                int startSector;
-                std::cin >> startSector;
-                std::cin.ignore();
-
-                std::cout << "输入结束扇区 (" << startSector << "-15): ";
-                int endSector;
-                std::cin >> endSector;
-                std::cin.ignore();
-
-                if (startSector >= 0 && startSector < 16 &&
-                    endSector >= startSector && endSector < 16) {
-                    for (int sector = startSector; sector <= endSector; sector++) {
-                        AddCustomKey(sector, key, keyType);
-                    }
-                    std::cout << "✅ 已为扇区 " << startSector << " 到 " << endSector << " 添加密钥" << std::endl;
-
-                    std::stringstream rangeMsg;
-                    rangeMsg << "已将自定义密钥应用到扇区 " << startSector << " 到 " << endSector;
-                    logger.Log(rangeMsg.str(), 0);
-                }
-                else {
-                    std::cout << "❌ 无效的扇区范围!" << std::endl;
-                    logger.Log("无效的扇区范围: " + std::to_string(startSector) + " 到 " + std::to_string(endSector), 2);
-                }
-            }
-            else {
-                std::cout << "❌ 无效的选择，返回主菜单" << std::endl;
-                logger.Log("无效的扇区选择选项", 2);
+            sectorResult.authenticated = TryAuthenticateSector(uid, sectorResult.sector, sectorResult.keyType, key);
+            if (sectorResult.authenticated && key.size() == 6) {
+                std::copy(key.begin(), key.end(), sectorResult.key.begin());
             }
         }
-    }
-
-    std::cout << "\n✅ 密钥设置完成!" << std::endl;
-    logger.Log("密钥设置完成", 0);
-}
+        sectorResult.authUs = elapsedUs(authStart);
 
-void PN532::ReadCardAllDataWithMultipleKeys(const std::vector<unsigned char>& uid) {
-    std::cout << "\n=== 读取CUID卡数据 (多密钥尝试) ===" << std::endl;
-    std::cout << "卡UID: ";
-    for (auto byte : uid) {
-        printf("%02X ", byte);
-    }
-    std::cout << std::endl;
-
-    // 记录开始读取
-    std::stringstream startMsg;
-    startMsg << "开始读取卡片数据 - UID: ";
-    for (auto b : uid) {
-        startMsg << std::hex << std::setw(2) << std::setfill('0') << (int)b << " ";
-    }
-    logger.Log(startMsg.str(), 0);
-    logger.LogToFile("读取操作开始", 0);
-
-    int successfulSectors = 0;
-
-    // 尝试读取所有扇区 (0-15)
-    for (int sector = 0; sector < 16; sector++) {
-        uint8_t keyType;
-        std::vector<unsigned char> successfulKey;
-
-        std::cout << "\n尝试扇区 " << sector << "..." << std::endl;
-
-        if (TryAuthenticateSector(uid, sector, keyType, successfulKey)) {
-            successfulSectors++;
+        if (sectorResult.authenticated) {
+            image.SetSectorKey(sector, sectorResult.keyType, sectorResult.key.data());
+            if (imageCache) {
+                imageCache->StoreKey(image, sector);
+            }
 
-            // 认证成功，读取扇区数据
-            uint8_t sectorFirstBlock = sector * 4;
-            std::vector<std::vector<unsigned char>> blocks;  // 这里声明 blocks 变量
+            auto readStart = Clock::now();
 
-            // 读取扇区的所有4个块
-            for (int block = 0; block < 4; block++) {
-                uint8_t blockNumber = sectorFirstBlock + block;
-                std::vector<unsigned char> blockData;
+            // 读取扇区的所有块，每块读到即发出
+            for (int block = 0; block < sectorResult.blockCount; block++) {
+                int blockNumber = firstBlock + block;
+                if (image.IsKnown(blockNumber)) {
+                    emitKnown(sectorResult, blockNumber);
+                    continue;
+                }
 
-                if (MifareReadBlock(blockNumber, blockData)) {
-                    blocks.push_back(blockData);
-                    std::cout << "块 " << (int)blockNumber << ": ";
-                    for (auto byte : blockData) {
-                        printf("%02X ", byte);
-                    }
-                    std::cout << std::endl;
+                BlockResult blockResult;
+                blockResult.sector = sectorResult.sector;
+                blockResult.block = static_cast<uint8_t>(blockNumber);
+                blockResult.keyType = sectorResult.keyType;
+                blockResult.key = sectorResult.key;
+
+                auto blockStart = Clock::now();
+                bool ok = MifareReadBlock(blockResult.block, image);
+                blockResult.readUs = elapsedUs(blockStart);
+                blockResult.offsetMs = elapsedUs(dumpStart) / 1000;
+                blockResult.result = lastResult;
+                if (ok) {
+                    blockResult.data = image.Block(blockNumber);
                 }
-                else {
-                    std::cout << "读取块 " << (int)blockNumber << " 失败!" << std::endl;
+                consumer.OnBlock(blockResult);
+
+                if (!ok) {
+                    Notify(EventLevel::Error, "读取块 " + std::to_string(blockNumber) + " 失败!");
                     break;
                 }
-
-                std::this_thread::sleep_for(std::chrono::milliseconds(50));
-            }
-
-            // 这里可以安全使用 blocks，因为它在上面已经声明了
-            if (blocks.size() == 4) {
-                // 记录扇区数据到日志文件
-                std::stringstream keyInfo;
-                keyInfo << (keyType == 0x60 ? "Key A " : "Key B ");
-                for (auto k : successfulKey) {
-                    keyInfo << std::hex << std::setw(2) << std::setfill('0') << (int)k << " ";
+                if (imageCache) {
+                    imageCache->StoreBlock(image, blockNumber);
                 }
+                sectorResult.blocks[sectorResult.blocksRead++] = blockResult.data;
 
-                logger.LogSectorData(sector, blocks,
-                    (keyType == 0x60 ? "Key A" : "Key B"),
-                    keyInfo.str());
-
-                // 显示扇区数据
-                std::cout << "扇区 " << sector << " 数据:" << std::endl;
-                for (size_t i = 0; i < blocks.size(); i++) {
-                    std::cout << "  块 " << (sector * 4 + i) << ": ";
-
-                    // 如果是数据块，尝试解析为文本
-                    if (i < 3) {  // 前3个块是数据块
-                        // 显示十六进制
-                        for (auto byte : blocks[i]) {
-                            printf("%02X ", byte);
-                        }
-
-                        // 如果包含可打印字符，显示ASCII
-                        bool hasPrintable = false;
-                        for (auto byte : blocks[i]) {
-                            if (byte >= 32 && byte <= 126) {
-                                hasPrintable = true;
-                                break;
-                            }
-                        }
-
-                        if (hasPrintable) {
-                            std::cout << "  ASCII: ";
-                            for (auto byte : blocks[i]) {
-                                if (byte >= 32 && byte <= 126) {
-                                    std::cout << (char)byte;
-                                }
-                                else {
-                                    std::cout << ".";
-                                }
-                            }
-                        }
-                    }
-                    else {  // 第4个块是控制块
-                        std::cout << "[控制块] ";
-                        for (auto byte : blocks[i]) {
-                            printf("%02X ", byte);
-                        }
-
-                        // 解析控制块
-                        if (blocks[i].size() >= 16) {
-                            std::cout << "\n        Key A: ";
-                            for (int j = 0; j < 6; j++) printf("%02X ", blocks[i][j]);
-
-                            std::cout << "  Access Bits: ";
-                            for (int j = 6; j < 9; j++) printf("%02X ", blocks[i][j]);
-
-                            std::cout << "  Key B: ";
-                            for (int j = 10; j < 16; j++) printf("%02X ", blocks[i][j]);
-                        }
-                    }
-                    std::cout << std::endl;
-                }
+                Pause(50);
             }
+            sectorResult.readUs = elapsedUs(readStart);
         }
-        else {
-            std::cout << "扇区 " << sector << " 认证失败（可能密钥不同）" << std::endl;
+
+        sectorResult.result = lastResult;
+        if (sectorResult.Complete()) {
+            summary.completedSectors++;
         }
+        consumer.OnSector(sectorResult);
 
         // 扇区间延迟
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-
-    std::cout << "\n读取完成! 成功读取 " << successfulSectors << "/16 个扇区" << std::endl;
-
-    // 记录读取结果
-    std::stringstream resultMsg;
-    resultMsg << "读取完成 - 成功读取 " << successfulSectors << "/16 个扇区";
-    logger.Log(resultMsg.str(), 0);
-    logger.LogToFile("读取操作完成", 0);
-}
-
-void PN532::ReadCardDataInteractive(const std::vector<unsigned char>& uid) {
-    std::cout << "\n=== 读取卡片数据 ===" << std::endl;
-    std::cout << "卡UID: ";
-    for (auto byte : uid) {
-        printf("%02X ", byte);
+        Pause(100);
     }
-    std::cout << std::endl;
 
-    // 记录开始交互式读取
-    std::stringstream startMsg;
-    startMsg << "开始交互式读取卡片 - UID: ";
-    for (auto b : uid) {
-        startMsg << std::hex << std::setw(2) << std::setfill('0') << (int)b << " ";
+    // 读完整卡后不再保留，下次读取重新从卡片获取最新内容
+    if (imageCache && summary.completedSectors == image.SectorCount()) {
+        imageCache->Remove(uid);
     }
-    logger.Log(startMsg.str(), 0);
 
-    // 询问密钥选项
-    std::cout << "\n请选择密钥选项:" << std::endl;
-    std::cout << "1. 快速读取 (仅尝试默认密钥 FFFFFFFFFFFF)" << std::endl;
-    std::cout << "2. 高级读取 (可配置多个密钥)" << std::endl;
-    std::cout << "请选择 (1-2): ";
-
-    std::string choice;
-    std::getline(std::cin, choice);
+    summary.image = image;
+    summary.aborted = lastResult.IsAborted();
+    summary.lastResult = lastResult;
+    summary.elapsedMs = elapsedUs(dumpStart) / 1000;
+    consumer.OnDumpEnd(summary);
+    return summary.completedSectors;
+}
 
-    if (choice == "1") {
-        // 快速读取：使用默认密钥
-        std::cout << "\n使用默认密钥进行快速读取..." << std::endl;
-        logger.Log("用户选择快速读取模式", 0);
+void PN532::ReadCardAllDataWithMultipleKeys(const std::vector<unsigned char>& uid) {
+    PN532_TRACE_SPAN("ReadCardAllDataWithMultipleKeys", "workflow");
+    sink->OnDumpStarted("读取CUID卡数据 (多密钥尝试)", uid);
 
-        ClearAllKeys();
+    // 记录开始读取
+    logger.LogToFile("开始读取卡片数据 - UID: " + HexString(uid, true), 0);
+    logger.LogToFile("读取操作开始", 0);
 
-        // 添加默认密钥到所有扇区
-        for (int sector = 0; sector < 16; sector++) {
-            AddDefaultKeyA(sector);
-            AddDefaultKeyB(sector);
+    // 块和扇区读到即显示，不等整卡读完（回调在本线程执行，可以直接访问 image）
+    CardImage image;
+    CallbackDumpConsumer consumer;
+    consumer.onBlock = [this](const BlockResult& block) {
+        if (block.result.Ok()) {
+            sink->OnBlockRead(block.block, block.data);
+        }
+    };
+    consumer.onSector = [this, &image](const SectorResult& sector) {
+        if (sector.Complete()) {
+            // 记录扇区数据到日志文件
+            const char* keyName = sector.keyType == 0x60 ? "Key A" : "Key B";
+            logger.LogSectorData(sector.sector, image, keyName,
+                std::string(keyName) + " " + HexString(sector.key.data(), sector.key.size()));
+
+            sink->OnSectorRead(sector.sector, image);
+        }
+        else if (!sector.authenticated && !sector.result.IsAborted()) {
+            Notify(EventLevel::Warning, "扇区 " + std::to_string(sector.sector) + " 认证失败（可能密钥不同）");
         }
+    };
 
-        logger.Log("已为所有扇区设置默认密钥: FFFFFFFFFFFFF", 0);
-        ReadCardAllDataWithMultipleKeys(uid);
-    }
-    else if (choice == "2") {
-        // 高级读取：配置密钥
-        std::cout << "\n使用高级读取模式..." << std::endl;
-        logger.Log("用户选择高级读取模式", 0);
+    int successfulSectors = StreamCardData(uid, image, consumer);
 
-        SetupKeysFromUserInput();
-        ReadCardAllDataWithMultipleKeys(uid);
-    }
-    else {
-        std::cout << "无效选择，使用快速读取模式" << std::endl;
-        logger.Log("用户输入无效，默认使用快速读取模式", 1);  // WARN级别
-
-        // 默认使用快速读取
-        ClearAllKeys();
-        for (int sector = 0; sector < 16; sector++) {
-            AddDefaultKeyA(sector);
-            AddDefaultKeyB(sector);
-        }
+    sink->OnDumpFinished(successfulSectors, image.SectorCount());
 
-        logger.Log("已为所有扇区设置默认密钥: FFFFFFFFFFFFF", 0);
-        ReadCardAllDataWithMultipleKeys(uid);
-    }
+    // 记录读取结果
+    std::stringstream resultMsg;
+    resultMsg << "读取完成 - 成功读取 " << successfulSectors << "/" << image.SectorCount() << " 个扇区";
+    logger.LogToFile(resultMsg.str(), 0);
+    logger.LogToFile("读取操作完成", 0);
 }
 
-// 在 PN532.cpp 中添加以下函数实现：
-
 // 清空所有密钥
 void PN532::ClearAllKeys() {
     sectorKeys.clear();
     useDefaultKeysOnly = true;
-    std::cout << "已清空所有密钥配置" << std::endl;
+    Notify(EventLevel::Info, "已清空所有密钥配置");
 }
 
 // 添加默认Key A到指定扇区
 void PN532::AddDefaultKeyA(uint8_t sector) {
     if (sector >= 16) {
-        std::cerr << "无效的扇区号: " << (int)sector << std::endl;
-        logger.Log("添加默认Key A失败: 无效扇区号 " + std::to_string(sector), 2);
+        Report(EventLevel::Error, "添加默认Key A失败: 无效扇区号 " + std::to_string(sector));
         return;
     }
 
     std::vector<unsigned char> defaultKeyA = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
     AddCustomKey(sector, defaultKeyA, 0x60);
 
-    logger.Log("为扇区 " + std::to_string(sector) + " 添加默认Key A", 3);  // DEBUG级别
+    Report(EventLevel::Debug, "为扇区 " + std::to_string(sector) + " 添加默认Key A");
 }
 
 // 添加默认Key B到指定扇区
 void PN532::AddDefaultKeyB(uint8_t sector) {
     if (sector >= 16) {
-        std::cerr << "无效的扇区号: " << (int)sector << std::endl;
-        logger.Log("添加默认Key B失败: 无效扇区号 " + std::to_string(sector), 2);
+        Report(EventLevel::Error, "添加默认Key B失败: 无效扇区号 " + std::to_string(sector));
         return;
     }
 
     std::vector<unsigned char> defaultKeyB = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
     AddCustomKey(sector, defaultKeyB, 0x61);
 
-    logger.Log("为扇区 " + std::to_string(sector) + " 添加默认Key B", 3);  // DEBUG级别
+    Report(EventLevel::Debug, "为扇区 " + std::to_string(sector) + " 添加默认Key B");
 }
 
 // 添加自定义密钥到指定扇区
 void PN532::AddCustomKey(uint8_t sector, const std::vector<unsigned char>& key, uint8_t keyType) {
     if (sector >= 16) {
-        std::cerr << "无效的扇区号: " << (int)sector << std::endl;
-        logger.Log("添加自定义密钥失败: 无效扇区号 " + std::to_string(sector), 2);
+        Report(EventLevel::Error, "添加自定义密钥失败: 无效扇区号 " + std::to_string(sector));
         return;
     }
 
     if (key.size() != 6) {
-        std::cerr << "密钥必须是6字节! 实际长度: " << key.size() << std::endl;
-        logger.Log("添加自定义密钥失败: 密钥长度错误", 2);
+        Report(EventLevel::Error, "添加自定义密钥失败: 密钥必须是6字节! 实际长度: " + std::to_string(key.size()));
         return;
     }
 
     if (keyType != 0x60 && keyType != 0x61) {
-        std::cerr << "无效的密钥类型: " << std::hex << (int)keyType << std::dec << std::endl;
-        logger.Log("添加自定义密钥失败: 无效密钥类型", 2);
+        Report(EventLevel::Error, "添加自定义密钥失败: 无效密钥类型 " + HexString(&keyType, 1));
         return;
     }
 
@@ -1585,23 +1415,23 @@ void PN532::AddCustomKey(uint8_t sector, const std::vector<unsigned char>& key,
 
     // 记录密钥添加
     std::stringstream keyMsg;
-    keyMsg << "为扇区 " << sector << " 添加密钥: ";
+    keyMsg << "为扇区 " << (int)sector << " 添加密钥: ";
     keyMsg << (keyType == 0x60 ? "Key A " : "Key B ");
     for (auto k : key) {
         keyMsg << std::hex << std::setw(2) << std::setfill('0') << (int)k << " ";
     }
-    logger.Log(keyMsg.str(), 3);  // DEBUG级别
+    Report(EventLevel::Debug, keyMsg.str());
 }
 
 // 设置特殊密钥配置
 void PN532::SetupSpecialKeys() {
     ClearAllKeys();
 
-    std::cout << "\n=== 配置特殊密钥 ===" << std::endl;
-    logger.Log("开始配置特殊密钥", 0);
+    Notify(EventLevel::Info, "\n=== 配置特殊密钥 ===");
+    logger.LogToFile("开始配置特殊密钥", 0);
 
-    std::cout << "扇区1和2 (索引1-2): Key A/B = 112233446655" << std::endl;
-    std::cout << "其余扇区 (0,3-15): 使用默认密钥 FFFFFFFFFFFFF" << std::endl;
+    Notify(EventLevel::Info, "扇区1和2 (索引1-2): Key A/B = 112233446655\n"
+        "其余扇区 (0,3-15): 使用默认密钥 FFFFFFFFFFFFF");
 
     // 特殊密钥：112233446655
     std::vector<unsigned char> specialKey = { 0x11, 0x22, 0x33, 0x44, 0x66, 0x55 };
@@ -1617,7 +1447,7 @@ void PN532::SetupSpecialKeys() {
         AddCustomKey(sector, defaultKey, 0x61);
     }
 
-    logger.Log("已为所有扇区设置默认密钥: FFFFFFFFFFFFF", 0);
+    logger.LogToFile("已为所有扇区设置默认密钥: FFFFFFFFFFFFF", 0);
 
     // 特殊处理扇区1和2（索引1和2）
     for (int sector = 1; sector <= 2; sector++) {
@@ -1629,200 +1459,96 @@ void PN532::SetupSpecialKeys() {
         // 添加特殊密钥 Key B
         AddCustomKey(sector, specialKey, 0x61);
 
-        std::cout << "扇区 " << sector << " (第" << (sector + 1) << "扇区): 特殊密钥已设置" << std::endl;
-
-        std::stringstream sectorMsg;
-        sectorMsg << "扇区 " << sector << " 使用特殊密钥: 11 22 33 44 66 55";
-        logger.Log(sectorMsg.str(), 0);
+        Notify(EventLevel::Info, "扇区 " + std::to_string(sector) + " (第" + std::to_string(sector + 1) + "扇区): 特殊密钥已设置");
+        logger.LogToFile("扇区 " + std::to_string(sector) + " 使用特殊密钥: 11 22 33 44 66 55", 0);
     }
 
-    std::cout << "✅ 特殊密钥配置完成!" << std::endl;
-    std::cout << "  扇区1-2: 112233446655 (Key A & B)" << std::endl;
-    std::cout << "  其他扇区: FFFFFFFFFFFFF (Key A & B)" << std::endl;
+    Notify(EventLevel::Info, "✅ 特殊密钥配置完成!\n"
+        "  扇区1-2: 112233446655 (Key A & B)\n"
+        "  其他扇区: FFFFFFFFFFFFF (Key A & B)");
 
-    logger.Log("特殊密钥配置完成: 扇区1-2使用112233446655, 其他扇区使用FFFFFFFFFFFF", 0);
+    logger.LogToFile("特殊密钥配置完成: 扇区1-2使用112233446655, 其他扇区使用FFFFFFFFFFFF", 0);
 }
 
 // 使用特殊密钥读取卡片
 void PN532::ReadCardWithSpecialKeys(const std::vector<unsigned char>& uid) {
-    std::cout << "\n=== 使用特殊密钥读取卡片 ===" << std::endl;
-    std::cout << "特殊密钥配置:" << std::endl;
-    std::cout << "  扇区1和2: Key A/B = 112233446655" << std::endl;
-    std::cout << "  其他扇区: 默认密钥 FFFFFFFFFFFFF" << std::endl;
-    std::cout << "卡UID: ";
-    for (auto byte : uid) {
-        printf("%02X ", byte);
-    }
-    std::cout << std::endl;
+    sink->OnDumpStarted("使用特殊密钥读取卡片", uid);
+    Notify(EventLevel::Info, "特殊密钥配置:\n"
+        "  扇区1和2: Key A/B = 112233446655\n"
+        "  其他扇区: 默认密钥 FFFFFFFFFFFFF");
 
     // 记录开始读取
-    std::stringstream startMsg;
-    startMsg << "开始特殊密钥读取卡片 - UID: ";
-    for (auto b : uid) {
-        startMsg << std::hex << std::setw(2) << std::setfill('0') << (int)b << " ";
-    }
-    logger.Log(startMsg.str(), 0);
+    logger.LogToFile("开始特殊密钥读取卡片 - UID: " + HexString(uid, true), 0);
     logger.LogToFile("特殊密钥读取操作开始", 0);
 
     // 设置特殊密钥
     SetupSpecialKeys();
 
-    // 记录特殊密钥配置
-    logger.Log("特殊密钥配置完成: 扇区1-2使用112233446655, 其他扇区使用FFFFFFFFFFFF", 0);
-
     // 读取卡片数据
     int successfulSectors = 0;
+    CardImage image;
+    image.SetUid(uid);
 
     for (int sector = 0; sector < 16; sector++) {
+        if (CheckAborted("特殊密钥读取", successfulSectors, image.SectorCount())) {
+            break;
+        }
+
         uint8_t keyType;
         std::vector<unsigned char> successfulKey;
+        bool special = (sector == 1 || sector == 2);
 
-        std::cout << "\n尝试读取扇区 " << sector;
-        if (sector == 1 || sector == 2) {
-            std::cout << " (使用特殊密钥 112233446655)" << std::endl;
-            logger.Log("尝试扇区 " + std::to_string(sector) + " (使用特殊密钥 112233446655)", 3);
-        }
-        else {
-            std::cout << " (使用默认密钥 FFFFFFFFFFFFF)" << std::endl;
-            logger.Log("尝试扇区 " + std::to_string(sector) + " (使用默认密钥 FFFFFFFFFFFFF)", 3);
-        }
+        Report(EventLevel::Info, "\n尝试读取扇区 " + std::to_string(sector) +
+            (special ? " (使用特殊密钥 112233446655)" : " (使用默认密钥 FFFFFFFFFFFFF)"));
 
         if (TryAuthenticateSector(uid, sector, keyType, successfulKey)) {
             successfulSectors++;
 
             // 认证成功，读取扇区数据
             uint8_t sectorFirstBlock = sector * 4;
-
-            // 记录成功的认证
-            std::stringstream authMsg;
-            authMsg << "扇区 " << sector << " 认证成功 - 密钥: ";
-            authMsg << (keyType == 0x60 ? "Key A " : "Key B ");
-            for (auto k : successfulKey) {
-                authMsg << std::hex << std::setw(2) << std::setfill('0') << (int)k << " ";
-            }
-            logger.Log(authMsg.str(), 0);
+            image.SetSectorKey(sector, keyType, successfulKey.data());
 
             // 读取当前扇区的4个块
             for (int block = 0; block < 4; block++) {
                 uint8_t blockNumber = sectorFirstBlock + block;
-                std::vector<unsigned char> blockData;
-
-                if (MifareReadBlock(blockNumber, blockData)) {
-                    // 显示块数据
-                    std::cout << "  块" << block << ": ";
-                    for (auto b : blockData) {
-                        printf("%02X ", b);
-                    }
-
-                    // 记录块数据到日志文件
-                    std::stringstream blockMsg;
-                    blockMsg << "扇区 " << sector << " 块 " << block << ": ";
-                    for (auto b : blockData) {
-                        blockMsg << std::hex << std::setw(2) << std::setfill('0') << (int)b << " ";
-                    }
 
-                    // 如果是数据块（块0-2）且包含可打印字符，显示ASCII
-                    if (block < 3) {
-                        bool hasPrintable = false;
-                        for (auto b : blockData) {
-                            if (b >= 32 && b <= 126) {
-                                hasPrintable = true;
-                                break;
-                            }
-                        }
-
-                        if (hasPrintable) {
-                            std::cout << " ASCII: \"";
-                            for (auto b : blockData) {
-                                if (b >= 32 && b <= 126) {
-                                    std::cout << (char)b;
-                                }
-                                else if (b == 0) {
-                                    std::cout << " ";  // 空格代替空字符
-                                }
-                                else {
-                                    std::cout << ".";
-                                }
-                            }
-                            std::cout << "\"";
-
-                            // 记录ASCII到日志
-                            blockMsg << " ASCII: \"";
-                            for (auto b : blockData) {
-                                if (b >= 32 && b <= 126) {
-                                    blockMsg << (char)b;
-                                }
-                                else if (b == 0) {
-                                    blockMsg << " ";
-                                }
-                                else {
-                                    blockMsg << ".";
-                                }
-                            }
-                            blockMsg << "\"";
-                        }
-                    }
-                    else {
-                        // 控制块（块3）- 显示密钥信息
-                        std::cout << " [控制块]";
-                        if (blockData.size() >= 16) {
-                            std::cout << "\n        Key A: ";
-                            for (int i = 0; i < 6; i++) printf("%02X ", blockData[i]);
-                            std::cout << "\n        访问控制: ";
-                            for (int i = 6; i < 9; i++) printf("%02X ", blockData[i]);
-                            std::cout << "\n        Key B: ";
-                            for (int i = 10; i < 16; i++) printf("%02X ", blockData[i]);
-
-                            // 记录控制块信息到日志
-                            blockMsg << " [控制块] KeyA: ";
-                            for (int i = 0; i < 6; i++) {
-                                blockMsg << std::hex << std::setw(2) << std::setfill('0') << (int)blockData[i] << " ";
-                            }
-                            blockMsg << " Access: ";
-                            for (int i = 6; i < 9; i++) {
-                                blockMsg << std::hex << std::setw(2) << std::setfill('0') << (int)blockData[i] << " ";
-                            }
-                            blockMsg << " KeyB: ";
-                            for (int i = 10; i < 16; i++) {
-                                blockMsg << std::hex << std::setw(2) << std::setfill('0') << (int)blockData[i] << " ";
-                            }
-                        }
-                    }
-                    std::cout << std::endl;
-
-                    // 将块数据记录到文件
-                    logger.LogToFile(blockMsg.str(), 0);
+                if (MifareReadBlock(blockNumber, image)) {
+                    const CardBlock& blockData = image.Block(blockNumber);
+
+                    // 记录块数据到日志文件（数据块含可打印字符时附 ASCII，控制块拆出密钥和访问位）
+                    BlockLineStyle style;
+                    style.lowercase = true;
+                    style.trailerFields = true;
+                    char line[BlockFormatter::MAX_LINE_LENGTH];
+                    size_t length = BlockFormatter::Line(blockData.data(), CardImage::IsTrailer(blockNumber), line, style);
+                    logger.LogToFile("扇区 " + std::to_string(sector) + " 块 " + std::to_string(block) + ": " +
+                        std::string(line, length), 0);
                 }
                 else {
-                    std::cout << "  ❌ 读取块 " << block << " 失败" << std::endl;
-                    logger.Log("读取扇区 " + std::to_string(sector) + " 块 " + std::to_string(block) + " 失败", 2);
+                    Report(EventLevel::Error, "❌ 读取扇区 " + std::to_string(sector) + " 块 " + std::to_string(block) + " 失败");
                 }
 
-                std::this_thread::sleep_for(std::chrono::milliseconds(50));
-            }
-        }
-        else {
-            if (sector == 1 || sector == 2) {
-                std::cout << "  ❌ 扇区 " << sector << " 特殊密钥认证失败" << std::endl;
-                logger.Log("扇区 " + std::to_string(sector) + " 特殊密钥认证失败", 2);
+                Pause(50);
             }
-            else {
-                std::cout << "  ❌ 扇区 " << sector << " 默认密钥认证失败" << std::endl;
-                logger.Log("扇区 " + std::to_string(sector) + " 默认密钥认证失败", 2);
+
+            if (image.SectorKnown(sector)) {
+                sink->OnSectorRead(sector, image);
             }
         }
+        else if (!IsOperationAborted()) {
+            Report(EventLevel::Error, "❌ 扇区 " + std::to_string(sector) +
+                (special ? " 特殊密钥认证失败" : " 默认密钥认证失败"));
+        }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        Pause(100);
     }
 
-    std::cout << "\n=== 读取完成 ===" << std::endl;
-    std::cout << "成功读取: " << successfulSectors << "/16 个扇区" << std::endl;
-    std::cout << "按任意键继续..." << std::endl;
+    sink->OnDumpFinished(successfulSectors, 16);
 
     // 记录读取结果
     std::stringstream resultMsg;
     resultMsg << "特殊密钥读取完成 - 成功读取 " << successfulSectors << "/16 个扇区";
-    logger.Log(resultMsg.str(), 0);
+    logger.LogToFile(resultMsg.str(), 0);
     logger.LogToFile("特殊密钥读取操作完成", 0);
 }
 
@@ -1830,561 +1556,141 @@ void PN532::ReadCardWithSpecialKeys(const std::vector<unsigned char>& uid) {
 // 卡片写入功能
 // =================================================================
 
-// 交互式写入卡片
-void PN532::WriteCardInteractive(const std::vector<unsigned char>& uid) {
-    std::cout << "\n=== 交互式卡片写入 ===" << std::endl;
-    std::cout << "卡UID: ";
-    for (auto byte : uid) {
-        printf("%02X ", byte);
-    }
-    std::cout << std::endl;
-
-    // 认证扇区
-    int sector;
-    std::cout << "\n输入要写入的扇区号 (0-15): ";
-    std::cin >> sector;
-    std::cin.ignore();
-
-    if (sector < 0 || sector > 15) {
-        std::cout << "无效的扇区号!" << std::endl;
-        return;
-    }
-
-    uint8_t keyType;
-    std::vector<unsigned char> successfulKey;
-
-    if (!TryAuthenticateSector(uid, sector, keyType, successfulKey)) {
-        std::cout << "扇区认证失败，无法写入!" << std::endl;
-        return;
-    }
-
-    // 选择写入模式
-    std::cout << "\n选择写入模式:" << std::endl;
-    std::cout << "1. 写入文本数据" << std::endl;
-    std::cout << "2. 写入十六进制数据" << std::endl;
-    std::cout << "3. 修改密钥" << std::endl;
-    std::cout << "4. 清空扇区" << std::endl;
-    std::cout << "请选择 (1-4): ";
-
-    std::string choice;
-    std::getline(std::cin, choice);
-
-    if (choice == "1") {
-        WriteTextToCard(uid);
-    }
-    else if (choice == "2") {
-        int blockInput;
-        uint8_t controlBlock = sector * 4 + 3;
-        std::cout << "输入块号 (" << (sector * 4) << "-" << (sector * 4 + 2)
-            << "，块" << (int)controlBlock << "为控制块): ";
-        std::cin >> blockInput;
-        std::cin.ignore();
-
-        // 验证输入是否在范围内
-        if (blockInput < static_cast<int>(sector * 4) ||
-            blockInput > static_cast<int>(sector * 4 + 2)) {
-            std::cout << "无效的块号!" << std::endl;
-            std::cout << "扇区 " << sector << " 的有效数据块是: "
-                << (sector * 4) << ", " << (sector * 4 + 1) << ", "
-                << (sector * 4 + 2) << std::endl;
-            return;
-        }
-
-        uint8_t block = static_cast<uint8_t>(blockInput);
-
-        // 输入十六进制数据
-        std::cout << "输入16字节十六进制数据 (空格分隔，例如: 01 02 03 ...): ";
-        std::string hexInput;
-        std::getline(std::cin, hexInput);
-
-        // 解析十六进制数据
-        std::vector<unsigned char> data;
-        std::stringstream ss(hexInput);
-        std::string byteStr;
-
-        while (ss >> byteStr) {
-            if (data.size() >= 16) break;
-            unsigned char byte = (unsigned char)std::strtoul(byteStr.c_str(), nullptr, 16);
-            data.push_back(byte);
-        }
-
-        // 填充到16字节
-        while (data.size() < 16) {
-            data.push_back(0x00);
-        }
-
-        // 写入数据
-        if (MifareWriteBlock(block, data)) {
-            std::cout << "✅ 数据写入成功!" << std::endl;
-
-            // 验证写入
-            std::vector<unsigned char> verifyData;
-            if (MifareReadBlock(block, verifyData)) {
-                std::cout << "验证读取: ";
-                for (auto b : verifyData) {
-                    printf("%02X ", b);
-                }
-                std::cout << std::endl;
-            }
-        }
-    }
-    else if (choice == "3") {
-        std::cout << "\n修改扇区 " << sector << " 密钥" << std::endl;
-
-        // 读取当前控制块
-        uint8_t controlBlock = sector * 4 + 3;
-        std::vector<unsigned char> currentData;
-        if (!MifareReadBlock(controlBlock, currentData)) {
-            std::cout << "无法读取当前控制块!" << std::endl;
-            return;
-        }
-
-        std::cout << "当前密钥A: ";
-        for (int i = 0; i < 6; i++) printf("%02X ", currentData[i]);
-        std::cout << std::endl;
-
-        std::cout << "当前访问位: ";
-        for (int i = 6; i < 9; i++) printf("%02X ", currentData[i]);
-        std::cout << std::endl;
-
-        std::cout << "当前密钥B: ";
-        for (int i = 10; i < 16; i++) printf("%02X ", currentData[i]);
-        std::cout << std::endl;
-
-        // 输入新密钥
-        std::cout << "\n输入新Key A (6字节十六进制，例如: FF FF FF FF FF FF): ";
-        std::string keyAStr;
-        std::getline(std::cin, keyAStr);
-
-        std::vector<unsigned char> keyA;
-        std::stringstream ssa(keyAStr);
-        std::string byteStr;
-
-        while (ssa >> byteStr && keyA.size() < 6) {
-            unsigned char byte = (unsigned char)std::strtoul(byteStr.c_str(), nullptr, 16);
-            keyA.push_back(byte);
-        }
-
-        if (keyA.size() != 6) {
-            std::cout << "Key A必须是6字节!" << std::endl;
-            return;
-        }
-
-        std::cout << "输入新Key B (6字节十六进制，或输入 'same' 使用Key A): ";
-        std::string keyBStr;
-        std::getline(std::cin, keyBStr);
-
-        std::vector<unsigned char> keyB;
-        if (keyBStr == "same" || keyBStr == "SAME") {
-            keyB = keyA;
-        }
-        else {
-            std::stringstream ssb(keyBStr);
-            while (ssb >> byteStr && keyB.size() < 6) {
-                unsigned char byte = (unsigned char)std::strtoul(byteStr.c_str(), nullptr, 16);
-                keyB.push_back(byte);
-            }
-
-            if (keyB.size() != 6) {
-                std::cout << "Key B必须是6字节!" << std::endl;
-                return;
-            }
-        }
+// 添加备份功能到 PN532 类
+// 备份文件按扇区追加：每个扇区读完后由后台线程打开文件、追加、关闭，
+// 文件写入与后续扇区的读取同时进行，卡片中途离开时文件里保留已读到的扇区。
+// 读完后另存一份同名的二进制转储（.pn532，见 CardDumpFile），供程序载入。
+// 设置了备份归档时只把镜像追加到归档
+bool PN532::BackupCardData(const std::vector<unsigned char>& uid, DumpSummary* result) {
+    PN532_TRACE_SPAN("BackupCardData", "workflow");
+    Notify(EventLevel::Info, "\n=== 卡片数据备份 ===\n正在备份所有扇区数据...");
 
-        // 保持原有访问控制位
-        std::vector<unsigned char> accessBits = { currentData[6], currentData[7], currentData[8], 0x00 };
+    auto now = std::chrono::system_clock::now();
+    auto now_time_t = std::chrono::system_clock::to_time_t(now);
 
-        if (ChangeSectorKeys(sector, keyA, keyB, accessBits)) {
-            std::cout << "✅ 密钥修改成功!" << std::endl;
-            std::cout << "新密钥已生效，请记住新密钥!" << std::endl;
+    DumpSummary summary;
+    if (backupArchive) {
+        CallbackDumpConsumer consumer;
+        consumer.onEnd = [&summary](const DumpSummary& dump) { summary = dump; };
+        CardImage image;
+        StreamCardData(uid, image, consumer);
+        if (result != nullptr) {
+            *result = summary;
         }
-    }
-    else if (choice == "4") {
-        std::cout << "清空扇区 " << sector << " (写入全0)" << std::endl;
-        std::cout << "按 Y 确认，其他键取消: ";
 
-        char ch = _getch();
-        if (ch != 'Y' && ch != 'y') {
-            std::cout << "操作取消" << std::endl;
-            return;
+        if (image.KnownBlockCount() == 0) {
+            Report(EventLevel::Error, "没有读到任何扇区，未写入备份归档");
+            return false;
         }
 
-        uint8_t startBlock = sector * 4;
-        std::vector<unsigned char> zeroData(16, 0x00);
-
-        bool success = true;
-        for (int i = 0; i < 4; i++) {
-            uint8_t block = startBlock + i;
-
-            // 跳过厂商块和控制块
-            if (block == 0 || i == 3) {
-                continue;
-            }
-
-            if (!MifareWriteBlock(block, zeroData)) {
-                success = false;
-                break;
-            }
+        PN532_TRACE_SPAN("写备份归档", "file");
+        if (!backupArchive->Append(image, static_cast<int64_t>(now_time_t))) {
+            Report(EventLevel::Error, "写入备份归档失败!");
+            return false;
         }
-
-        if (success) {
-            std::cout << "✅ 扇区清空成功!" << std::endl;
+        std::string count = std::to_string(backupArchive->History(uid).size());
+        if (image.Complete()) {
+            Report(EventLevel::Info, "✅ 备份完成! 已存入备份归档（该卡共 " + count + " 份备份）");
         }
         else {
-            std::cout << "❌ 扇区清空失败!" << std::endl;
-        }
-    }
-}
-
-// 写入文本到卡片
-void PN532::WriteTextToCard(const std::vector<unsigned char>& uid) {
-    std::cout << "\n=== 写入文本数据 ===" << std::endl;
-
-    int sector;
-    std::cout << "输入扇区号 (0-15): ";
-    std::cin >> sector;
-    std::cin.ignore();
-
-    if (sector < 0 || sector > 15) {
-        std::cout << "无效的扇区号!" << std::endl;
-        return;
-    }
-
-    int blockInput;
-    uint8_t controlBlock = sector * 4 + 3;  // 计算控制块号
-    std::cout << "输入块号 (" << (sector * 4) << "-" << (sector * 4 + 2)
-        << "，块" << (int)controlBlock << "为控制块): ";
-    std::cin >> blockInput;
-    std::cin.ignore();
-
-    if (blockInput < static_cast<int>(sector * 4) ||
-        blockInput > static_cast<int>(sector * 4 + 2)) {
-        std::cout << "无效的块号! 只能写入数据块(0-2)!" << std::endl;
-        std::cout << "扇区 " << sector << " 的有效数据块是: "
-            << (sector * 4) << ", " << (sector * 4 + 1) << ", "
-            << (sector * 4 + 2) << std::endl;
-        return;
-    }
-
-    uint8_t block = static_cast<uint8_t>(blockInput);
-
-    std::cout << "输入要写入的文本 (最多16个字符): ";
-    std::string text;
-    std::getline(std::cin, text);
-
-    // 将文本转换为16字节数据
-    std::vector<unsigned char> data(16, 0x00);
-    for (size_t i = 0; i < text.length() && i < 16; i++) {
-        data[i] = text[i];
-    }
-
-    // 添加结束符
-    if (text.length() < 16) {
-        data[text.length()] = 0x00;
-    }
-
-    std::cout << "准备写入的数据: ";
-    for (auto b : data) {
-        printf("%02X ", b);
-    }
-    std::cout << std::endl;
-
-    std::cout << "按 Y 确认写入，其他键取消: ";
-    char ch = _getch();
-    if (ch != 'Y' && ch != 'y') {
-        std::cout << "操作取消" << std::endl;
-        return;
-    }
-
-    if (MifareWriteBlock(block, data)) {
-        std::cout << "✅ 文本写入成功!" << std::endl;
-
-        // 验证写入
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        std::vector<unsigned char> verifyData;
-        if (MifareReadBlock(block, verifyData)) {
-            std::cout << "验证读取: ";
-            for (auto b : verifyData) {
-                if (b >= 32 && b <= 126) {
-                    std::cout << (char)b;
-                }
-                else if (b == 0) {
-                    std::cout << " ";
-                }
-                else {
-                    std::cout << ".";
-                }
-            }
-            std::cout << std::endl;
+            Report(EventLevel::Warning, "⚠️ 部分备份已存入备份归档（已读 " + std::to_string(image.KnownSectorCount()) +
+                "/" + std::to_string(image.SectorCount()) + " 个扇区）");
         }
+        return true;
     }
-}
-
-// 添加备份功能到 PN532 类
-void PN532::BackupCardData(const std::vector<unsigned char>& uid) {
-    std::cout << "\n=== 卡片数据备份 ===" << std::endl;
-    std::cout << "正在备份所有扇区数据..." << std::endl;
 
     // 生成备份文件名
-    auto now = std::chrono::system_clock::now();
-    auto now_time_t = std::chrono::system_clock::to_time_t(now);
     std::tm now_tm;
     localtime_s(&now_tm, &now_time_t);
 
     char filename[100];
     strftime(filename, sizeof(filename), "backup_%Y%m%d_%H%M%S.txt", &now_tm);
-
-    std::ofstream backupFile(filename);
-    if (!backupFile.is_open()) {
-        std::cout << "无法创建备份文件!" << std::endl;
-        return;
-    }
+    char dumpFilename[100];
+    strftime(dumpFilename, sizeof(dumpFilename), "backup_%Y%m%d_%H%M%S.pn532", &now_tm);
 
     // 写入备份头信息
-    backupFile << "PN532 NFC卡片备份" << std::endl;
-    backupFile << "时间: " << std::ctime(&now_time_t);
-    backupFile << "UID: ";
-    for (auto b : uid) {
-        backupFile << std::hex << std::setw(2) << std::setfill('0') << (int)b << " ";
-    }
-    backupFile << std::endl << std::endl;
-
-    // 备份所有扇区
-    for (int sector = 0; sector < 16; sector++) {
-        uint8_t keyType;
-        std::vector<unsigned char> successfulKey;
-
-        if (TryAuthenticateSector(uid, sector, keyType, successfulKey)) {
-            backupFile << "扇区 " << sector << " (认证成功)" << std::endl;
-
-            uint8_t sectorFirstBlock = sector * 4;
-            for (int block = 0; block < 4; block++) {
-                uint8_t blockNumber = sectorFirstBlock + block;
-                std::vector<unsigned char> blockData;
-
-                if (MifareReadBlock(blockNumber, blockData)) {
-                    backupFile << "  块 " << block << " (" << (int)blockNumber << "): ";
-                    for (auto b : blockData) {
-                        backupFile << std::hex << std::setw(2) << std::setfill('0') << (int)b << " ";
-                    }
-
-                    // 如果是数据块且包含可打印字符，添加ASCII表示
-                    if (block < 3) {
-                        bool hasPrintable = false;
-                        for (auto b : blockData) {
-                            if (b >= 32 && b <= 126) {
-                                hasPrintable = true;
-                                break;
-                            }
-                        }
-
-                        if (hasPrintable) {
-                            backupFile << "  ASCII: ";
-                            for (auto b : blockData) {
-                                if (b >= 32 && b <= 126) {
-                                    backupFile << (char)b;
-                                }
-                                else {
-                                    backupFile << ".";
-                                }
-                            }
-                        }
-                    }
-                    backupFile << std::endl;
-                }
-            }
-            backupFile << std::endl;
-        }
-        else {
-            backupFile << "扇区 " << sector << " (认证失败)" << std::endl << std::endl;
+    {
+        std::ofstream backupFile(filename);
+        if (!backupFile.is_open()) {
+            Report(EventLevel::Error, "无法创建备份文件!");
+            return false;
         }
-    }
-
-    backupFile.close();
-    std::cout << "✅ 备份完成! 文件: " << filename << std::endl;
-}
-
-// 特殊写入模式
-void PN532::SpecialWriteMode() {
-    std::cout << "\n=== 特殊写入模式 ===" << std::endl;
-    std::cout << "此模式使用特殊密钥配置:" << std::endl;
-    std::cout << "  扇区1和2: Key A/B = 112233446655" << std::endl;
-    std::cout << "  其他扇区: 默认密钥 FFFFFFFFFFFFF" << std::endl;
-    std::cout << "将向扇区1的块5和块6写入特定格式的数据" << std::endl;
-    std::cout << "\n请输入一个0~50000之间的整数: ";
-
-    int number;
-    std::cin >> number;
-    std::cin.ignore();
-
-    if (number < 0 || number > 50000) {
-        std::cout << "❌ 输入的数字必须在0~50000之间!" << std::endl;
-        return;
-    }
-
-    // 转换为8位十六进制字符串
-    std::stringstream ss;
-    ss << std::hex << std::setw(8) << std::setfill('0') << number;
-    std::string hexStr = ss.str();  // 8位十六进制字符串，例如：00000002
-
-    std::cout << "输入的整数: " << number << std::endl;
-    std::cout << "转换为8位十六进制: " << hexStr << std::endl;
-
-    // 分组：每2位一组，共4组
-    std::vector<std::string> groups;
-    for (int i = 0; i < 8; i += 2) {
-        groups.push_back(hexStr.substr(i, 2));
-    }
-
-    std::cout << "分组结果: ";
-    for (const auto& group : groups) {
-        std::cout << group << " ";
-    }
-    std::cout << std::endl;
-
-    // 倒序排列组，但组内顺序不变
-    std::reverse(groups.begin(), groups.end());
-
-    std::cout << "倒序后: ";
-    for (const auto& group : groups) {
-        std::cout << group << " ";
-    }
-    std::cout << std::endl;
-
-    // 计算校验码：原数组 + 校验码 = FF
-    std::vector<std::string> checksums;
-    for (const auto& group : groups) {
-        unsigned int value;
-        std::stringstream groupStream;
-        groupStream << std::hex << group;
-        groupStream >> value;
-
-        unsigned char checksum = 0xFF - static_cast<unsigned char>(value);
-        std::stringstream checksumStream;
-        checksumStream << std::hex << std::setw(2) << std::setfill('0')
-            << static_cast<int>(checksum);
-        checksums.push_back(checksumStream.str());
-    }
-
-    std::cout << "校验码: ";
-    for (const auto& checksum : checksums) {
-        std::cout << checksum << " ";
-    }
-    std::cout << std::endl;
-
-    // 按照原数据-校验码-原数据进行编组
-    std::vector<std::string> combined;
-
-    // 添加原数据（倒序后）
-    for (const auto& group : groups) {
-        combined.push_back(group);
-    }
-
-    // 添加校验码
-    for (const auto& checksum : checksums) {
-        combined.push_back(checksum);
-    }
-
-    // 再次添加原数据（倒序后）
-    for (const auto& group : groups) {
-        combined.push_back(group);
-    }
 
-    std::cout << "编组结果: ";
-    for (const auto& item : combined) {
-        std::cout << item << " ";
+        backupFile << "PN532 NFC卡片备份" << std::endl;
+        backupFile << "时间: " << std::ctime(&now_time_t);
+        backupFile << "UID: " << HexString(uid, true) << std::endl << std::endl;
     }
-    std::cout << std::endl;
 
-    // 转换为字节序列
-    std::vector<unsigned char> baseData;
-    for (const auto& item : combined) {
-        unsigned char byte = static_cast<unsigned char>(
-            std::strtoul(item.c_str(), nullptr, 16));
-        baseData.push_back(byte);
-    }
-
-    // 创建第一组数据：baseData + 01 FE 01 FE
-    std::vector<unsigned char> data1 = baseData;
-    data1.push_back(0x01);
-    data1.push_back(0xFE);
-    data1.push_back(0x01);
-    data1.push_back(0xFE);
-
-    // 创建第二组数据：baseData + 02 FD 02 FD
-    std::vector<unsigned char> data2 = baseData;
-    data2.push_back(0x02);
-    data2.push_back(0xFD);
-    data2.push_back(0x02);
-    data2.push_back(0xFD);
-
-    // 检测卡片
-    std::cout << "\n请放置卡片..." << std::endl;
+    bool fileError = false;
 
-    std::vector<unsigned char> uid;
-    while (!DetectNFC(uid)) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    }
+    CallbackDumpConsumer writer;
+    writer.onSector = [&filename, &fileError](const SectorResult& sector) {
+        // 中止导致的认证失败不写入，由结束时的说明代替
+        if (!sector.authenticated && sector.result.IsAborted()) {
+            return;
+        }
 
-    std::cout << "✅ 检测到卡片!" << std::endl;
-    std::cout << "卡UID: ";
-    for (auto b : uid) {
-        printf("%02X ", b);
-    }
-    std::cout << std::endl;
+        PN532_TRACE_SPAN_ARG("写备份文件", "file", "sector", sector.sector);
+        std::ofstream backupFile(filename, std::ios::app);
+        if (!backupFile.is_open()) {
+            fileError = true;
+            return;
+        }
 
-    // 设置特殊密钥
-    SetupSpecialKeys();
+        if (!sector.authenticated) {
+            backupFile << "扇区 " << (int)sector.sector << " (认证失败)" << std::endl << std::endl;
+            return;
+        }
 
-    // 认证扇区1
-    uint8_t keyType;
-    std::vector<unsigned char> successfulKey;
+        // 整个扇区格式化后一次写入（与 ArchiveExporter 的文本格式相同）
+        BlockLineStyle style;
+        style.lowercase = true;
+        std::string text = "扇区 " + std::to_string(sector.sector) + " (认证成功)\n";
+        char line[BlockFormatter::MAX_LINE_LENGTH];
+        for (int block = 0; block < sector.blocksRead; block++) {
+            int blockNumber = sector.FirstBlock() + block;
+            text += "  块 " + std::to_string(block) + " (" + std::to_string(blockNumber) + "): ";
+            text.append(line, BlockFormatter::Line(sector.blocks[block].data(), CardImage::IsTrailer(blockNumber), line, style));
+            text += '\n';
+        }
+        text += '\n';
+        backupFile << text;
+    };
+    writer.onEnd = [&filename, &summary](const DumpSummary& dump) {
+        summary = dump;
+        if (dump.aborted) {
+            std::ofstream backupFile(filename, std::ios::app);
+            backupFile << "备份未完成 (" << dump.lastResult.Describe() << ")，已完成 "
+                << dump.completedSectors << "/" << dump.totalSectors << " 个扇区" << std::endl;
+        }
+    };
 
-    std::cout << "\n正在认证扇区1..." << std::endl;
-    if (!TryAuthenticateSector(uid, 1, keyType, successfulKey)) {
-        std::cout << "❌ 扇区1认证失败!" << std::endl;
-        return;
+    {
+        QueuedDumpConsumer queued(writer);
+        CardImage image;
+        StreamCardData(uid, image, queued);
+        queued.Finish();
     }
-
-    std::cout << "✅ 扇区1认证成功!" << std::endl;
-
-    // 写入块5
-    std::cout << "\n正在写入扇区1块5..." << std::endl;
-    std::cout << "数据: ";
-    for (auto b : data1) {
-        printf("%02X ", b);
+    if (result != nullptr) {
+        *result = summary;
     }
-    std::cout << std::endl;
 
-    if (MifareWriteBlock(5, data1)) {
-        std::cout << "✅ 块5写入成功!" << std::endl;
-    }
-    else {
-        std::cout << "❌ 块5写入失败!" << std::endl;
-        return;
+    if (summary.image.KnownBlockCount() > 0 &&
+        !CardDumpFile::Save(dumpFilename, summary.image, static_cast<int64_t>(now_time_t))) {
+        Report(EventLevel::Error, std::string("写入二进制转储失败: ") + dumpFilename);
     }
 
-    // 等待一下
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-    // 写入块6
-    std::cout << "\n正在写入扇区1块6..." << std::endl;
-    std::cout << "数据: ";
-    for (auto b : data2) {
-        printf("%02X ", b);
+    if (fileError) {
+        Report(EventLevel::Error, std::string("写入备份文件失败: ") + filename);
+        return false;
     }
-    std::cout << std::endl;
-
-    if (MifareWriteBlock(6, data2)) {
-        std::cout << "✅ 块6写入成功!" << std::endl;
+    if (!summary.aborted) {
+        Report(EventLevel::Info, std::string("✅ 备份完成! 文件: ") + filename);
     }
     else {
-        std::cout << "❌ 块6写入失败!" << std::endl;
-        return;
+        Report(EventLevel::Warning, std::string("⚠️ 部分备份已保存: ") + filename);
     }
-
-    std::cout << "\n🎉 特殊写入模式完成!" << std::endl;
-    std::cout << "按任意键继续..." << std::endl;
+    return true;
 }
 
 // 记录卡片信息
@@ -2392,6 +1698,11 @@ void PN532::LogCardInfo(const std::vector<unsigned char>& uid, const std::string
     logger.LogCardInfo(uid, operation);
 }
 
+// 仅写入日志文件
+void PN532::LogToFile(const std::string& message, int level) {
+    logger.LogToFile(message, level);
+}
+
 void PN532::Close() {
     serial.Close();
 }
\ No newline at end of file
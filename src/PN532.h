@@ -1,6 +1,14 @@
 #pragma once
 #include "SerialPort.h"
 #include "Log.h"
+#include "CommandStats.h"
+#include "PN532Status.h"
+#include "CardEventSink.h"
+#include "Cancellation.h"
+#include "DumpConsumer.h"
+#include "PartialImageCache.h"
+#include "BackupArchive.h"
+#include "ReaderInfoCache.h"
 #include <vector>
 #include <string>
 #include <map>
@@ -14,6 +22,60 @@ private:
     // ־
     Logger logger;
 
+    // ¼ӵȨĬΪ NullCardEventSink
+    CardEventSink* sink;
+
+    // δ꾵Ļ棨ӵȨnullptr ʾ棩͵ǰѡеĿƬ
+    PartialImageCache* imageCache;
+    std::vector<unsigned char> selectedUid;
+    uint16_t selectedAtqa;
+    uint8_t selectedSak;
+
+    // ݹ鵵ӵȨnullptr ʾÿαдļ
+    BackupArchive* backupArchive;
+
+    // Ϣ棨ӵȨnullptr ʾÿѯ̼͵ǰϢ
+    ReaderInfoCache* infoCache;
+    ReaderInfo readerInfo;
+    bool readerInfoKnown;
+
+    // ¼Ϣ
+    void Notify(EventLevel level, const std::string& message);
+    // д־ļϢ
+    void Report(EventLevel level, const std::string& message);
+
+    // ӳͳ
+    CommandStatsRecorder stats;
+    int statsDumpIntervalSec;
+    std::chrono::steady_clock::time_point lastStatsDump;
+
+    // ʱͳд־
+    void MaybeDumpStats();
+
+    // һĽԲ
+    PN532Result lastResult;
+    RetryPolicy retryPolicy;
+
+    // ǰȡƺͽֹʱ
+    OperationContext operation;
+
+    // ɱȡ/ֹʱϵĵȴ
+    void Pause(int ms);
+    // ֹʱ¼ԭ򲢷 truewhat Ϊ
+    bool CheckAborted(const char* what, int completedSectors, int totalSectors);
+
+    // ȡӦͳһڣ
+    PN532Result Transceive(const std::vector<unsigned char>& command,
+        std::vector<unsigned char>& data, int waitMs);
+    PN532Result TransceiveWithRetry(const std::vector<unsigned char>& command,
+        std::vector<unsigned char>& data, int waitMs);
+    // ͺѯջյӦأ timeoutMswakeUp ʱ֡ǰ HSU ǰ
+    PN532Result TransceivePolled(const std::vector<unsigned char>& command,
+        std::vector<unsigned char>& data, int timeoutMs, bool wakeUp);
+
+    // 򿪴ںȶѡSAM áûлʱѯ̶̼ȴ
+    bool WaitReady(const std::string& port, int timeoutMs);
+
     // ô
     std::vector<std::string> DetectAvailablePorts();
 
@@ -26,6 +88,12 @@ private:
     static constexpr unsigned char STARTCODE2 = 0xFF;
     static constexpr unsigned char POSTAMBLE = 0x00;
 
+    // HSU ǰ0x55 ֮һ 0x00ôڵ͹״̬ģͬ
+    static constexpr unsigned char HSU_WAKEUP[16] = { 0x55, 0x55, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    static constexpr int READY_TIMEOUT_MS = 1000;  // Ľֹʱ䣨ϵģͨʮӦ
+    static constexpr int READY_ATTEMPT_MS = 40;    // ÿλѳԵȴӦʱ
+
     static constexpr unsigned char HOSTTOPN532 = 0xD4;
     static constexpr unsigned char PN532TOHOST = 0xD5;
 
@@ -48,12 +116,6 @@ private:
     std::map<int, std::vector<unsigned char>> sectorKeys;  //  -> Կб
     bool useDefaultKeysOnly;
 
-    // ԿԺ
-    bool TryAuthenticateSector(const std::vector<unsigned char>& uid,
-        uint8_t sector,
-        uint8_t& successfulKeyType,
-        std::vector<unsigned char>& successfulKey);
-
     // Уͼ
     unsigned char CalculateChecksum(const std::vector<unsigned char>& data);
 
@@ -71,14 +133,49 @@ public:
     // ر
     void Close();
 
-    // дģʽ
-    void SpecialWriteMode();
+    // ¼nullptr ʾ
+    void SetEventSink(CardEventSink* eventSink);
+    CardEventSink& GetEventSink() const;
+
+    // δ꾵Ļ棺ͬһſƬٴζȡʱֻȱٵ
+    void SetImageCache(PartialImageCache* cache);
+    PartialImageCache* GetImageCache() const;
+
+    // ñݹ鵵׷ӵ鵵ɵļ
+    void SetBackupArchive(BackupArchive* archive);
+    BackupArchive* GetBackupArchive() const;
+
+    // öϢ棺ͬһ豸ٴʱ̼ѯ
+    void SetReaderInfoCache(ReaderInfoCache* cache);
+    // ǰĹ̼Ϣ֮ã
+    bool GetReaderInfo(ReaderInfo& info) const;
 
     // 
+    // Initialize 򿪴ڲȶ SAM ãڽֹʱûӦʱ false
     bool Initialize(const char* port = "", DWORD baud = CBR_115200);
     bool GetFirmwareVersion(std::vector<unsigned char>& version);
     bool SAMConfiguration();
     bool DetectNFC(std::vector<unsigned char>& uid);
+
+    // ·LinkWatchdog ʹã
+    // Ping ֻһ GetFirmwareVersionԡյӦأ
+    // Reconnect ´򿪴ڡѲط SAM ãԭѲڣUSB öٺ˱ţʱ̼Ӧҵ豸
+    // searchOtherPorts Ϊ false ʱֻԭڣȲ PortMonitor ʱռ²Ĵڣ
+    bool Ping();
+    bool Reconnect(bool searchOtherPorts = true);
+    const std::string& GetPort() const;
+
+    // Բ
+    const PN532Result& GetLastResult() const;
+    void SetRetryPolicy(const RetryPolicy& policy);
+    const RetryPolicy& GetRetryPolicy() const;
+
+    // ȡֹʱ䣺úÿǰ飬ֹʱ Cancelled/DeadlineExceeded
+    // д֮ͣ²ɵĲ
+    void SetOperationContext(const OperationContext& context);
+    void ClearOperationContext();
+    const OperationContext& GetOperationContext() const;
+    bool IsOperationAborted() const;
   
     // ȡ
     bool MifareAuthenticate(const std::vector<unsigned char>& uid,
@@ -86,37 +183,47 @@ public:
         uint8_t keyType = 0x60,
         const unsigned char* key = nullptr);
     bool MifareReadBlock(uint8_t blockNumber, std::vector<unsigned char>& data);
-    bool MifareReadSector(uint8_t sector, std::vector<std::vector<unsigned char>>& blocks);
+    bool MifareReadBlock(uint8_t blockNumber, CardImage& image);
+    bool MifareReadSector(uint8_t sector, CardImage& image);
     void ReadCardAllData(const std::vector<unsigned char>& uid);
     void ReadCardAllDataWithMultipleKeys(const std::vector<unsigned char>& uid);
-    void ReadCardDataInteractive(const std::vector<unsigned char>& uid);
     void ReadCardWithSpecialKeys(const std::vector<unsigned char>& uid);
 
+    // ʽȡÿһ顢ÿһ consumerȡ
+    // image ȡ image Ϊ
+    // ˾񻺴ʱϴжϴѻĿֱӽ
+    int StreamCardData(const std::vector<unsigned char>& uid, CardImage& image, DumpConsumer& consumer);
+
+    // γԸõԿ֤
+    bool TryAuthenticateSector(const std::vector<unsigned char>& uid,
+        uint8_t sector,
+        uint8_t& successfulKeyType,
+        std::vector<unsigned char>& successfulKey);
+
     // д빦
     bool MifareWriteBlock(uint8_t blockNumber, const std::vector<unsigned char>& data);
+    bool MifareWriteBlock(uint8_t blockNumber, const CardBlock& data);
     bool MifareWriteValueBlock(uint8_t blockNumber, int32_t value);
-    bool MifareWriteSector(uint8_t sector, const std::vector<std::vector<unsigned char>>& blocks);
+    // д޸ĹdirtyĿ飬̿飻дɹĿ޸ı
+    bool MifareWriteSector(uint8_t sector, CardImage& image);
     bool ChangeSectorKeys(uint8_t sector,
         const std::vector<unsigned char>& keyA,
         const std::vector<unsigned char>& keyB,
         const std::vector<unsigned char>& accessBits);
-    void WriteCardInteractive(const std::vector<unsigned char>& uid);
-    void WriteTextToCard(const std::vector<unsigned char>& uid);
 
     // ݹ
-    void BackupCardData(const std::vector<unsigned char>& uid);
+    // д루鵵ļֻвʱ trueresult ΪʱõζĻ
+    bool BackupCardData(const std::vector<unsigned char>& uid, DumpSummary* result = nullptr);
 
     // Կ
     void ClearAllKeys();
     void AddDefaultKeyA(uint8_t sector);
     void AddDefaultKeyB(uint8_t sector);
     void AddCustomKey(uint8_t sector, const std::vector<unsigned char>& key, uint8_t keyType);
-    void SetupKeysFromUserInput();
     void SetupSpecialKeys();
 
     // ʿλ
     std::vector<unsigned char> CalculateAccessBits(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3);
-    void DisplayAccessBits(uint8_t sector);
 
     // ־
     void EnableLogging(bool enable = true);
@@ -124,4 +231,27 @@ public:
     std::string GetLogFileName() const;
     void LogCardInfo(const std::vector<unsigned char>& uid, const std::string& operation);
     void LogToFile(const std::string& message, int level = 0);
-};
\ No newline at end of file
+
+    // ͳ
+    PN532Stats GetStats() const;
+    void ResetStats();
+    void DumpStats();
+    void SetStatsDumpInterval(int seconds);  // 0 ʾر
+};
+
+// Ϊ PN532 òԼ뿪ʱָԭ
+class ScopedOperationContext {
+private:
+    PN532& nfc;
+    OperationContext previous;
+
+public:
+    ScopedOperationContext(PN532& reader, const OperationContext& context)
+        : nfc(reader), previous(reader.GetOperationContext()) {
+        nfc.SetOperationContext(context);
+    }
+    ~ScopedOperationContext() { nfc.SetOperationContext(previous); }
+
+    ScopedOperationContext(const ScopedOperationContext&) = delete;
+    ScopedOperationContext& operator=(const ScopedOperationContext&) = delete;
+};
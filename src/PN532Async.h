@@ -0,0 +1,309 @@
+﻿#pragma once
+
+// 基于 C++20 协程的 PN532 异步接口
+// 在 SerialReactor 上把多步流程写成顺序代码，不需要每个读卡器一个线程：
+//
+//   CardTask<AsyncResult> ReadFirstBlock(AsyncReader& reader) {
+//       AsyncResult card = co_await reader.Detect();
+//       if (!card.result.Ok()) co_return card;
+//       co_await reader.Authenticate(card.data, 4, 0x60, key);
+//       co_return co_await reader.ReadBlock(4);
+//   }
+//   Spawn(ReadFirstBlock(reader), [](AsyncResult r) { ... });
+//
+// 协程在第一次发送命令前运行于调用线程，之后在反应器线程中恢复，不能调用阻塞接口。
+// 项目默认按 C++17 编译，此头文件只在 /std:c++20（-std=c++20）下生效。
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "SerialReactor.h"
+#include "CardImage.h"
+#include "Cancellation.h"
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 命令结果：data 为应答数据，Detect 返回 UID，ReadBlock 返回16字节块数据
+struct AsyncResult {
+    PN532Result result;
+    std::vector<unsigned char> data;
+};
+
+// 整卡读取结果
+struct AsyncCardDump {
+    int completedSectors = 0;
+    CardImage image;                                 // 读取失败的块 known 为 false
+    PN532Result lastResult;
+};
+
+// 惰性启动的协程任务，被 co_await 时才开始执行，结束后恢复等待者
+template <typename T>
+class CardTask {
+public:
+    struct promise_type {
+        T value{};
+        std::coroutine_handle<> continuation;
+
+        CardTask get_return_object() {
+            return CardTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                std::coroutine_handle<> next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void return_value(T result) { value = std::move(result); }
+        void unhandled_exception() { std::terminate(); }
+    };
+
+private:
+    std::coroutine_handle<promise_type> coroutine;
+
+    explicit CardTask(std::coroutine_handle<promise_type> h) : coroutine(h) {}
+
+public:
+    CardTask(CardTask&& other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) {}
+    CardTask& operator=(CardTask&& other) noexcept {
+        if (this != &other) {
+            if (coroutine) {
+                coroutine.destroy();
+            }
+            coroutine = std::exchange(other.coroutine, nullptr);
+        }
+        return *this;
+    }
+    CardTask(const CardTask&) = delete;
+    CardTask& operator=(const CardTask&) = delete;
+
+    ~CardTask() {
+        if (coroutine) {
+            coroutine.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        coroutine.promise().continuation = awaiting;
+        return coroutine;
+    }
+    T await_resume() { return std::move(coroutine.promise().value); }
+};
+
+// 无人等待的顶层协程，用于 Spawn
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// 启动任务，完成后在最后一次恢复它的线程上调用 done（T 只从 task 推导，done 可以直接传 lambda）
+template <typename T>
+DetachedTask Spawn(CardTask<T> task, std::function<void(std::type_identity_t<T>)> done = nullptr) {
+    T value = co_await task;
+    if (done) {
+        done(std::move(value));
+    }
+}
+
+// 单个读卡器的异步操作，命令经由 SerialReactor 发送
+class AsyncReader {
+private:
+    SerialReactor& reactor;
+    int port;
+    RetryPolicy retryPolicy;
+    OperationContext operation;
+
+    // co_await 一条命令：挂起直到反应器回调
+    struct ExchangeAwaitable {
+        SerialReactor& reactor;
+        int port;
+        std::vector<unsigned char> command;
+        int timeoutMs;
+        TransportError aborted;          // 操作已取消/超时时不发送，直接返回
+        AsyncResult outcome;
+
+        bool await_ready() const noexcept { return aborted != TransportError::None; }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            bool submitted = reactor.Exchange(port, command, timeoutMs,
+                [this, h](const PN532Result& result, const std::vector<unsigned char>& data) {
+                    outcome.result = result;
+                    outcome.data = data;
+                    h.resume();
+                });
+
+            if (!submitted) {
+                // 反应器未运行，不挂起
+                outcome.result = PN532Result::FromTransport(TransportError::NotConnected);
+                return false;
+            }
+            return true;
+        }
+
+        AsyncResult await_resume() {
+            if (aborted != TransportError::None) {
+                outcome.result = PN532Result::FromTransport(aborted);
+            }
+            return std::move(outcome);
+        }
+    };
+
+public:
+    AsyncReader(SerialReactor& serialReactor, int portId)
+        : reactor(serialReactor), port(portId) {}
+
+    void SetRetryPolicy(const RetryPolicy& policy) { retryPolicy = policy; }
+    // 取消令牌和截止时间，每条命令发出前检查
+    void SetOperationContext(const OperationContext& context) { operation = context; }
+    int Port() const { return port; }
+
+    // 发送一条命令（command 以 D4 开头）
+    ExchangeAwaitable Exchange(std::vector<unsigned char> command, int timeoutMs = 200) {
+        return ExchangeAwaitable{ reactor, port, std::move(command), timeoutMs, operation.Check(), {} };
+    }
+
+    // 按重试策略发送，只重试临时错误
+    CardTask<AsyncResult> ExchangeWithRetry(std::vector<unsigned char> command, int timeoutMs = 200) {
+        auto start = std::chrono::steady_clock::now();
+        for (int attempt = 0; ; attempt++) {
+            AsyncResult reply = co_await Exchange(command, timeoutMs + attempt * retryPolicy.backoffMs);
+            if (reply.result.Ok() || !retryPolicy.ShouldRetry(reply.result, attempt, start)) {
+                co_return reply;
+            }
+        }
+    }
+
+    CardTask<AsyncResult> SAMConfiguration() {
+        std::vector<unsigned char> command = { 0xD4, 0x14, 0x01, 0x14, 0x01 };
+        co_return co_await ExchangeWithRetry(std::move(command), 100);
+    }
+
+    // 检测卡片，成功时 data 为 UID；没有卡片时 result 成功但 data 为空
+    CardTask<AsyncResult> Detect() {
+        std::vector<unsigned char> command = { 0xD4, 0x4A, 0x01, 0x00 };
+        AsyncResult reply = co_await ExchangeWithRetry(std::move(command), 200);
+        AsyncResult card;
+        card.result = reply.result;
+        if (!reply.result.Ok() || (reply.data.size() >= 3 && reply.data[2] == 0)) {
+            co_return card;
+        }
+
+        // 应答: D5 4B 目标数 目标号 ATQA(2) SAK UID长度 UID...
+        unsigned char nfcidLength = reply.data.size() >= 8 ? reply.data[7] : 0;
+        if (nfcidLength == 0 || reply.data.size() < 8u + nfcidLength) {
+            card.result = PN532Result::FromTransport(TransportError::BadFrame);
+            co_return card;
+        }
+
+        card.data.assign(reply.data.begin() + 8, reply.data.begin() + 8 + nfcidLength);
+        co_return card;
+    }
+
+    CardTask<AsyncResult> Authenticate(std::vector<unsigned char> uid, uint8_t blockNumber,
+        uint8_t keyType, std::vector<unsigned char> key) {
+        std::vector<unsigned char> command = { 0xD4, 0x40, 0x01, keyType, blockNumber };
+        command.insert(command.end(), key.begin(), key.end());
+        command.insert(command.end(), uid.begin(), uid.end());
+        co_return co_await ExchangeWithRetry(std::move(command), 100);
+    }
+
+    CardTask<AsyncResult> ReadBlock(uint8_t blockNumber) {
+        std::vector<unsigned char> command = { 0xD4, 0x40, 0x01, 0x30, blockNumber };
+        AsyncResult reply = co_await ExchangeWithRetry(std::move(command), 100);
+        AsyncResult block;
+        block.result = reply.result;
+        if (reply.result.Ok()) {
+            if (reply.data.size() >= 19) {
+                block.data.assign(reply.data.begin() + 3, reply.data.begin() + 19);
+            }
+            else {
+                block.result = PN532Result::FromTransport(TransportError::UnexpectedResponse);
+            }
+        }
+        co_return block;
+    }
+
+    // 写入不自动重试（与 PN532::MifareWriteBlock 一致）；控制块需由调用者自行确认
+    CardTask<AsyncResult> WriteBlock(uint8_t blockNumber, std::vector<unsigned char> data) {
+        if (data.size() != 16) {
+            co_return AsyncResult{ PN532Result::FromTransport(TransportError::UnexpectedResponse), {} };
+        }
+        std::vector<unsigned char> command = { 0xD4, 0x40, 0x01, 0xA0, blockNumber };
+        command.insert(command.end(), data.begin(), data.end());
+        co_return co_await Exchange(std::move(command), 200);
+    }
+
+    // 依次尝试密钥（类型 + 6字节密钥）认证扇区，返回成功的密钥下标，-1 表示全部失败
+    CardTask<int> AuthenticateSector(std::vector<unsigned char> uid, uint8_t sector,
+        std::vector<std::pair<uint8_t, std::vector<unsigned char>>> keys) {
+        for (size_t i = 0; i < keys.size(); i++) {
+            AsyncResult auth = co_await Authenticate(uid, static_cast<uint8_t>(sector * 4), keys[i].first, keys[i].second);
+            if (auth.result.Ok()) {
+                co_return static_cast<int>(i);
+            }
+            // 密钥错误继续尝试下一个，其他永久错误立即放弃
+            if (auth.result.Class() == ErrorClass::Permanent && auth.result.status != 0x14) {
+                co_return -1;
+            }
+        }
+        co_return -1;
+    }
+
+    // 读取整卡（16扇区 × 4块）
+    CardTask<AsyncCardDump> Dump(std::vector<unsigned char> uid,
+        std::vector<std::pair<uint8_t, std::vector<unsigned char>>> keys) {
+        AsyncCardDump dump;
+        dump.image.SetUid(uid);
+
+        for (uint8_t sector = 0; sector < 16; sector++) {
+            // 中止时保留已读取的扇区
+            if (operation.Stopped()) {
+                dump.lastResult = PN532Result::FromTransport(operation.Check());
+                break;
+            }
+
+            int keyIndex = co_await AuthenticateSector(uid, sector, keys);
+            if (keyIndex < 0) {
+                continue;
+            }
+
+            bool sectorOk = true;
+            for (uint8_t block = 0; block < 4; block++) {
+                uint8_t blockNumber = static_cast<uint8_t>(sector * 4 + block);
+                AsyncResult read = co_await ReadBlock(blockNumber);
+                dump.lastResult = read.result;
+                if (!read.result.Ok()) {
+                    sectorOk = false;
+                    break;
+                }
+                if (read.data.size() >= 16) {
+                    dump.image.StoreRead(blockNumber, read.data.data());
+                }
+            }
+
+            if (sectorOk) {
+                dump.completedSectors++;
+            }
+        }
+        co_return dump;
+    }
+};
+
+#endif
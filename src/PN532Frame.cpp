@@ -0,0 +1,96 @@
+﻿#include "PN532Frame.h"
+
+unsigned char PN532Frame::CalculateChecksum(const std::vector<unsigned char>& data) {
+    unsigned char sum = 0;
+    for (auto byte : data) {
+        sum += byte;
+    }
+    return (0x100 - sum) & 0xFF;  // 低8位补数
+}
+
+std::vector<unsigned char> PN532Frame::BuildFrame(const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> frame;
+
+    // 添加前导码和起始码
+    frame.push_back(PREAMBLE);
+    frame.push_back(STARTCODE1);
+    frame.push_back(STARTCODE2);
+
+    // 数据长度和长度校验
+    unsigned char len = data.size();
+    unsigned char len_checksum = (0x100 - len) & 0xFF;
+
+    frame.push_back(len);
+    frame.push_back(len_checksum);
+
+    // 添加数据
+    for (auto byte : data) {
+        frame.push_back(byte);
+    }
+
+    // 计算数据校验和
+    unsigned char data_checksum = CalculateChecksum(data);
+    frame.push_back(data_checksum);
+
+    // 添加后导码
+    frame.push_back(POSTAMBLE);
+
+    return frame;
+}
+
+bool PN532Frame::ParseFrame(const std::vector<unsigned char>& response,
+    std::vector<unsigned char>& data) {
+    data.clear();
+
+    // 寻找有效的PN532帧
+    for (int i = 0; i < (int)response.size() - 5; i++) {
+        if (response[i] == 0x00 && response[i + 1] == 0xFF &&
+            (response[i + 4] == 0xD4 || response[i + 4] == 0xD5)) {
+
+            unsigned char len = response[i + 2];
+            unsigned char lcs = response[i + 3];
+
+            // 检查长度校验
+            if (((len + lcs) & 0xFF) != 0) continue;
+
+            // 检查数据长度
+            if (i + 4 + len + 1 >= response.size()) continue;
+
+            // 提取数据
+            for (int j = 0; j < len; j++) {
+                data.push_back(response[i + 4 + j]);
+            }
+
+            // 验证校验和
+            unsigned char received_checksum = response[i + 4 + len];
+            unsigned char calculated_checksum = CalculateChecksum(data);
+
+            if (received_checksum == calculated_checksum) {
+                return true;
+            }
+
+            data.clear();
+        }
+    }
+
+    return false;
+}
+
+PN532Result PN532Frame::CheckResponse(uint8_t commandCode, std::vector<unsigned char>& data) {
+    // 检查TFI和命令响应
+    if (data.size() < 2 || data[0] != 0xD5 || data[1] != commandCode + 1) {
+        data.clear();
+        return PN532Result::FromTransport(TransportError::UnexpectedResponse);
+    }
+
+    // InDataExchange 应答的第3字节是卡片操作状态
+    if (commandCode == 0x40) {
+        if (data.size() < 3) {
+            data.clear();
+            return PN532Result::FromTransport(TransportError::UnexpectedResponse);
+        }
+        return PN532Result::FromStatus(data[2]);
+    }
+
+    return PN532Result::Success();
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+﻿#pragma once
+#include "PN532Status.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// PN532 普通信息帧的构建与解析
+// 与串口无关，可单独编译（供 tools/bench_frame.cpp 基准测试使用）
+class PN532Frame {
+public:
+    static constexpr unsigned char PREAMBLE = 0x00;
+    static constexpr unsigned char STARTCODE1 = 0x00;
+    static constexpr unsigned char STARTCODE2 = 0xFF;
+    static constexpr unsigned char POSTAMBLE = 0x00;
+
+    // 普通帧最大数据长度（LEN为1字节），完整帧最长 255 + 7 = 262 字节
+    static constexpr size_t MAX_DATA_LENGTH = 255;
+    static constexpr size_t MAX_FRAME_LENGTH = MAX_DATA_LENGTH + 7;
+
+    // 校验和计算
+    static unsigned char CalculateChecksum(const std::vector<unsigned char>& data);
+
+    // 构建PN532帧
+    static std::vector<unsigned char> BuildFrame(const std::vector<unsigned char>& data);
+
+    // 解析PN532帧（在缓冲区中寻找第一个有效帧）
+    static bool ParseFrame(const std::vector<unsigned char>& response,
+        std::vector<unsigned char>& data);
+
+    // 检查已解析的应答（TFI、命令码+1、InDataExchange 状态字节），不符合时清空 data
+    static PN532Result CheckResponse(uint8_t commandCode, std::vector<unsigned char>& data);
+};
@@ -0,0 +1,175 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+// 传输层错误（与PN532状态字节相互独立）
+enum class TransportError {
+    None = 0,
+    NotConnected,        // 串口未打开
+    WriteFailed,         // 写串口失败
+    NoResponse,          // 超时未收到任何数据
+    BadFrame,            // 收到数据但没有有效帧
+    UnexpectedResponse,  // 帧有效但TFI/命令码不匹配或数据太短
+    Cancelled,           // 操作已被取消，命令未发送
+    DeadlineExceeded,    // 操作截止时间已到，命令未发送
+};
+
+// 错误类别：决定是否值得重试
+enum class ErrorClass {
+    None = 0,    // 成功
+    Transient,   // 瞬时错误（射频干扰、超时等），可重试
+    Permanent,   // 永久错误（密钥错误、访问被拒、卡片离开等），立即失败
+};
+
+// PN532 状态字节含义（UM0701 用户手册 表"Error code list"）
+inline const char* PN532StatusName(uint8_t code) {
+    switch (code) {
+    case 0x00: return "成功";
+    case 0x01: return "超时";
+    case 0x02: return "CRC错误";
+    case 0x03: return "奇偶校验错误";
+    case 0x04: return "防冲突位数错误";
+    case 0x05: return "Mifare帧错误";
+    case 0x06: return "位冲突";
+    case 0x07: return "通信缓冲区不足";
+    case 0x09: return "射频缓冲区溢出";
+    case 0x0A: return "射频场未及时打开";
+    case 0x0B: return "射频协议错误";
+    case 0x0D: return "芯片过热";
+    case 0x0E: return "内部缓冲区溢出";
+    case 0x10: return "参数无效";
+    case 0x12: return "DEP命令不支持";
+    case 0x13: return "数据格式不匹配";
+    case 0x14: return "认证失败(密钥错误)";
+    case 0x23: return "UID校验错误";
+    case 0x25: return "设备状态无效";
+    case 0x26: return "操作不允许(访问被拒)";
+    case 0x27: return "命令在当前状态不可用";
+    case 0x29: return "目标已被释放";
+    case 0x2A: return "卡片ID不匹配";
+    case 0x2B: return "卡片已离开";
+    case 0x2C: return "NFCID3不匹配";
+    case 0x2D: return "过流";
+    case 0x2E: return "缺少NAD";
+    default: return "未知错误";
+    }
+}
+
+inline const char* TransportErrorName(TransportError error) {
+    switch (error) {
+    case TransportError::None: return "无";
+    case TransportError::NotConnected: return "串口未连接";
+    case TransportError::WriteFailed: return "发送命令失败";
+    case TransportError::NoResponse: return "没有响应";
+    case TransportError::BadFrame: return "解析响应失败";
+    case TransportError::UnexpectedResponse: return "响应格式错误";
+    case TransportError::Cancelled: return "操作已取消";
+    case TransportError::DeadlineExceeded: return "操作超时";
+    default: return "未知传输错误";
+    }
+}
+
+// 一次PN532命令的结果：传输错误 + PN532状态字节
+struct PN532Result {
+    TransportError transport = TransportError::None;
+    uint8_t status = 0x00;
+
+    static PN532Result Success() { return PN532Result(); }
+
+    static PN532Result FromStatus(uint8_t code) {
+        PN532Result result;
+        result.status = code & 0x3F;  // 高两位为NAD/MI标志
+        return result;
+    }
+
+    static PN532Result FromTransport(TransportError error) {
+        PN532Result result;
+        result.transport = error;
+        return result;
+    }
+
+    bool Ok() const {
+        return transport == TransportError::None && status == 0x00;
+    }
+
+    bool IsTransportError() const {
+        return transport != TransportError::None;
+    }
+
+    // 因取消或超时而中止（不是读卡器或卡片的错误）
+    bool IsAborted() const {
+        return transport == TransportError::Cancelled || transport == TransportError::DeadlineExceeded;
+    }
+
+    ErrorClass Class() const {
+        if (Ok()) {
+            return ErrorClass::None;
+        }
+
+        switch (transport) {
+        case TransportError::None:
+            break;
+        case TransportError::NoResponse:
+        case TransportError::BadFrame:
+        case TransportError::UnexpectedResponse:
+            return ErrorClass::Transient;  // 串口噪声、应答未到齐或读到上一条命令的迟到应答
+        default:
+            return ErrorClass::Permanent;  // 串口不可用或操作已取消/超时，重试无意义
+        }
+
+        switch (status) {
+        case 0x01:  // 超时
+        case 0x02:  // CRC错误
+        case 0x03:  // 奇偶校验错误
+        case 0x04:  // 位数错误
+        case 0x05:  // 帧错误
+        case 0x06:  // 位冲突
+        case 0x09:  // 射频缓冲区溢出
+        case 0x0A:  // 射频场未及时打开
+        case 0x0B:  // 射频协议错误
+        case 0x0E:  // 内部缓冲区溢出
+            return ErrorClass::Transient;
+        default:
+            return ErrorClass::Permanent;
+        }
+    }
+
+    std::string Describe() const {
+        if (IsTransportError()) {
+            return TransportErrorName(transport);
+        }
+
+        std::stringstream ss;
+        ss << PN532StatusName(status) << " (0x" << std::hex << std::setw(2)
+            << std::setfill('0') << (int)status << ")";
+        return ss.str();
+    }
+};
+
+// 按错误类别重试：只重试瞬时错误，总次数和总时间都有上限
+struct RetryPolicy {
+    int maxAttempts = 3;     // 最多尝试次数（含第一次）
+    int budgetMs = 600;      // 总时间预算
+    int backoffMs = 50;      // 每次重试额外增加的等待时间
+
+    static RetryPolicy NoRetry() {
+        RetryPolicy policy;
+        policy.maxAttempts = 1;
+        return policy;
+    }
+
+    bool ShouldRetry(const PN532Result& result, int attempt,
+        std::chrono::steady_clock::time_point start) const {
+        if (result.Class() != ErrorClass::Transient) {
+            return false;
+        }
+        if (attempt + 1 >= maxAttempts) {
+            return false;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed < std::chrono::milliseconds(budgetMs);
+    }
+};
@@ -0,0 +1,98 @@
+﻿#include "PartialImageCache.h"
+#include <algorithm>
+
+PartialImageCache::PartialImageCache(size_t maxImages, int expirySeconds)
+    : capacity(maxImages > 0 ? maxImages : 1), expiry(expirySeconds) {
+}
+
+// 取得（必要时创建）image 对应的条目，调用者持有 cacheMutex
+PartialImageCache::Entry& PartialImageCache::Touch(const CardImage& image) {
+    std::vector<unsigned char> uid = image.Uid();
+    auto it = images.find(uid);
+    if (it == images.end() || it->second.image.Geometry() != image.Geometry()) {
+        if (it != images.end()) {
+            images.erase(it);
+        }
+        Prune();
+        it = images.emplace(uid, Entry(image.Geometry())).first;
+        it->second.image.SetUid(uid);
+    }
+    it->second.updated = std::chrono::steady_clock::now();
+    return it->second;
+}
+
+// 丢弃过期条目，仍然太多时丢弃最旧的（调用者持有 cacheMutex）
+void PartialImageCache::Prune() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = images.begin(); it != images.end();) {
+        if (now - it->second.updated > expiry) {
+            it = images.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    while (images.size() >= capacity) {
+        auto oldest = std::min_element(images.begin(), images.end(),
+            [](const auto& a, const auto& b) { return a.second.updated < b.second.updated; });
+        images.erase(oldest);
+    }
+}
+
+bool PartialImageCache::Find(const std::vector<unsigned char>& uid, CardImage& image) const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = images.find(uid);
+    if (it == images.end() || std::chrono::steady_clock::now() - it->second.updated > expiry) {
+        return false;
+    }
+    image = it->second.image;
+    return true;
+}
+
+void PartialImageCache::StoreBlock(const CardImage& image, int block) {
+    if (block < 0 || block >= image.BlockCount() || !image.IsKnown(block)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    Touch(image).image.StoreRead(block, image.Block(block).data());
+}
+
+void PartialImageCache::StoreKey(const CardImage& image, int sector) {
+    if (sector < 0 || sector >= image.SectorCount() || !image.SectorKey(sector).known) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    const SectorKeyInfo& key = image.SectorKey(sector);
+    Touch(image).image.SetSectorKey(sector, key.keyType, key.key.data());
+}
+
+void PartialImageCache::InvalidateBlock(const std::vector<unsigned char>& uid, int block) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = images.find(uid);
+    if (it == images.end()) {
+        return;
+    }
+
+    it->second.image.Forget(block);
+    if (CardImage::IsTrailer(block)) {
+        it->second.image.ForgetSectorKey(CardImage::SectorOfBlock(block));
+    }
+}
+
+void PartialImageCache::Remove(const std::vector<unsigned char>& uid) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    images.erase(uid);
+}
+
+void PartialImageCache::Clear() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    images.clear();
+}
+
+size_t PartialImageCache::Size() const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return images.size();
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+#include "CardImage.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// 按 UID 缓存未读完的卡片镜像
+// 卡片中途离开时保留已读到的块和成功的密钥，同一张卡片再次放上时读卡流程只补读缺少的部分。
+// 条目超过有效期或缓存已满时丢弃最旧的条目；读完整卡后由读卡流程移除。线程安全。
+class PartialImageCache {
+private:
+    struct Entry {
+        CardImage image;
+        std::chrono::steady_clock::time_point updated;
+
+        explicit Entry(CardGeometry geometry) : image(geometry) {}
+    };
+
+    mutable std::mutex cacheMutex;
+    std::map<std::vector<unsigned char>, Entry> images;
+    size_t capacity;
+    std::chrono::seconds expiry;
+
+    Entry& Touch(const CardImage& image);
+    void Prune();
+
+public:
+    // maxImages 为最多缓存的卡片数，expirySeconds 为条目有效期
+    explicit PartialImageCache(size_t maxImages = 32, int expirySeconds = 120);
+
+    // 查找未过期的镜像（复制到 image）
+    bool Find(const std::vector<unsigned char>& uid, CardImage& image) const;
+
+    // 从 image（须已设置 UID）复制一个已读到的块/扇区密钥
+    void StoreBlock(const CardImage& image, int block);
+    void StoreKey(const CardImage& image, int sector);
+
+    // 块被写入后作废缓存内容（控制块同时作废该扇区的密钥）
+    void InvalidateBlock(const std::vector<unsigned char>& uid, int block);
+
+    void Remove(const std::vector<unsigned char>& uid);
+    void Clear();
+    size_t Size() const;
+};
@@ -0,0 +1,188 @@
+﻿#include "PortMonitor.h"
+#include <dbt.h>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    const char* const WINDOW_CLASS = "PN532PortMonitor";
+    const UINT_PTR RESCAN_TIMER = 1;
+    const UINT RESCAN_DELAY_MS = 500;
+
+    // GUID_DEVINTERFACE_COMPORT（ntddser.h），在这里定义以免依赖 initguid
+    const GUID COMPORT_INTERFACE = { 0x86E0D1E0, 0x8089, 0x11D0, { 0x9C, 0xE4, 0x08, 0x00, 0x3E, 0x30, 0x1F, 0x73 } };
+}
+
+PortMonitor::PortMonitor(PortCallback callback, bool existing)
+    : onChange(std::move(callback)), reportExisting(existing), window(NULL), starting(false) {
+}
+
+PortMonitor::~PortMonitor() {
+    Stop();
+}
+
+bool PortMonitor::Start() {
+    if (worker.joinable()) {
+        return window != NULL;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        starting = true;
+    }
+    worker = std::thread([this]() { Run(); });
+
+    // 等窗口创建好（或失败）再返回，保证 Start 之后的插拔不会漏掉
+    std::unique_lock<std::mutex> lock(startMutex);
+    startCondition.wait(lock, [this]() { return !starting; });
+    if (window == NULL) {
+        lock.unlock();
+        worker.join();
+        return false;
+    }
+    return true;
+}
+
+void PortMonitor::Stop() {
+    HWND hwnd = window.exchange(NULL);
+    if (hwnd != NULL) {
+        PostMessageA(hwnd, WM_CLOSE, 0, 0);
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+std::vector<std::string> PortMonitor::ListPorts() {
+    std::vector<std::string> ports;
+
+    HKEY key;
+    if (RegOpenKeyExA(HKEY_LOCAL_MACHINE, "HARDWARE\\DEVICEMAP\\SERIALCOMM", 0, KEY_READ, &key) != ERROR_SUCCESS) {
+        return ports;  // 没有任何串口时这个键不存在
+    }
+
+    for (DWORD i = 0;; i++) {
+        char name[256];
+        DWORD nameLength = sizeof(name);
+        char value[64];
+        DWORD valueLength = sizeof(value) - 1;
+        DWORD type = 0;
+        LONG status = RegEnumValueA(key, i, name, &nameLength, NULL, &type,
+            reinterpret_cast<BYTE*>(value), &valueLength);
+        if (status == ERROR_NO_MORE_ITEMS) {
+            break;
+        }
+        if (status != ERROR_SUCCESS || type != REG_SZ || valueLength == 0) {
+            continue;
+        }
+
+        value[valueLength] = '\0';
+        ports.push_back(value);
+    }
+    RegCloseKey(key);
+
+    std::sort(ports.begin(), ports.end());
+    return ports;
+}
+
+// 与上次的列表比较，先报告拔出再报告插入（换读卡器时旧的先释放）
+void PortMonitor::Rescan() {
+    std::vector<std::string> current = ListPorts();
+
+    std::vector<std::string> removed;
+    std::vector<std::string> added;
+    std::set_difference(known.begin(), known.end(), current.begin(), current.end(), std::back_inserter(removed));
+    std::set_difference(current.begin(), current.end(), known.begin(), known.end(), std::back_inserter(added));
+    known.swap(current);
+
+    for (const auto& port : removed) {
+        onChange(port, false);
+    }
+    for (const auto& port : added) {
+        onChange(port, true);
+    }
+}
+
+LRESULT CALLBACK PortMonitor::WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message == WM_NCCREATE) {
+        const CREATESTRUCTA* create = reinterpret_cast<const CREATESTRUCTA*>(lParam);
+        SetWindowLongPtrA(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+    }
+
+    PortMonitor* monitor = reinterpret_cast<PortMonitor*>(GetWindowLongPtrA(hwnd, GWLP_USERDATA));
+    switch (message) {
+    case WM_DEVICECHANGE:
+        if (monitor != nullptr &&
+            (wParam == DBT_DEVICEARRIVAL || wParam == DBT_DEVICEREMOVECOMPLETE || wParam == DBT_DEVNODES_CHANGED)) {
+            monitor->Rescan();
+            SetTimer(hwnd, RESCAN_TIMER, RESCAN_DELAY_MS, NULL);
+        }
+        return TRUE;
+
+    case WM_TIMER:
+        if (wParam == RESCAN_TIMER) {
+            KillTimer(hwnd, RESCAN_TIMER);
+            if (monitor != nullptr) {
+                monitor->Rescan();
+            }
+        }
+        return 0;
+
+    case WM_CLOSE:
+        DestroyWindow(hwnd);
+        return 0;
+
+    case WM_DESTROY:
+        PostQuitMessage(0);
+        return 0;
+    }
+    return DefWindowProcA(hwnd, message, wParam, lParam);
+}
+
+void PortMonitor::Run() {
+    HINSTANCE instance = GetModuleHandleA(NULL);
+
+    WNDCLASSA windowClass = {};
+    windowClass.lpfnWndProc = WindowProc;
+    windowClass.hInstance = instance;
+    windowClass.lpszClassName = WINDOW_CLASS;
+    RegisterClassA(&windowClass);  // 已注册（第二个监视器）时失败，沿用已有的类
+
+    // 不可见的顶层窗口：HWND_MESSAGE 窗口收不到 DBT_DEVNODES_CHANGED 广播
+    HWND hwnd = CreateWindowExA(0, WINDOW_CLASS, "", 0, 0, 0, 0, 0, NULL, NULL, instance, this);
+
+    HDEVNOTIFY notification = NULL;
+    if (hwnd != NULL) {
+        DEV_BROADCAST_DEVICEINTERFACE_A filter = {};
+        filter.dbcc_size = sizeof(filter);
+        filter.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+        filter.dbcc_classguid = COMPORT_INTERFACE;
+        notification = RegisterDeviceNotificationA(hwnd, &filter, DEVICE_NOTIFY_WINDOW_HANDLE);
+        known = ListPorts();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(startMutex);
+        window = hwnd;
+        starting = false;
+    }
+    startCondition.notify_all();
+    if (hwnd == NULL) {
+        return;
+    }
+
+    if (reportExisting) {
+        for (const auto& port : known) {
+            onChange(port, true);
+        }
+    }
+
+    MSG message;
+    while (GetMessageA(&message, NULL, 0, 0) > 0) {
+        TranslateMessage(&message);
+        DispatchMessageA(&message);
+    }
+
+    if (notification != NULL) {
+        UnregisterDeviceNotification(notification);
+    }
+}
@@ -0,0 +1,51 @@
+﻿#pragma once
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 串口热插拔监视
+// 在独立线程上创建一个隐藏窗口，用 RegisterDeviceNotification 订阅串口设备接口（GUID_DEVINTERFACE_COMPORT），
+// 同时接收系统广播的 DBT_DEVNODES_CHANGED。收到设备变化后读取注册表 HARDWARE\DEVICEMAP\SERIALCOMM
+// 得到当前串口列表，与上一次比较得出插入和拔出的串口。
+// 读注册表不打开任何串口：不会打扰正在使用的读卡器，也不用像 SerialPort::GetAvailablePorts 那样逐个尝试 COM1-COM256。
+// 有的驱动在设备通知之后才写注册表，所以每次变化后 500ms 再比较一次。
+class PortMonitor {
+public:
+    // 在监视线程上调用：attached 为 true 表示插入，false 表示拔出
+    using PortCallback = std::function<void(const std::string& port, bool attached)>;
+
+private:
+    PortCallback onChange;
+    bool reportExisting;
+    std::thread worker;
+    std::atomic<HWND> window;
+    std::vector<std::string> known;  // 只在监视线程上使用
+
+    std::mutex startMutex;
+    std::condition_variable startCondition;
+    bool starting;
+
+    void Run();
+    void Rescan();
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
+
+public:
+    // existing 为 true 时，启动时已有的串口也按插入报告一次
+    explicit PortMonitor(PortCallback callback, bool existing = false);
+    ~PortMonitor();
+
+    PortMonitor(const PortMonitor&) = delete;
+    PortMonitor& operator=(const PortMonitor&) = delete;
+
+    // 启动监视线程；窗口创建失败（如没有窗口站的服务进程）时返回 false
+    bool Start();
+    void Stop();
+
+    // 当前系统中的串口（按名称排序）
+    static std::vector<std::string> ListPorts();
+};
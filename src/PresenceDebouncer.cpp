@@ -0,0 +1,43 @@
+﻿#include "PresenceDebouncer.h"
+
+PresenceDebouncer::PresenceDebouncer(int debounce, int failures)
+    : debounceCount(debounce), maxFailures(failures), detectCounter(0), consecutiveFailures(0), cardPresent(false) {
+}
+
+bool PresenceDebouncer::Update(bool detected, const std::vector<unsigned char>& uid, PresenceEvent& event) {
+    // 卡片在场时连续检测失败
+    if (!detected && cardPresent) {
+        consecutiveFailures++;
+        if (consecutiveFailures >= maxFailures) {
+            consecutiveFailures = 0;
+            event.type = PresenceEventType::DetectTrouble;
+            event.uid = cardUid;
+            return true;
+        }
+    }
+    else {
+        consecutiveFailures = 0;
+    }
+
+    if (detected == cardPresent) {
+        detectCounter = 0;
+        return false;
+    }
+
+    detectCounter++;
+    if (detectCounter < debounceCount) {
+        return false;
+    }
+
+    detectCounter = 0;
+    cardPresent = detected;
+    if (cardPresent) {
+        cardUid = uid;
+        event.type = PresenceEventType::CardArrived;
+    }
+    else {
+        event.type = PresenceEventType::CardRemoved;
+    }
+    event.uid = cardUid;
+    return true;
+}
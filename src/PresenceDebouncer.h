@@ -0,0 +1,39 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+
+// 防抖后的卡片在场事件
+enum class PresenceEventType {
+    CardArrived,    // 卡片从无到有，uid 为新卡片
+    CardRemoved,    // 卡片从有到无，uid 为移开的卡片
+    DetectTrouble,  // 卡片在场时检测连续失败
+    ReaderLost,     // 读卡器链路断开（看门狗正在重连）
+    ReaderRestored, // 读卡器已重新连接，durationMs 为断开时长
+};
+
+struct PresenceEvent {
+    PresenceEventType type = PresenceEventType::CardArrived;
+    std::vector<unsigned char> uid;
+    int64_t durationMs = 0;
+};
+
+// 在场检测防抖
+// 连续 debounceCount 次检测结果与当前状态不同才切换状态；卡片在场时连续 maxFailures 次检测失败报告一次异常。
+// 只在一个线程中使用（读卡器 I/O 线程）。
+class PresenceDebouncer {
+private:
+    int debounceCount;
+    int maxFailures;
+    int detectCounter;
+    int consecutiveFailures;
+    bool cardPresent;
+    std::vector<unsigned char> cardUid;
+
+public:
+    explicit PresenceDebouncer(int debounce = 2, int failures = 5);
+
+    // 输入一次检测结果，产生事件时返回 true
+    bool Update(bool detected, const std::vector<unsigned char>& uid, PresenceEvent& event);
+
+    bool CardPresent() const { return cardPresent; }
+};
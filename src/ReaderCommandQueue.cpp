@@ -0,0 +1,150 @@
+﻿#include "ReaderCommandQueue.h"
+#include "Trace.h"
+
+ReaderCommandQueue::ReaderCommandQueue(PN532& reader)
+    : nfc(reader), running(false), nextSequence(0), pollIntervalMs(0),
+    nextPoll(std::chrono::steady_clock::now()), watchdog(reader) {
+}
+
+ReaderCommandQueue::~ReaderCommandQueue() {
+    Stop();
+}
+
+void ReaderCommandQueue::Start() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    if (running) {
+        return;
+    }
+    running = true;
+    worker = std::thread([this]() { Run(); });
+}
+
+void ReaderCommandQueue::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    queueCondition.notify_all();
+
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void ReaderCommandQueue::Enqueue(CommandPriority priority, std::function<void(PN532&)> run) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        items.push({ priority, nextSequence++, std::move(run) });
+    }
+    queueCondition.notify_one();
+}
+
+void ReaderCommandQueue::SetPresencePolling(int intervalMs) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        pollIntervalMs = intervalMs < 0 ? 0 : intervalMs;
+    }
+    queueCondition.notify_one();
+}
+
+PresenceSample ReaderCommandQueue::GetPresence() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return presence;
+}
+
+void ReaderCommandQueue::SetPresenceListener(PresenceListener listener) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    presenceListener = std::move(listener);
+}
+
+void ReaderCommandQueue::RetryLinkNow() {
+    watchdog.RetryNow();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        nextPoll = std::chrono::steady_clock::now();
+    }
+    queueCondition.notify_one();
+}
+
+size_t ReaderCommandQueue::PendingCount() const {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return items.size();
+}
+
+void ReaderCommandQueue::Run() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+
+    while (true) {
+        // 排队的操作总是先于在场检测执行
+        if (!items.empty()) {
+            Item item = items.top();
+            items.pop();
+            lock.unlock();
+            {
+                PN532_TRACE_SPAN_ARG("队列命令", "queue", "priority", static_cast<int>(item.priority));
+                item.run(nfc);
+            }
+            lock.lock();
+            continue;
+        }
+
+        if (!running) {
+            break;
+        }
+
+        if (pollIntervalMs > 0) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= nextPoll) {
+                lock.unlock();
+                Poll();
+                lock.lock();
+                nextPoll = std::chrono::steady_clock::now() + std::chrono::milliseconds(pollIntervalMs);
+                continue;
+            }
+            queueCondition.wait_until(lock, nextPoll);
+        }
+        else {
+            queueCondition.wait(lock);
+        }
+    }
+}
+
+// 单次在场检测：只发一帧，不重试，避免挡住用户操作；链路断开时改为尝试重连
+void ReaderCommandQueue::Poll() {
+    PN532_TRACE_SPAN("在场检测", "queue");
+
+    std::vector<unsigned char> uid;
+    bool detected = false;
+    bool online = watchdog.Online() || watchdog.TryRecover();
+    if (online) {
+        RetryPolicy saved = nfc.GetRetryPolicy();
+        nfc.SetRetryPolicy(RetryPolicy::NoRetry());
+        detected = nfc.DetectNFC(uid);
+        nfc.SetRetryPolicy(saved);
+
+        online = watchdog.AfterPoll();
+        if (!online) {
+            detected = false;
+            uid.clear();
+        }
+    }
+
+    PresenceSample sample;
+    PresenceListener listener;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        presence.sequence++;
+        presence.detected = detected;
+        presence.uid = uid;
+        presence.readerOnline = online;
+        presence.lastOutageMs = watchdog.LastOutageMs();
+        sample = presence;
+        listener = presenceListener;
+    }
+    if (listener) {
+        listener(sample);
+    }
+}
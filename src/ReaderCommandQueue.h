@@ -0,0 +1,116 @@
+﻿#pragma once
+#include "PN532.h"
+#include "LinkWatchdog.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// 命令优先级：数值越大越先执行
+enum class CommandPriority {
+    Background = 0,   // 后台任务
+    Normal = 1,       // 普通读写/事务
+    Interactive = 2,  // 用户按键触发的操作
+};
+
+// 最近一次在场检测的结果
+struct PresenceSample {
+    uint64_t sequence;               // 每次检测递增，0 表示尚未检测
+    bool detected;
+    std::vector<unsigned char> uid;
+    bool readerOnline;               // 链路正常（断开时正在按退避间隔重连）
+    int64_t lastOutageMs;            // 最近一次链路断开到恢复的时长
+
+    PresenceSample() : sequence(0), detected(false), readerOnline(true), lastOutageMs(0) {}
+};
+
+// 单个读卡器的命令队列
+// 一个专用 I/O 线程独占 PN532 对象，其他线程通过 Submit 提交操作并拿到 future。
+// 队列空闲时按间隔做在场检测（只发一次 InListPassiveTarget，不重试），
+// 所以用户操作最多等待一次检测交换，而不是一整轮带重试的检测。
+// 在场检测同时由 LinkWatchdog 监视链路：链路断开时检测改为按退避间隔重连，恢复后照常检测。
+class ReaderCommandQueue {
+public:
+    // 每次在场检测后在 I/O 线程上调用（不持有队列锁，不能调用 Run 等待自己）
+    using PresenceListener = std::function<void(const PresenceSample& sample)>;
+
+private:
+    struct Item {
+        CommandPriority priority;
+        uint64_t sequence;
+        std::function<void(PN532&)> run;
+    };
+
+    struct ItemOrder {
+        bool operator()(const Item& a, const Item& b) const {
+            if (a.priority != b.priority) {
+                return a.priority < b.priority;
+            }
+            return a.sequence > b.sequence;  // 同优先级先进先出
+        }
+    };
+
+    PN532& nfc;
+    std::thread worker;
+    bool running;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::priority_queue<Item, std::vector<Item>, ItemOrder> items;
+    uint64_t nextSequence;
+
+    int pollIntervalMs;              // 0 表示不做在场检测
+    std::chrono::steady_clock::time_point nextPoll;
+    PresenceSample presence;
+    PresenceListener presenceListener;
+    LinkWatchdog watchdog;           // 只在 I/O 线程上使用
+
+    void Run();
+    void Poll();
+    void Enqueue(CommandPriority priority, std::function<void(PN532&)> run);
+
+public:
+    explicit ReaderCommandQueue(PN532& reader);
+    ~ReaderCommandQueue();
+
+    ReaderCommandQueue(const ReaderCommandQueue&) = delete;
+    ReaderCommandQueue& operator=(const ReaderCommandQueue&) = delete;
+
+    void Start();
+    // 停止 I/O 线程，已排队的操作仍会执行完
+    void Stop();
+
+    // 提交操作，在 I/O 线程上执行 fn(PN532&)，返回其结果的 future
+    template <typename F>
+    auto Submit(CommandPriority priority, F&& fn) -> std::future<decltype(fn(std::declval<PN532&>()))> {
+        using Result = decltype(fn(std::declval<PN532&>()));
+        auto task = std::make_shared<std::packaged_task<Result(PN532&)>>(std::forward<F>(fn));
+        std::future<Result> future = task->get_future();
+        Enqueue(priority, [task](PN532& reader) { (*task)(reader); });
+        return future;
+    }
+
+    // 提交并等待完成
+    template <typename F>
+    auto Run(CommandPriority priority, F&& fn) -> decltype(fn(std::declval<PN532&>())) {
+        return Submit(priority, std::forward<F>(fn)).get();
+    }
+
+    // 在场检测间隔（毫秒），0 表示关闭
+    void SetPresencePolling(int intervalMs);
+    PresenceSample GetPresence() const;
+    void SetPresenceListener(PresenceListener listener);
+
+    // 有新串口插入时调用（任意线程）：链路断开中的读卡器立即尝试重连，不等退避间隔
+    void RetryLinkNow();
+
+    size_t PendingCount() const;
+};
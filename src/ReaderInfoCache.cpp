@@ -0,0 +1,84 @@
+﻿#include "ReaderInfoCache.h"
+#include <cstdio>
+#include <fstream>
+
+bool ReaderInfoCache::Open(const std::string& filePath) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    path = filePath;
+    entries.clear();
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return true;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t tab = line.find('\t');
+        if (tab == 0 || tab == std::string::npos) {
+            continue;
+        }
+
+        unsigned int fields[4];
+        if (std::sscanf(line.c_str() + tab + 1, "%x %x %x %x", &fields[0], &fields[1], &fields[2], &fields[3]) != 4) {
+            continue;  // 损坏的行忽略，下次写回时丢掉
+        }
+
+        ReaderInfo info;
+        info.ic = static_cast<unsigned char>(fields[0]);
+        info.version = static_cast<unsigned char>(fields[1]);
+        info.revision = static_cast<unsigned char>(fields[2]);
+        info.support = static_cast<unsigned char>(fields[3]);
+        entries[line.substr(0, tab)] = info;
+    }
+    return true;
+}
+
+bool ReaderInfoCache::SaveLocked() const {
+    if (path.empty()) {
+        return false;
+    }
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    for (const auto& entry : entries) {
+        char fields[16];
+        std::snprintf(fields, sizeof(fields), "%02X %02X %02X %02X",
+            entry.second.ic, entry.second.version, entry.second.revision, entry.second.support);
+        file << entry.first << '\t' << fields << '\n';
+    }
+    return file.good();
+}
+
+bool ReaderInfoCache::Find(const std::string& deviceId, ReaderInfo& info) const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = entries.find(deviceId);
+    if (it == entries.end()) {
+        return false;
+    }
+    info = it->second;
+    return true;
+}
+
+void ReaderInfoCache::Store(const std::string& deviceId, const ReaderInfo& info) {
+    if (deviceId.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = entries.find(deviceId);
+    if (it != entries.end() && it->second.ic == info.ic && it->second.version == info.version &&
+        it->second.revision == info.revision && it->second.support == info.support) {
+        return;
+    }
+    entries[deviceId] = info;
+    SaveLocked();
+}
+
+size_t ReaderInfoCache::Size() const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return entries.size();
+}
@@ -0,0 +1,36 @@
+﻿#pragma once
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 读卡器信息（GetFirmwareVersion 应答的4个字节）
+struct ReaderInfo {
+    unsigned char ic = 0;        // 芯片型号（PN532 为 0x32）
+    unsigned char version = 0;
+    unsigned char revision = 0;
+    unsigned char support = 0;   // 支持的协议位图（ISO14443A/B、ISO18092）
+};
+
+// 按设备ID缓存读卡器信息
+// 同一个读卡器再次启动时直接使用缓存的固件信息，唤醒后只需完成 SAM 配置，省去固件查询。
+// 文本文件每行一个读卡器：设备ID<TAB>IC 版本 修订 功能（十六进制）。
+// 线程安全，读卡器池的各个线程可以共用一个。
+class ReaderInfoCache {
+private:
+    std::string path;
+    mutable std::mutex cacheMutex;
+    std::unordered_map<std::string, ReaderInfo> entries;
+
+    bool SaveLocked() const;
+
+public:
+    // 载入缓存文件；文件不存在时得到空缓存并返回 true
+    bool Open(const std::string& filePath);
+
+    bool Find(const std::string& deviceId, ReaderInfo& info) const;
+
+    // 保存一个读卡器的信息，与已有内容不同时写回文件
+    void Store(const std::string& deviceId, const ReaderInfo& info);
+
+    size_t Size() const;
+};
@@ -0,0 +1,438 @@
+﻿#include "ReaderPool.h"
+#include "LinkWatchdog.h"
+#include "PortMonitor.h"
+#include "Trace.h"
+#include <chrono>
+
+ReaderPool::ReaderPool()
+    : running(false), nextJobId(1), pollIntervalMs(100), debounceCount(2), hotPlug(false), hotPlugBaud(CBR_115200),
+    infoCache(nullptr) {
+}
+
+ReaderPool::~ReaderPool() {
+    Stop();
+}
+
+ReaderPool::Reader* ReaderPool::GetReader(int reader) const {
+    std::lock_guard<std::mutex> lock(readersMutex);
+    if (reader < 0 || reader >= static_cast<int>(readers.size())) {
+        return nullptr;
+    }
+    return readers[reader].get();
+}
+
+int ReaderPool::FindActiveReader(const std::string& port) const {
+    std::lock_guard<std::mutex> lock(readersMutex);
+    for (const auto& reader : readers) {
+        if (reader->active && reader->port == port) {
+            return reader->index;
+        }
+    }
+    return -1;
+}
+
+int ReaderPool::AddReader(const std::string& port, DWORD baud) {
+    return AttachReader(port, baud, false);
+}
+
+// probe 为 true 时先找探测失败留下的读卡器：等它的线程退出后沿用编号和 PN532 对象（串口已关闭）
+int ReaderPool::AttachReader(const std::string& port, DWORD baud, bool probe) {
+    std::lock_guard<std::mutex> lock(readersMutex);
+    Reader* r = nullptr;
+    if (probe) {
+        for (auto& reader : readers) {
+            if (reader->recyclable) {
+                r = reader.get();
+                break;
+            }
+        }
+    }
+
+    if (r != nullptr) {
+        // recyclable 是 ReaderLoop 最后设置的，线程已经或马上返回
+        if (r->worker.joinable()) {
+            r->worker.join();
+        }
+        r->recyclable = false;
+        r->port = port;
+        r->baudRate = baud;
+        r->online = false;
+        r->nfc->SetReaderInfoCache(infoCache);
+        std::lock_guard<std::mutex> jobLock(r->jobMutex);
+        r->active = true;
+    }
+    else {
+        auto reader = std::make_unique<Reader>();
+        reader->port = port;
+        reader->baudRate = baud;
+        reader->probe = probe;
+        reader->nfc = std::make_unique<PN532>();
+        reader->nfc->SetReaderInfoCache(infoCache);
+        reader->index = static_cast<int>(readers.size());
+        r = reader.get();
+        readers.push_back(std::move(reader));
+    }
+
+    if (running) {
+        r->worker = std::thread([this, r]() { ReaderLoop(*r); });
+    }
+    return r->index;
+}
+
+bool ReaderPool::RemoveReader(int reader) {
+    Reader* r = GetReader(reader);
+    if (r == nullptr) {
+        return false;
+    }
+    {
+        // 持锁清除，Submit 在同一把锁下检查 active，线程退出后不会再有任务排进来
+        std::lock_guard<std::mutex> lock(r->jobMutex);
+        if (!r->active) {
+            return false;
+        }
+        r->active = false;
+        r->jobCondition.notify_all();
+    }
+
+    if (r->worker.joinable() && r->worker.get_id() != std::this_thread::get_id()) {
+        r->worker.join();
+    }
+    return true;
+}
+
+bool ReaderPool::Start() {
+    std::lock_guard<std::mutex> lock(readersMutex);
+    if (running || readers.empty()) {
+        return false;
+    }
+
+    running = true;
+    for (auto& reader : readers) {
+        if (reader->active) {
+            Reader* r = reader.get();
+            r->worker = std::thread([this, r]() { ReaderLoop(*r); });
+        }
+    }
+    return true;
+}
+
+void ReaderPool::Stop() {
+    if (!running) {
+        return;
+    }
+
+    // 先停热插拔监视，之后不会再有读卡器加入或移除
+    DisableHotPlug();
+
+    running = false;
+    std::vector<Reader*> stopping;
+    {
+        std::lock_guard<std::mutex> lock(readersMutex);
+        for (auto& reader : readers) {
+            stopping.push_back(reader.get());
+        }
+    }
+
+    for (Reader* reader : stopping) {
+        // 持锁通知，避免读卡器线程在检查 running 与进入等待之间错过唤醒
+        std::lock_guard<std::mutex> lock(reader->jobMutex);
+        reader->jobCondition.notify_all();
+    }
+
+    // 不持有 readersMutex 等待：任务里可能还在调用 Submit 等方法
+    for (Reader* reader : stopping) {
+        if (reader->worker.joinable()) {
+            reader->worker.join();
+        }
+    }
+}
+
+bool ReaderPool::EnableHotPlug(DWORD baud) {
+    if (!running || portMonitor) {
+        return false;
+    }
+
+    hotPlugBaud = baud;
+    hotPlug = true;
+    portMonitor = std::make_unique<PortMonitor>(
+        [this](const std::string& port, bool attached) { OnPortChanged(port, attached); }, true);
+    if (!portMonitor->Start()) {
+        portMonitor.reset();
+        hotPlug = false;
+        return false;
+    }
+    return true;
+}
+
+void ReaderPool::DisableHotPlug() {
+    if (portMonitor) {
+        portMonitor->Stop();
+        portMonitor.reset();
+    }
+    hotPlug = false;
+}
+
+// 在 PortMonitor 线程上调用：新串口起一个读卡器线程探测（不是 PN532 时初始化失败，线程自行退出，
+// 编号留给下一次探测），拔出的串口对应的读卡器立即移除
+void ReaderPool::OnPortChanged(const std::string& port, bool attached) {
+    int existing = FindActiveReader(port);
+    if (attached) {
+        if (existing < 0 && running) {
+            AttachReader(port, hotPlugBaud, true);
+        }
+        return;
+    }
+
+    if (existing >= 0) {
+        RemoveReader(existing);
+    }
+}
+
+size_t ReaderPool::ReaderCount() const {
+    std::lock_guard<std::mutex> lock(readersMutex);
+    return readers.size();
+}
+
+bool ReaderPool::IsOnline(int reader) const {
+    Reader* r = GetReader(reader);
+    return r != nullptr && r->online;
+}
+
+uint64_t ReaderPool::Submit(int reader, ReaderJob job) {
+    Reader* r = GetReader(reader);
+    if (!running || !job || r == nullptr) {
+        return 0;
+    }
+
+    uint64_t jobId;
+    {
+        std::lock_guard<std::mutex> lock(r->jobMutex);
+        if (!r->active) {
+            return 0;
+        }
+        jobId = nextJobId++;
+        r->jobs.emplace_back(jobId, std::move(job));
+    }
+    r->jobCondition.notify_one();
+    return jobId;
+}
+
+bool ReaderPool::WaitEvent(ReaderEvent& event, int timeoutMs) {
+    std::unique_lock<std::mutex> lock(eventMutex);
+    if (!eventCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+        [this]() { return !events.empty(); })) {
+        return false;
+    }
+
+    event = std::move(events.front());
+    events.pop_front();
+    return true;
+}
+
+bool ReaderPool::PollEvent(ReaderEvent& event) {
+    std::lock_guard<std::mutex> lock(eventMutex);
+    if (events.empty()) {
+        return false;
+    }
+
+    event = std::move(events.front());
+    events.pop_front();
+    return true;
+}
+
+PN532Stats ReaderPool::GetReaderStats(int reader) const {
+    Reader* r = GetReader(reader);
+    if (r == nullptr) {
+        return PN532Stats();
+    }
+    return r->nfc->GetStats();
+}
+
+void ReaderPool::SetPollInterval(int ms) {
+    pollIntervalMs = ms < 1 ? 1 : ms;
+}
+
+void ReaderPool::SetReaderInfoCache(ReaderInfoCache* cache) {
+    std::lock_guard<std::mutex> lock(readersMutex);
+    infoCache = cache;
+}
+
+void ReaderPool::SetDebounceCount(int count) {
+    debounceCount = count < 1 ? 1 : count;
+}
+
+void ReaderPool::PushEvent(ReaderEvent&& event) {
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        events.push_back(std::move(event));
+    }
+    eventCondition.notify_one();
+}
+
+// 执行该读卡器上排队的任务（只在读卡器线程中调用）
+void ReaderPool::RunPendingJobs(Reader& reader, const std::vector<unsigned char>& uid) {
+    std::deque<std::pair<uint64_t, ReaderJob>> pending;
+    {
+        std::lock_guard<std::mutex> lock(reader.jobMutex);
+        pending.swap(reader.jobs);
+    }
+
+    for (auto& job : pending) {
+        PN532_TRACE_SPAN_ARGS("读卡器任务", "pool", "reader", reader.index, "job", job.first);
+
+        ReaderEvent event;
+        event.type = ReaderEvent::Type::JobCompleted;
+        event.reader = reader.index;
+        event.port = reader.port;
+        event.uid = uid;
+        event.jobId = job.first;
+        event.success = job.second(*reader.nfc, uid);
+        event.result = reader.nfc->GetLastResult();
+        PushEvent(std::move(event));
+    }
+}
+
+void ReaderPool::FailPendingJobs(Reader& reader, const std::string& message) {
+    std::deque<std::pair<uint64_t, ReaderJob>> pending;
+    {
+        std::lock_guard<std::mutex> lock(reader.jobMutex);
+        pending.swap(reader.jobs);
+    }
+
+    for (auto& job : pending) {
+        ReaderEvent event;
+        event.type = ReaderEvent::Type::JobCompleted;
+        event.reader = reader.index;
+        event.port = reader.port;
+        event.jobId = job.first;
+        event.success = false;
+        event.result = PN532Result::FromTransport(TransportError::NotConnected);
+        event.message = message;
+        PushEvent(std::move(event));
+    }
+}
+
+void ReaderPool::ReaderLoop(Reader& reader) {
+    PN532& nfc = *reader.nfc;
+
+    ReaderEvent status;
+    status.reader = reader.index;
+    status.port = reader.port;
+
+    // Initialize 唤醒读卡器并完成 SAM 配置，不是 PN532 或没有应答时在截止时间内失败
+    if (!nfc.Initialize(reader.port.c_str(), reader.baudRate)) {
+        status.type = ReaderEvent::Type::ReaderOffline;
+        status.result = nfc.GetLastResult();
+        status.message = "读卡器初始化失败";
+        PushEvent(std::move(status));
+        {
+            // 不再接受任务；热插拔时同一串口再次插入会重新探测
+            std::lock_guard<std::mutex> lock(reader.jobMutex);
+            reader.active = false;
+        }
+        FailPendingJobs(reader, "读卡器离线");
+        nfc.Close();
+        if (reader.probe) {
+            // 离线事件已在前面发出，之后接手这个编号的读卡器的上线事件一定排在它后面
+            reader.recyclable = true;
+        }
+        return;
+    }
+
+    reader.online = true;
+    status.type = ReaderEvent::Type::ReaderOnline;
+    PushEvent(ReaderEvent(status));
+
+    // 防抖：连续 debounceCount 次检测结果一致才认为状态改变
+    bool cardPresent = false;
+    int detectCounter = 0;
+    std::vector<unsigned char> stableUID;
+    // 热插拔开启时拔出的读卡器由 PortMonitor 移除，重连只试原串口，不去抢新插入的串口
+    WatchdogPolicy policy;
+    policy.searchOtherPorts = !hotPlug;
+    LinkWatchdog watchdog(nfc, policy);
+
+    while (running && reader.active) {
+        if (!watchdog.Online()) {
+            // 链路断开期间提交的任务直接失败，不等重连
+            FailPendingJobs(reader, "读卡器离线，正在重连");
+            if (watchdog.TryRecover()) {
+                reader.online = true;
+                ReaderEvent restored;
+                restored.type = ReaderEvent::Type::ReaderOnline;
+                restored.reader = reader.index;
+                restored.port = nfc.GetPort();
+                restored.message = "读卡器已重新连接";
+                PushEvent(std::move(restored));
+            }
+        }
+        else {
+            RunPendingJobs(reader, stableUID);
+
+            std::vector<unsigned char> uid;
+            bool currentDetect = nfc.DetectNFC(uid);
+            if (!watchdog.AfterPoll()) {
+                reader.online = false;
+                ReaderEvent lost;
+                lost.type = ReaderEvent::Type::ReaderOffline;
+                lost.reader = reader.index;
+                lost.port = reader.port;
+                lost.result = nfc.GetLastResult();
+                lost.message = "链路断开，正在重连";
+                PushEvent(std::move(lost));
+            }
+            else {
+                Debounce(reader, currentDetect, uid, cardPresent, detectCounter, stableUID);
+            }
+        }
+
+        // 等待下一次轮询，有新任务或停止时立即醒来
+        std::unique_lock<std::mutex> lock(reader.jobMutex);
+        reader.jobCondition.wait_for(lock, std::chrono::milliseconds(pollIntervalMs),
+            [this, &reader]() { return !running || !reader.active || !reader.jobs.empty(); });
+    }
+
+    bool removed = !reader.active;
+    FailPendingJobs(reader, removed ? "读卡器已移除" : "读卡器池已停止");
+    nfc.Close();
+    reader.online = false;
+
+    status.type = removed ? ReaderEvent::Type::ReaderRemoved : ReaderEvent::Type::ReaderOffline;
+    status.message = removed ? "读卡器已移除" : "读卡器池已停止";
+    PushEvent(std::move(status));
+}
+
+void ReaderPool::Debounce(Reader& reader, bool currentDetect, const std::vector<unsigned char>& uid,
+    bool& cardPresent, int& detectCounter, std::vector<unsigned char>& stableUID) {
+    PN532& nfc = *reader.nfc;
+
+    if (currentDetect == cardPresent && (!currentDetect || uid == stableUID)) {
+        detectCounter = 0;
+    }
+    else if (++detectCounter >= debounceCount) {
+        detectCounter = 0;
+
+        if (cardPresent) {
+            ReaderEvent removed;
+            removed.type = ReaderEvent::Type::CardRemoved;
+            removed.reader = reader.index;
+            removed.port = reader.port;
+            removed.uid = stableUID;
+            PushEvent(std::move(removed));
+            nfc.LogCardInfo(stableUID, "卡片移开");
+        }
+
+        cardPresent = currentDetect;
+        stableUID = uid;
+
+        if (cardPresent) {
+            ReaderEvent arrived;
+            arrived.type = ReaderEvent::Type::CardArrived;
+            arrived.reader = reader.index;
+            arrived.port = reader.port;
+            arrived.uid = stableUID;
+            PushEvent(std::move(arrived));
+            nfc.LogCardInfo(stableUID, "卡片放置");
+        }
+    }
+}
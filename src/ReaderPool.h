@@ -0,0 +1,139 @@
+﻿#pragma once
+#include "PN532.h"
+#include "PortMonitor.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 读卡器池事件
+struct ReaderEvent {
+    enum class Type {
+        ReaderOnline,   // 读卡器已就绪（串口打开、唤醒并完成 SAM 配置；断线后重连成功也会再发一次）
+        ReaderOffline,  // 初始化失败、链路断开（后台自动重连）或已停止
+        CardArrived,    // 卡片放置（已防抖）
+        CardRemoved,    // 卡片移开（已防抖）
+        JobCompleted,   // 提交的任务执行完毕
+        ReaderRemoved,  // 读卡器已移除（RemoveReader 或热插拔拔出），编号不再使用
+    };
+
+    Type type;
+    int reader;
+    std::string port;
+    std::vector<unsigned char> uid;  // 卡片事件/任务执行时的卡片 UID
+    uint64_t jobId;
+    bool success;
+    PN532Result result;              // 任务最后一条命令的结果
+    std::string message;
+
+    ReaderEvent() : type(Type::ReaderOffline), reader(-1), jobId(0), success(false) {}
+};
+
+// 在读卡器线程上执行的任务，uid 为当前稳定在场的卡片（无卡时为空）
+using ReaderJob = std::function<bool(PN532& nfc, const std::vector<unsigned char>& uid)>;
+
+// 多读卡器池
+// 每个读卡器独占一个 PN532 对象和一个 I/O 线程，串口操作互不阻塞：
+// 某个适配器卡住只会拖住它自己的线程，其他读卡器照常轮询和执行任务。
+// 所有读卡器的卡片事件和任务完成事件汇总到同一个队列，由调用者取出。
+// 运行中可以增删读卡器；EnableHotPlug 后插入的串口自动探测并加入，拔出的自动移除。
+// 读卡器编号不复用：移除后的编号一直无效，重新插入的读卡器得到新编号。
+// 例外是热插拔探测失败（不是 PN532）的编号：线程退出后留给下一次探测，反复插拔其他串口设备不会让读卡器越来越多。
+class ReaderPool {
+private:
+    struct Reader {
+        int index;
+        std::string port;
+        DWORD baudRate;
+        std::unique_ptr<PN532> nfc;
+        std::thread worker;
+        std::atomic<bool> online;
+        std::atomic<bool> active;    // 未被移除（在 jobMutex 下修改）
+        bool probe;                  // 热插拔探测加入，初始化失败时编号可复用
+        std::atomic<bool> recyclable;  // 探测失败且 I/O 线程即将退出，可由下一次探测接手
+
+        std::mutex jobMutex;
+        std::condition_variable jobCondition;
+        std::deque<std::pair<uint64_t, ReaderJob>> jobs;
+
+        Reader() : index(-1), baudRate(CBR_115200), online(false), active(true), probe(false), recyclable(false) {}
+    };
+
+    // 读卡器对象在池销毁前不释放，GetReader 返回的指针一直有效
+    std::vector<std::unique_ptr<Reader>> readers;
+    mutable std::mutex readersMutex;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> nextJobId;
+    std::atomic<int> pollIntervalMs;
+    std::atomic<int> debounceCount;
+
+    std::mutex eventMutex;
+    std::condition_variable eventCondition;
+    std::deque<ReaderEvent> events;
+
+    std::unique_ptr<PortMonitor> portMonitor;
+    std::atomic<bool> hotPlug;
+    DWORD hotPlugBaud;
+    ReaderInfoCache* infoCache;  // 新加入的读卡器共用（不拥有所有权）
+
+    Reader* GetReader(int reader) const;
+    int FindActiveReader(const std::string& port) const;
+    int AttachReader(const std::string& port, DWORD baud, bool probe);
+    void OnPortChanged(const std::string& port, bool attached);
+    void ReaderLoop(Reader& reader);
+    void RunPendingJobs(Reader& reader, const std::vector<unsigned char>& uid);
+    void Debounce(Reader& reader, bool currentDetect, const std::vector<unsigned char>& uid,
+        bool& cardPresent, int& detectCounter, std::vector<unsigned char>& stableUID);
+    void FailPendingJobs(Reader& reader, const std::string& message);
+    void PushEvent(ReaderEvent&& event);
+
+public:
+    ReaderPool();
+    ~ReaderPool();
+
+    ReaderPool(const ReaderPool&) = delete;
+    ReaderPool& operator=(const ReaderPool&) = delete;
+
+    // 添加读卡器，返回读卡器编号；池已启动时立即为它启动 I/O 线程
+    int AddReader(const std::string& port, DWORD baud = CBR_115200);
+
+    // 移除读卡器：未执行的任务以失败结束，等 I/O 线程退出并关闭串口后返回（不能在该读卡器的任务中调用）
+    bool RemoveReader(int reader);
+
+    // 为每个读卡器启动 I/O 线程（串口在各自线程中打开）
+    bool Start();
+
+    // 停止所有线程（包括热插拔监视），未执行的任务以失败结束
+    void Stop();
+
+    // 热插拔（Start 之后调用）：已有和之后插入的串口中没有对应读卡器的，按 baud 探测，是 PN532 就加入；
+    // 拔出的串口对应的读卡器立即移除。开启后新启动的读卡器断线重连只试自己的串口
+    bool EnableHotPlug(DWORD baud = CBR_115200);
+    void DisableHotPlug();
+
+    size_t ReaderCount() const;  // 包括已移除的编号
+    bool IsOnline(int reader) const;
+
+    // 提交任务到指定读卡器，返回任务编号（0 表示读卡器编号无效或池未启动）
+    uint64_t Submit(int reader, ReaderJob job);
+
+    // 取出事件：WaitEvent 最多等待 timeoutMs 毫秒，PollEvent 不等待
+    bool WaitEvent(ReaderEvent& event, int timeoutMs);
+    bool PollEvent(ReaderEvent& event);
+
+    // 单个读卡器的命令统计
+    PN532Stats GetReaderStats(int reader) const;
+
+    // 空闲时的卡片检测间隔和防抖次数
+    void SetPollInterval(int ms);
+    void SetDebounceCount(int count);
+
+    // 读卡器信息缓存：对之后添加的读卡器生效（在 AddReader 之前设置）
+    void SetReaderInfoCache(ReaderInfoCache* cache);
+};
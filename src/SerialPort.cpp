@@ -1,5 +1,9 @@
 #include "SerialPort.h"
-#include <iostream>
+#include <setupapi.h>
+#include <cfgmgr32.h>
+
+// GUID_DEVCLASS_PORTSdevguid.hﶨ initguid
+static const GUID PORTS_CLASS = { 0x4D36E978, 0xE325, 0x11CE, { 0xBF, 0xC1, 0x08, 0x00, 0x2B, 0xE1, 0x03, 0x18 } };
 
 SerialPort::SerialPort() : hSerial(NULL), connected(false) {
 }
@@ -8,7 +12,7 @@ SerialPort::~SerialPort() {
     Close();
 }
 
-bool SerialPort::Open(const char* portName, DWORD baudRate) {
+bool SerialPort::Open(const char* portName, DWORD baudRate, bool overlapped) {
     // ʽCOM3, COM4
     std::string port = "\\\\.\\" + std::string(portName);
 
@@ -19,13 +23,13 @@ bool SerialPort::Open(const char* portName, DWORD baudRate) {
         0,
         NULL,
         OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
+        overlapped ? FILE_FLAG_OVERLAPPED : FILE_ATTRIBUTE_NORMAL,
         NULL
     );
 
     if (hSerial == INVALID_HANDLE_VALUE) {
         DWORD error = GetLastError();
-        std::cerr << "򿪴ʧ! : " << error << std::endl;
+        lastError = "򿪴ʧ! : " + std::to_string(error);
         return false;
     }
 
@@ -34,7 +38,7 @@ bool SerialPort::Open(const char* portName, DWORD baudRate) {
     dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
 
     if (!GetCommState(hSerial, &dcbSerialParams)) {
-        std::cerr << "ȡ״̬ʧ!" << std::endl;
+        lastError = "ȡ״̬ʧ!";
         Close();
         return false;
     }
@@ -47,7 +51,7 @@ bool SerialPort::Open(const char* portName, DWORD baudRate) {
     dcbSerialParams.fDtrControl = DTR_CONTROL_ENABLE;
 
     if (!SetCommState(hSerial, &dcbSerialParams)) {
-        std::cerr << "ôڲʧ!" << std::endl;
+        lastError = "ôڲʧ!";
         Close();
         return false;
     }
@@ -60,14 +64,21 @@ bool SerialPort::Open(const char* portName, DWORD baudRate) {
     timeouts.WriteTotalTimeoutConstant = 50;   // д̶ʱ
     timeouts.WriteTotalTimeoutMultiplier = 10; // дܳʱ
 
+    if (overlapped) {
+        // صģʽأûʱһֱȴʱ SerialReactor Ľֹʱ
+        timeouts.ReadIntervalTimeout = MAXDWORD;
+        timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+        timeouts.ReadTotalTimeoutConstant = MAXDWORD - 1;
+    }
+
     if (!SetCommTimeouts(hSerial, &timeouts)) {
-        std::cerr << "óʱʧ!" << std::endl;
+        lastError = "óʱʧ!";
         Close();
         return false;
     }
 
     connected = true;
-    std::cout << " " << portName << " 򿪳ɹ!" << std::endl;
+    lastError.clear();
     return true;
 }
 
@@ -75,7 +86,6 @@ void SerialPort::Close() {
     if (connected) {
         connected = false;
         CloseHandle(hSerial);
-        std::cout << "ѹر" << std::endl;
     }
 }
 
@@ -101,10 +111,31 @@ bool SerialPort::WriteData(const char* buffer, unsigned int buf_size) {
     return (bytesWritten == buf_size);
 }
 
+int SerialPort::BytesAvailable() {
+    if (!connected || !ClearCommError(hSerial, &errors, &status)) {
+        return -1;
+    }
+    return static_cast<int>(status.cbInQue);
+}
+
+void SerialPort::PurgeInput() {
+    if (connected) {
+        PurgeComm(hSerial, PURGE_RXCLEAR | PURGE_RXABORT);
+    }
+}
+
 bool SerialPort::IsConnected() {
     return connected;
 }
 
+HANDLE SerialPort::GetHandle() const {
+    return hSerial;
+}
+
+std::string SerialPort::GetLastErrorMessage() const {
+    return lastError;
+}
+
 // ȡпô
 std::vector<std::string> SerialPort::GetAvailablePorts() {
     std::vector<std::string> ports;
@@ -153,4 +184,37 @@ bool SerialPort::PortExists(const std::string& portName) {
     }
 
     return false;
-}
\ No newline at end of file
+}
+
+// ڡ˿ڡ豸 PortName  portName 豸ʵID
+std::string SerialPort::GetDeviceId(const std::string& portName) {
+    HDEVINFO devices = SetupDiGetClassDevsA(&PORTS_CLASS, NULL, NULL, DIGCF_PRESENT);
+    if (devices == INVALID_HANDLE_VALUE) {
+        return "";
+    }
+
+    std::string deviceId;
+    SP_DEVINFO_DATA device = {};
+    device.cbSize = sizeof(device);
+    for (DWORD i = 0; deviceId.empty() && SetupDiEnumDeviceInfo(devices, i, &device); i++) {
+        HKEY key = SetupDiOpenDevRegKey(devices, &device, DICS_FLAG_GLOBAL, 0, DIREG_DEV, KEY_READ);
+        if (key == INVALID_HANDLE_VALUE) {
+            continue;
+        }
+
+        char name[32] = {};
+        DWORD size = sizeof(name) - 1;
+        DWORD type = 0;
+        bool match = RegQueryValueExA(key, "PortName", NULL, &type, reinterpret_cast<BYTE*>(name), &size) == ERROR_SUCCESS &&
+            type == REG_SZ && portName == name;
+        RegCloseKey(key);
+
+        char id[MAX_DEVICE_ID_LEN] = {};
+        if (match && SetupDiGetDeviceInstanceIdA(devices, &device, id, sizeof(id), NULL)) {
+            deviceId = id;
+        }
+    }
+
+    SetupDiDestroyDeviceInfoList(devices);
+    return deviceId;
+}
@@ -9,6 +9,7 @@ private:
     bool connected;
     COMSTAT status;
     DWORD errors;
+    std::string lastError;
 
 public:
     SerialPort();
@@ -20,8 +21,13 @@ public:
     // 鴮Ƿ
     static bool PortExists(const std::string& portName);
 
+    // 豸ʵIDUSB תоƬкʱ USB ڡںűҲ䣩Ҳʱؿ
+    static std::string GetDeviceId(const std::string& portName);
+
     // 򿪴
-    bool Open(const char* portName, DWORD baudRate = CBR_115200);
+    // overlapped Ϊ true ʱص I/O ʽ򿪣ֻܽ SerialReactor 
+    // ٵ ReadData/WriteData
+    bool Open(const char* portName, DWORD baudRate = CBR_115200, bool overlapped = false);
 
     // رմ
     void Close();
@@ -32,6 +38,19 @@ public:
     // д
     bool WriteData(const char* buffer, unsigned int buf_size);
 
+    // ջеֽȴʱ -1
+    // ֻôֽʱ ReadData أõȶȡʱ
+    int BytesAvailable();
+
+    // ջеľ
+    void PurgeInput();
+
     // ״̬
     bool IsConnected();
+
+    // ײ SerialReactor ɶ˿ڣ
+    HANDLE GetHandle() const;
+
+    // һʧܵԭ
+    std::string GetLastErrorMessage() const;
 };
\ No newline at end of file
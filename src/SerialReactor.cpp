@@ -0,0 +1,331 @@
+﻿#include "SerialReactor.h"
+#include "PN532Frame.h"
+#include "Trace.h"
+#include <cstring>
+
+SerialReactor::SerialReactor() : running(false) {
+    completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+}
+
+SerialReactor::~SerialReactor() {
+    Stop();
+    if (completionPort != NULL) {
+        CloseHandle(completionPort);
+    }
+}
+
+int SerialReactor::AddPort(const std::string& portName, DWORD baud) {
+    if (running || completionPort == NULL) {
+        return -1;
+    }
+
+    auto port = std::make_unique<Port>();
+    port->id = static_cast<int>(ports.size());
+    port->name = portName;
+    port->pendingIo = 0;
+    port->busy = false;
+    port->completed = false;
+    port->firstByte = false;
+    port->writeContext.kind = OpKind::Write;
+    port->writeContext.port = port.get();
+    port->readContext.kind = OpKind::Read;
+    port->readContext.port = port.get();
+
+    if (!port->serial.Open(portName.c_str(), baud, true)) {
+        return -1;
+    }
+
+    if (CreateIoCompletionPort(port->serial.GetHandle(), completionPort, KEY_IO, 0) == NULL) {
+        port->serial.Close();
+        return -1;
+    }
+
+    port->stats.SetPort(portName);
+    ports.push_back(std::move(port));
+    return ports.back()->id;
+}
+
+bool SerialReactor::Start() {
+    if (running || completionPort == NULL || ports.empty()) {
+        return false;
+    }
+
+    running = true;
+    worker = std::thread([this]() { Run(); });
+    return true;
+}
+
+void SerialReactor::Stop() {
+    if (!running) {
+        return;
+    }
+
+    running = false;
+    PostQueuedCompletionStatus(completionPort, 0, KEY_WAKE, NULL);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+size_t SerialReactor::PortCount() const {
+    return ports.size();
+}
+
+bool SerialReactor::Exchange(int portId, const std::vector<unsigned char>& command, int timeoutMs, Completion done) {
+    if (!running || portId < 0 || portId >= static_cast<int>(ports.size()) || command.size() < 2) {
+        return false;
+    }
+
+    Command cmd;
+    cmd.frame = PN532Frame::BuildFrame(command);
+    cmd.commandCode = command[1];
+    cmd.subCommand = (command[1] == 0x40 && command.size() > 3) ? command[3] : 0;
+    cmd.timeoutMs = timeoutMs;
+    cmd.done = std::move(done);
+
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        submitted.emplace_back(portId, std::move(cmd));
+    }
+    return PostQueuedCompletionStatus(completionPort, 0, KEY_WAKE, NULL) != FALSE;
+}
+
+PN532Stats SerialReactor::GetPortStats(int portId) const {
+    if (portId < 0 || portId >= static_cast<int>(ports.size())) {
+        return PN532Stats();
+    }
+    return ports[portId]->stats.Snapshot();
+}
+
+void SerialReactor::Run() {
+    while (running) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED* overlapped = NULL;
+        BOOL ok = GetQueuedCompletionStatus(completionPort, &bytes, &key, &overlapped, NextTimeoutMs());
+
+        if (overlapped == NULL) {
+            // 唤醒（新命令/停止）或等待超时
+            if (ok && key == KEY_WAKE) {
+                DrainSubmitted();
+            }
+        }
+        else {
+            IoContext* context = reinterpret_cast<IoContext*>(overlapped);
+            Port& port = *context->port;
+            port.pendingIo--;
+
+            if (context->kind == OpKind::Write) {
+                OnWriteComplete(port, ok, bytes);
+            }
+            else {
+                OnReadComplete(port, ok, bytes);
+            }
+            Settle(port);
+        }
+
+        CheckDeadlines();
+    }
+
+    // 停止：取消所有未完成的 I/O，等待完成包返回后再关闭串口
+    for (auto& port : ports) {
+        if (port->pendingIo > 0) {
+            CancelIoEx(port->serial.GetHandle(), NULL);
+        }
+    }
+
+    for (auto& port : ports) {
+        while (port->pendingIo > 0) {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = NULL;
+            GetQueuedCompletionStatus(completionPort, &bytes, &key, &overlapped, INFINITE);
+            if (overlapped != NULL) {
+                reinterpret_cast<IoContext*>(overlapped)->port->pendingIo--;
+            }
+        }
+    }
+
+    DrainSubmitted();
+    std::vector<unsigned char> empty;
+    PN532Result stopped = PN532Result::FromTransport(TransportError::NotConnected);
+    for (auto& port : ports) {
+        if (port->busy && !port->completed) {
+            Complete(*port, stopped, empty);
+        }
+        while (!port->queue.empty()) {
+            Command cmd = std::move(port->queue.front());
+            port->queue.pop_front();
+            if (cmd.done) {
+                cmd.done(stopped, empty);
+            }
+        }
+        port->busy = false;
+        port->serial.Close();
+    }
+}
+
+void SerialReactor::DrainSubmitted() {
+    std::vector<std::pair<int, Command>> batch;
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        batch.swap(submitted);
+    }
+
+    for (auto& item : batch) {
+        Port& port = *ports[item.first];
+        port.queue.push_back(std::move(item.second));
+        if (running) {
+            StartNext(port);
+        }
+    }
+}
+
+// 开始执行队列中的下一条命令
+void SerialReactor::StartNext(Port& port) {
+    if (port.busy || port.queue.empty()) {
+        return;
+    }
+
+    port.current = std::move(port.queue.front());
+    port.queue.pop_front();
+    port.busy = true;
+    port.completed = false;
+    port.firstByte = false;
+    port.response.clear();
+    port.deadline = Clock::now() + std::chrono::milliseconds(port.current.timeoutMs);
+    port.timer = std::make_unique<CommandTimer>(port.stats, port.current.commandCode, port.current.subCommand);
+
+    std::memset(&port.writeContext.overlapped, 0, sizeof(OVERLAPPED));
+    BOOL ok = WriteFile(port.serial.GetHandle(), port.current.frame.data(),
+        static_cast<DWORD>(port.current.frame.size()), NULL, &port.writeContext.overlapped);
+
+    // 关联完成端口后，同步完成也会投递完成包
+    if (ok || GetLastError() == ERROR_IO_PENDING) {
+        port.pendingIo++;
+        return;
+    }
+
+    Complete(port, PN532Result::FromTransport(TransportError::WriteFailed), std::vector<unsigned char>());
+    Settle(port);
+}
+
+void SerialReactor::StartRead(Port& port) {
+    std::memset(&port.readContext.overlapped, 0, sizeof(OVERLAPPED));
+    BOOL ok = ReadFile(port.serial.GetHandle(), port.readBuffer, sizeof(port.readBuffer),
+        NULL, &port.readContext.overlapped);
+
+    if (ok || GetLastError() == ERROR_IO_PENDING) {
+        port.pendingIo++;
+        return;
+    }
+
+    Complete(port, PN532Result::FromTransport(TransportError::NoResponse), std::vector<unsigned char>());
+}
+
+void SerialReactor::OnWriteComplete(Port& port, BOOL ok, DWORD bytes) {
+    if (port.completed) {
+        return;
+    }
+
+    if (!ok || bytes != port.current.frame.size()) {
+        Complete(port, PN532Result::FromTransport(TransportError::WriteFailed), std::vector<unsigned char>());
+        return;
+    }
+
+    port.timer->MarkWrite();
+    StartRead(port);
+}
+
+void SerialReactor::OnReadComplete(Port& port, BOOL ok, DWORD bytes) {
+    if (port.completed) {
+        return;
+    }
+
+    if (!ok) {
+        Complete(port, PN532Result::FromTransport(TransportError::NoResponse), std::vector<unsigned char>());
+        return;
+    }
+
+    if (bytes > 0) {
+        if (!port.firstByte) {
+            port.timer->MarkWait();
+            port.firstByte = true;
+        }
+        port.response.insert(port.response.end(), port.readBuffer, port.readBuffer + bytes);
+
+        std::vector<unsigned char> data;
+        if (PN532Frame::ParseFrame(port.response, data)) {
+            port.timer->MarkRead();
+            PN532Result result = PN532Frame::CheckResponse(port.current.commandCode, data);
+            if (!result.IsTransportError()) {
+                port.timer->SetStatus(result.status);
+            }
+            Complete(port, result, data);
+            return;
+        }
+
+        // ACK + 最长应答帧之后仍无法解析，认为是垃圾数据
+        if (port.response.size() > PN532Frame::MAX_FRAME_LENGTH + 6) {
+            Complete(port, PN532Result::FromTransport(TransportError::BadFrame), std::vector<unsigned char>());
+            return;
+        }
+    }
+
+    StartRead(port);
+}
+
+// 回调当前命令；仍有 I/O 未返回时先取消，等 Settle 收尾
+void SerialReactor::Complete(Port& port, const PN532Result& result, const std::vector<unsigned char>& data) {
+    PN532_TRACE_SPAN_ARG("反应器回调", "reactor", "port", port.id);
+    port.completed = true;
+    port.timer.reset();
+
+    if (port.pendingIo > 0) {
+        CancelIoEx(port.serial.GetHandle(), NULL);
+    }
+
+    Completion done = std::move(port.current.done);
+    if (done) {
+        done(result, data);
+    }
+}
+
+// 当前命令已回调且没有未返回的 I/O 时，开始下一条
+void SerialReactor::Settle(Port& port) {
+    if (port.busy && port.completed && port.pendingIo == 0) {
+        port.busy = false;
+        if (running) {
+            StartNext(port);
+        }
+    }
+}
+
+void SerialReactor::CheckDeadlines() {
+    Clock::time_point now = Clock::now();
+    for (auto& port : ports) {
+        if (port->busy && !port->completed && now >= port->deadline) {
+            TransportError error = port->response.empty() ? TransportError::NoResponse : TransportError::BadFrame;
+            Complete(*port, PN532Result::FromTransport(error), std::vector<unsigned char>());
+            Settle(*port);
+        }
+    }
+}
+
+DWORD SerialReactor::NextTimeoutMs() const {
+    bool any = false;
+    Clock::time_point nearest;
+    for (const auto& port : ports) {
+        if (port->busy && !port->completed && (!any || port->deadline < nearest)) {
+            nearest = port->deadline;
+            any = true;
+        }
+    }
+
+    if (!any) {
+        return INFINITE;
+    }
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(nearest - Clock::now()).count();
+    return remaining <= 0 ? 0 : static_cast<DWORD>(remaining + 1);
+}
@@ -0,0 +1,113 @@
+﻿#pragma once
+#include "SerialPort.h"
+#include "PN532Status.h"
+#include "CommandStats.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 异步串口反应器
+// 单个线程通过 I/O 完成端口驱动多个以重叠方式打开的串口：
+// 写命令帧 → 读到完整应答帧（自动跳过 ACK）→ 回调；每条命令有独立的截止时间，
+// 超时后取消未完成的读并以 NoResponse 回调。同一串口上的命令按提交顺序逐条执行。
+//
+// 回调在反应器线程中执行，不能阻塞；需要继续发送命令时直接在回调里调用 Exchange。
+class SerialReactor {
+public:
+    // 应答回调：data 为应答数据（D5 + 命令码+1 + 参数），失败时为空
+    using Completion = std::function<void(const PN532Result& result, const std::vector<unsigned char>& data)>;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class OpKind { Write, Read };
+
+    struct Port;
+
+    // 重叠 I/O 上下文（OVERLAPPED 必须是第一个成员）
+    struct IoContext {
+        OVERLAPPED overlapped;
+        OpKind kind;
+        Port* port;
+    };
+
+    struct Command {
+        std::vector<unsigned char> frame;
+        uint8_t commandCode;
+        uint8_t subCommand;
+        int timeoutMs;
+        Completion done;
+    };
+
+    struct Port {
+        int id;
+        std::string name;
+        SerialPort serial;
+        IoContext writeContext;
+        IoContext readContext;
+        unsigned char readBuffer[64];
+        int pendingIo;                   // 尚未完成的重叠操作数
+
+        std::deque<Command> queue;
+        bool busy;                       // 有命令在执行（含等待被取消的 I/O 返回）
+        bool completed;                  // 当前命令已回调（超时或出错后等待 I/O 收尾）
+        Command current;
+        std::vector<unsigned char> response;
+        Clock::time_point deadline;
+        std::unique_ptr<CommandTimer> timer;
+        bool firstByte;
+
+        CommandStatsRecorder stats;
+    };
+
+    HANDLE completionPort;
+    std::thread worker;
+    std::atomic<bool> running;
+
+    std::vector<std::unique_ptr<Port>> ports;  // 只在反应器线程中访问（AddPort 在 Start 之前调用）
+
+    std::mutex submitMutex;
+    std::vector<std::pair<int, Command>> submitted;
+
+    static constexpr ULONG_PTR KEY_WAKE = 1;
+    static constexpr ULONG_PTR KEY_IO = 2;
+
+    void Run();
+    void DrainSubmitted();
+    void StartNext(Port& port);
+    void StartRead(Port& port);
+    void OnWriteComplete(Port& port, BOOL ok, DWORD bytes);
+    void OnReadComplete(Port& port, BOOL ok, DWORD bytes);
+    void Complete(Port& port, const PN532Result& result, const std::vector<unsigned char>& data);
+    void Settle(Port& port);
+    void CheckDeadlines();
+    DWORD NextTimeoutMs() const;
+
+public:
+    SerialReactor();
+    ~SerialReactor();
+
+    SerialReactor(const SerialReactor&) = delete;
+    SerialReactor& operator=(const SerialReactor&) = delete;
+
+    // 打开串口并关联到完成端口（须在 Start 之前调用），返回串口编号，-1 表示失败
+    int AddPort(const std::string& portName, DWORD baud = CBR_115200);
+
+    bool Start();
+    void Stop();
+
+    size_t PortCount() const;
+
+    // 异步发送命令（command 以 D4 开头），可在任意线程调用
+    bool Exchange(int portId, const std::vector<unsigned char>& command, int timeoutMs, Completion done);
+
+    // 单个串口的命令统计
+    PN532Stats GetPortStats(int portId) const;
+};
@@ -0,0 +1,50 @@
+﻿#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// 单生产者单消费者的无锁环形队列
+// 只能有一个线程调用 Push、另一个线程调用 Pop；容量为2的幂，满时 Push 返回 false（不阻塞、不分配内存）。
+// 读写位置各占一条缓存行，生产者和消费者之间没有伪共享。
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "容量必须是2的幂");
+
+private:
+    std::array<T, Capacity> slots;
+    alignas(64) std::atomic<size_t> head;  // 下一个读取位置，只由消费者修改
+    alignas(64) std::atomic<size_t> tail;  // 下一个写入位置，只由生产者修改
+
+public:
+    SpscQueue() : slots(), head(0), tail(0) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // 生产者线程
+    bool Push(T value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (position - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots[position & (Capacity - 1)] = std::move(value);
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者线程
+    bool Pop(T& value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(slots[position & (Capacity - 1)]);
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
@@ -0,0 +1,188 @@
+﻿#pragma once
+
+// 区间(span)性能追踪，输出 Chrome trace-event JSON
+// 可在 chrome://tracing 或 https://ui.perfetto.dev 中打开
+//
+// 默认不编译，定义 PN532_ENABLE_TRACE 后启用：
+//   cl /DPN532_ENABLE_TRACE ...   或   g++ -DPN532_ENABLE_TRACE ...
+// 程序退出时写入 nfc_trace_年月日_时分秒.json，也可调用 PN532_TRACE_SAVE(文件名)
+//
+// 用法：
+//   PN532_TRACE_SPAN("读取块", "rf");
+//   PN532_TRACE_SPAN_ARG("认证", "rf", "sector", sector);
+//   PN532_TRACE_SPAN_ARGS("认证密钥", "rf", "sector", sector, "key", keyIndex);
+
+#ifdef PN532_ENABLE_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TraceRecorder {
+public:
+    struct Event {
+        const char* name;
+        const char* category;
+        int64_t startUs;
+        int64_t durationUs;
+        int tid;
+        const char* argName1;
+        int64_t argValue1;
+        const char* argName2;
+        int64_t argValue2;
+    };
+
+private:
+    std::mutex traceMutex;
+    std::vector<Event> events;
+    std::map<std::thread::id, int> threadIds;
+    std::chrono::steady_clock::time_point origin;
+    bool saved;
+
+    TraceRecorder() : origin(std::chrono::steady_clock::now()), saved(false) {
+        events.reserve(1 << 16);
+    }
+
+    // JSON字符串转义（名称均为字面量，只需处理引号和反斜杠）
+    static void WriteEscaped(std::ofstream& out, const char* text) {
+        for (const char* p = text; *p; p++) {
+            if (*p == '"' || *p == '\\') {
+                out << '\\';
+            }
+            out << *p;
+        }
+    }
+
+public:
+    static TraceRecorder& Instance() {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    ~TraceRecorder() {
+        if (!saved && !events.empty()) {
+            auto now_time_t = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            std::tm now_tm;
+            localtime_s(&now_tm, &now_time_t);
+
+            char fileName[100];
+            strftime(fileName, sizeof(fileName), "nfc_trace_%Y%m%d_%H%M%S.json", &now_tm);
+            Save(fileName);
+        }
+    }
+
+    int64_t NowUs() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void Add(const char* name, const char* category, int64_t startUs, int64_t durationUs,
+        const char* argName1, int64_t argValue1, const char* argName2, int64_t argValue2) {
+        std::lock_guard<std::mutex> lock(traceMutex);
+
+        auto id = std::this_thread::get_id();
+        auto it = threadIds.find(id);
+        int tid = 0;
+        if (it == threadIds.end()) {
+            tid = (int)threadIds.size() + 1;
+            threadIds[id] = tid;
+        }
+        else {
+            tid = it->second;
+        }
+
+        events.push_back({ name, category, startUs, durationUs, tid,
+            argName1, argValue1, argName2, argValue2 });
+    }
+
+    bool Save(const std::string& fileName) {
+        std::lock_guard<std::mutex> lock(traceMutex);
+
+        std::ofstream out(fileName);
+        if (!out.is_open()) {
+            return false;
+        }
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        for (size_t i = 0; i < events.size(); i++) {
+            const Event& e = events[i];
+            out << "{\"name\":\"";
+            WriteEscaped(out, e.name);
+            out << "\",\"cat\":\"";
+            WriteEscaped(out, e.category);
+            out << "\",\"ph\":\"X\",\"ts\":" << e.startUs
+                << ",\"dur\":" << e.durationUs
+                << ",\"pid\":1,\"tid\":" << e.tid;
+
+            if (e.argName1) {
+                out << ",\"args\":{\"" << e.argName1 << "\":" << e.argValue1;
+                if (e.argName2) {
+                    out << ",\"" << e.argName2 << "\":" << e.argValue2;
+                }
+                out << "}";
+            }
+            out << "}" << (i + 1 < events.size() ? ",\n" : "\n");
+        }
+        out << "]}\n";
+
+        saved = true;
+        return true;
+    }
+};
+
+// 作用域区间：构造时记录开始时间，析构时写入事件
+class TraceSpan {
+private:
+    const char* name;
+    const char* category;
+    const char* argName1;
+    int64_t argValue1;
+    const char* argName2;
+    int64_t argValue2;
+    int64_t startUs;
+
+public:
+    TraceSpan(const char* spanName, const char* spanCategory,
+        const char* arg1 = nullptr, int64_t value1 = 0,
+        const char* arg2 = nullptr, int64_t value2 = 0)
+        : name(spanName), category(spanCategory),
+        argName1(arg1), argValue1(value1), argName2(arg2), argValue2(value2),
+        startUs(TraceRecorder::Instance().NowUs()) {
+    }
+
+    ~TraceSpan() {
+        TraceRecorder& recorder = TraceRecorder::Instance();
+        recorder.Add(name, category, startUs, recorder.NowUs() - startUs,
+            argName1, argValue1, argName2, argValue2);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+};
+
+#define PN532_TRACE_CONCAT_INNER(a, b) a##b
+#define PN532_TRACE_CONCAT(a, b) PN532_TRACE_CONCAT_INNER(a, b)
+#define PN532_TRACE_SPAN(name, category) \
+    TraceSpan PN532_TRACE_CONCAT(traceSpan_, __LINE__)(name, category)
+#define PN532_TRACE_SPAN_ARG(name, category, argName, argValue) \
+    TraceSpan PN532_TRACE_CONCAT(traceSpan_, __LINE__)(name, category, argName, (int64_t)(argValue))
+#define PN532_TRACE_SPAN_ARGS(name, category, argName1, argValue1, argName2, argValue2) \
+    TraceSpan PN532_TRACE_CONCAT(traceSpan_, __LINE__)(name, category, \
+        argName1, (int64_t)(argValue1), argName2, (int64_t)(argValue2))
+#define PN532_TRACE_SAVE(fileName) TraceRecorder::Instance().Save(fileName)
+
+#else
+
+#define PN532_TRACE_SPAN(name, category) ((void)0)
+#define PN532_TRACE_SPAN_ARG(name, category, argName, argValue) ((void)0)
+#define PN532_TRACE_SPAN_ARGS(name, category, argName1, argValue1, argName2, argValue2) ((void)0)
+#define PN532_TRACE_SAVE(fileName) ((void)0)
+
+#endif
@@ -1,45 +1,123 @@
 ﻿#include "PN532.h"
+#include "ConsoleFrontend.h"
+#include "ReaderCommandQueue.h"
+#include "ConsoleScreen.h"
+#include "BlockFormatter.h"
+#include "ConsoleKeyReader.h"
+#include "PortMonitor.h"
+#include "PresenceDebouncer.h"
+#include "SpscQueue.h"
 #include <iostream>
 #include <thread>
 #include <conio.h>
 #include <vector>
 #include <string>
 #include <deque>
+#include <functional>
 
-// 清屏
-void ClearScreen() {
-    system("cls");
+// 主菜单画面的内容
+struct MenuState {
+    bool loggingEnabled = false;
+    bool cardPresent = false;
+    std::vector<unsigned char> uid;
+    std::vector<std::string> info;  // 启动信息（备份归档、日志文件）
+    std::string message;            // 最近一条提示
+};
+
+// 程序标题
+std::vector<std::string> TitleLines() {
+    return {
+        "================================================",
+        "         PN532 NFC读写器 - 稳定版",
+        "================================================",
+    };
 }
 
-// 显示程序标题
-void ShowTitle() {
-    std::cout << "================================================" << std::endl;
-    std::cout << "         PN532 NFC读写器 - 稳定版" << std::endl;
-    std::cout << "================================================" << std::endl;
+// 主菜单画面：标题、启动信息、操作说明、状态、卡片UID、提示
+// 每次状态变化都重新组成整屏，由 ConsoleScreen 只重写变化的行
+std::vector<std::string> ComposeMenu(const MenuState& state) {
+    std::vector<std::string> lines = TitleLines();
+    lines.insert(lines.end(), state.info.begin(), state.info.end());
+    lines.push_back("");
+    lines.push_back(" 操作说明:");
+    lines.push_back("  [R] 读取卡片数据");
+    lines.push_back("  [W] 写入卡片数据 (谨慎!)");
+    lines.push_back("  [B] 备份卡片数据 (建议写入前备份)");
+    lines.push_back("  [S] 特殊密钥读取");
+    lines.push_back("  [K] 配置密钥");
+    lines.push_back(std::string("  [L] ") + (state.loggingEnabled ? "关闭" : "开启") + "日志记录");
+    lines.push_back("  [Enter] 四中水卡金额充值");
+    lines.push_back("  [C] 清屏");
+    lines.push_back("  [Q] 退出程序");
+    lines.push_back("================================================");
+    lines.push_back("");
+    lines.push_back(state.cardPresent ? "状态: ✅ 卡片就绪" : "状态: 等待检测...");
+
+    std::string uidLine = "UID: ";
+    if (state.cardPresent && !state.uid.empty()) {
+        size_t start = uidLine.size();
+        uidLine.resize(start + state.uid.size() * 3);
+        BlockFormatter::HexSpaced(state.uid.data(), state.uid.size(), &uidLine[start]);
+    }
+    else {
+        uidLine += "-";
+    }
+    lines.push_back(uidLine);
+    lines.push_back(state.message);
+    return lines;
 }
 
-// 显示操作说明
-void ShowInstructions(PN532& nfc) {
-    std::cout << "\n 操作说明:" << std::endl;
-    std::cout << "  [R] 读取卡片数据" << std::endl;
-    std::cout << "  [W] 写入卡片数据 (谨慎!)" << std::endl;
-    std::cout << "  [B] 备份卡片数据 (建议写入前备份)" << std::endl;
-    std::cout << "  [S] 特殊密钥读取" << std::endl;
-    std::cout << "  [K] 配置密钥" << std::endl;
-    std::cout << "  [L] " << (nfc.IsLoggingEnabled() ? "关闭" : "开启") << "日志记录" << std::endl;
-    std::cout << "  [Enter] 四中水卡金额充值" << std::endl;  // 添加这一行
-    std::cout << "  [C] 清屏" << std::endl;
-    std::cout << "  [Q] 退出程序" << std::endl;
-    std::cout << "================================================" << std::endl;
+// 在 I/O 线程上执行可取消的长操作（读取、备份），等待期间按 Esc 取消
+// 操作在下一条命令前停下，已读取的部分照常输出
+void RunCancellable(ReaderCommandQueue& queue, const std::function<void(PN532&)>& action) {
+    CancellationSource cancel;
+    auto done = queue.Submit(CommandPriority::Interactive, [&](PN532& reader) {
+        ScopedOperationContext scope(reader, OperationContext(cancel.Token()));
+        action(reader);
+    });
+
+    while (done.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready) {
+        if (_kbhit() && _getch() == 27 && !cancel.IsCancelled()) {
+            cancel.Cancel();
+            std::cout << "\n正在取消..." << std::endl;
+        }
+    }
+    done.get();
 }
 
 int main() {
-    // 显示标题
-    ClearScreen();
-    ShowTitle();
+    // 显示标题（之后的初始化输出接在标题下面）
+    ConsoleScreen screen;
+    screen.Present(TitleLines());
+    MenuState menu;
 
     // 初始化PN532
     PN532 nfc;
+    ConsoleEventSink consoleSink;
+    nfc.SetEventSink(&consoleSink);
+    ConsoleFrontend frontend(nfc);
+
+    // 卡片中途拿开时保留已读到的扇区，再次放上同一张卡片只补读缺少的部分
+    PartialImageCache imageCache;
+    nfc.SetImageCache(&imageCache);
+
+    // 按设备缓存读卡器固件信息，同一个读卡器再次启动时跳过固件查询
+    ReaderInfoCache readerInfoCache;
+    readerInfoCache.Open("readers.cache");
+    nfc.SetReaderInfoCache(&readerInfoCache);
+
+    // 备份追加到同一个归档文件，打不开时退回到每次备份写单独的文件
+    BackupArchive backupArchive;
+    if (backupArchive.Open("backups.pack")) {
+        nfc.SetBackupArchive(&backupArchive);
+        menu.info.push_back("✅ 备份归档: backups.pack（" + std::to_string(backupArchive.RecordCount()) + " 份备份）");
+    }
+    if (nfc.IsLoggingEnabled()) {
+        menu.info.push_back("✅ 日志系统已启动，文件: " + nfc.GetLogFileName());
+    }
+    for (const auto& line : menu.info) {
+        std::cout << line << std::endl;
+    }
     std::cout << "\nPN532设备初始化..." << std::endl;
 
     // 询问用户如何选择串口
@@ -96,88 +174,128 @@ int main() {
 
     std::cout << "设备就绪!" << std::endl;
 
-    // 防抖机制相关变量
-    const int DEBOUNCE_COUNT = 2;  // 从3减少到2，响应更快
-    int detectCounter = 0;
-    bool cardPresent = false;
-    bool stableCardPresent = false;
-    std::vector<unsigned char> cardUID;
-    std::vector<unsigned char> lastStableUID;
-    int consecutiveFailures = 0;  // 添加连续失败计数器
-    const int MAX_FAILURES = 5;   // 最大连续失败次数
-
-    // 显示初始菜单
-    ShowInstructions(nfc);
-    std::cout << "\n状态: 等待检测..." << std::endl;
-
-    while (true) {
-        // 检测卡片
-        std::vector<unsigned char> uid;
-        bool currentDetect = nfc.DetectNFC(uid);
-
-        // 如果连续失败次数过多，尝试重新初始化
-        if (!currentDetect && cardPresent) {
-            consecutiveFailures++;
-            if (consecutiveFailures >= MAX_FAILURES) {
-                std::cout << "\n⚠️ 检测异常，尝试重新初始化..." << std::endl;
-                // 这里可以添加重新初始化逻辑
-                consecutiveFailures = 0;
-            }
+    // 界面线程只等待事件：I/O 线程把防抖后的卡片事件、按键线程把按键放进各自的无锁队列，再触发 wakeEvent，
+    // 所以按键不必等在场检测的串口交换，卡片事件也不必等按键轮询
+    HANDLE wakeEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+    PresenceDebouncer debouncer(2, 5);  // 连续2次结果相同才切换；卡片在场时连续5次检测失败报告异常
+    SpscQueue<PresenceEvent, 64> presenceEvents;
+    ConsoleKeyReader keyReader(wakeEvent);
+
+    // 读卡器由命令队列的 I/O 线程独占：空闲时后台检测卡片，按键操作优先执行
+    ReaderCommandQueue commandQueue(nfc);
+    int pollIntervalMs = 150;
+    commandQueue.SetPresencePolling(pollIntervalMs);
+    bool readerOnline = true;  // 只在 I/O 线程上使用
+    commandQueue.SetPresenceListener([&](const PresenceSample& sample) {
+        bool wake = false;
+        if (sample.readerOnline != readerOnline) {
+            readerOnline = sample.readerOnline;
+            PresenceEvent link;
+            link.type = readerOnline ? PresenceEventType::ReaderRestored : PresenceEventType::ReaderLost;
+            link.durationMs = sample.lastOutageMs;
+            wake = presenceEvents.Push(std::move(link));
         }
-        else {
-            consecutiveFailures = 0;
+
+        PresenceEvent event;
+        if (debouncer.Update(sample.detected, sample.uid, event) && presenceEvents.Push(std::move(event))) {
+            wake = true;
+        }
+        if (wake) {
+            SetEvent(wakeEvent);
         }
+    });
 
-        // 防抖逻辑
-        if (currentDetect == cardPresent) {
-            detectCounter = 0;
+    // 插入串口时让断开中的读卡器立即重连，换读卡器不用等退避间隔；监视启动失败时仍按间隔重连
+    PortMonitor portMonitor([&](const std::string&, bool attached) {
+        if (attached) {
+            commandQueue.RetryLinkNow();
         }
-        else {
-            detectCounter++;
-
-            if (detectCounter >= DEBOUNCE_COUNT) {
-                cardPresent = currentDetect;
-
-                if (cardPresent != stableCardPresent) {
-                    stableCardPresent = cardPresent;
-
-                    if (stableCardPresent) {
-                        // 卡片从无到有
-                        cardUID = uid;
-                        lastStableUID = uid;
-
-                        std::cout << "\n✅ 检测到卡片!" << std::endl;
-                        std::cout << "UID: ";
-                        for (auto b : uid) {
-                            printf("%02X ", b);
-                        }
-                        std::cout << std::endl;
-                        std::cout << "按 R 读取数据，按 S 特殊密钥读取" << std::endl;
-
-                        // 检测到卡片后立即记录
-                        nfc.LogCardInfo(uid, "卡片放置");
-                    }
-                    else {
-                        // 卡片从有到无
-                        cardUID.clear();
-                        std::cout << "\n📭 卡片已移开" << std::endl;
+    });
 
-                        // 记录卡片移开
-                        nfc.LogCardInfo(lastStableUID, "卡片移开");
-                    }
-                }
-                detectCounter = 0;
+    bool cardPresent = false;
+    std::vector<unsigned char> cardUID;
+
+    // 显示菜单；full 为 true 时清屏后整屏绘制（菜单下方有过其他输出），否则只重写变化的行
+    auto showMenu = [&](bool full) {
+        menu.loggingEnabled = nfc.IsLoggingEnabled();
+        menu.cardPresent = cardPresent;
+        menu.uid = cardUID;
+        if (full) {
+            screen.Invalidate();
+        }
+        screen.Present(ComposeMenu(menu));
+    };
+
+    // 操作结束后等待按键，回到完整的菜单
+    auto returnToMenu = [&]() {
+        std::cout << "\n按任意键继续..." << std::endl;
+        _getch();
+        menu.message.clear();
+        showMenu(true);
+    };
+
+    // 没有卡片时只在提示行说明，不暂停、不重画整屏
+    auto requireCard = [&]() {
+        menu.message = "⚠️ 请先放置卡片!";
+        showMenu(false);
+    };
+
+    menu.message = "设备就绪!";
+    showMenu(true);
+
+    commandQueue.Start();
+    keyReader.Start();
+    portMonitor.Start();
+
+    bool quit = false;
+    while (!quit) {
+        WaitForSingleObject(wakeEvent, INFINITE);
+
+        // 卡片事件
+        PresenceEvent event;
+        while (presenceEvents.Pop(event)) {
+            switch (event.type) {
+            case PresenceEventType::CardArrived:
+                cardPresent = true;
+                cardUID = event.uid;
+                menu.message = "按 R 读取数据，按 S 特殊密钥读取";
+                nfc.LogCardInfo(event.uid, "卡片放置");
+                break;
+
+            case PresenceEventType::CardRemoved:
+                cardPresent = false;
+                cardUID.clear();
+                menu.message = "📭 卡片已移开";
+                nfc.LogCardInfo(event.uid, "卡片移开");
+                break;
+
+            case PresenceEventType::DetectTrouble:
+                // 链路是否断开由命令队列的看门狗判断，断开时另有 ReaderLost 事件
+                menu.message = "⚠️ 检测异常，正在检查读卡器连接...";
+                break;
+
+            case PresenceEventType::ReaderLost:
+                menu.message = "⚠️ 读卡器连接断开，正在自动重连...";
+                break;
+
+            case PresenceEventType::ReaderRestored: {
+                char seconds[32];
+                snprintf(seconds, sizeof(seconds), "%.1f", event.durationMs / 1000.0);
+                menu.message = std::string("✅ 读卡器已重新连接（断开 ") + seconds + " 秒）";
+                break;
             }
+            }
+            showMenu(false);
         }
 
-        // 检查按键
-        if (_kbhit()) {
-            char ch = _getch();
-            ch = toupper(ch);
+        // 按键：处理完（包括操作中的输入提示）再让按键线程继续读取
+        int key = 0;
+        if (keyReader.Next(key)) {
+            char ch = static_cast<char>(toupper(key));
 
             switch (ch) {
             case 13:  // Enter 键 (ASCII 13)
-                if (stableCardPresent && !cardUID.empty()) {
+                if (cardPresent && !cardUID.empty()) {
                     std::cout << "\n警告: 特殊写入模式将修改扇区1的块5和块6!" << std::endl;
                     std::cout << "密钥配置将自动设置为:" << std::endl;
                     std::cout << "  扇区1和2: Key A/B = 112233446655" << std::endl;
@@ -186,47 +304,26 @@ int main() {
 
                     char confirm = _getch();
                     if (confirm == 'Y' || confirm == 'y') {
-                        nfc.SpecialWriteMode();
+                        commandQueue.Run(CommandPriority::Interactive, [&](PN532&) { frontend.SpecialWriteMode(); });
                     }
                     else {
                         std::cout << "\n操作取消" << std::endl;
                     }
-
-                    std::cout << "\n按任意键继续..." << std::endl;
-                    _getch();
-                    ClearScreen();
-                    ShowTitle();
-                    ShowInstructions(nfc);
-                    std::cout << "\n状态: 卡片就绪" << std::endl;
+                    returnToMenu();
                 }
                 else {
-                    std::cout << "\n请先放置卡片!" << std::endl;
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-                    ClearScreen();
-                    ShowTitle();
-                    ShowInstructions(nfc);
-                    if (stableCardPresent) {
-                        std::cout << "\n状态: 卡片就绪" << std::endl;
-                    }
-                    else {
-                        std::cout << "\n状态: 等待检测..." << std::endl;
-                    }
+                    requireCard();
                 }
                 break;
 
             case 'B':  // 备份卡片数据
                 if (cardPresent && !cardUID.empty()) {
-                    std::cout << "\n\n开始备份卡片数据..." << std::endl;
-                    nfc.BackupCardData(cardUID);
-                    std::cout << "\n按任意键继续..." << std::endl;
-                    _getch();
-                    ClearScreen();
-                    ShowTitle();
-                    ShowInstructions(nfc);
+                    std::cout << "\n\n开始备份卡片数据... (按 Esc 取消)" << std::endl;
+                    RunCancellable(commandQueue, [&](PN532& reader) { reader.BackupCardData(cardUID); });
+                    returnToMenu();
                 }
                 else {
-                    std::cout << "\n请先放置卡片!" << std::endl;
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+                    requireCard();
                 }
                 break;
 
@@ -238,135 +335,76 @@ int main() {
 
                     char confirm = _getch();
                     if (confirm == 'Y' || confirm == 'y') {
-                        nfc.WriteCardInteractive(cardUID);
+                        commandQueue.Run(CommandPriority::Interactive, [&](PN532&) { frontend.WriteCardInteractive(cardUID); });
                     }
                     else {
                         std::cout << "\n操作取消" << std::endl;
                     }
-
-                    std::cout << "\n按任意键继续..." << std::endl;
-                    _getch();
-                    ClearScreen();
-                    ShowTitle();
-                    ShowInstructions(nfc);
+                    returnToMenu();
                 }
                 else {
-                    std::cout << "\n请先放置卡片!" << std::endl;
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+                    requireCard();
                 }
                 break;
             
             case 'Q':
                 std::cout << "\n程序结束!" << std::endl;
-                return 0;
+                quit = true;
+                break;
 
             case 'C':
-                ClearScreen();
-                ShowTitle();
-                ShowInstructions(nfc);
-                if (stableCardPresent) {
-                    std::cout << "\n状态: 卡片就绪" << std::endl;
-                }
-                else {
-                    std::cout << "\n状态: 等待检测..." << std::endl;
-                }
+                menu.message.clear();
+                showMenu(true);
                 break;
 
             case 'K':
                 std::cout << "\n配置密钥..." << std::endl;
-                nfc.SetupKeysFromUserInput();
-                std::cout << "\n按任意键继续..." << std::endl;
-                _getch();
-                ClearScreen();
-                ShowTitle();
-                ShowInstructions(nfc);
-                if (stableCardPresent) {
-                    std::cout << "\n状态: 卡片就绪" << std::endl;
-                }
-                else {
-                    std::cout << "\n状态: 等待检测..." << std::endl;
-                }
+                commandQueue.Run(CommandPriority::Interactive, [&](PN532&) { frontend.SetupKeysFromUserInput(); });
+                returnToMenu();
                 break;
 
             case 'R':
-                if (stableCardPresent && !cardUID.empty()) {
+                if (cardPresent && !cardUID.empty()) {
                     std::cout << "\n读取卡片数据..." << std::endl;
-                    nfc.ReadCardDataInteractive(cardUID);
-                    std::cout << "\n按任意键继续..." << std::endl;
-                    _getch();
-                    ClearScreen();
-                    ShowTitle();
-                    ShowInstructions(nfc);
-                    std::cout << "\n状态: 卡片就绪" << std::endl;
+                    commandQueue.Run(CommandPriority::Interactive, [&](PN532&) { frontend.ReadCardDataInteractive(cardUID); });
+                    returnToMenu();
                 }
                 else {
-                    std::cout << "\n请先放置卡片!" << std::endl;
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-                    ClearScreen();
-                    ShowTitle();
-                    ShowInstructions(nfc);
-                    if (stableCardPresent) {
-                        std::cout << "\n状态: 卡片就绪" << std::endl;
-                    }
-                    else {
-                        std::cout << "\n状态: 等待检测..." << std::endl;
-                    }
+                    requireCard();
                 }
                 break;
 
             case 'S':
-                if (stableCardPresent && !cardUID.empty()) {
-                    std::cout << "\n特殊密钥读取..." << std::endl;
-                    nfc.ReadCardWithSpecialKeys(cardUID);
-                    std::cout << "\n按任意键继续..." << std::endl;
-                    _getch();
-                    ClearScreen();
-                    ShowTitle();
-                    ShowInstructions(nfc);
-                    std::cout << "\n状态: 卡片就绪" << std::endl;
+                if (cardPresent && !cardUID.empty()) {
+                    std::cout << "\n特殊密钥读取... (按 Esc 取消)" << std::endl;
+                    RunCancellable(commandQueue, [&](PN532& reader) { reader.ReadCardWithSpecialKeys(cardUID); });
+                    returnToMenu();
                 }
                 else {
-                    std::cout << "\n请先放置卡片!" << std::endl;
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-                    ClearScreen();
-                    ShowTitle();
-                    ShowInstructions(nfc);
-                    if (stableCardPresent) {
-                        std::cout << "\n状态: 卡片就绪" << std::endl;
-                    }
-                    else {
-                        std::cout << "\n状态: 等待检测..." << std::endl;
-                    }
+                    requireCard();
                 }
                 break;
 
             case 'L':
-                nfc.EnableLogging(!nfc.IsLoggingEnabled());
-                std::cout << "\n日志记录已" << (nfc.IsLoggingEnabled() ? "启用" : "禁用") << std::endl;
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
-                ClearScreen();
-                ShowTitle();
-                ShowInstructions(nfc);
-                if (stableCardPresent) {
-                    std::cout << "\n状态: 卡片就绪" << std::endl;
-                }
-                else {
-                    std::cout << "\n状态: 等待检测..." << std::endl;
-                }
+                commandQueue.Run(CommandPriority::Interactive, [](PN532& reader) { reader.EnableLogging(!reader.IsLoggingEnabled()); });
+                menu.message = std::string("日志记录已") + (nfc.IsLoggingEnabled() ? "启用" : "禁用");
+                showMenu(false);
                 break;
             }
+            keyReader.Resume();
         }
 
-        // 根据卡片状态调整延迟
-        if (stableCardPresent) {
-            // 卡片已放置，可以增加延迟，减少系统负载
-            std::this_thread::sleep_for(std::chrono::milliseconds(300));
-        }
-        else {
-            // 卡片未放置，减少延迟以快速检测
-            std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        // 根据卡片状态调整检测间隔：卡片已放置时降低频率减少系统负载，未放置时快速检测
+        int wantedInterval = cardPresent ? 300 : 150;
+        if (wantedInterval != pollIntervalMs) {
+            pollIntervalMs = wantedInterval;
+            commandQueue.SetPresencePolling(pollIntervalMs);
         }
     }
 
+    portMonitor.Stop();
+    keyReader.Stop();
+    commandQueue.Stop();
+    CloseHandle(wakeEvent);
     return 0;
 }
\ No newline at end of file
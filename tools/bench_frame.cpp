@@ -0,0 +1,224 @@
+// PN532 帧层微基准测试
+// 测量 BuildFrame / ParseFrame / CalculateChecksum 每帧耗时(ns)和每帧堆分配次数
+//
+// 编译（不依赖串口，任意平台均可）：
+//   g++ -std=c++17 -O2 -Isrc -o bench_frame tools/bench_frame.cpp src/PN532Frame.cpp
+//   cl /std:c++17 /O2 /EHsc /utf-8 /Isrc tools\bench_frame.cpp src\PN532Frame.cpp
+//
+// 用法：bench_frame [迭代次数]
+#include "PN532Frame.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+// 统计堆分配次数
+static size_t g_allocCount = 0;
+
+void* operator new(size_t size) {
+    g_allocCount++;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// 防止编译器把被测代码优化掉
+static volatile unsigned int g_sink = 0;
+
+struct BenchResult {
+    double nsPerFrame;
+    double allocsPerFrame;
+};
+
+template <typename Fn>
+BenchResult RunBench(int iterations, Fn&& fn) {
+    // 预热
+    for (int i = 0; i < iterations / 10 + 1; i++) {
+        fn();
+    }
+
+    size_t allocBefore = g_allocCount;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    size_t allocAfter = g_allocCount;
+
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    return { ns / iterations, (double)(allocAfter - allocBefore) / iterations };
+}
+
+static void PrintResult(const char* name, size_t frameSize, const BenchResult& r) {
+    printf("  %-32s %4zu 字节  %10.1f ns/帧  %6.2f 次分配/帧\n",
+        name, frameSize, r.nsPerFrame, r.allocsPerFrame);
+}
+
+// 模拟PN532应答：把数据封装成帧
+static std::vector<unsigned char> MakeResponse(const std::vector<unsigned char>& data) {
+    return PN532Frame::BuildFrame(data);
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = 200000;
+    if (argc > 1) {
+        iterations = std::atoi(argv[1]);
+        if (iterations <= 0) {
+            printf("无效的迭代次数: %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    printf("PN532 帧层微基准测试\n");
+    printf("====================\n");
+    printf("迭代次数: %d\n\n", iterations);
+
+    const std::vector<unsigned char> uid = { 0x12, 0x34, 0x56, 0x78 };
+
+    // 认证命令: D4 40 01 60 块号 + 6字节密钥 + 4字节UID
+    std::vector<unsigned char> authCmd = { 0xD4, 0x40, 0x01, 0x60, 0x04,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    authCmd.insert(authCmd.end(), uid.begin(), uid.end());
+
+    // 读取命令: D4 40 01 30 块号
+    const std::vector<unsigned char> readCmd = { 0xD4, 0x40, 0x01, 0x30, 0x04 };
+
+    // 写入命令: D4 40 01 A0 块号 + 16字节数据
+    std::vector<unsigned char> writeCmd = { 0xD4, 0x40, 0x01, 0xA0, 0x05 };
+    for (int i = 0; i < 16; i++) {
+        writeCmd.push_back((unsigned char)i);
+    }
+
+    // 最大帧: 255字节数据 -> 262字节帧
+    std::vector<unsigned char> maxCmd = { 0xD4, 0x40, 0x01 };
+    while (maxCmd.size() < PN532Frame::MAX_DATA_LENGTH) {
+        maxCmd.push_back((unsigned char)maxCmd.size());
+    }
+
+    struct Case {
+        const char* name;
+        const std::vector<unsigned char>* data;
+    };
+    const Case cases[] = {
+        { "认证 (auth)", &authCmd },
+        { "读块 (read)", &readCmd },
+        { "写块 (write)", &writeCmd },
+        { "最大帧 (max)", &maxCmd },
+    };
+
+    printf("[CalculateChecksum]\n");
+    for (const auto& c : cases) {
+        BenchResult r = RunBench(iterations, [&]() {
+            g_sink += PN532Frame::CalculateChecksum(*c.data);
+        });
+        PrintResult(c.name, c.data->size(), r);
+    }
+
+    printf("\n[BuildFrame]\n");
+    for (const auto& c : cases) {
+        BenchResult r = RunBench(iterations, [&]() {
+            std::vector<unsigned char> frame = PN532Frame::BuildFrame(*c.data);
+            g_sink += frame.back();
+        });
+        PrintResult(c.name, c.data->size() + 7, r);
+    }
+
+    // 应答帧：ACK帧 + 应答信息帧（与串口实际收到的数据一致）
+    const std::vector<unsigned char> ack = { 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00 };
+
+    std::vector<unsigned char> authResp = { 0xD5, 0x41, 0x00 };
+    std::vector<unsigned char> readResp = { 0xD5, 0x41, 0x00 };
+    for (int i = 0; i < 16; i++) {
+        readResp.push_back((unsigned char)(0xA0 + i));
+    }
+    std::vector<unsigned char> maxResp = { 0xD5, 0x41, 0x00 };
+    while (maxResp.size() < PN532Frame::MAX_DATA_LENGTH) {
+        maxResp.push_back((unsigned char)maxResp.size());
+    }
+
+    struct ParseCase {
+        std::string name;
+        std::vector<unsigned char> input;
+        bool expectOk;
+    };
+    std::vector<ParseCase> parseCases;
+
+    auto addParseCases = [&](const char* name, const std::vector<unsigned char>& resp) {
+        std::vector<unsigned char> frame = MakeResponse(resp);
+
+        // 干净输入：ACK + 应答帧
+        std::vector<unsigned char> clean = ack;
+        clean.insert(clean.end(), frame.begin(), frame.end());
+        parseCases.push_back({ std::string(name) + " 干净", clean, true });
+
+        // 噪声输入：垃圾前缀（含伪起始码）+ ACK + 应答帧
+        std::vector<unsigned char> noisy = { 0x55, 0x00, 0xFF, 0x03, 0x10, 0xD5, 0x7E,
+            0x00, 0xFF, 0xFF, 0x01, 0xD5, 0xAA, 0x00, 0x00, 0xFF, 0x02 };
+        for (int i = 0; i < 32; i++) {
+            noisy.push_back((unsigned char)(i * 37 + 11));
+        }
+        noisy.insert(noisy.end(), clean.begin(), clean.end());
+        parseCases.push_back({ std::string(name) + " 噪声前缀", noisy, true });
+
+        // 分包输入：只收到前半帧（应解析失败，需等待后续数据）
+        std::vector<unsigned char> head(clean.begin(), clean.begin() + clean.size() / 2);
+        parseCases.push_back({ std::string(name) + " 分包(前半)", head, false });
+    };
+
+    addParseCases("认证应答", authResp);
+    addParseCases("读块应答", readResp);
+    addParseCases("最大帧应答", maxResp);
+
+    printf("\n[ParseFrame]\n");
+    bool allOk = true;
+    for (const auto& c : parseCases) {
+        std::vector<unsigned char> out;
+        if (PN532Frame::ParseFrame(c.input, out) != c.expectOk) {
+            printf("  ❌ %s: 解析结果与预期不符\n", c.name.c_str());
+            allOk = false;
+            continue;
+        }
+
+        BenchResult r = RunBench(iterations, [&]() {
+            std::vector<unsigned char> data;
+            g_sink += PN532Frame::ParseFrame(c.input, data) ? 1u : 0u;
+        });
+        PrintResult(c.name.c_str(), c.input.size(), r);
+    }
+
+    // 分包重组：先解析前半帧失败，拼接后半帧后再次解析（模拟串口分两次读到一帧）
+    printf("\n[ParseFrame 分包重组]\n");
+    const std::vector<unsigned char>* splitSources[] = { &authResp, &readResp, &maxResp };
+    const char* splitNames[] = { "认证应答 两次读取", "读块应答 两次读取", "最大帧应答 两次读取" };
+    for (int k = 0; k < 3; k++) {
+        std::vector<unsigned char> full = ack;
+        std::vector<unsigned char> frame = MakeResponse(*splitSources[k]);
+        full.insert(full.end(), frame.begin(), frame.end());
+        std::vector<unsigned char> head(full.begin(), full.begin() + full.size() / 2);
+        std::vector<unsigned char> tail(full.begin() + full.size() / 2, full.end());
+
+        BenchResult r = RunBench(iterations, [&]() {
+            std::vector<unsigned char> buffer = head;
+            std::vector<unsigned char> data;
+            if (!PN532Frame::ParseFrame(buffer, data)) {
+                buffer.insert(buffer.end(), tail.begin(), tail.end());
+                g_sink += PN532Frame::ParseFrame(buffer, data) ? 1u : 0u;
+            }
+        });
+        PrintResult(splitNames[k], full.size(), r);
+    }
+
+    printf("\n%s\n", allOk ? "✅ 基准测试完成" : "❌ 部分用例解析结果错误");
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+// 卡片转储查询工具
+// 比较两个转储、查看某张卡片历次备份之间的变化、把一个转储与归档中同一张卡片的每次备份比较、
+// 在整个备份归档中按块内容查找
+//
+// 编译（Windows）：
+//   cl /std:c++17 /O2 /EHsc /utf-8 /Isrc tools\dump_query.cpp src\BackupArchive.cpp src\CardDumpFile.cpp src\CardImage.cpp src\CardImageDiff.cpp
+//
+// 用法：
+//   dump_query diff <转储A> <转储B>                      转储可以是 .pn532、.mfd 或 backup_*.txt
+//   dump_query history <归档> <UID>                      每次备份相对上一次的变化，UID 如 de ad be ef
+//   dump_query against <转储> <归档>                     转储相对归档中同一UID每次备份的变化
+//   dump_query find <归档> <块号> <模式> [--latest]      模式如 "00 ?? 1f"，? 表示任意半字节
+//
+// 归档以只读方式打开，读卡程序正在运行、追加备份时也可以查询
+#include "BackupArchive.h"
+#include "CardDumpFile.h"
+#include "CardImageDiff.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static std::string HexBytes(const unsigned char* data, size_t size) {
+    std::string text;
+    char byte[4];
+    for (size_t i = 0; i < size; i++) {
+        snprintf(byte, sizeof(byte), i + 1 < size ? "%02X " : "%02X", data[i]);
+        text += byte;
+    }
+    return text;
+}
+
+static std::string FormatTime(int64_t timestamp) {
+    std::time_t value = static_cast<std::time_t>(timestamp);
+    std::tm tm;
+    localtime_s(&tm, &value);
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm);
+    return text;
+}
+
+static bool ParseUid(const std::string& text, std::vector<unsigned char>& uid) {
+    BlockPattern pattern;
+    if (!BlockPattern::Parse(text, pattern)) {
+        return false;
+    }
+    uid.clear();
+    for (size_t i = 0; i < 16 && pattern.mask[i] == 0xFF; i++) {
+        uid.push_back(pattern.value[i]);
+    }
+    return !uid.empty() && uid.size() <= CardImage::MAX_UID;
+}
+
+// 打印差异：变化的字节用 ^^ 标出
+static void PrintDiff(const CardImage& before, const CardImage& after) {
+    std::vector<BlockDiff> diffs = CardImageDiff::Diff(before, after);
+    if (diffs.empty()) {
+        printf("  (没有变化)\n");
+        return;
+    }
+    for (const BlockDiff& diff : diffs) {
+        printf("  块 %3d (扇区 %2d)\n", diff.block, CardImage::SectorOfBlock(diff.block));
+        printf("    前: %s\n", diff.knownBefore ? HexBytes(before.Block(diff.block).data(), 16).c_str() : "(未读到)");
+        printf("    后: %s\n", diff.knownAfter ? HexBytes(after.Block(diff.block).data(), 16).c_str() : "(未读到)");
+        if (diff.knownBefore && diff.knownAfter) {
+            std::string marks;
+            for (int i = 0; i < 16; i++) {
+                marks += (diff.changedBytes & (1 << i)) ? "^^ " : "   ";
+            }
+            printf("        %s\n", marks.c_str());
+        }
+    }
+}
+
+static int RunDiff(const char* first, const char* second) {
+    CardImage before;
+    CardImage after;
+    if (!CardDumpFile::Load(first, before)) {
+        printf("无法载入: %s\n", first);
+        return 2;
+    }
+    if (!CardDumpFile::Load(second, after)) {
+        printf("无法载入: %s\n", second);
+        return 2;
+    }
+    printf("%s → %s\n", first, second);
+    PrintDiff(before, after);
+    return 0;
+}
+
+static int RunHistory(const char* archivePath, const char* uidText) {
+    std::vector<unsigned char> uid;
+    if (!ParseUid(uidText, uid)) {
+        printf("无效的UID: %s\n", uidText);
+        return 1;
+    }
+    BackupArchive archive;
+    if (!archive.Open(archivePath, true)) {
+        printf("无法打开归档: %s\n", archivePath);
+        return 2;
+    }
+
+    // History 最新的在前，按时间顺序比较相邻两次备份
+    std::vector<ArchiveEntry> entries = archive.History(uid);
+    if (entries.empty()) {
+        printf("归档中没有这张卡片\n");
+        return 0;
+    }
+    CardImage previous;
+    for (size_t i = entries.size(); i-- > 0;) {
+        CardImage image;
+        if (!archive.Load(entries[i].offset, image)) {
+            printf("读取记录失败 (位置 %llu)\n", static_cast<unsigned long long>(entries[i].offset));
+            return 2;
+        }
+        printf("\n[%s]%s  %d/%d 个扇区\n", FormatTime(entries[i].timestamp).c_str(), entries[i].complete ? "" : " (不完整)",
+            image.KnownSectorCount(), image.SectorCount());
+        if (i + 1 < entries.size()) {
+            PrintDiff(previous, image);
+        }
+        previous = image;
+    }
+    return 0;
+}
+
+static int RunAgainst(const char* dumpPath, const char* archivePath) {
+    CardImage dump;
+    if (!CardDumpFile::Load(dumpPath, dump)) {
+        printf("无法载入: %s\n", dumpPath);
+        return 2;
+    }
+    std::vector<unsigned char> uid = dump.Uid();
+    if (uid.empty()) {
+        printf("转储中没有UID: %s\n", dumpPath);
+        return 1;
+    }
+    BackupArchive archive;
+    if (!archive.Open(archivePath, true)) {
+        printf("无法打开归档: %s\n", archivePath);
+        return 2;
+    }
+
+    std::vector<ArchiveEntry> entries = archive.History(uid);
+    if (entries.empty()) {
+        printf("归档中没有这张卡片 (UID %s)\n", HexBytes(uid.data(), uid.size()).c_str());
+        return 0;
+    }
+
+    // 按时间顺序，每次备份作为"前"，转储作为"后"
+    size_t identical = 0;
+    for (size_t i = entries.size(); i-- > 0;) {
+        CardImage image;
+        if (!archive.Load(entries[i].offset, image)) {
+            printf("读取记录失败 (位置 %llu)\n", static_cast<unsigned long long>(entries[i].offset));
+            return 2;
+        }
+        printf("\n[%s]%s → %s\n", FormatTime(entries[i].timestamp).c_str(), entries[i].complete ? "" : " (不完整)", dumpPath);
+        if (CardImageDiff::Diff(image, dump).empty()) {
+            identical++;
+        }
+        PrintDiff(image, dump);
+    }
+
+    printf("\nUID %s 共 %zu 份备份，与转储相同的 %zu 份\n", HexBytes(uid.data(), uid.size()).c_str(),
+        entries.size(), identical);
+    return 0;
+}
+
+static int RunFind(const char* archivePath, const char* blockText, const char* patternText, bool latestOnly) {
+    int block = std::atoi(blockText);
+    BlockPattern pattern;
+    if (block < 0 || block >= CardImage::MAX_BLOCKS || !BlockPattern::Parse(patternText, pattern)) {
+        printf("无效的块号或模式\n");
+        return 1;
+    }
+    BackupArchive archive;
+    if (!archive.Open(archivePath, true)) {
+        printf("无法打开归档: %s\n", archivePath);
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t matched = 0;
+    uint64_t examined = archive.FindBlockMatches(block, pattern,
+        [&matched](const ArchiveEntry& entry, const std::vector<unsigned char>& uid) {
+            matched++;
+            printf("  %s  UID %s%s\n", FormatTime(entry.timestamp).c_str(), HexBytes(uid.data(), uid.size()).c_str(),
+                entry.complete ? "" : " (不完整)");
+            return true;
+        }, latestOnly);
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\n检查 %llu 份备份，匹配 %llu 份，耗时 %.1f ms\n",
+        static_cast<unsigned long long>(examined), static_cast<unsigned long long>(matched), elapsedMs);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 4 && std::strcmp(argv[1], "diff") == 0) {
+        return RunDiff(argv[2], argv[3]);
+    }
+    if (argc == 4 && std::strcmp(argv[1], "history") == 0) {
+        return RunHistory(argv[2], argv[3]);
+    }
+    if (argc == 4 && std::strcmp(argv[1], "against") == 0) {
+        return RunAgainst(argv[2], argv[3]);
+    }
+    if ((argc == 5 || argc == 6) && std::strcmp(argv[1], "find") == 0) {
+        bool latestOnly = argc == 6 && std::strcmp(argv[5], "--latest") == 0;
+        return RunFind(argv[2], argv[3], argv[4], latestOnly);
+    }
+
+    printf("用法:\n");
+    printf("  dump_query diff <转储A> <转储B>\n");
+    printf("  dump_query history <归档> <UID>\n");
+    printf("  dump_query against <转储> <归档>\n");
+    printf("  dump_query find <归档> <块号> <模式> [--latest]\n");
+    return 1;
+}
@@ -0,0 +1,59 @@
+// 备份归档导出工具
+// 把备份归档（backups.pack）中的全部备份导出为 JSON Lines 或与 BackupCardData 相同的文本，供审计和其他工具处理
+//
+// 编译（Windows）：
+//   cl /std:c++17 /O2 /EHsc /utf-8 /Isrc tools\export_archive.cpp src\ArchiveExporter.cpp src\BackupArchive.cpp src\BlockFormatter.cpp src\CardDumpFile.cpp src\CardImage.cpp src\CardImageDiff.cpp
+//
+// 用法：export_archive <归档> <输出> [--text] [--latest] [--threads N]
+//   默认输出一个 .jsonl 文件；--text 时 <输出> 为目录，按归档顺序写出 export_00000.txt、export_00001.txt ...
+//   --latest 只导出每张卡片的最新备份；--threads 默认为 CPU 核数
+//   归档以只读方式打开，读卡程序运行时也可以导出
+#include "ArchiveExporter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    ExportOptions options;
+    std::string packPath;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--text") == 0) {
+            options.format = ExportFormat::Text;
+        }
+        else if (std::strcmp(argv[i], "--latest") == 0) {
+            options.latestOnly = true;
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        }
+        else if (packPath.empty()) {
+            packPath = argv[i];
+        }
+        else {
+            options.output = argv[i];
+        }
+    }
+
+    if (packPath.empty() || options.output.empty()) {
+        printf("用法: export_archive <归档> <输出> [--text] [--latest] [--threads N]\n");
+        return 1;
+    }
+
+    BackupArchive archive;
+    if (!archive.Open(packPath, true)) {
+        printf("❌ 无法打开归档: %s\n", packPath.c_str());
+        return 2;
+    }
+
+    ExportStats stats;
+    bool ok = ArchiveExporter::Export(archive, options, &stats);
+    printf("%s 已导出 %llu 份备份（%llu 份读取失败），%llu 个文件，%.1f MB\n", ok ? "✅" : "❌",
+        static_cast<unsigned long long>(stats.records), static_cast<unsigned long long>(stats.failed),
+        static_cast<unsigned long long>(stats.files), stats.bytes / 1048576.0);
+    if (stats.elapsedMs > 0) {
+        printf("   %u 个线程，耗时 %.1f ms（%.0f 份/秒）\n", stats.threads, stats.elapsedMs,
+            stats.records * 1000.0 / stats.elapsedMs);
+    }
+    return ok ? 0 : 2;
+}
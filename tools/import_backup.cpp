@@ -0,0 +1,98 @@
+// 旧版文本备份转换工具
+// 把 BackupCardData 写出的 backup_*.txt 转换为二进制转储（.pn532，见 src/CardDumpFile.h），
+// 也可以顺带导出标准 .mfd，供其他 MIFARE 工具使用
+//
+// 编译（不依赖串口，任意平台均可）：
+//   g++ -std=c++17 -O2 -Isrc -o import_backup tools/import_backup.cpp src/CardDumpFile.cpp src/CardImage.cpp
+//   cl /std:c++17 /O2 /EHsc /utf-8 /Isrc tools\import_backup.cpp src\CardDumpFile.cpp src\CardImage.cpp
+//
+// 用法：import_backup [--mfd] <backup_*.txt 或目录>...
+//   指定目录时转换其中所有 backup_*.txt；输出文件与输入同名，扩展名改为 .pn532 / .mfd
+#include "CardDumpFile.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static bool IsLegacyBackup(const fs::path& path) {
+    std::string name = path.filename().string();
+    return name.size() > 11 && name.compare(0, 7, "backup_") == 0 &&
+        name.compare(name.size() - 4, 4, ".txt") == 0;
+}
+
+static bool ConvertOne(const fs::path& input, bool writeMfd) {
+    CardImage image;
+    int64_t timestamp = 0;
+    DumpFormat format;
+    if (!CardDumpFile::Load(input.string(), image, &timestamp, &format) || format != DumpFormat::LegacyText) {
+        printf("  ❌ %s: 不是有效的文本备份\n", input.string().c_str());
+        return false;
+    }
+
+    fs::path output = input;
+    output.replace_extension(".pn532");
+    if (!CardDumpFile::Save(output.string(), image, timestamp)) {
+        printf("  ❌ %s: 写入失败\n", output.string().c_str());
+        return false;
+    }
+    if (writeMfd) {
+        fs::path mfd = input;
+        mfd.replace_extension(".mfd");
+        if (!CardDumpFile::SaveMfd(mfd.string(), image)) {
+            printf("  ❌ %s: 写入失败\n", mfd.string().c_str());
+            return false;
+        }
+    }
+
+    printf("  ✅ %s: %d/%d 个扇区, %d 个块\n", input.filename().string().c_str(),
+        image.KnownSectorCount(), image.SectorCount(), image.KnownBlockCount());
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    bool writeMfd = false;
+    std::vector<fs::path> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--mfd") == 0) {
+            writeMfd = true;
+            continue;
+        }
+
+        fs::path path(argv[i]);
+        std::error_code error;
+        if (fs::is_directory(path, error)) {
+            for (const auto& entry : fs::directory_iterator(path, error)) {
+                if (entry.is_regular_file() && IsLegacyBackup(entry.path())) {
+                    inputs.push_back(entry.path());
+                }
+            }
+        }
+        else {
+            inputs.push_back(path);
+        }
+    }
+
+    if (inputs.empty()) {
+        printf("用法: import_backup [--mfd] <backup_*.txt 或目录>...\n");
+        return 1;
+    }
+
+    printf("PN532 文本备份转换\n");
+    printf("==================\n");
+
+    auto start = std::chrono::steady_clock::now();
+    int converted = 0;
+    for (const auto& input : inputs) {
+        if (ConvertOne(input, writeMfd)) {
+            converted++;
+        }
+    }
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\n已转换 %d/%zu 个文件，耗时 %.1f ms\n", converted, inputs.size(), elapsedMs);
+    return converted == static_cast<int>(inputs.size()) ? 0 : 2;
+}